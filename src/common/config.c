@@ -60,6 +60,12 @@ struct nla_policy joolnl_pool4_entry_policy[JNLAP4_COUNT] = {
 	[JNLAP4_PREFIX] = { .type = NLA_NESTED },
 	[JNLAP4_PORT_MIN] = { .type = NLA_U16 },
 	[JNLAP4_PORT_MAX] = { .type = NLA_U16 },
+	[JNLAP4_USED] = { .type = NLA_U32 },
+};
+
+struct nla_policy joolnl_mark_range_policy[JNLAMR_COUNT] = {
+	[JNLAMR_LOW] = { .type = NLA_U32 },
+	[JNLAMR_HIGH] = { .type = NLA_U32 },
 };
 
 struct nla_policy joolnl_bib_entry_policy[JNLAB_COUNT] = {
@@ -80,6 +86,12 @@ struct nla_policy joolnl_session_entry_policy[JNLASE_COUNT] = {
 	[JNLASE_EXPIRATION] = { .type = NLA_U32 },
 };
 
+struct nla_policy joolnl_talker_policy[JNLATK_COUNT] = {
+	[JNLATK_PREFIX] = { .type = NLA_NESTED },
+	[JNLATK_REQUESTS] = { .type = NLA_U32 },
+	[JNLATK_SESSIONS] = { .type = NLA_U32 },
+};
+
 struct nla_policy siit_globals_policy[JNLAG_COUNT] = {
 	[JNLAG_ENABLED] = { .type = NLA_U8 },
 	[JNLAG_POOL6] = { .type = NLA_NESTED },
@@ -89,6 +101,10 @@ struct nla_policy siit_globals_policy[JNLAG_COUNT] = {
 	[JNLAG_RESET_TOS] = { .type = NLA_U8 },
 	[JNLAG_TOS] = { .type = NLA_U8 },
 	[JNLAG_PLATEAUS] = { .type = NLA_NESTED },
+	[JNLAG_ICMP_ERRORS_RATE] = { .type = NLA_U32 },
+	[JNLAG_ICMP_ERRORS_BURST] = { .type = NLA_U32 },
+	[JNLAG_LATENCY_HISTOGRAMS] = { .type = NLA_U8 },
+	[JNLAG_STATS_PUSH_INTERVAL] = { .type = NLA_U32 },
 	[JNLAG_COMPUTE_CSUM_ZERO] = { .type = NLA_U8 },
 	[JNLAG_HAIRPIN_MODE] = { .type = NLA_U8 },
 	[JNLAG_RANDOMIZE_ERROR_ADDR] = { .type = NLA_U8 },
@@ -105,6 +121,10 @@ struct nla_policy nat64_globals_policy[JNLAG_COUNT] = {
 	[JNLAG_RESET_TOS] = { .type = NLA_U8 },
 	[JNLAG_TOS] = { .type = NLA_U8 },
 	[JNLAG_PLATEAUS] = { .type = NLA_NESTED },
+	[JNLAG_ICMP_ERRORS_RATE] = { .type = NLA_U32 },
+	[JNLAG_ICMP_ERRORS_BURST] = { .type = NLA_U32 },
+	[JNLAG_LATENCY_HISTOGRAMS] = { .type = NLA_U8 },
+	[JNLAG_STATS_PUSH_INTERVAL] = { .type = NLA_U32 },
 	[JNLAG_DROP_ICMP6_INFO] = { .type = NLA_U8 },
 	[JNLAG_SRC_ICMP6_BETTER] = { .type = NLA_U8 },
 	[JNLAG_F_ARGS] = { .type = NLA_U8 },
@@ -115,15 +135,32 @@ struct nla_policy nat64_globals_policy[JNLAG_COUNT] = {
 	[JNLAG_TTL_ICMP] = { .type = NLA_U32 },
 	[JNLAG_BIB_LOGGING] = { .type = NLA_U8 },
 	[JNLAG_SESSION_LOGGING] = { .type = NLA_U8 },
+	[JNLAG_RING_LOGGING] = { .type = NLA_U8 },
 	[JNLAG_DROP_BY_ADDR] = { .type = NLA_U8 },
 	[JNLAG_DROP_EXTERNAL_TCP] = { .type = NLA_U8 },
 	[JNLAG_MAX_STORED_PKTS] = { .type = NLA_U32 },
+	[JNLAG_PBA_BLOCK_SIZE] = { .type = NLA_U32 },
+	[JNLAG_PBA_PREFIX_LEN] = { .type = NLA_U8 },
+	[JNLAG_PBA_DET_PREFIX] = { .type = NLA_NESTED },
+	[JNLAG_SESSION_QUOTA] = { .type = NLA_U32 },
+	[JNLAG_SESSION_QUOTA_PREFIX_LEN] = { .type = NLA_U8 },
+	[JNLAG_VIRTUAL_REASSEMBLY] = { .type = NLA_U8 },
+	[JNLAG_MAX_STORED_FRAGS] = { .type = NLA_U32 },
+	[JNLAG_LOCK_STATISTICS] = { .type = NLA_U8 },
 	[JNLAG_JOOLD_ENABLED] = { .type = NLA_U8 },
 	[JNLAG_JOOLD_FLUSH_ASAP] = { .type = NLA_U8 },
 	[JNLAG_JOOLD_FLUSH_DEADLINE] = { .type = NLA_U32 },
 	[JNLAG_JOOLD_CAPACITY] = { .type = NLA_U32 },
 	[JNLAG_JOOLD_MAX_PAYLOAD] = { .type = NLA_U32 },
 	[JNLAG_JOOLD_MAX_SESSIONS_PER_PACKET] = { .type = NLA_U32 },
+	[JNLAG_JOOLD_TCP_MIN_AGE] = { .type = NLA_U32 },
+	[JNLAG_JOOLD_UDP_MIN_AGE] = { .type = NLA_U32 },
+	[JNLAG_JOOLD_ICMP_MIN_AGE] = { .type = NLA_U32 },
+	[JNLAG_JOOLD_TCP_MIN_PKTS] = { .type = NLA_U32 },
+	[JNLAG_JOOLD_UDP_MIN_PKTS] = { .type = NLA_U32 },
+	[JNLAG_JOOLD_ICMP_MIN_PKTS] = { .type = NLA_U32 },
+	[JNLAG_JOOLD_TCP_STATES] = { .type = NLA_U8 },
+	[JNLAG_JOOLD_MARKS] = { .type = NLA_NESTED },
 };
 
 int iname_validate(const char *iname, bool allow_null)
@@ -150,11 +187,17 @@ int xt_validate(xlator_type xt)
 
 int xf_validate(xlator_framework xf)
 {
-#ifdef XTABLES_DISABLED
-	return (xf == XF_NETFILTER) ? 0 : -EINVAL;
-#else
-	return (xf == XF_NETFILTER || xf == XF_IPTABLES) ? 0 : -EINVAL;
+	switch (xf) {
+	case XF_NETFILTER:
+	case XF_INGRESS:
+		return 0;
+#ifndef XTABLES_DISABLED
+	case XF_IPTABLES:
+		return 0;
 #endif
+	}
+
+	return -EINVAL;
 }
 
 xlator_type xlator_flags2xt(xlator_flags flags)
@@ -164,7 +207,7 @@ xlator_type xlator_flags2xt(xlator_flags flags)
 
 xlator_framework xlator_flags2xf(xlator_flags flags)
 {
-	return flags & 0x0C;
+	return flags & XF_ANY;
 }
 
 char const *xt2str(xlator_type xt)
@@ -16,6 +16,8 @@
 
 #define JOOLNL_FAMILY "Jool"
 #define JOOLNL_MULTICAST_GRP_NAME "joold"
+#define JOOLNL_NATLOG_GRP_NAME "natlog"
+#define JOOLNL_STATS_GRP_NAME "stats"
 
 #define JOOLNL_HDR_MAGIC "jool"
 #define JOOLNL_HDR_MAGIC_LEN 4
@@ -31,6 +33,8 @@ enum joolnl_operation {
 	JNLOP_ADDRESS_QUERY46,
 
 	JNLOP_STATS_FOREACH,
+	JNLOP_STATS_LATENCY,
+	JNLOP_STATS_LOCKS,
 
 	JNLOP_GLOBAL_FOREACH,
 	JNLOP_GLOBAL_UPDATE,
@@ -49,12 +53,15 @@ enum joolnl_operation {
 	JNLOP_POOL4_ADD,
 	JNLOP_POOL4_RM,
 	JNLOP_POOL4_FLUSH,
+	JNLOP_POOL4_USAGE,
+	JNLOP_POOL4_ITERATIONS,
 
 	JNLOP_BIB_FOREACH,
 	JNLOP_BIB_ADD,
 	JNLOP_BIB_RM,
 
 	JNLOP_SESSION_FOREACH,
+	JNLOP_SESSION_TOP,
 
 	JNLOP_FILE_HANDLE,
 
@@ -77,6 +84,13 @@ enum joolnl_attr_root {
 	JNLAR_PROTO,
 	JNLAR_ATOMIC_INIT,
 	JNLAR_ATOMIC_END,
+	JNLAR_NATLOG_RECORDS,
+	JNLAR_LATENCY,
+	JNLAR_STATS_SEQ,
+	JNLAR_STATS_KEYFRAME,
+	JNLAR_STATS_DELTAS,
+	JNLAR_POOL4_ITERATIONS,
+	JNLAR_LOCKS,
 	JNLAR_COUNT,
 #define JNLAR_MAX (JNLAR_COUNT - 1)
 };
@@ -144,6 +158,9 @@ extern struct nla_policy joolnl_instance_entry_policy[JNLAIE_COUNT];
 
 enum joolnl_attr_instance_status {
 	JNLAIS_STATUS = 1,
+	/* Only if the instance is alive. (See struct xlator.generation.) */
+	JNLAIS_GENERATION,
+	JNLAIS_PADDING,
 	JNLAIS_COUNT,
 #define JNLAIS_MAX (JNLAIS_COUNT - 1)
 };
@@ -151,6 +168,7 @@ enum joolnl_attr_instance_status {
 enum joolnl_attr_instance_add {
 	JNLAIA_XF = 1,
 	JNLAIA_POOL6,
+	JNLAIA_DEVICES,
 	JNLAIA_COUNT,
 #define JNLAIA_MAX (JNLAIA_COUNT - 1)
 };
@@ -172,12 +190,23 @@ enum joolnl_attr_pool4 {
 	JNLAP4_PREFIX,
 	JNLAP4_PORT_MIN,
 	JNLAP4_PORT_MAX,
+	/* Only in JNLOP_POOL4_USAGE responses. */
+	JNLAP4_USED,
 	JNLAP4_COUNT,
 #define JNLAP4_MAX (JNLAP4_COUNT - 1)
 };
 
 extern struct nla_policy joolnl_pool4_entry_policy[JNLAP4_COUNT];
 
+enum joolnl_attr_mark_range {
+	JNLAMR_LOW = 1,
+	JNLAMR_HIGH,
+	JNLAMR_COUNT,
+#define JNLAMR_MAX (JNLAMR_COUNT - 1)
+};
+
+extern struct nla_policy joolnl_mark_range_policy[JNLAMR_COUNT];
+
 enum joolnl_attr_bib {
 	JNLAB_SRC6 = 1,
 	JNLAB_SRC4,
@@ -205,6 +234,16 @@ enum joolnl_attr_session {
 
 extern struct nla_policy joolnl_session_entry_policy[JNLASE_COUNT];
 
+enum joolnl_attr_talker {
+	JNLATK_PREFIX = 1,
+	JNLATK_REQUESTS,
+	JNLATK_SESSIONS,
+	JNLATK_COUNT,
+#define JNLATK_MAX (JNLATK_COUNT - 1)
+};
+
+extern struct nla_policy joolnl_talker_policy[JNLATK_COUNT];
+
 enum joolnl_attr_address_query {
 	JNLAAQ_ADDR6 = 1,
 	JNLAAQ_ADDR4,
@@ -224,6 +263,10 @@ enum joolnl_attr_global {
 	JNLAG_RESET_TOS,
 	JNLAG_TOS,
 	JNLAG_PLATEAUS,
+	JNLAG_ICMP_ERRORS_RATE,
+	JNLAG_ICMP_ERRORS_BURST,
+	JNLAG_LATENCY_HISTOGRAMS,
+	JNLAG_STATS_PUSH_INTERVAL,
 
 	/* SIIT */
 	JNLAG_COMPUTE_CSUM_ZERO,
@@ -245,7 +288,16 @@ enum joolnl_attr_global {
 	JNLAG_TTL_ICMP,
 	JNLAG_BIB_LOGGING,
 	JNLAG_SESSION_LOGGING,
+	JNLAG_RING_LOGGING,
 	JNLAG_MAX_STORED_PKTS,
+	JNLAG_PBA_BLOCK_SIZE,
+	JNLAG_PBA_PREFIX_LEN,
+	JNLAG_PBA_DET_PREFIX,
+	JNLAG_SESSION_QUOTA,
+	JNLAG_SESSION_QUOTA_PREFIX_LEN,
+	JNLAG_VIRTUAL_REASSEMBLY,
+	JNLAG_MAX_STORED_FRAGS,
+	JNLAG_LOCK_STATISTICS,
 
 	/* joold */
 	JNLAG_JOOLD_ENABLED,
@@ -254,6 +306,14 @@ enum joolnl_attr_global {
 	JNLAG_JOOLD_CAPACITY,
 	JNLAG_JOOLD_MAX_PAYLOAD,
 	JNLAG_JOOLD_MAX_SESSIONS_PER_PACKET,
+	JNLAG_JOOLD_TCP_MIN_AGE,
+	JNLAG_JOOLD_UDP_MIN_AGE,
+	JNLAG_JOOLD_ICMP_MIN_AGE,
+	JNLAG_JOOLD_TCP_MIN_PKTS,
+	JNLAG_JOOLD_UDP_MIN_PKTS,
+	JNLAG_JOOLD_ICMP_MIN_PKTS,
+	JNLAG_JOOLD_TCP_STATES,
+	JNLAG_JOOLD_MARKS,
 
 	/* Needs to be last */
 	JNLAG_COUNT,
@@ -408,6 +468,8 @@ struct bib_config {
 
 	bool bib_logging;
 	bool session_logging;
+	/** Send the above to the NAT event log instead of the kernel log? */
+	bool ring_logging;
 
 	/** Use Address-Dependent Filtering? */
 	bool drop_by_addr;
@@ -415,10 +477,45 @@ struct bib_config {
 	bool drop_external_tcp;
 
 	__u32 max_stored_pkts;
+
+	/**
+	 * Port Block Allocation (RFC 7422): Number of ports each block lends
+	 * to a subscriber. Zero disables PBA.
+	 */
+	__u32 pba_block_size;
+	/** Length of the IPv6 prefix that identifies a PBA subscriber. */
+	__u8 pba_prefix_len;
+	/**
+	 * If set, PBA is deterministic (RFC 7422 section 2.3): Each subscriber
+	 * contained in this prefix is always masked using the same block.
+	 */
+	struct config_prefix6 pba_det_prefix;
+
+	/**
+	 * Maximum number of sessions (per protocol) each subscriber can
+	 * initiate. Zero disables the quota.
+	 */
+	__u32 session_quota;
+	/**
+	 * Length of the IPv6 prefix that identifies a subscriber, for the
+	 * purposes of @session_quota and the top talkers.
+	 */
+	__u8 session_quota_prefix_len;
 };
 
 #define JOOLD_MAX_PAYLOAD 2048
 
+/**
+ * Conditions a session needs to meet before joold synchronizes it for the
+ * first time.
+ */
+struct joold_sync_filter {
+	/** Milliseconds the session needs to have existed. */
+	__u32 min_age;
+	/** Number of packets the session needs to have translated. */
+	__u32 min_pkts;
+};
+
 struct joold_config {
 	/** Is joold enabled on this Jool instance? */
 	bool enabled;
@@ -460,6 +557,27 @@ struct joold_config {
 	 * code. (I guess I'm missing something.)
 	 */
 	__u32 max_sessions_per_pkt;
+
+	/*
+	 * Sync filters.
+	 *
+	 * Most short-lived sessions (DNS over UDP, pings) die long before the
+	 * other instances could ever use them, so synchronizing them is mostly
+	 * a waste of bandwidth. These let the user skip them.
+	 */
+	struct {
+		struct joold_sync_filter tcp;
+		struct joold_sync_filter udp;
+		struct joold_sync_filter icmp;
+	} filter;
+	/** Bitmask of the TCP states (1 << tcp_state) that get synchronized. */
+	__u8 tcp_states;
+	/**
+	 * Only sessions whose BIB entries were masked by pool4 entries whose
+	 * marks belong to one of these ranges get synchronized.
+	 * Empty means "all of them."
+	 */
+	struct mark_ranges marks;
 };
 
 /**
@@ -517,6 +635,28 @@ struct jool_globals {
 	 */
 	struct mtu_plateaus plateaus;
 
+	/**
+	 * Maximum number of ICMP errors (of the same type) Jool is allowed to
+	 * send towards a given /24 or /64, per second. Zero means unlimited.
+	 * See mod/common/icmp_ratelimit.h.
+	 */
+	__u32 icmp_errors_rate;
+	/**
+	 * Maximum number of ICMP errors that can be sent in a row towards the
+	 * same prefix, before icmp_errors_rate kicks in.
+	 */
+	__u32 icmp_errors_burst;
+	/**
+	 * Measure how long each translation stage takes?
+	 * See mod/common/stats.h.
+	 */
+	bool latency_histograms;
+	/**
+	 * Seconds between stat pushes to the JOOLNL_STATS_GRP_NAME multicast
+	 * group. Zero disables them.
+	 */
+	__u32 stats_push_interval;
+
 	union {
 		struct {
 			/**
@@ -572,6 +712,24 @@ struct jool_globals {
 			 * https://github.com/NICMx/Jool/issues/212
 			 */
 			bool handle_rst_during_fin_rcv;
+			/**
+			 * Translate fragments as they arrive, rather than
+			 * letting the kernel reassemble them first?
+			 * See mod/common/db/fragdb.h.
+			 */
+			bool virtual_reassembly;
+			/**
+			 * Maximum number of fragments that can be stored
+			 * (while they wait for their datagram's first fragment)
+			 * at any given time.
+			 */
+			__u32 max_stored_frags;
+			/**
+			 * Count the acquisitions and measure the hold times of
+			 * the BIB, pool4 and joold locks?
+			 * See mod/common/lockstat.h.
+			 */
+			bool lock_statistics;
 
 			struct bib_config bib;
 			struct joold_config joold;
@@ -67,11 +67,19 @@
 #define DEFAULT_FILTER_ICMPV6_INFO false
 #define DEFAULT_DROP_EXTERNAL_CONNECTIONS false
 #define DEFAULT_MAX_STORED_PKTS 10
+#define DEFAULT_PBA_BLOCK_SIZE 0
+#define DEFAULT_PBA_PREFIX_LEN 128
+#define DEFAULT_SESSION_QUOTA 0
+#define DEFAULT_SESSION_QUOTA_PREFIX_LEN 128
 #define DEFAULT_SRC_ICMP6ERRS_BETTER true
 #define DEFAULT_F_ARGS 0b1011
 #define DEFAULT_HANDLE_FIN_RCV_RST false
+#define DEFAULT_VIRTUAL_REASSEMBLY false
+#define DEFAULT_MAX_STORED_FRAGS 256
+#define DEFAULT_LOCK_STATISTICS false
 #define DEFAULT_BIB_LOGGING false
 #define DEFAULT_SESSION_LOGGING false
+#define DEFAULT_RING_LOGGING false
 
 #define DEFAULT_INSTANCE_ENABLED true
 #define DEFAULT_RESET_TRAFFIC_CLASS false
@@ -83,6 +91,10 @@
 #define DEFAULT_RANDOMIZE_RFC6791 true
 #define DEFAULT_MTU_PLATEAUS { 65535, 32000, 17914, 8166, 4352, 2002, 1492, \
 		1006, 508, 296, 68 }
+#define DEFAULT_ICMP_ERRORS_RATE 100
+#define DEFAULT_ICMP_ERRORS_BURST 100
+#define DEFAULT_LATENCY_HISTOGRAMS false
+#define DEFAULT_STATS_PUSH_INTERVAL 0
 #define DEFAULT_JOOLD_ENABLED false
 #define DEFAULT_JOOLD_DEADLINE 2
 #define DEFAULT_JOOLD_CAPACITY 512
@@ -111,6 +123,10 @@
  * computed the hard way. Run the joold unit test to find them in dmesg.
  */
 #define DEFAULT_JOOLD_MAX_SESSIONS_PER_PKT ((1500 - 40 - 8 - 4) / 40)
+#define DEFAULT_JOOLD_MIN_AGE 0
+#define DEFAULT_JOOLD_MIN_PKTS 0
+/* All of them. */
+#define DEFAULT_JOOLD_TCP_STATES ((1 << TCP_STATE_COUNT) - 1)
 
 /* -- IPv6 Pool -- */
 
@@ -0,0 +1,151 @@
+#include "deterministic.h"
+
+#ifdef __KERNEL__
+#include <linux/errno.h>
+#include <linux/string.h>
+#else
+#include <errno.h>
+#include <string.h>
+#endif
+
+static unsigned int get_addr6_bit(struct in6_addr const *addr, unsigned int pos)
+{
+	return (addr->s6_addr[pos >> 3] >> (7 - (pos & 7))) & 1;
+}
+
+static void set_addr6_bit(struct in6_addr *addr, unsigned int pos,
+		unsigned int value)
+{
+	__u8 mask = 1 << (7 - (pos & 7));
+
+	if (value)
+		addr->s6_addr[pos >> 3] |= mask;
+	else
+		addr->s6_addr[pos >> 3] &= ~mask;
+}
+
+/**
+ * Returns whether @det (pba-deterministic-prefix) and @plen
+ * (pba-prefix-length) can be used together.
+ */
+int det_validate(struct ipv6_prefix const *det, __u8 plen)
+{
+	if (plen > 128 || plen < det->len)
+		return -EINVAL;
+	if (plen - det->len > DET_MAX_INDEX_BITS)
+		return -EINVAL;
+	return 0;
+}
+
+/**
+ * Computes the index of the subscriber @addr belongs to.
+ * Returns -ESRCH if @addr is not contained in @det.
+ */
+int det_subscriber_index(struct ipv6_prefix const *det, __u8 plen,
+		struct in6_addr const *addr, __u64 *index)
+{
+	unsigned int i;
+
+	if (det_validate(det, plen))
+		return -EINVAL;
+
+	for (i = 0; i < det->len; i++)
+		if (get_addr6_bit(addr, i) != get_addr6_bit(&det->addr, i))
+			return -ESRCH;
+
+	*index = 0;
+	for (i = det->len; i < plen; i++)
+		*index = (*index << 1) | get_addr6_bit(addr, i);
+
+	return 0;
+}
+
+/**
+ * Reverse of det_subscriber_index(): Computes the prefix of subscriber @index.
+ * Assumes det_validate() succeeds.
+ */
+void det_subscriber_prefix(struct ipv6_prefix const *det, __u8 plen,
+		__u64 index, struct ipv6_prefix *subscriber)
+{
+	unsigned int i;
+
+	memset(&subscriber->addr, 0, sizeof(subscriber->addr));
+	for (i = 0; i < det->len; i++)
+		set_addr6_bit(&subscriber->addr, i, get_addr6_bit(&det->addr, i));
+	for (i = plen; i > det->len; i--) {
+		set_addr6_bit(&subscriber->addr, i - 1, index & 1);
+		index >>= 1;
+	}
+	subscriber->len = plen;
+}
+
+static unsigned int range_blocks(struct ipv4_range const *range,
+		unsigned int size)
+{
+	return port_range_count(&range->ports) / size;
+}
+
+/**
+ * Computes the first transport address of block @index.
+ *
+ * @ranges is the mark's pool4, in pool4 order. Blocks are aligned to the
+ * beginning of their range, and the range remainders that can't hold a whole
+ * block are skipped. (Same as mask_domain_next_block().)
+ *
+ * Returns -ESRCH if the ranges do not have that many blocks.
+ */
+int det_nth_block(struct ipv4_range const *ranges, unsigned int count,
+		unsigned int size, __u64 index, struct ipv4_transport_addr *first)
+{
+	unsigned int blocks;
+	unsigned int i;
+
+	if (size == 0)
+		return -EINVAL;
+
+	for (i = 0; i < count; i++) {
+		blocks = range_blocks(&ranges[i], size);
+		if (index < blocks) {
+			first->l3 = ranges[i].prefix.addr;
+			first->l4 = ranges[i].ports.min + index * size;
+			return 0;
+		}
+		index -= blocks;
+	}
+
+	return -ESRCH;
+}
+
+/**
+ * Reverse of det_nth_block(): Computes the index and first transport address
+ * of the block @taddr belongs to.
+ *
+ * Returns -ESRCH if @taddr does not belong to any block.
+ */
+int det_block_index(struct ipv4_range const *ranges, unsigned int count,
+		unsigned int size, struct ipv4_transport_addr const *taddr,
+		__u64 *index, struct ipv4_transport_addr *first)
+{
+	unsigned int block;
+	unsigned int i;
+
+	if (size == 0)
+		return -EINVAL;
+
+	*index = 0;
+	for (i = 0; i < count; i++) {
+		if (ranges[i].prefix.addr.s_addr == taddr->l3.s_addr
+				&& port_range_contains(&ranges[i].ports, taddr->l4)) {
+			block = (taddr->l4 - ranges[i].ports.min) / size;
+			if (block >= range_blocks(&ranges[i], size))
+				return -ESRCH;
+			*index += block;
+			first->l3 = taddr->l3;
+			first->l4 = ranges[i].ports.min + block * size;
+			return 0;
+		}
+		*index += range_blocks(&ranges[i], size);
+	}
+
+	return -ESRCH;
+}
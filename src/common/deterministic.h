@@ -0,0 +1,39 @@
+#ifndef SRC_COMMON_DETERMINISTIC_H_
+#define SRC_COMMON_DETERMINISTIC_H_
+
+/**
+ * @file
+ * Deterministic NAT64 arithmetic (RFC 7422 section 2.3).
+ *
+ * When pba-deterministic-prefix is set, the subscribers are the
+ * pba-prefix-length prefixes contained in it. Subscriber N (counting from the
+ * beginning of pba-deterministic-prefix) is always masked using block N, where
+ * the blocks are the pba-block-size aligned port blocks of the mark's pool4
+ * ranges, in pool4 order.
+ *
+ * Because the mapping only depends on configuration, it does not need to be
+ * logged; the kernel module uses these functions to compute it, and userspace
+ * uses them to reverse it.
+ *
+ * Both the kernel module and the userspace application can see this file.
+ */
+
+#include "common/types.h"
+
+/** Maximum number of index bits between the two prefix lengths. */
+#define DET_MAX_INDEX_BITS 64
+
+int det_validate(struct ipv6_prefix const *det, __u8 plen);
+
+int det_subscriber_index(struct ipv6_prefix const *det, __u8 plen,
+		struct in6_addr const *addr, __u64 *index);
+void det_subscriber_prefix(struct ipv6_prefix const *det, __u8 plen,
+		__u64 index, struct ipv6_prefix *subscriber);
+
+int det_nth_block(struct ipv4_range const *ranges, unsigned int count,
+		unsigned int size, __u64 index, struct ipv4_transport_addr *first);
+int det_block_index(struct ipv4_range const *ranges, unsigned int count,
+		unsigned int size, struct ipv4_transport_addr const *taddr,
+		__u64 *index, struct ipv4_transport_addr *first);
+
+#endif /* SRC_COMMON_DETERMINISTIC_H_ */
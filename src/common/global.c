@@ -7,6 +7,9 @@
 #include "mod/common/db/global.h"
 #else
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include "usr/util/str_utils.h"
 #include "usr/nl/attribute.h"
@@ -14,6 +17,7 @@
 #include "usr/nl/json.h"
 #endif
 #include "common/constants.h"
+#include "common/session.h"
 
 #ifdef __KERNEL__
 
@@ -103,6 +107,12 @@ static int raw2nl_plateaus(struct joolnl_global_meta const *meta, void *raw,
 	return jnla_put_plateaus(skb, meta->id, raw);
 }
 
+static int raw2nl_mark_ranges(struct joolnl_global_meta const *meta,
+		void *raw, struct sk_buff *skb)
+{
+	return jnla_put_mark_ranges(skb, meta->id, raw);
+}
+
 static int raw2nl_prefix6(struct joolnl_global_meta const *meta, void *raw,
 		struct sk_buff *skb)
 {
@@ -142,6 +152,11 @@ static int nl2raw_plateaus(struct nlattr *attr, void *raw, bool force)
 	return jnla_get_plateaus(attr, raw);
 }
 
+static int nl2raw_mark_ranges(struct nlattr *attr, void *raw, bool force)
+{
+	return jnla_get_mark_ranges(attr, raw);
+}
+
 static int validate_prefix6791v4(struct config_prefix4 *prefix, bool force)
 {
 	int error;
@@ -284,8 +299,92 @@ static int nl2raw_f_args(struct nlattr *attr, void *raw, bool force)
 	return 0;
 }
 
+static int nl2raw_pba_block_size(struct nlattr *attr, void *raw, bool force)
+{
+	__u32 size;
+
+	size = nla_get_u32(attr);
+	if (size > 65536u) {
+		log_err("pba-block-size (%u) is out of range. (0-%u)", size,
+				65536u);
+		return -EINVAL;
+	}
+
+	*((__u32 *)raw) = size;
+	return 0;
+}
+
+static int nl2raw_pba_prefix_len(struct nlattr *attr, void *raw, bool force)
+{
+	__u8 len;
+
+	len = nla_get_u8(attr);
+	if (len > 128u) {
+		log_err("pba-prefix-length (%u) is out of range. (0-%u)", len,
+				128u);
+		return -EINVAL;
+	}
+
+	*((__u8 *)raw) = len;
+	return 0;
+}
+
+static int nl2raw_session_quota_prefix_len(struct nlattr *attr, void *raw,
+		bool force)
+{
+	__u8 len;
+
+	len = nla_get_u8(attr);
+	if (len > 128u) {
+		log_err("session-quota-prefix-length (%u) is out of range. (0-%u)",
+				len, 128u);
+		return -EINVAL;
+	}
+
+	*((__u8 *)raw) = len;
+	return 0;
+}
+
+static int nl2raw_pba_det_prefix(struct nlattr *attr, void *raw, bool force)
+{
+	struct config_prefix6 *prefix = raw;
+	int error;
+
+	error = jnla_get_prefix6_optional(attr, "PBA deterministic prefix",
+			prefix);
+	if (error)
+		return error;
+
+	return prefix->set ? prefix6_validate(&prefix->prefix) : 0;
+}
+
+static int nl2raw_tcp_states(struct nlattr *attr, void *raw, bool force)
+{
+	__u8 states;
+
+	states = nla_get_u8(attr);
+	if (states >> TCP_STATE_COUNT) {
+		log_err("ss-tcp-states (%u) contains unknown states. (Max: %u)",
+				states, (1u << TCP_STATE_COUNT) - 1);
+		return -EINVAL;
+	}
+
+	*((__u8 *)raw) = states;
+	return 0;
+}
+
 #else
 
+static char const *const TCP_STATE_NAMES[TCP_STATE_COUNT] = {
+	[ESTABLISHED] = "ESTABLISHED",
+	[V6_INIT] = "V6_INIT",
+	[V4_INIT] = "V4_INIT",
+	[V4_FIN_RCV] = "V4_FIN_RCV",
+	[V6_FIN_RCV] = "V6_FIN_RCV",
+	[V4_FIN_V6_FIN_RCV] = "V4_FIN_V6_FIN_RCV",
+	[TRANS] = "TRANS",
+};
+
 static void print_bool(void *value, bool csv)
 {
 	bool bvalue = *((bool *)value);
@@ -405,6 +504,53 @@ static void print_fargs(void *value, bool csv)
 	printf("DstPort:%u",  (uvalue >> 0) & 1);
 }
 
+static void print_tcp_states(void *value, bool csv)
+{
+	__u8 states = *((__u8 *)value);
+	bool first = true;
+	unsigned int i;
+
+	if (csv)
+		printf("\"");
+	else if (!states)
+		printf("(none)");
+
+	for (i = 0; i < TCP_STATE_COUNT; i++) {
+		if (!(states & (1u << i)))
+			continue;
+		printf("%s%s", first ? "" : ",", TCP_STATE_NAMES[i]);
+		first = false;
+	}
+
+	if (csv)
+		printf("\"");
+}
+
+static void print_mark_ranges(void *value, bool csv)
+{
+	struct mark_ranges *ranges = value;
+	struct mark_range *range;
+	unsigned int i;
+
+	if (csv)
+		printf("\"");
+	else if (ranges->count == 0)
+		printf("(all)");
+
+	for (i = 0; i < ranges->count; i++) {
+		range = &ranges->ranges[i];
+		if (range->min == range->max)
+			printf("%u", range->min);
+		else
+			printf("%u-%u", range->min, range->max);
+		if (i != ranges->count - 1)
+			printf(",");
+	}
+
+	if (csv)
+		printf("\"");
+}
+
 static struct jool_result nl2raw_bool(struct nlattr *attr, void *raw)
 {
 	*((bool *)raw) = nla_get_u8(attr);
@@ -428,6 +574,11 @@ static struct jool_result nl2raw_plateaus(struct nlattr *attr, void *raw)
 	return nla_get_plateaus(attr, raw);
 }
 
+static struct jool_result nl2raw_mark_ranges(struct nlattr *attr, void *raw)
+{
+	return nla_get_mark_ranges(attr, raw);
+}
+
 static struct jool_result nl2raw_prefix6(struct nlattr *attr, void *raw)
 {
 	struct config_prefix6 *prefix = raw;
@@ -539,6 +690,59 @@ static struct jool_result str2nl_plateaus(enum joolnl_attr_global id,
 			: result_success();
 }
 
+static struct jool_result str2nl_tcp_states(enum joolnl_attr_global id,
+		char const *str, struct nl_msg *msg)
+{
+	char *str_copy;
+	char *token;
+	__u8 states;
+	unsigned int i;
+
+	str_copy = strdup(str);
+	if (!str_copy)
+		return result_from_enomem();
+
+	states = 0;
+	for (token = strtok(str_copy, ","); token; token = strtok(NULL, ",")) {
+		for (i = 0; i < TCP_STATE_COUNT; i++) {
+			if (strcasecmp(token, TCP_STATE_NAMES[i]) == 0) {
+				states |= 1u << i;
+				break;
+			}
+		}
+
+		if (i == TCP_STATE_COUNT) {
+			free(str_copy);
+			return result_from_error(
+				-EINVAL,
+				"'%s' is not a TCP state.\n"
+				"Available options: ESTABLISHED, V6_INIT, V4_INIT, V4_FIN_RCV, V6_FIN_RCV, V4_FIN_V6_FIN_RCV, TRANS",
+				token
+			);
+		}
+	}
+
+	free(str_copy);
+	return (nla_put_u8(msg, id, states) < 0)
+			? joolnl_err_msgsize()
+			: result_success();
+}
+
+static struct jool_result str2nl_mark_ranges(enum joolnl_attr_global id,
+		char const *str, struct nl_msg *msg)
+{
+	struct mark_ranges ranges;
+	struct jool_result result;
+
+	result = str_to_mark_ranges(str, &ranges);
+	if (result.error)
+		return result;
+
+	return (nla_put_mark_ranges(msg, id, &ranges) < 0)
+			? joolnl_err_msgsize()
+			: result_success();
+}
+
 static struct jool_result str2nl_prefix6(enum joolnl_attr_global id,
 		char const *str, struct nl_msg *msg)
 {
@@ -733,6 +937,19 @@ static struct joolnl_global_type gt_plateaus = {
 	USERSPACE_FUNCTIONS(print_plateaus, str2nl_plateaus, json2nl_plateaus, nl2raw_plateaus)
 };
 
+static struct joolnl_global_type gt_tcp_states = {
+	.name = "List of TCP states separated by commas",
+	.candidates = "ESTABLISHED V6_INIT V4_INIT V4_FIN_RCV V6_FIN_RCV V4_FIN_V6_FIN_RCV TRANS",
+	KERNEL_FUNCTIONS(raw2nl_u8, nl2raw_tcp_states)
+	USERSPACE_FUNCTIONS(print_tcp_states, str2nl_tcp_states, json2nl_string, nl2raw_u8)
+};
+
+static struct joolnl_global_type gt_mark_ranges = {
+	.name = "List of marks or mark ranges (min-max) separated by commas",
+	KERNEL_FUNCTIONS(raw2nl_mark_ranges, nl2raw_mark_ranges)
+	USERSPACE_FUNCTIONS(print_mark_ranges, str2nl_mark_ranges, json2nl_string, nl2raw_mark_ranges)
+};
+
 static struct joolnl_global_type gt_prefix6 = {
 	.name = "IPv6 prefix",
 	KERNEL_FUNCTIONS(raw2nl_prefix6, NULL)
@@ -816,6 +1033,34 @@ static const struct joolnl_global_meta globals_metadata[] = {
 		.doc = "Set the list of plateaus for ICMPv4 Fragmentation Neededs with MTU unset.",
 		.offset = offsetof(struct jool_globals, plateaus),
 		.xt = XT_ANY,
+	}, {
+		.id = JNLAG_ICMP_ERRORS_RATE,
+		.name = "icmp-errors-rate",
+		.type = &gt_uint32,
+		.doc = "Set the number of ICMP errors per second Jool can send towards the same /24 or /64. (0 = unlimited)",
+		.offset = offsetof(struct jool_globals, icmp_errors_rate),
+		.xt = XT_ANY,
+	}, {
+		.id = JNLAG_ICMP_ERRORS_BURST,
+		.name = "icmp-errors-burst",
+		.type = &gt_uint32,
+		.doc = "Set the number of ICMP errors Jool can send in a row towards the same /24 or /64.",
+		.offset = offsetof(struct jool_globals, icmp_errors_burst),
+		.xt = XT_ANY,
+	}, {
+		.id = JNLAG_LATENCY_HISTOGRAMS,
+		.name = "latency-histograms",
+		.type = &gt_bool,
+		.doc = "Measure how long each translation stage takes? (See `jool stats latency`.)",
+		.offset = offsetof(struct jool_globals, latency_histograms),
+		.xt = XT_ANY,
+	}, {
+		.id = JNLAG_STATS_PUSH_INTERVAL,
+		.name = "stats-push-interval",
+		.type = &gt_uint32,
+		.doc = "Set the number of seconds between stat pushes to the stats Netlink multicast group. (0 = disabled)",
+		.offset = offsetof(struct jool_globals, stats_push_interval),
+		.xt = XT_ANY,
 	}, {
 		.id = JNLAG_COMPUTE_CSUM_ZERO,
 		.name = "amend-udp-checksum-zero",
@@ -961,6 +1206,13 @@ static const struct joolnl_global_meta globals_metadata[] = {
 		.doc = "Log sessions as they are created and destroyed?",
 		.offset = offsetof(struct jool_globals, nat64.bib.session_logging),
 		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_RING_LOGGING,
+		.name = "logging-ring",
+		.type = &gt_bool,
+		.doc = "Send the BIB and session logs to the binary NAT event log (`session log`) instead of the kernel log?",
+		.offset = offsetof(struct jool_globals, nat64.bib.ring_logging),
+		.xt = XT_NAT64,
 	}, {
 		.id = JNLAG_MAX_STORED_PKTS,
 		.name = "maximum-simultaneous-opens",
@@ -968,6 +1220,74 @@ static const struct joolnl_global_meta globals_metadata[] = {
 		.doc = "Set the maximum allowable 'simultaneous' Simultaneos Opens of TCP connections.",
 		.offset = offsetof(struct jool_globals, nat64.bib.max_stored_pkts),
 		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_PBA_BLOCK_SIZE,
+		.name = "pba-block-size",
+		.type = &gt_uint32,
+		.doc = "Lend pool4 ports to each subscriber in blocks of this many contiguous ports (Port Block Allocation). Zero disables PBA.",
+		.offset = offsetof(struct jool_globals, nat64.bib.pba_block_size),
+		.xt = XT_NAT64,
+#ifdef __KERNEL__
+		.nl2raw = nl2raw_pba_block_size,
+#endif
+	}, {
+		.id = JNLAG_PBA_PREFIX_LEN,
+		.name = "pba-prefix-length",
+		.type = &gt_uint8,
+		.doc = "Length of the IPv6 prefix that identifies a PBA subscriber. (128 means one subscriber per IPv6 address.)",
+		.offset = offsetof(struct jool_globals, nat64.bib.pba_prefix_len),
+		.xt = XT_NAT64,
+#ifdef __KERNEL__
+		.nl2raw = nl2raw_pba_prefix_len,
+#endif
+	}, {
+		.id = JNLAG_PBA_DET_PREFIX,
+		.name = "pba-deterministic-prefix",
+		.type = &gt_prefix6,
+		.doc = "Make PBA deterministic: Each pba-prefix-length subscriber from this prefix is always masked using the same block. (RFC 7422)",
+		.offset = offsetof(struct jool_globals, nat64.bib.pba_det_prefix),
+		.xt = XT_NAT64,
+#ifdef __KERNEL__
+		.nl2raw = nl2raw_pba_det_prefix,
+#endif
+	}, {
+		.id = JNLAG_SESSION_QUOTA,
+		.name = "session-quota",
+		.type = &gt_uint32,
+		.doc = "Maximum number of sessions (per protocol) each subscriber can initiate. Zero disables the quota.",
+		.offset = offsetof(struct jool_globals, nat64.bib.session_quota),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_SESSION_QUOTA_PREFIX_LEN,
+		.name = "session-quota-prefix-length",
+		.type = &gt_uint8,
+		.doc = "Length of the IPv6 prefix that identifies a subscriber, for session-quota and `session top`. (128 means one subscriber per IPv6 address.)",
+		.offset = offsetof(struct jool_globals, nat64.bib.session_quota_prefix_len),
+		.xt = XT_NAT64,
+#ifdef __KERNEL__
+		.nl2raw = nl2raw_session_quota_prefix_len,
+#endif
+	}, {
+		.id = JNLAG_VIRTUAL_REASSEMBLY,
+		.name = "virtual-reassembly",
+		.type = &gt_bool,
+		.doc = "Translate fragments as they arrive, instead of reassembling them first? (Can only be set while the instance is being created.)",
+		.offset = offsetof(struct jool_globals, nat64.virtual_reassembly),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_MAX_STORED_FRAGS,
+		.name = "maximum-stored-fragments",
+		.type = &gt_uint32,
+		.doc = "Set the maximum number of fragments that can wait for their first fragment at the same time.",
+		.offset = offsetof(struct jool_globals, nat64.max_stored_frags),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_LOCK_STATISTICS,
+		.name = "lock-statistics",
+		.type = &gt_bool,
+		.doc = "Count the acquisitions and measure the hold times of the BIB, pool4 and joold locks? (See `jool stats locks`.)",
+		.offset = offsetof(struct jool_globals, nat64.lock_statistics),
+		.xt = XT_NAT64,
 	}, {
 		.id = JNLAG_JOOLD_ENABLED,
 		.name = "ss-enabled",
@@ -1010,6 +1330,62 @@ static const struct joolnl_global_meta globals_metadata[] = {
 		.doc = "Maximum number of sessions to send, per joold packet.",
 		.offset = offsetof(struct jool_globals, nat64.joold.max_sessions_per_pkt),
 		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_TCP_MIN_AGE,
+		.name = "ss-tcp-min-age",
+		.type = &gt_timeout,
+		.doc = "Do not synchronize TCP sessions younger than this (HH:MM:SS.mmm).",
+		.offset = offsetof(struct jool_globals, nat64.joold.filter.tcp.min_age),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_UDP_MIN_AGE,
+		.name = "ss-udp-min-age",
+		.type = &gt_timeout,
+		.doc = "Do not synchronize UDP sessions younger than this (HH:MM:SS.mmm).",
+		.offset = offsetof(struct jool_globals, nat64.joold.filter.udp.min_age),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_ICMP_MIN_AGE,
+		.name = "ss-icmp-min-age",
+		.type = &gt_timeout,
+		.doc = "Do not synchronize ICMP sessions younger than this (HH:MM:SS.mmm).",
+		.offset = offsetof(struct jool_globals, nat64.joold.filter.icmp.min_age),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_TCP_MIN_PKTS,
+		.name = "ss-tcp-min-packets",
+		.type = &gt_uint32,
+		.doc = "Do not synchronize TCP sessions that have translated fewer packets than this.",
+		.offset = offsetof(struct jool_globals, nat64.joold.filter.tcp.min_pkts),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_UDP_MIN_PKTS,
+		.name = "ss-udp-min-packets",
+		.type = &gt_uint32,
+		.doc = "Do not synchronize UDP sessions that have translated fewer packets than this.",
+		.offset = offsetof(struct jool_globals, nat64.joold.filter.udp.min_pkts),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_ICMP_MIN_PKTS,
+		.name = "ss-icmp-min-packets",
+		.type = &gt_uint32,
+		.doc = "Do not synchronize ICMP sessions that have translated fewer packets than this.",
+		.offset = offsetof(struct jool_globals, nat64.joold.filter.icmp.min_pkts),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_TCP_STATES,
+		.name = "ss-tcp-states",
+		.type = &gt_tcp_states,
+		.doc = "Only synchronize TCP sessions that are in one of these states.",
+		.offset = offsetof(struct jool_globals, nat64.joold.tcp_states),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_MARKS,
+		.name = "ss-marks",
+		.type = &gt_mark_ranges,
+		.doc = "Only synchronize sessions masked by pool4 entries whose marks belong to these ranges. (Empty means all of them.)",
+		.offset = offsetof(struct jool_globals, nat64.joold.marks),
+		.xt = XT_NAT64,
 	},
 };
 
@@ -0,0 +1,58 @@
+#ifndef SRC_COMMON_NATLOG_H_
+#define SRC_COMMON_NATLOG_H_
+
+/**
+ * @file
+ * The NAT event log's record format.
+ *
+ * When logging-ring is enabled, BIB and session events are not printed; they
+ * are instead queued (as these fixed-size records) in per-CPU rings, which are
+ * periodically drained into the JOOLNL_NATLOG_GRP_NAME Netlink multicast
+ * group. Each message carries one JNLAR_NATLOG_RECORDS attribute, which is a
+ * plain array of records. The instance is the one named by the message's
+ * joolnlhdr.
+ *
+ * Both the kernel module and the userspace application can see this file.
+ * All fields are in network byte order, so the userspace collector can write
+ * them to disk as they are.
+ *
+ * Port block events (Port Block Allocation; see pba-block-size) reuse the
+ * record as follows: @src6 is the subscriber's prefix and @src6_port is its
+ * length, @src4 and @src4_port are the block's first transport address, and
+ * @dst4_port is the block's last port. The remaining fields are zero.
+ */
+
+#include "common/types.h"
+
+enum natlog_event {
+	NATLOG_BIB_ADD = 1,
+	NATLOG_BIB_RM,
+	NATLOG_SESSION_ADD,
+	NATLOG_SESSION_RM,
+	NATLOG_BLOCK_ADD,
+	NATLOG_BLOCK_RM,
+};
+
+struct natlog_record {
+	/** Nanoseconds since the epoch. */
+	__be64 timestamp;
+
+	struct in6_addr src6;
+	/** Zero in BIB events. */
+	struct in6_addr dst6;
+	struct in_addr src4;
+	/** Zero in BIB events. */
+	struct in_addr dst4;
+	__be16 src6_port;
+	__be16 dst6_port;
+	__be16 src4_port;
+	__be16 dst4_port;
+
+	/** IANA protocol number (IPPROTO_TCP, IPPROTO_UDP or IPPROTO_ICMP). */
+	__u8 proto;
+	/** enum natlog_event. */
+	__u8 event;
+	__u8 padding[6];
+};
+
+#endif /* SRC_COMMON_NATLOG_H_ */
@@ -34,8 +34,39 @@ typedef enum tcp_state {
 	V6_FIN_RCV,
 	/** Both sides issued a FIN. Packets can still flow for a short time. */
 	V4_FIN_V6_FIN_RCV,
-	/** The session might die in a short while. */
+	/** The session might die in a short while. Needs to be last. */
 	TRANS,
 } tcp_state;
 
+/*
+ * Not a trailing enumerator, so the switches over tcp_state don't need to
+ * handle it.
+ */
+#define TCP_STATE_COUNT (TRANS + 1)
+
+/*
+ * Layout of the session records the kernel module exchanges with joold.
+ * (See jnla_put_session_joold().) Offsets are in bytes; every field is in
+ * network byte order.
+ *
+ * dst6 is not included; the receiving end infers it from dst4.
+ */
+/* struct in6_addr */
+#define JOOLD_SESSION_SRC6 0
+/* struct in_addr */
+#define JOOLD_SESSION_SRC4 16
+/* struct in_addr */
+#define JOOLD_SESSION_DST4 20
+/* __be32; milliseconds until the session expires. */
+#define JOOLD_SESSION_EXPIRATION 24
+/* __be16 */
+#define JOOLD_SESSION_SRC6_PORT 28
+/* __be16 */
+#define JOOLD_SESSION_SRC4_PORT 30
+/* __be16 */
+#define JOOLD_SESSION_DST4_PORT 32
+/* __be16; protocol (bits 5-6), TCP state (bits 2-4) and timer type (0-1). */
+#define JOOLD_SESSION_META 34
+#define JOOLD_SESSION_SIZE 36
+
 #endif /* SRC_COMMON_SESSION_H_ */
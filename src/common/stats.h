@@ -1,6 +1,8 @@
 #ifndef SRC_COMMON_STATS_H_
 #define SRC_COMMON_STATS_H_
 
+#include <linux/types.h>
+
 /*
  * TODO (fine) Caller review needed.
  * Make sure there's a counter for every worthwhile event,
@@ -57,6 +59,7 @@ enum jool_stat_id {
 	JSTAT_TYPE2PKT,
 	JSTAT_SO_EXISTS,
 	JSTAT_SO_FULL,
+	JSTAT_SESSION_QUOTA,
 
 	JSTAT64_SRC,
 	JSTAT64_DST,
@@ -86,10 +89,24 @@ enum jool_stat_id {
 	JSTAT_PKT_TOO_BIG,
 	JSTAT_DST_OUTPUT,
 
+	JSTAT_XLAT_IN_PLACE,
+	JSTAT_XLAT_COPY,
+
+	JSTAT_ROUTE_CACHE_HIT,
+	JSTAT_ROUTE_CACHE_MISS,
+
+	JSTAT_FRAG_QUEUED,
+	JSTAT_FRAG_QUEUE_FULL,
+	JSTAT_FRAG_EXPIRED,
+	JSTAT_FRAG_UNKNOWN,
+	JSTAT_FRAG_OVERLAP,
+
 	JSTAT_ICMP6ERR_SUCCESS,
 	JSTAT_ICMP6ERR_FAILURE,
 	JSTAT_ICMP4ERR_SUCCESS,
 	JSTAT_ICMP4ERR_FAILURE,
+	JSTAT_ICMP6ERR_LIMITED,
+	JSTAT_ICMP4ERR_LIMITED,
 
 	JSTAT_ICMPEXT_BIG,
 
@@ -104,11 +121,17 @@ enum jool_stat_id {
 	JSTAT_JOOLD_SSS_SENT,
 	JSTAT_JOOLD_SSS_RCVD,
 	JSTAT_JOOLD_SSS_ENOSPC,
+	JSTAT_JOOLD_SSS_FILTERED,
 	JSTAT_JOOLD_PKT_SENT,
 	JSTAT_JOOLD_PKT_RCVD,
 	JSTAT_JOOLD_ADS,
 	JSTAT_JOOLD_ACKS,
 
+	JSTAT_NATLOG_SENT,
+	JSTAT_NATLOG_RING_FULL,
+	JSTAT_NATLOG_ENOMEM,
+	JSTAT_NATLOG_UNHEARD,
+
 	/* These 3 need to be last, and in this order. */
 	JSTAT_UNKNOWN, /* "WTF was that" errors only. */
 	JSTAT_PADDING,
@@ -116,4 +139,89 @@ enum jool_stat_id {
 #define JSTAT_MAX (JSTAT_COUNT - 1)
 };
 
+/*
+ * Translation stages measured by the latency histograms.
+ * (See the latency-histograms global.)
+ */
+enum jool_latency_stage {
+	JLAT_IN_TUPLE,
+	JLAT_FILTERING,
+	JLAT_OUT_TUPLE,
+	JLAT_TRANSLATE,
+	/* Sending the packet, or handing it to hairpinning. */
+	JLAT_SEND,
+	JLAT_STAGE_COUNT,
+};
+
+enum jool_latency_dir {
+	JLAT_6TO4,
+	JLAT_4TO6,
+	JLAT_DIR_COUNT,
+};
+
+/*
+ * Histograms are base 2, in nanoseconds.
+ * Bucket 0 counts the samples that took less than 2 nanoseconds, bucket N
+ * counts the ones that took [2^N, 2^(N+1)) nanoseconds, and the last bucket
+ * also counts everything slower than that.
+ */
+#define JLAT_BUCKETS 32
+
+struct jool_latency {
+	__u64 buckets[JLAT_DIR_COUNT][JLAT_STAGE_COUNT][JLAT_BUCKETS];
+};
+
+/*
+ * How many pool4 candidates the NAT64 had to try before finding an available
+ * transport address, per allocation. (See `jool pool4 display --usage`.)
+ *
+ * The histogram is base 2: Bucket N counts the allocations that needed
+ * [2^N, 2^(N+1)) iterations, and the last bucket also counts everything above
+ * that. (Bucket 0 is the single iteration case.)
+ */
+#define JITER_BUCKETS 24
+
+struct jool_mask_iterations {
+	/* Allocations that found an available transport address. */
+	__u64 successes;
+	/* Allocations that ran out of pool4 (or max-iterations). */
+	__u64 failures;
+	/* Sum of the iterations of every allocation. */
+	__u64 total;
+	/* Iterations of the most expensive allocation. */
+	__u64 max;
+	__u64 buckets[JITER_BUCKETS];
+};
+
+/* There's one jool_mask_iterations per protocol; indexed by l4_protocol. */
+#define JITER_PROTO_COUNT 3
+
+/*
+ * NAT64 locks measured by the lock statistics.
+ * (See the lock-statistics global.)
+ */
+enum jool_lock_class {
+	JLOCK_BIB_TCP,
+	JLOCK_BIB_UDP,
+	JLOCK_BIB_ICMP,
+	JLOCK_POOL4,
+	JLOCK_JOOLD,
+	JLOCK_CLASS_COUNT,
+};
+
+struct jool_lock_stats {
+	/* Number of times the lock was taken. */
+	__u64 acquisitions;
+	/* Acquisitions that had to wait for somebody else to release it. */
+	__u64 contended;
+	/* Sum of the hold times of every acquisition, in nanoseconds. */
+	__u64 hold_total;
+	/* Longest hold time, in nanoseconds. */
+	__u64 hold_max;
+};
+
+struct jool_locks {
+	struct jool_lock_stats classes[JLOCK_CLASS_COUNT];
+};
+
 #endif /* SRC_COMMON_STATS_H_ */
@@ -32,9 +32,10 @@ typedef unsigned int xlator_framework; /** Bitwise or'd XF_* constants below. */
 #define XT_NAT64 (1 << 1)
 #define XF_NETFILTER (1 << 2)
 #define XF_IPTABLES (1 << 3)
+#define XF_INGRESS (1 << 4)
 
 #define XT_ANY (XT_SIIT | XT_NAT64)
-#define XF_ANY (XF_NETFILTER | XF_IPTABLES)
+#define XF_ANY (XF_NETFILTER | XF_IPTABLES | XF_INGRESS)
 
 int xf_validate(xlator_framework xf);
 int xt_validate(xlator_type xt);
@@ -47,10 +48,10 @@ xlator_framework xlator_flags2xf(xlator_flags flags);
 
 #ifdef XTABLES_DISABLED
 #define XF_VALIDATE_ERRMSG \
-	"Netfilter is the only available instance framework."
+	"Netfilter and ingress are the only available instance frameworks."
 #else
 #define XF_VALIDATE_ERRMSG \
-	"Netfilter and iptables are the only available instance frameworks."
+	"Netfilter, iptables and ingress are the only available instance frameworks."
 #endif
 
 char const *xt2str(xlator_type xt);
@@ -67,6 +68,14 @@ int iname_validate(const char *iname, bool allow_null);
 #define INAME_VALIDATE_ERRMSG \
 	"The instance name must be a null-terminated ascii string, 15 characters max."
 
+/** Maximum number of interfaces an XF_INGRESS instance can be hooked to. */
+#define INGRESS_MAX_DEVS 8
+/**
+ * Size of an XF_INGRESS instance's comma-separated interface list. (IFNAMSIZ
+ * includes the null chara, so it also makes room for the commas.)
+ */
+#define INGRESS_DEVS_MAX_SIZE (INGRESS_MAX_DEVS * 16)
+
 /**
  * Network (layer 3) protocols Jool is supposed to support.
  * We do not use PF_INET, PF_INET6, AF_INET or AF_INET6 because I want the
@@ -126,6 +135,19 @@ struct mtu_plateaus {
 	__u16 count;
 };
 
+#define MARK_RANGES_MAX 16
+
+struct mark_range {
+	__u32 min;
+	__u32 max;
+};
+
+struct mark_ranges {
+	struct mark_range ranges[MARK_RANGES_MAX];
+	/** Actual length of the ranges array. */
+	__u16 count;
+};
+
 /**
  * A layer-3 (IPv4) identifier attached to a layer-4 identifier.
  * Because they're paired all the time in this project.
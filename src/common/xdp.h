@@ -0,0 +1,86 @@
+#ifndef SRC_COMMON_XDP_H_
+#define SRC_COMMON_XDP_H_
+
+/*
+ * Structures shared by SIIT Jool's XDP fast path (src/usr/xdp/) and the
+ * userspace client code that loads it and mirrors the instance's configuration
+ * into its maps (src/usr/argp/wargp/xdp.c).
+ *
+ * Everything here is in network byte order, unless stated otherwise.
+ */
+
+#include <linux/types.h>
+
+/* The maps of instance "foo" are pinned in JOOL_XDP_PIN_ROOT "/foo/". */
+#define JOOL_XDP_PIN_ROOT "/sys/fs/bpf/jool"
+
+#define JOOL_XDP_EAMT_MAX 16384
+#define JOOL_XDP_DENYLIST4_MAX 1024
+#define JOOL_XDP_LOCAL4_MAX 256
+/* INAME_MAX_SIZE (common/types.h isn't BPF-friendly) */
+#define JOOL_XDP_INAME_SIZE 16
+
+/* Key of the LPM tries that hold IPv6 prefixes. (eamt6) */
+struct jool_xdp_key6 {
+	/* Host byte order; this is what the kernel's LPM trie wants. */
+	__u32 prefixlen;
+	__be32 addr[4];
+};
+
+/* Key of the LPM tries that hold IPv4 prefixes. (eamt4, denylist4) */
+struct jool_xdp_key4 {
+	/* Host byte order; this is what the kernel's LPM trie wants. */
+	__u32 prefixlen;
+	__be32 addr;
+};
+
+/*
+ * Value of both EAMT tries. The prefixes' suffixes are zeroized by userspace,
+ * so the fast path only needs to OR the host bits in.
+ */
+struct jool_xdp_eam {
+	__be32 prefix6[4];
+	__be32 prefix4;
+	__u8 prefix6_len;
+	__u8 prefix4_len;
+	__u16 reserved;
+};
+
+/* The subset of struct jool_globals the fast path cares about. */
+struct jool_xdp_config {
+	/*
+	 * Host byte order. The instance's generation, as of the moment the maps
+	 * were mirrored from it. If the kernel module reports a different one
+	 * (because the instance changed, died, or was disabled), the maps are
+	 * stale, and the fast path passes everything to the kernel module.
+	 */
+	__u64 generation;
+	/* The instance the maps were mirrored from. */
+	char iname[JOOL_XDP_INAME_SIZE];
+	/* Zero means "pass everything to the kernel module." */
+	__u8 enabled;
+	__u8 pool6_set;
+	__u8 pool6_len;
+	__u8 reset_traffic_class;
+	__u8 reset_tos;
+	__u8 new_tos;
+	/* enum eam_hairpinning_mode */
+	__u8 eam_hairpin_mode;
+	__u8 reserved;
+	/* Host byte order. */
+	__u32 lowest_ipv6_mtu;
+	__be32 pool6[4];
+};
+
+/* Indexes of the "stats" per-CPU array. */
+enum jool_xdp_stat {
+	/* IPv6 packets translated and redirected by the fast path. */
+	JOOL_XDP_XLAT64,
+	/* IPv4 packets translated and redirected by the fast path. */
+	JOOL_XDP_XLAT46,
+	/* IP packets left for the kernel module to handle. */
+	JOOL_XDP_PASS,
+	JOOL_XDP_STAT_COUNT,
+};
+
+#endif /* SRC_COMMON_XDP_H_ */
@@ -1,10 +1,14 @@
 #include "mod/common/core.h"
 
+#include <linux/ktime.h>
 #include "common/config.h"
 #include "mod/common/log.h"
+#include "mod/common/stats.h"
 #include "mod/common/trace.h"
+#include "mod/common/tracepoints.h"
 #include "mod/common/translation_state.h"
 #include "mod/common/xlator.h"
+#include "mod/common/db/fragdb.h"
 #include "mod/common/rfc7915/core.h"
 #include "mod/common/steps/compute_outgoing_tuple.h"
 #include "mod/common/steps/determine_incoming_tuple.h"
@@ -25,25 +29,84 @@ static verdict validate_xlator(struct xlation *state)
 	return VERDICT_CONTINUE;
 }
 
-static verdict core_common(struct xlation *state)
+/*
+ * Latency histograms: @state->latency_ts is the moment the current stage
+ * started. Both functions are no-ops while the static key is disabled.
+ */
+static void latency_start(struct xlation *state)
 {
+	if (static_branch_unlikely(&jstat_latency_key))
+		state->latency_ts = ktime_get_ns();
+}
+
+static void latency_mark(struct xlation *state, enum jool_latency_stage stage)
+{
+	__u64 now;
+
+	if (!static_branch_unlikely(&jstat_latency_key))
+		return;
+	/* (latency_ts is zero if the key was enabled mid-translation.) */
+	if (!state->jool.globals.latency_histograms || !state->latency_ts)
+		return;
+
+	now = ktime_get_ns();
+	jstat_latency_add(state->jool.stats,
+			(pkt_l3_proto(&state->in) == L3PROTO_IPV6)
+					? JLAT_6TO4
+					: JLAT_4TO6,
+			stage, now - state->latency_ts);
+	state->latency_ts = now;
+}
+
+static verdict compute_tuples(struct xlation *state)
+{
+	verdict result;
+
+	result = determine_in_tuple(state);
+	latency_mark(state, JLAT_IN_TUPLE);
+	if (result != VERDICT_CONTINUE)
+		return result;
+	result = filtering_and_updating(state);
+	latency_mark(state, JLAT_FILTERING);
+	if (result != VERDICT_CONTINUE)
+		return result;
+	result = compute_out_tuple(state);
+	latency_mark(state, JLAT_OUT_TUPLE);
+	return result;
+}
+
+/**
+ * @early: If @state's packet turns out to be the first fragment of a virtually
+ *     reassembled datagram, the fragments that had arrived before it will be
+ *     moved here. NULL if @state's packet is one of those.
+ */
+static verdict core_common(struct xlation *state, struct sk_buff_head *early)
+{
+	bool is_frag = false;
+	bool is_first = true;
 	verdict result;
 
+	latency_start(state);
+
 	if (xlation_is_nat64(state)) {
-		result = determine_in_tuple(state);
-		if (result != VERDICT_CONTINUE)
-			return result;
-		result = filtering_and_updating(state);
-		if (result != VERDICT_CONTINUE)
-			return result;
-		result = compute_out_tuple(state);
+		is_frag = fragdb_is_fragment(state, &is_first);
+		result = is_first
+				? compute_tuples(state)
+				: fragdb_find(state, early != NULL);
 		if (result != VERDICT_CONTINUE)
 			return result;
+		if (!is_first)
+			latency_start(state); /* fragdb_find() is not a stage. */
 	}
 	result = translating_the_packet(state);
+	latency_mark(state, JLAT_TRANSLATE);
 	if (result != VERDICT_CONTINUE)
 		return result;
 
+	/* (The incoming headers are still readable, even if translated in place.) */
+	if (is_frag && is_first)
+		fragdb_add(state, early);
+
 	if (state->jool.is_hairpin(state)) {
 		skb_dst_drop(state->out.skb);
 		result = state->jool.handling_hairpinning(state);
@@ -52,6 +115,22 @@ static verdict core_common(struct xlation *state)
 		result = sendpkt_send(state);
 		/* sendpkt_send() releases out's skb regardless of verdict. */
 	}
+	latency_mark(state, JLAT_SEND);
+
+	if (state->in_place.active) {
+		/*
+		 * The incoming skb became the outgoing one, so it's already
+		 * gone, one way or the other. There's nothing left to free,
+		 * reply to or return to the kernel.
+		 */
+		if (result != VERDICT_CONTINUE) {
+			state->result.icmp = ICMPERR_NONE;
+			return VERDICT_STOLEN;
+		}
+		log_debug(state, "Success.");
+		return stolen(state, JSTAT_SUCCESS);
+	}
+
 	if (result != VERDICT_CONTINUE)
 		return result;
 
@@ -68,24 +147,52 @@ static verdict core_common(struct xlation *state)
 	return stolen(state, JSTAT_SUCCESS);
 }
 
-static void send_icmp4_error(struct xlation *state, verdict result)
+/*
+ * Translates the fragments that had been waiting for the datagram's first
+ * fragment. (See fragdb.h.)
+ */
+static void core_early_fragments(struct xlation *state, l3_protocol proto,
+		struct sk_buff_head *early)
 {
-	bool success;
+	struct xlation *frag;
+	struct sk_buff *skb;
+	verdict result;
 
+	while ((skb = __skb_dequeue(early)) != NULL) {
+		frag = xlation_create(&state->jool);
+		if (!frag) {
+			jstat_inc(state->jool.stats, JSTAT_ENOMEM);
+			kfree_skb(skb);
+			continue;
+		}
+
+		result = (proto == L3PROTO_IPV6)
+				? pkt_init_ipv6(frag, skb)
+				: pkt_init_ipv4(frag, skb);
+		if (result == VERDICT_CONTINUE)
+			result = core_common(frag, NULL);
+		/* The kernel forgot about these long ago; can't return them. */
+		if (result != VERDICT_STOLEN)
+			kfree_skb(skb);
+
+		xlation_destroy(frag);
+	}
+}
+
+static void send_icmp4_error(struct xlation *state, verdict result)
+{
 	if (state->result.icmp == ICMPERR_NONE)
 		return;
 	if (result == VERDICT_UNTRANSLATABLE)
 		return; /* Linux will decide what to do. */
 
-	success = icmp64_send4(&state->jool, state->in.skb,
-			state->result.icmp, state->result.info);
-	jstat_inc(state->jool.stats, success
-			? JSTAT_ICMP4ERR_SUCCESS
-			: JSTAT_ICMP4ERR_FAILURE);
+	icmp64_send4(&state->jool, state->in.skb, state->result.icmp,
+			state->result.info);
 }
 
 verdict core_4to6(struct sk_buff *skb, struct xlation *state)
 {
+	struct sk_buff_head early;
 	verdict result;
 
 	jstat_inc(state->jool.stats, JSTAT_RECEIVED4);
@@ -108,8 +215,12 @@ verdict core_4to6(struct sk_buff *skb, struct xlation *state)
 
 	if (state->jool.globals.debug)
 		pkt_trace4(state);
+	if (trace_jool_rcv4_enabled())
+		pkt_tracepoint4(state);
 
-	result = core_common(state);
+	__skb_queue_head_init(&early);
+	result = core_common(state, &early);
+	core_early_fragments(state, L3PROTO_IPV4, &early);
 	/* Fall through */
 
 end:
@@ -119,22 +230,18 @@ end:
 
 static void send_icmp6_error(struct xlation *state, verdict result)
 {
-	bool success;
-
 	if (state->result.icmp == ICMPERR_NONE)
 		return;
 	if (result == VERDICT_UNTRANSLATABLE)
 		return; /* Linux will decide what to do. */
 
-	success = icmp64_send6(&state->jool, state->in.skb,
-			state->result.icmp, state->result.info);
-	jstat_inc(state->jool.stats, success
-			? JSTAT_ICMP6ERR_SUCCESS
-			: JSTAT_ICMP6ERR_FAILURE);
+	icmp64_send6(&state->jool, state->in.skb, state->result.icmp,
+			state->result.info);
 }
 
 verdict core_6to4(struct sk_buff *skb, struct xlation *state)
 {
+	struct sk_buff_head early;
 	verdict result;
 
 	jstat_inc(state->jool.stats, JSTAT_RECEIVED6);
@@ -157,8 +264,12 @@ verdict core_6to4(struct sk_buff *skb, struct xlation *state)
 
 	if (state->jool.globals.debug)
 		pkt_trace6(state);
+	if (trace_jool_rcv6_enabled())
+		pkt_tracepoint6(state);
 
-	result = core_common(state);
+	__skb_queue_head_init(&early);
+	result = core_common(state, &early);
+	core_early_fragments(state, L3PROTO_IPV6, &early);
 	/* Fall through */
 
 end:
@@ -2,13 +2,19 @@
 
 #include <linux/ktime.h>
 #include <net/ip6_checksum.h>
+#include <net/ipv6.h>
 
 #include "common/constants.h"
 #include "mod/common/icmp_wrapper.h"
+#include "mod/common/lockstat.h"
 #include "mod/common/log.h"
+#include "mod/common/natlog.h"
+#include "mod/common/tracepoints.h"
 #include "mod/common/wkmalloc.h"
 #include "mod/common/db/rbtree.h"
+#include "mod/common/db/bib/pba.h"
 #include "mod/common/db/bib/pkt_queue.h"
+#include "mod/common/db/bib/subscriber.h"
 
 #define XGLOBALS(xlator) (xlator->globals.nat64.bib)
 #define GLOBALS(state) (state->jool.globals.nat64.bib)
@@ -36,6 +42,25 @@ struct tabled_bib {
 	struct ipv4_transport_addr src4;
 	l4_protocol proto;
 	bool is_static;
+	/**
+	 * Mark of the pool4 entry @src4 was borrowed from.
+	 * Zero if the entry is static or was created by joold.
+	 */
+	__u32 mark;
+	/**
+	 * Port block @src4 was borrowed from. (See pba.h.)
+	 * NULL if PBA was disabled when the entry was created, if the entry is
+	 * static, or if it was created by joold.
+	 */
+	struct pba_block *block;
+	/**
+	 * Session counter of the subscriber that owns @src6. (See
+	 * subscriber.h.) Every one of @sessions is charged to it.
+	 * NULL if session-quota was disabled when the entry was created, if the
+	 * entry was created by joold or a Simultaneous Open, or if the entry is
+	 * static and ran out of sessions.
+	 */
+	struct subscriber *subscriber;
 
 	struct rb_node hook6;
 	struct rb_node hook4;
@@ -55,6 +80,11 @@ struct tabled_session {
 	struct ipv6_transport_addr dst6;
 	struct ipv4_transport_addr dst4;
 	tcp_state state;
+	/**
+	 * Packets translated through this session. Incremented by the bib_add*()
+	 * functions, once per packet they let through.
+	 */
+	__u32 pkts;
 	/** MUST NOT be NULL. */
 	struct tabled_bib *bib;
 
@@ -86,6 +116,7 @@ struct tabled_session {
 	struct rb_node tree_hook;
 
 	unsigned long update_time;
+	unsigned long creation_time;
 	/** MUST NOT be NULL. */
 	struct expire_timer *expirer;
 	struct list_head list_hook;
@@ -127,7 +158,7 @@ struct bib_table {
 	/** Indexes the entries using their IPv4 identifiers. */
 	struct rb_root tree4;
 
-	spinlock_t lock;
+	struct jool_lock lock;
 
 	/** Expires this table's established sessions. */
 	struct expire_timer est_timer;
@@ -161,6 +192,11 @@ struct bib_table {
 	 * This is NULL in UDP/ICMP.
 	 */
 	struct pktqueue *pkt_queue;
+
+	/** Port blocks lent to subscribers. (Only used if PBA is enabled.) */
+	struct pba_table blocks;
+	/** Session counters and top talkers. */
+	struct subscriber_table subscribers;
 };
 
 struct bib {
@@ -255,6 +291,9 @@ static void tstose(struct xlator *jool,
 	se->update_time = ts->update_time;
 	se->timeout = get_timeout(jool, ts->expirer);
 	se->has_stored = !!ts->stored;
+	se->creation_time = ts->creation_time;
+	se->pkts = ts->pkts;
+	se->mark = ts->bib->mark;
 }
 
 /**
@@ -366,7 +405,7 @@ static void init_table(struct bib_table *table,
 {
 	table->tree6 = RB_ROOT;
 	table->tree4 = RB_ROOT;
-	spin_lock_init(&table->lock);
+	jlock_init(&table->lock);
 	init_expirer(&table->est_timer, est_timeout, SESSION_TIMER_EST, est_cb);
 
 	init_expirer(&table->trans_timer, trans_timeout, SESSION_TIMER_TRANS,
@@ -376,6 +415,7 @@ static void init_table(struct bib_table *table,
 			just_die);
 	table->pkt_count = 0;
 	table->pkt_queue = NULL;
+	pba_init(&table->blocks);
 }
 
 struct bib *bib_alloc(void)
@@ -402,10 +442,23 @@ struct bib *bib_alloc(void)
 	if (!db->tcp.pkt_queue)
 		goto pktqueue_alloc_fail;
 
+	if (subscriber_init(&db->udp.subscribers))
+		goto udp_subscribers_fail;
+	if (subscriber_init(&db->tcp.subscribers))
+		goto tcp_subscribers_fail;
+	if (subscriber_init(&db->icmp.subscribers))
+		goto icmp_subscribers_fail;
+
 	kref_init(&db->refs);
 
 	return db;
 
+icmp_subscribers_fail:
+	subscriber_destroy(&db->tcp.subscribers);
+tcp_subscribers_fail:
+	subscriber_destroy(&db->udp.subscribers);
+udp_subscribers_fail:
+	pktqueue_release(db->tcp.pkt_queue);
 pktqueue_alloc_fail:
 	wkfree(struct bib, db);
 db_alloc_fail:
@@ -457,6 +510,14 @@ static void bib_release(struct kref *refs)
 	rbtree_foreach(bib, tmp, &db->icmp.tree4, hook4)
 		release_bib_entry(bib);
 
+	pba_flush(&db->udp.blocks);
+	pba_flush(&db->tcp.blocks);
+	pba_flush(&db->icmp.blocks);
+
+	subscriber_destroy(&db->udp.subscribers);
+	subscriber_destroy(&db->tcp.subscribers);
+	subscriber_destroy(&db->icmp.subscribers);
+
 	pktqueue_release(db->tcp.pkt_queue);
 
 	wkfree(struct bib, db);
@@ -467,13 +528,23 @@ void bib_put(struct bib *db)
 	kref_put(&db->refs, bib_release);
 }
 
-static void log_bib(struct xlator *jool, struct tabled_bib *bib, char *action)
+static void log_bib(struct xlator *jool, struct tabled_bib *bib,
+		enum natlog_event event, char *action)
 {
 	time64_t tsec;
 	struct tm time;
 
 	if (!jool->globals.nat64.bib.bib_logging)
 		return;
+	/* PBA: The block's log already implies this mapping. */
+	if (bib->block)
+		return;
+
+	if (jool->globals.nat64.bib.ring_logging) {
+		natlog_add(jool, event, bib->proto, &bib->src6, NULL,
+				&bib->src4, NULL);
+		return;
+	}
 
 	tsec = ktime_get_real_seconds();
 	time64_to_tm(tsec, 0, &time);
@@ -487,12 +558,13 @@ static void log_bib(struct xlator *jool, struct tabled_bib *bib, char *action)
 
 static void log_new_bib(struct xlator *jool, struct tabled_bib *bib)
 {
-	return log_bib(jool, bib, "Mapped");
+	trace_jool_bib_add(jool, bib->proto, &bib->src6, &bib->src4);
+	return log_bib(jool, bib, NATLOG_BIB_ADD, "Mapped");
 }
 
 static void log_session(struct xlator *jool,
 		struct tabled_session *session,
-		char *action)
+		enum natlog_event event, char *action)
 {
 	time64_t tsec;
 	struct tm time;
@@ -500,6 +572,13 @@ static void log_session(struct xlator *jool,
 	if (!jool->globals.nat64.bib.session_logging)
 		return;
 
+	if (jool->globals.nat64.bib.ring_logging) {
+		natlog_add(jool, event, session->bib->proto,
+				&session->bib->src6, &session->dst6,
+				&session->bib->src4, &session->dst4);
+		return;
+	}
+
 	tsec = ktime_get_real_seconds();
 	time64_to_tm(tsec, 0, &time);
 	log_info("%s %ld/%d/%d %d:%d:%d (GMT) - %s " TA6PP "|" TA6PP "|"
@@ -513,7 +592,9 @@ static void log_session(struct xlator *jool,
 
 static void log_new_session(struct xlator *jool, struct tabled_session *session)
 {
-	return log_session(jool, session, "Added session");
+	trace_jool_session_add(jool, session->bib->proto, &session->bib->src6,
+			&session->dst6, &session->bib->src4, &session->dst4);
+	return log_session(jool, session, NATLOG_SESSION_ADD, "Added session");
 }
 
 /**
@@ -581,14 +662,26 @@ static void rm(struct xlator *jool,
 
 	rb_erase(&session->tree_hook, &bib->sessions);
 	list_del(&session->list_hook);
-	log_session(jool, session, "Forgot session");
+	trace_jool_session_rm(jool, bib->proto, &bib->src6, &session->dst6,
+			&bib->src4, &session->dst4);
+	log_session(jool, session, NATLOG_SESSION_RM, "Forgot session");
 	free_session(session);
 	jstat_dec(jool->stats, JSTAT_SESSIONS);
 
+	if (bib->subscriber) {
+		subscriber_put(&table->subscribers, bib->subscriber, 1);
+		/* The counter might be gone, and static entries linger. */
+		if (RB_EMPTY_ROOT(&bib->sessions))
+			bib->subscriber = NULL;
+	}
+
 	if (!bib->is_static && RB_EMPTY_ROOT(&bib->sessions)) {
 		rb_erase(&bib->hook6, &table->tree6);
 		rb_erase(&bib->hook4, &table->tree4);
-		log_bib(jool, bib, "Forgot");
+		trace_jool_bib_rm(jool, bib->proto, &bib->src6, &bib->src4);
+		log_bib(jool, bib, NATLOG_BIB_RM, "Forgot");
+		if (bib->block)
+			pba_put(jool, &table->blocks, bib->block);
 		free_bib(bib);
 		jstat_dec(jool->stats, JSTAT_BIB_ENTRIES);
 	}
@@ -846,9 +939,12 @@ static void commit_bib_add(struct xlator *jool, struct slot_group *slots)
 	jstat_inc(jool->stats, JSTAT_BIB_ENTRIES);
 }
 
-static void commit_session_add(struct xlator *jool, struct tree_slot *slot)
+static void commit_session_add(struct xlator *jool,
+		struct tabled_session *session, struct tree_slot *slot)
 {
 	treeslot_commit(slot);
+	if (session->bib->subscriber)
+		session->bib->subscriber->sessions++;
 	jstat_inc(jool->stats, JSTAT_SESSIONS);
 }
 
@@ -1015,10 +1111,15 @@ static int create_bib_session6(struct bib_session_tuple *tuple,
 	 */
 	tuple->bib->proto = tuple6->l4_proto;
 	tuple->bib->is_static = false;
+	tuple->bib->mark = 0;
+	tuple->bib->block = NULL;
+	tuple->bib->subscriber = NULL;
 	tuple->bib->sessions = RB_ROOT;
 	tuple->session->dst6 = tuple6->dst.addr6;
 	tuple->session->dst4 = *dst4;
 	tuple->session->state = state;
+	tuple->session->pkts = 0;
+	tuple->session->creation_time = jiffies;
 	tuple->session->stored = NULL;
 	return 0;
 }
@@ -1040,6 +1141,8 @@ static struct tabled_session *create_session4(struct tuple *tuple4,
 	session->dst6 = *dst6;
 	session->dst4 = tuple4->src.addr4;
 	session->state = state;
+	session->pkts = 0;
+	session->creation_time = jiffies;
 	session->stored = NULL;
 	return session;
 }
@@ -1061,11 +1164,16 @@ static int create_bib_session(struct session_entry *session,
 	tuple->bib->src4 = session->src4;
 	tuple->bib->proto = session->proto;
 	tuple->bib->is_static = false;
+	tuple->bib->mark = 0;
+	tuple->bib->block = NULL;
+	tuple->bib->subscriber = NULL;
 	tuple->bib->sessions = RB_ROOT;
 	tuple->session->dst6 = session->dst6;
 	tuple->session->dst4 = session->dst4;
 	tuple->session->state = session->state;
+	tuple->session->pkts = 0;
 	tuple->session->update_time = session->update_time;
+	tuple->session->creation_time = jiffies;
 	tuple->session->stored = NULL;
 	return 0;
 }
@@ -1084,7 +1192,7 @@ static void commit_add6(struct xlation *state,
 		struct expire_timer *expirer)
 {
 	new->session->bib = old->bib ? : new->bib;
-	commit_session_add(&state->jool, &slots->session);
+	commit_session_add(&state->jool, new->session, &slots->session);
 	attach_timer(new->session, expirer);
 	log_new_session(&state->jool, new->session);
 	tstobs(state, new->session);
@@ -1092,6 +1200,8 @@ static void commit_add6(struct xlation *state,
 
 	if (!old->bib) {
 		commit_bib_add(&state->jool, slots);
+		if (new->bib->block)
+			pba_commit(&state->jool, new->bib->block);
 		log_new_bib(&state->jool, new->bib);
 		new->bib = NULL; /* Do not free! */
 	}
@@ -1113,7 +1223,7 @@ static void commit_add4(struct xlation *state,
 	struct tabled_session *session = *new;
 
 	session->bib = old->bib;
-	commit_session_add(&state->jool, slot);
+	commit_session_add(&state->jool, session, slot);
 	attach_timer(session, expirer);
 	log_new_session(&state->jool, session);
 	tstobs(state, session);
@@ -1141,7 +1251,7 @@ static int commit_add(struct xlator *jool,
 		return error;
 
 	new->session->bib = old->bib ? : new->bib;
-	commit_session_add(jool, &slots->session);
+	commit_session_add(jool, new->session, &slots->session);
 	log_new_session(jool, new->session);
 	new->session = NULL; /* Do not free! */
 
@@ -1172,11 +1282,22 @@ static int detach_sessions(struct bib_table *table, struct tabled_bib *bib)
 static void detach_bib(struct xlator *jool, struct bib_table *table,
 		struct tabled_bib *bib)
 {
+	int detached;
+
 	rb_erase(&bib->hook6, &table->tree6);
 	rb_erase(&bib->hook4, &table->tree4);
+	if (bib->block) {
+		pba_put(jool, &table->blocks, bib->block);
+		bib->block = NULL;
+	}
 	jstat_dec(jool->stats, JSTAT_BIB_ENTRIES);
 	/* NOTE THAT detach_sessions() RETURNS NEGATIVE. */
-	jstat_add(jool->stats, JSTAT_SESSIONS, detach_sessions(table, bib));
+	detached = detach_sessions(table, bib);
+	jstat_add(jool->stats, JSTAT_SESSIONS, detached);
+	if (bib->subscriber) {
+		subscriber_put(&table->subscribers, bib->subscriber, -detached);
+		bib->subscriber = NULL;
+	}
 }
 
 struct bib_delete_list {
@@ -1259,13 +1380,16 @@ static struct tabled_bib *try_next(struct bib_table *table,
  * 			return success (0)
  * 	return failure (-ENOENT)
  *
+ * The number of candidates it had to try is recorded in @jool's stats.
  */
-static int find_available_mask(struct bib_table *table,
+static int find_available_mask(struct xlator *jool,
+		struct bib_table *table,
 		struct mask_domain *masks,
 		struct tabled_bib *bib,
 		struct tree_slot *slot)
 {
 	struct tabled_bib *collision = NULL;
+	unsigned int iterations = 0;
 	bool consecutive;
 	int error;
 
@@ -1280,6 +1404,7 @@ static int find_available_mask(struct bib_table *table,
 		error = mask_domain_next(masks, &bib->src4, &consecutive);
 		if (error)
 			goto end;
+		iterations++;
 
 		/*
 		 * Just for the sake of clarity:
@@ -1293,9 +1418,94 @@ static int find_available_mask(struct bib_table *table,
 
 end:
 	mask_domain_commit(masks);
+	jstat_iterations_add(jool->stats, bib->proto, iterations, !error);
 	return error;
 }
 
+/*
+ * Tries to mask @bib using one of @block's ports.
+ * Works like find_available_mask(), except the candidates are @block's ports,
+ * starting from the one that follows the last one that was lent.
+ */
+static int find_available_block_port(struct bib_table *table,
+		struct pba_block *block,
+		struct tabled_bib *bib,
+		struct tree_slot *slot)
+{
+	unsigned int i;
+
+	bib->src4.l3 = block->first.l3;
+	for (i = 0; i < block->size; i++) {
+		bib->src4.l4 = block->first.l4 + block->next;
+		block->next = (block->next + 1) % block->size;
+		if (!find_bibtree4_slot(table, bib, slot))
+			return 0;
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * Port Block Allocation version of find_available_mask().
+ *
+ * Only traverses @masks if all of the subscriber's blocks are full. Even then,
+ * the traversal is per block, not per port.
+ *
+ * If a new block is needed, it's left uncommitted. (See pba_add().)
+ *
+ * In deterministic mode, the subscriber only ever gets its own block, so the
+ * traversal is skipped altogether.
+ */
+static int find_available_block_mask(struct xlator *jool,
+		struct bib_table *table,
+		struct mask_domain *masks,
+		struct tabled_bib *bib,
+		struct tree_slot *slot)
+{
+	struct ipv6_prefix subscriber;
+	struct pba_block *block;
+	int error;
+
+	if (XGLOBALS(jool).pba_det_prefix.set) {
+		error = pba_add_det(jool, &table->blocks, masks, &bib->src6.l3,
+				bib->proto, &block);
+		if (error)
+			return error;
+		if (!find_available_block_port(table, block, bib, slot))
+			goto success;
+		pba_cancel(&table->blocks, block);
+		return -ENOENT;
+	}
+
+	subscriber.len = XGLOBALS(jool).pba_prefix_len;
+	ipv6_addr_prefix(&subscriber.addr, &bib->src6.l3, subscriber.len);
+
+	for (block = pba_first(&table->blocks, &subscriber);
+			block;
+			block = pba_next(block)) {
+		/* If pool4 changed, let the block die out. */
+		if (!pba_matches(block, masks))
+			continue;
+		if (!find_available_block_port(table, block, bib, slot))
+			goto success;
+	}
+
+	do {
+		error = pba_add(&table->blocks, masks, &subscriber, bib->proto,
+				XGLOBALS(jool).pba_block_size, &block);
+		if (error)
+			return error;
+		if (!find_available_block_port(table, block, bib, slot))
+			goto success;
+		/* Static BIB entries took the whole block. */
+		pba_cancel(&table->blocks, block);
+	} while (true);
+
+success:
+	bib->block = block;
+	return 0;
+}
+
 static int upgrade_pktqueue_session(struct xlator *jool,
 		struct bib_table *table,
 		struct mask_domain *masks,
@@ -1372,13 +1582,23 @@ static int upgrade_pktqueue_session(struct xlator *jool,
 	bib->src4 = sos->src4;
 	bib->proto = L4PROTO_TCP;
 	bib->is_static = false;
+	bib->mark = mask_domain_get_mark(masks);
+	/*
+	 * Exempt from Port Block Allocation: src4 was chosen by the IPv4 node
+	 * (it's the one it sent the stored SYN to), so it can't be assigned to
+	 * one of the subscriber's blocks.
+	 */
+	bib->block = NULL;
+	bib->subscriber = NULL;
 	bib->sessions = RB_ROOT;
 
 	session->dst6 = sos->dst6;
 	session->dst4 = sos->dst4;
 	session->state = V4_INIT;
+	session->pkts = 0;
 	session->bib = bib;
 	session->update_time = jiffies;
+	session->creation_time = jiffies;
 	session->stored = NULL;
 
 	/*
@@ -1514,8 +1734,18 @@ static int find_bib_session6(struct xlator *jool,
 	 * NULL.)
 	 */
 	if (masks) {
-		error = find_available_mask(table, masks, new->bib, &slots->bib4);
+		error = XGLOBALS(jool).pba_block_size
+				? find_available_block_mask(jool, table, masks,
+						new->bib, &slots->bib4)
+				: find_available_mask(jool, table, masks,
+						new->bib, &slots->bib4);
 		if (error) {
+			/* pba_add() could not allocate the block. */
+			if (error == -ENOMEM)
+				return error;
+			/* Not a deterministic subscriber. */
+			if (error == -ESRCH)
+				return error;
 			if (WARN(error != -ENOENT, "Unknown error: %d", error))
 				return error;
 			/*
@@ -1536,6 +1766,7 @@ static int find_bib_session6(struct xlator *jool,
 			return error;
 		}
 
+		new->bib->mark = mask_domain_get_mark(masks);
 		if (new->bib->proto == L4PROTO_ICMP)
 			new->session->dst4.l4 = new->bib->src4.l4;
 
@@ -1557,6 +1788,49 @@ static int find_bib_session6(struct xlator *jool,
 	return 0; /* Happy path for new sessions */
 }
 
+/**
+ * Feeds the top talkers sketch, and enforces session-quota on the subscriber
+ * that's about to get @new->session. Returns -EDQUOT if the subscriber already
+ * has too many sessions.
+ *
+ * If @new->bib is going to be created, this also finds (or creates) its
+ * subscriber's counter, so don't call it unless the session is going to be
+ * committed on success.
+ */
+static int charge_subscriber(struct xlator *jool, struct bib_table *table,
+		struct bib_session_tuple *old, struct bib_session_tuple *new)
+{
+	struct tabled_bib *bib;
+	struct ipv6_prefix prefix;
+	__u32 quota;
+	int error;
+
+	bib = old->bib ? : new->bib;
+	prefix.len = XGLOBALS(jool).session_quota_prefix_len;
+	ipv6_addr_prefix(&prefix.addr, &bib->src6.l3, prefix.len);
+	subscriber_request(&table->subscribers, &prefix);
+
+	quota = XGLOBALS(jool).session_quota;
+	if (!quota)
+		return 0;
+
+	if (!old->bib) {
+		error = subscriber_get(&table->subscribers, &prefix,
+				&new->bib->subscriber);
+		if (error)
+			return error;
+	}
+
+	if (bib->subscriber && bib->subscriber->sessions >= quota) {
+		__log_debug(jool, "Subscriber %pI6c/%u has reached its session quota.",
+				&bib->subscriber->prefix.addr,
+				bib->subscriber->prefix.len);
+		return -EDQUOT;
+	}
+
+	return 0;
+}
+
 /**
  * @db current BIB & session database.
  * @masks Should a BIB entry be created, its IPv4 address mask will be allocated
@@ -1601,7 +1875,7 @@ int bib_add6(struct xlation *state,
 	if (error)
 		return error;
 
-	spin_lock_bh(&table->lock); /* Here goes... */
+	jlock_lock(&table->lock); /* Here goes... */
 
 	error = find_bib_session6(&state->jool, table, masks, &new, &old, &slots, &bdl);
 	if (error)
@@ -1609,16 +1883,23 @@ int bib_add6(struct xlation *state,
 
 	if (old.session) { /* Session already exists. */
 		handle_fate_timer(old.session, &table->est_timer);
+		old.session->pkts++;
 		tstobs(state, old.session);
 		goto end;
 	}
 
 	/* New connection; add the session. (And maybe the BIB entry as well) */
+	error = charge_subscriber(&state->jool, table, &old, &new);
+	if (error)
+		goto end;
+	new.session->pkts = 1;
 	commit_add6(state, &old, &new, &slots, &table->est_timer);
 	/* Fall through */
 
 end:
-	spin_unlock_bh(&table->lock);
+	if (new.bib && new.bib->block)
+		pba_cancel(&table->blocks, new.bib->block);
+	jlock_unlock(&table->lock);
 
 	if (new.bib)
 		free_bib(new.bib);
@@ -1666,12 +1947,13 @@ int bib_add4(struct xlation *state,
 	if (!new)
 		return -ENOMEM;
 
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 
 	find_bib_session4(table, tuple4, new, &old, &allow, &session_slot);
 
 	if (old.session) {
 		handle_fate_timer(old.session, &table->est_timer);
+		old.session->pkts++;
 		tstobs(state, old.session);
 		goto end;
 	}
@@ -1688,11 +1970,12 @@ int bib_add4(struct xlation *state,
 	}
 
 	/* Ok, no issues; add the session. */
+	new->pkts = 1;
 	commit_add4(state, &old, &new, &session_slot, &table->est_timer);
 	/* Fall through */
 
 end:
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 	if (new)
 		free_session(new);
 	return error;
@@ -1714,6 +1997,7 @@ verdict bib_add_tcp6(struct xlation *state,
 	struct slot_group slots;
 	struct bib_delete_list bdl = { NULL };
 	verdict result;
+	int error;
 
 	pkt = &state->in;
 	if (WARN(pkt->tuple.l4_proto != L4PROTO_TCP, "Incorrect l4 proto in TCP handler."))
@@ -1723,9 +2007,15 @@ verdict bib_add_tcp6(struct xlation *state,
 		return drop(state, JSTAT_ENOMEM);
 
 	table = &state->jool.nat64.bib->tcp;
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 
-	if (find_bib_session6(&state->jool, table, masks, &new, &old, &slots, &bdl)) {
+	error = find_bib_session6(&state->jool, table, masks, &new, &old,
+			&slots, &bdl);
+	if (error == -ENOMEM) {
+		result = drop(state, JSTAT_ENOMEM);
+		goto end;
+	}
+	if (error) {
 		result = drop(state, JSTAT_UNKNOWN);
 		goto end;
 	}
@@ -1733,6 +2023,7 @@ verdict bib_add_tcp6(struct xlation *state,
 	if (old.session) {
 		/* All states except CLOSED. */
 		if (decide_fate(&state->jool, cb, table, old.session, NULL)) {
+			old.session->pkts++;
 			tstobs(state, old.session);
 			result = VERDICT_CONTINUE;
 		} else {
@@ -1755,14 +2046,28 @@ verdict bib_add_tcp6(struct xlation *state,
 		goto end;
 	}
 
+	switch (charge_subscriber(&state->jool, table, &old, &new)) {
+	case 0:
+		break;
+	case -EDQUOT:
+		result = drop(state, JSTAT_SESSION_QUOTA);
+		goto end;
+	default:
+		result = drop(state, JSTAT_ENOMEM);
+		goto end;
+	}
+
 	/* All exits up till now require @new.* to be deleted. */
 
+	new.session->pkts = 1;
 	commit_add6(state, &old, &new, &slots, &table->trans_timer);
 	result = VERDICT_CONTINUE;
 	/* Fall through */
 
 end:
-	spin_unlock_bh(&table->lock);
+	if (new.bib && new.bib->block)
+		pba_cancel(&table->blocks, new.bib->block);
+	jlock_unlock(&table->lock);
 
 	if (new.bib)
 		free_bib(new.bib);
@@ -1798,13 +2103,14 @@ verdict bib_add_tcp4(struct xlation *state,
 		return drop(state, JSTAT_ENOMEM);
 
 	table = &state->jool.nat64.bib->tcp;
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 
 	find_bib_session4(table, &pkt->tuple, new, &old, NULL, &session_slot);
 
 	if (old.session) {
 		/* All states except CLOSED. */
 		if (decide_fate(&state->jool, cb, table, old.session, NULL)) {
+			old.session->pkts++;
 			tstobs(state, old.session);
 			result = VERDICT_CONTINUE;
 		} else {
@@ -1877,12 +2183,15 @@ verdict bib_add_tcp4(struct xlation *state,
 		 */
 	}
 
+	/* A stored packet is not translated (at least not yet). */
+	if (!new->stored)
+		new->pkts = 1;
 	commit_add4(state, &old, &new, &session_slot,
 			new->stored ? &table->syn4_timer : &table->trans_timer);
 	/* Fall through */
 
 end:
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 
 	if (new)
 		free_session(new);
@@ -1890,7 +2199,7 @@ end:
 	return result;
 
 too_many_pkts:
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 	free_session(new);
 	log_debug(state, "Too many Simultaneous Opens.");
 	/* Fall back to assume there's no SO. */
@@ -1943,7 +2252,7 @@ int bib_add_session(struct xlator *jool,
 	if (error)
 		return error;
 
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 
 	error = find_bib_session6(jool, table, NULL, &new, &old, &slots, &bdl);
 	if (error)
@@ -1959,7 +2268,7 @@ int bib_add_session(struct xlator *jool,
 	/* Fall through */
 
 end:
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 
 	if (new.bib)
 		free_bib(new.bib);
@@ -2000,7 +2309,8 @@ static void clean_table(struct xlator *jool, struct bib_table *table)
 	LIST_HEAD(probes);
 	LIST_HEAD(icmps);
 
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
+	subscriber_decay(&table->subscribers);
 	__clean(jool, &table->est_timer, table, &probes);
 	__clean(jool, &table->trans_timer, table, &probes);
 	__clean(jool, &table->syn4_timer, table, &probes);
@@ -2008,10 +2318,10 @@ static void clean_table(struct xlator *jool, struct bib_table *table)
 		table->pkt_count -= pktqueue_prepare_clean(table->pkt_queue,
 				&icmps);
 	}
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 
 	post_fate(jool, &probes);
-	pktqueue_clean(&icmps);
+	pktqueue_clean(jool, &icmps);
 }
 
 /**
@@ -2069,7 +2379,7 @@ int bib_foreach(struct bib *db, l4_protocol proto,
 	if (!table)
 		return -EINVAL;
 
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 
 	node = find_starting_point(table, offset, false);
 	for (; node && !error; node = rb_next(node)) {
@@ -2078,7 +2388,7 @@ int bib_foreach(struct bib *db, l4_protocol proto,
 		error = cb(&bib, cb_arg);
 	}
 
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 	return error;
 }
 
@@ -2172,7 +2482,7 @@ int bib_foreach_session(struct xlator *jool, l4_protocol proto,
 	if (!table)
 		return -EINVAL;
 
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 
 	if (offset) {
 		find_session_offset(table, offset, &pos);
@@ -2194,7 +2504,7 @@ goto_session:		tstose(jool, pos.session, &tmp);
 	}
 
 end:
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 	return error;
 }
 
@@ -2212,11 +2522,11 @@ int bib_find6(struct bib *db, l4_protocol proto,
 	if (!table)
 		return -EINVAL;
 
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 	bib = find_bib6(table, addr);
 	if (bib)
 		tbtobe(bib, result);
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 
 	return bib ? 0 : -ESRCH;
 }
@@ -2232,11 +2542,11 @@ int bib_find4(struct bib *db, l4_protocol proto,
 	if (!table)
 		return -EINVAL;
 
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 	bib = find_bib4(table, addr);
 	if (bib)
 		tbtobe(bib, result);
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 
 	return bib ? 0 : -ESRCH;
 }
@@ -2247,6 +2557,9 @@ static void bib2tabled(struct bib_entry *bib, struct tabled_bib *tabled)
 	tabled->src4 = bib->addr4;
 	tabled->proto = bib->l4_proto;
 	tabled->is_static = true;
+	tabled->mark = 0;
+	tabled->block = NULL;
+	tabled->subscriber = NULL;
 	tabled->sessions = RB_ROOT;
 }
 
@@ -2270,7 +2583,7 @@ static int __bib_add_static(struct xlator *jool, struct bib_entry *new,
 		return -ENOMEM;
 	bib2tabled(new, bib);
 
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 
 	collision = find_bibtree6_slot(table, bib, &slot6);
 	if (collision) {
@@ -2296,18 +2609,18 @@ static int __bib_add_static(struct xlator *jool, struct bib_entry *new,
 	if (new->l4_proto == L4PROTO_TCP)
 		pktqueue_rm(jool->nat64.bib->tcp.pkt_queue, &new->addr4);
 
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 	return 0;
 
 upgrade:
 	collision->is_static = true;
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 	free_bib(bib);
 	return 0;
 
 eexist:
 	tbtobe(collision, old);
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 	free_bib(bib);
 	return -EEXIST;
 }
@@ -2347,7 +2660,7 @@ int bib_rm(struct xlator *jool, struct bib_entry *entry)
 
 	bib2tabled(entry, &key);
 
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 
 	bib = find_bib6(table, &key.src6);
 	if (bib && taddr4_equals(&key.src4, &bib->src4)) {
@@ -2355,7 +2668,7 @@ int bib_rm(struct xlator *jool, struct bib_entry *entry)
 		error = 0;
 	}
 
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 
 	if (!error)
 		release_bib_entry(bib);
@@ -2380,7 +2693,7 @@ void bib_rm_range(struct xlator *jool, l4_protocol proto,
 	offset.l3 = range->prefix.addr;
 	offset.l4 = range->ports.min;
 
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 
 	node = find_starting_point(table, &offset, true);
 	for (; node; node = next) {
@@ -2395,18 +2708,102 @@ void bib_rm_range(struct xlator *jool, l4_protocol proto,
 		}
 	}
 
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 
 	commit_delete_list(&delete_list);
 }
 
+/**
+ * Returns (in @result) the number of BIB entries whose IPv4 transport address
+ * belongs to @range. (ie. the number of @range's ports that are currently in
+ * use.)
+ *
+ * The entries are counted regardless of their marks. Even if a different pool4
+ * mark (or a static entry) is the one holding the port, it's still not
+ * available.
+ */
+int bib_count_range(struct bib *db, l4_protocol proto,
+		struct ipv4_range const *range, __u32 *result)
+{
+	struct bib_table *table;
+	struct ipv4_transport_addr offset;
+	struct rb_node *node;
+	struct tabled_bib *bib;
+	__u32 next_addr;
+	__u32 count = 0;
+
+	table = get_table(db, proto);
+	if (!table)
+		return -EINVAL;
+
+	offset.l3 = range->prefix.addr;
+	offset.l4 = range->ports.min;
+
+	jlock_lock(&table->lock);
+
+	/*
+	 * Only the ports in @range are visited; whenever the walk leaves them,
+	 * it seeks to the next address's ports.min instead.
+	 */
+	node = find_starting_point(table, &offset, true);
+	while (node) {
+		bib = bib4_entry(node);
+		if (!prefix4_contains(&range->prefix, &bib->src4.l3))
+			break;
+
+		if (bib->src4.l4 < range->ports.min) {
+			offset.l3 = bib->src4.l3;
+			node = find_starting_point(table, &offset, true);
+			continue;
+		}
+		if (bib->src4.l4 > range->ports.max) {
+			next_addr = be32_to_cpu(bib->src4.l3.s_addr) + 1;
+			if (next_addr == 0)
+				break; /* Overflow; this was 255.255.255.255. */
+			offset.l3.s_addr = cpu_to_be32(next_addr);
+			node = find_starting_point(table, &offset, true);
+			continue;
+		}
+
+		count++;
+		node = rb_next(node);
+	}
+
+	jlock_unlock(&table->lock);
+
+	*result = count;
+	return 0;
+}
+
+/**
+ * Copies @proto's top talkers (see subscriber.h) to @result, which needs room
+ * for TOP_TALKERS entries. Returns the number of talkers copied, or a negative
+ * error code.
+ */
+int bib_top_talkers(struct bib *db, l4_protocol proto,
+		struct top_talker *result)
+{
+	struct bib_table *table;
+	unsigned int count;
+
+	table = get_table(db, proto);
+	if (!table)
+		return -EINVAL;
+
+	jlock_lock(&table->lock);
+	count = subscriber_top(&table->subscribers, result);
+	jlock_unlock(&table->lock);
+
+	return count;
+}
+
 static void flush_table(struct xlator *jool, struct bib_table *table)
 {
 	struct rb_node *node;
 	struct rb_node *next;
 	struct bib_delete_list delete_list = { NULL };
 
-	spin_lock_bh(&table->lock);
+	jlock_lock(&table->lock);
 
 	for (node = rb_first(&table->tree4); node; node = next) {
 		next = rb_next(node);
@@ -2414,7 +2811,7 @@ static void flush_table(struct xlator *jool, struct bib_table *table)
 		add_to_delete_list(&delete_list, node);
 	}
 
-	spin_unlock_bh(&table->lock);
+	jlock_unlock(&table->lock);
 
 	commit_delete_list(&delete_list);
 }
@@ -2427,6 +2824,20 @@ void bib_flush(struct xlator *jool)
 	flush_table(jool, &db->icmp);
 }
 
+void bib_lockstat_enable(struct bib *db, bool enable)
+{
+	jlock_enable(&db->tcp.lock, enable);
+	jlock_enable(&db->udp.lock, enable);
+	jlock_enable(&db->icmp.lock, enable);
+}
+
+void bib_lockstat_query(struct bib *db, struct jool_locks *result)
+{
+	jlock_query(&db->tcp.lock, &result->classes[JLOCK_BIB_TCP]);
+	jlock_query(&db->udp.lock, &result->classes[JLOCK_BIB_UDP]);
+	jlock_query(&db->icmp.lock, &result->classes[JLOCK_BIB_ICMP]);
+}
+
 static void print_tabs(int tabs)
 {
 	int i;
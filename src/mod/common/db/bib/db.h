@@ -8,10 +8,12 @@
  */
 
 #include "common/config.h"
+#include "common/stats.h"
 #include "mod/common/packet.h"
 #include "mod/common/translation_state.h"
 #include "mod/common/db/pool4/db.h"
 #include "mod/common/db/bib/entry.h"
+#include "mod/common/db/bib/subscriber.h"
 
 struct bib;
 
@@ -124,10 +126,17 @@ int bib_find4(struct bib *db, l4_protocol proto,
 		struct bib_entry *result);
 int bib_add_static(struct xlator *jool, struct bib_entry *new);
 int bib_rm(struct xlator *jool, struct bib_entry *entry);
+int bib_count_range(struct bib *db, l4_protocol proto,
+		struct ipv4_range const *range, __u32 *result);
 void bib_rm_range(struct xlator *jool, l4_protocol proto,
 		struct ipv4_range *range);
+int bib_top_talkers(struct bib *db, l4_protocol proto,
+		struct top_talker *result);
 void bib_flush(struct xlator *jool);
 
+void bib_lockstat_enable(struct bib *db, bool enable);
+void bib_lockstat_query(struct bib *db, struct jool_locks *result);
+
 void bib_print(struct bib *db);
 
 /* The user of this module has to implement this. */
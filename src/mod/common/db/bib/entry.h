@@ -60,6 +60,18 @@ struct session_entry {
 	unsigned long timeout;
 
 	bool has_stored;
+
+	/*
+	 * The following are only used to decide whether joold should
+	 * synchronize the session. They are not synchronized themselves.
+	 */
+
+	/** Jiffy (from the epoch) this session was created. */
+	unsigned long creation_time;
+	/** Number of packets this session has translated. */
+	__u32 pkts;
+	/** Mark of the pool4 entry that masked this session's BIB entry. */
+	__u32 mark;
 };
 
 /* Session Entry Printk Pattern */
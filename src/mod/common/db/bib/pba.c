@@ -0,0 +1,367 @@
+#include "mod/common/db/bib/pba.h"
+
+#include <linux/ktime.h>
+#include <net/ipv6.h>
+#include "common/deterministic.h"
+#include "mod/common/address.h"
+#include "mod/common/log.h"
+#include "mod/common/natlog.h"
+#include "mod/common/wkmalloc.h"
+#include "mod/common/db/rbtree.h"
+
+static struct pba_block *node2block6(struct rb_node *node)
+{
+	return node ? rb_entry(node, struct pba_block, hook6) : NULL;
+}
+
+static struct pba_block *node2block4(struct rb_node *node)
+{
+	return node ? rb_entry(node, struct pba_block, hook4) : NULL;
+}
+
+static int compare_subscriber(struct ipv6_prefix const *a,
+		struct ipv6_prefix const *b)
+{
+	int gap;
+
+	gap = ipv6_addr_cmp(&a->addr, &b->addr);
+	if (gap)
+		return gap;
+
+	return ((int)a->len) - ((int)b->len);
+}
+
+static int compare_block6(struct pba_block const *a, struct pba_block const *b)
+{
+	int gap;
+
+	gap = compare_subscriber(&a->subscriber, &b->subscriber);
+	if (gap)
+		return gap;
+
+	return taddr4_compare(&a->first, &b->first);
+}
+
+static int compare_block4(struct pba_block const *a,
+		struct ipv4_transport_addr const *b)
+{
+	return taddr4_compare(&a->first, b);
+}
+
+static void log_block(struct xlator *jool, struct pba_block *block,
+		enum natlog_event event, char *action)
+{
+	struct ipv6_transport_addr subscriber;
+	struct ipv4_transport_addr last;
+	time64_t tsec;
+	struct tm time;
+
+	if (!jool->globals.nat64.bib.bib_logging || block->deterministic)
+		return;
+
+	last.l3.s_addr = 0;
+	last.l4 = block->first.l4 + block->size - 1;
+
+	if (jool->globals.nat64.bib.ring_logging) {
+		subscriber.l3 = block->subscriber.addr;
+		subscriber.l4 = block->subscriber.len;
+		natlog_add(jool, event, block->proto, &subscriber, NULL,
+				&block->first, &last);
+		return;
+	}
+
+	tsec = ktime_get_real_seconds();
+	time64_to_tm(tsec, 0, &time);
+	log_info("%s %ld/%d/%d %d:%d:%d (GMT) - %s %pI6c/%u to " TA4PP "-%u (%s)",
+			jool->iname,
+			1900 + time.tm_year, time.tm_mon + 1, time.tm_mday,
+			time.tm_hour, time.tm_min, time.tm_sec, action,
+			&block->subscriber.addr, block->subscriber.len,
+			TA4PA(block->first), last.l4,
+			l4proto_to_string(block->proto));
+}
+
+void pba_init(struct pba_table *table)
+{
+	table->tree6 = RB_ROOT;
+	table->tree4 = RB_ROOT;
+}
+
+/**
+ * Releases every block in @table, without logging.
+ * Only meant to be used while the BIB is being destroyed.
+ */
+void pba_flush(struct pba_table *table)
+{
+	struct pba_block *block, *tmp;
+
+	rbtree_foreach(block, tmp, &table->tree4, hook4)
+		wkfree(struct pba_block, block);
+
+	table->tree6 = RB_ROOT;
+	table->tree4 = RB_ROOT;
+}
+
+/**
+ * Returns @subscriber's first block, or NULL if it doesn't have any.
+ */
+struct pba_block *pba_first(struct pba_table *table,
+		struct ipv6_prefix const *subscriber)
+{
+	struct rb_node *node;
+	struct pba_block *block;
+	struct pba_block *result = NULL;
+	int comparison;
+
+	node = table->tree6.rb_node;
+	while (node) {
+		block = node2block6(node);
+		comparison = compare_subscriber(&block->subscriber, subscriber);
+		if (comparison < 0) {
+			node = node->rb_right;
+		} else if (comparison > 0) {
+			node = node->rb_left;
+		} else {
+			/* Keep looking for an earlier one. */
+			result = block;
+			node = node->rb_left;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * Returns the subscriber's block that follows @block, or NULL if @block is the
+ * last one.
+ */
+struct pba_block *pba_next(struct pba_block *block)
+{
+	struct pba_block *next;
+
+	next = node2block6(rb_next(&block->hook6));
+	if (!next)
+		return NULL;
+
+	return compare_subscriber(&next->subscriber, &block->subscriber)
+			? NULL
+			: next;
+}
+
+/**
+ * Can @block still be used to mask connections from @masks?
+ * (pool4 might have changed since the block was lent.)
+ */
+bool pba_matches(struct pba_block *block, struct mask_domain *masks)
+{
+	struct ipv4_transport_addr last;
+
+	last.l3 = block->first.l3;
+	last.l4 = block->first.l4 + block->size - 1;
+
+	return mask_domain_matches(masks, &block->first)
+			&& mask_domain_matches(masks, &last);
+}
+
+/*
+ * Returns the block from @table that overlaps with
+ * [@first, @first + @size - 1], or NULL if there is none.
+ *
+ * (Blocks are aligned, so there usually are no partial overlaps. But
+ * pba-block-size might have changed since the older blocks were lent.)
+ */
+static struct pba_block *find_overlap(struct pba_table *table,
+		struct ipv4_transport_addr const *first,
+		unsigned int size)
+{
+	struct rb_node *node;
+	struct pba_block *block;
+	struct pba_block *prev = NULL;
+	struct pba_block *next = NULL;
+
+	node = table->tree4.rb_node;
+	while (node) {
+		block = node2block4(node);
+		if (taddr4_compare(&block->first, first) <= 0) {
+			prev = block;
+			node = node->rb_right;
+		} else {
+			next = block;
+			node = node->rb_left;
+		}
+	}
+
+	if (prev && prev->first.l3.s_addr == first->l3.s_addr
+			&& prev->first.l4 + prev->size > first->l4)
+		return prev;
+	if (next && next->first.l3.s_addr == first->l3.s_addr
+			&& next->first.l4 < first->l4 + size)
+		return next;
+	return NULL;
+}
+
+static int insert_block(struct pba_table *table,
+		struct ipv6_prefix const *subscriber, l4_protocol proto,
+		struct ipv4_transport_addr const *first, unsigned int size,
+		bool deterministic, struct pba_block **result)
+{
+	struct pba_block *block;
+
+	block = wkmalloc(struct pba_block, GFP_ATOMIC);
+	if (!block)
+		return -ENOMEM;
+
+	block->subscriber = *subscriber;
+	block->first = *first;
+	block->size = size;
+	block->proto = proto;
+	block->deterministic = deterministic;
+	block->bibs = 0;
+	block->next = 0;
+
+	if (WARN(rbtree_add(block, block, &table->tree6, compare_block6,
+			struct pba_block, hook6), "Block was not in tree4 but was in tree6.")) {
+		wkfree(struct pba_block, block);
+		return -EINVAL;
+	}
+	if (WARN(rbtree_add(block, first, &table->tree4, compare_block4,
+			struct pba_block, hook4), "Overlap check missed a block.")) {
+		rb_erase(&block->hook6, &table->tree6);
+		wkfree(struct pba_block, block);
+		return -EINVAL;
+	}
+
+	*result = block;
+	return 0;
+}
+
+/**
+ * Lends a new block from @masks to @subscriber.
+ *
+ * The block is added to @table right away, but is considered tentative until
+ * pba_commit(). If you end up not needing it, pba_cancel() it.
+ *
+ * Consecutive calls (using the same @masks) return different blocks.
+ */
+int pba_add(struct pba_table *table, struct mask_domain *masks,
+		struct ipv6_prefix const *subscriber, l4_protocol proto,
+		unsigned int size, struct pba_block **result)
+{
+	struct ipv4_transport_addr first;
+	int error;
+
+	do {
+		error = mask_domain_next_block(masks, size, &first);
+		if (error)
+			return error;
+	} while (find_overlap(table, &first, size));
+
+	return insert_block(table, subscriber, proto, &first, size, false,
+			result);
+}
+
+/**
+ * Deterministic version of pba_add(): Returns the block that
+ * pba-deterministic-prefix assigns to @src6's subscriber. If the subscriber
+ * isn't using it yet, it is added as in pba_add().
+ *
+ * Returns -ESRCH if @src6 doesn't belong to pba-deterministic-prefix, or if
+ * @masks doesn't have a block for it. Also if the block is still occupied by
+ * some other subscriber, which can only happen while the old blocks die out
+ * after a configuration change.
+ */
+int pba_add_det(struct xlator *jool, struct pba_table *table,
+		struct mask_domain *masks, struct in6_addr const *src6,
+		l4_protocol proto, struct pba_block **result)
+{
+	struct bib_config *cfg = &jool->globals.nat64.bib;
+	struct ipv6_prefix subscriber;
+	struct ipv4_transport_addr first;
+	struct pba_block *block;
+	__u64 index;
+	int error;
+
+	error = det_subscriber_index(&cfg->pba_det_prefix.prefix,
+			cfg->pba_prefix_len, src6, &index);
+	if (error == -EINVAL) {
+		log_warn_once("pba-prefix-length (%u) is incompatible with pba-deterministic-prefix (%pI6c/%u).",
+				cfg->pba_prefix_len,
+				&cfg->pba_det_prefix.prefix.addr,
+				cfg->pba_det_prefix.prefix.len);
+		return -ESRCH;
+	}
+	if (error) {
+		__log_debug(jool, "%pI6c is not a deterministic subscriber.",
+				src6);
+		return error;
+	}
+
+	error = mask_domain_det_block(masks, cfg->pba_block_size, index,
+			&first);
+	if (error) {
+		log_warn_once("Pool4 mark %u has no port block for deterministic subscriber %pI6c.",
+				mask_domain_get_mark(masks), src6);
+		return error;
+	}
+
+	det_subscriber_prefix(&cfg->pba_det_prefix.prefix, cfg->pba_prefix_len,
+			index, &subscriber);
+
+	for (block = pba_first(table, &subscriber); block;
+			block = pba_next(block)) {
+		if (block->deterministic && block->size == cfg->pba_block_size
+				&& taddr4_equals(&block->first, &first)) {
+			*result = block;
+			return 0;
+		}
+	}
+
+	if (find_overlap(table, &first, cfg->pba_block_size)) {
+		__log_debug(jool, "Block " TA4PP " is still in use.",
+				TA4PA(first));
+		return -ESRCH;
+	}
+
+	return insert_block(table, &subscriber, proto, &first,
+			cfg->pba_block_size, true, result);
+}
+
+static void rm_block(struct pba_table *table, struct pba_block *block)
+{
+	rb_erase(&block->hook6, &table->tree6);
+	rb_erase(&block->hook4, &table->tree4);
+	wkfree(struct pba_block, block);
+}
+
+/**
+ * Records that a new BIB entry borrowed its port from @block.
+ */
+void pba_commit(struct xlator *jool, struct pba_block *block)
+{
+	if (block->bibs == 0)
+		log_block(jool, block, NATLOG_BLOCK_ADD, "Allocated block");
+	block->bibs++;
+}
+
+/**
+ * Reverts pba_add(), if @block hasn't been committed.
+ */
+void pba_cancel(struct pba_table *table, struct pba_block *block)
+{
+	if (block->bibs == 0)
+		rm_block(table, block);
+}
+
+/**
+ * Records that a BIB entry that borrowed its port from @block died.
+ * Returns the block once its last BIB entry is gone.
+ */
+void pba_put(struct xlator *jool, struct pba_table *table,
+		struct pba_block *block)
+{
+	block->bibs--;
+	if (block->bibs == 0) {
+		log_block(jool, block, NATLOG_BLOCK_RM, "Released block");
+		rm_block(table, block);
+	}
+}
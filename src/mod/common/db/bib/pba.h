@@ -0,0 +1,79 @@
+#ifndef SRC_MOD_NAT64_BIB_PBA_H_
+#define SRC_MOD_NAT64_BIB_PBA_H_
+
+/**
+ * @file
+ * Port Block Allocation (PBA), as in RFC 7422.
+ *
+ * When pba-block-size is nonzero, the BIB does not borrow pool4 transport
+ * addresses one at a time. Instead, each subscriber (IPv6 prefix of length
+ * pba-prefix-length) is lazily lent a block of pba-block-size contiguous ports
+ * (on a single pool4 address), and its BIB entries are masked using ports from
+ * its blocks. The subscriber only gets another block once its current ones are
+ * full, and a block is returned once its last BIB entry dies.
+ *
+ * So the expensive pool4 traversal only happens once per block, and, because
+ * the subscriber's mapping can be inferred from the block, only block events
+ * need to be logged.
+ *
+ * If pba-deterministic-prefix is set, blocks are not lent on demand. Instead,
+ * each subscriber is always masked using the one block that
+ * common/deterministic.h assigns to it. Its mapping can be computed offline,
+ * so deterministic blocks are never logged.
+ *
+ * Blocks are owned by their BIB table, and are protected by its spinlock.
+ */
+
+#include "mod/common/xlator.h"
+#include "mod/common/db/pool4/db.h"
+
+struct pba_block {
+	/** The subscriber; src6 masked to pba-prefix-length. */
+	struct ipv6_prefix subscriber;
+	/** Pool4 address and first port of the block. */
+	struct ipv4_transport_addr first;
+	/** Number of ports in the block. */
+	unsigned int size;
+	l4_protocol proto;
+	/** Was the block assigned by pba_add_det()? */
+	bool deterministic;
+
+	/**
+	 * Number of BIB entries that borrowed their port from this block.
+	 * Zero means the block is brand new and has not been committed yet.
+	 */
+	unsigned int bibs;
+	/** Offset (from @first) of the next port that should be tried. */
+	unsigned int next;
+
+	/** Indexes the block by @subscriber, then @first. */
+	struct rb_node hook6;
+	/** Indexes the block by @first. */
+	struct rb_node hook4;
+};
+
+struct pba_table {
+	struct rb_root tree6;
+	struct rb_root tree4;
+};
+
+void pba_init(struct pba_table *table);
+void pba_flush(struct pba_table *table);
+
+struct pba_block *pba_first(struct pba_table *table,
+		struct ipv6_prefix const *subscriber);
+struct pba_block *pba_next(struct pba_block *block);
+bool pba_matches(struct pba_block *block, struct mask_domain *masks);
+
+int pba_add(struct pba_table *table, struct mask_domain *masks,
+		struct ipv6_prefix const *subscriber, l4_protocol proto,
+		unsigned int size, struct pba_block **result);
+int pba_add_det(struct xlator *jool, struct pba_table *table,
+		struct mask_domain *masks, struct in6_addr const *src6,
+		l4_protocol proto, struct pba_block **result);
+void pba_commit(struct xlator *jool, struct pba_block *block);
+void pba_cancel(struct pba_table *table, struct pba_block *block);
+void pba_put(struct xlator *jool, struct pba_table *table,
+		struct pba_block *block);
+
+#endif /* SRC_MOD_NAT64_BIB_PBA_H_ */
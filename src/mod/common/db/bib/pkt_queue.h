@@ -155,7 +155,7 @@ unsigned int pktqueue_prepare_clean(struct pktqueue *queue,
 /**
  * Sends the ICMP errors contained in the @probe list.
  */
-void pktqueue_clean(struct list_head *probes);
+void pktqueue_clean(struct xlator *jool, struct list_head *probes);
 
 
 #endif /* SRC_MOD_NAT64_BIB_PKT_QUEUE_H_ */
@@ -0,0 +1,230 @@
+#include "mod/common/db/bib/subscriber.h"
+
+#include <linux/jhash.h>
+#include <linux/jiffies.h>
+#include <linux/random.h>
+#include <net/ipv6.h>
+#include "mod/common/address.h"
+#include "mod/common/wkmalloc.h"
+#include "mod/common/db/rbtree.h"
+
+/* Columns of the count-min sketch. Must be a power of two. */
+#define SKETCH_WIDTH 512
+#define SKETCH_SIZE (SKETCH_DEPTH * SKETCH_WIDTH * sizeof(__u32))
+/*
+ * The sketch and the top talkers are halved this often, so a subscriber's
+ * estimate is roughly the number of sessions it requested during the last
+ * couple of periods.
+ */
+#define DECAY_PERIOD msecs_to_jiffies(60 * 1000)
+
+static struct subscriber *node2subscriber(struct rb_node *node)
+{
+	return rb_entry(node, struct subscriber, hook);
+}
+
+static int compare_prefix(struct subscriber const *a,
+		struct ipv6_prefix const *b)
+{
+	int gap;
+
+	gap = ipv6_addr_cmp(&a->prefix.addr, &b->addr);
+	if (gap)
+		return gap;
+
+	return ((int)a->prefix.len) - ((int)b->len);
+}
+
+int subscriber_init(struct subscriber_table *table)
+{
+	table->sketch = __wkmalloc("subscriber sketch", SKETCH_SIZE,
+			GFP_KERNEL);
+	if (!table->sketch)
+		return -ENOMEM;
+	memset(table->sketch, 0, SKETCH_SIZE);
+	get_random_bytes(table->seeds, sizeof(table->seeds));
+	table->last_decay = jiffies;
+
+	table->tree = RB_ROOT;
+	table->top_len = 0;
+	return 0;
+}
+
+/**
+ * Releases everything in @table. Only meant to be used while the BIB is being
+ * destroyed.
+ */
+void subscriber_destroy(struct subscriber_table *table)
+{
+	struct subscriber *subscriber, *tmp;
+
+	rbtree_foreach(subscriber, tmp, &table->tree, hook)
+		wkfree(struct subscriber, subscriber);
+	table->tree = RB_ROOT;
+
+	__wkfree("subscriber sketch", table->sketch);
+	table->sketch = NULL;
+}
+
+/**
+ * Returns @prefix's session counter, creating it if it doesn't exist.
+ *
+ * The counter is not charged; the caller is expected to increment
+ * (*result)->sessions once the session is committed. (A brand new counter that
+ * is never charged leaks until the BIB dies, so don't call this unless you're
+ * sure the session will be added.)
+ */
+int subscriber_get(struct subscriber_table *table,
+		struct ipv6_prefix const *prefix, struct subscriber **result)
+{
+	struct subscriber *subscriber;
+	struct rb_node **node;
+	struct rb_node *parent;
+
+	rbtree_find_node(prefix, &table->tree, compare_prefix,
+			struct subscriber, hook, parent, node);
+	if (*node) {
+		*result = node2subscriber(*node);
+		return 0;
+	}
+
+	subscriber = wkmalloc(struct subscriber, GFP_ATOMIC);
+	if (!subscriber)
+		return -ENOMEM;
+
+	subscriber->prefix = *prefix;
+	subscriber->sessions = 0;
+	rb_link_node(&subscriber->hook, parent, node);
+	rb_insert_color(&subscriber->hook, &table->tree);
+
+	*result = subscriber;
+	return 0;
+}
+
+/**
+ * Records that @sessions of @subscriber's sessions died. The counter is
+ * released once the subscriber runs out of sessions.
+ */
+void subscriber_put(struct subscriber_table *table,
+		struct subscriber *subscriber, unsigned int sessions)
+{
+	if (WARN(subscriber->sessions < sessions,
+			"Subscriber %pI6c/%u is releasing %u sessions, but only has %u.",
+			&subscriber->prefix.addr, subscriber->prefix.len,
+			sessions, subscriber->sessions))
+		sessions = subscriber->sessions;
+
+	subscriber->sessions -= sessions;
+	if (subscriber->sessions == 0) {
+		rb_erase(&subscriber->hook, &table->tree);
+		wkfree(struct subscriber, subscriber);
+	}
+}
+
+static void update_top(struct subscriber_table *table,
+		struct ipv6_prefix const *prefix, __u32 estimate)
+{
+	struct top_talker *talker;
+	struct top_talker *min = NULL;
+	unsigned int i;
+
+	for (i = 0; i < table->top_len; i++) {
+		talker = &table->top[i];
+		if (prefix6_equals(&talker->prefix, prefix)) {
+			talker->requests = estimate;
+			return;
+		}
+		if (!min || talker->requests < min->requests)
+			min = talker;
+	}
+
+	if (table->top_len < TOP_TALKERS)
+		talker = &table->top[table->top_len++];
+	else if (estimate > min->requests)
+		talker = min;
+	else
+		return;
+
+	talker->prefix = *prefix;
+	talker->requests = estimate;
+	talker->sessions = 0;
+}
+
+/**
+ * Records that @prefix requested a session.
+ *
+ * This is a conservative update: Only the counters that hold the current
+ * estimate are incremented. (The others already overestimate, due to
+ * collisions.)
+ */
+void subscriber_request(struct subscriber_table *table,
+		struct ipv6_prefix const *prefix)
+{
+	__u32 *counters[SKETCH_DEPTH];
+	__u32 estimate = U32_MAX;
+	unsigned int row;
+	u32 hash;
+
+	for (row = 0; row < SKETCH_DEPTH; row++) {
+		hash = jhash2((u32 const *)prefix->addr.s6_addr32, 4,
+				table->seeds[row] ^ prefix->len);
+		counters[row] = &table->sketch[row * SKETCH_WIDTH
+				+ (hash & (SKETCH_WIDTH - 1))];
+		estimate = min(estimate, *counters[row]);
+	}
+
+	if (estimate == U32_MAX)
+		return;
+	estimate++;
+
+	for (row = 0; row < SKETCH_DEPTH; row++)
+		if (*counters[row] < estimate)
+			*counters[row] = estimate;
+
+	update_top(table, prefix, estimate);
+}
+
+/**
+ * Halves the sketch and the top talkers, if DECAY_PERIOD has elapsed since the
+ * last time.
+ */
+void subscriber_decay(struct subscriber_table *table)
+{
+	unsigned int i, j;
+
+	if (time_before(jiffies, table->last_decay + DECAY_PERIOD))
+		return;
+
+	for (i = 0; i < SKETCH_DEPTH * SKETCH_WIDTH; i++)
+		table->sketch[i] >>= 1;
+
+	for (i = 0, j = 0; i < table->top_len; i++) {
+		table->top[i].requests >>= 1;
+		if (table->top[i].requests)
+			table->top[j++] = table->top[i];
+	}
+	table->top_len = j;
+
+	table->last_decay = jiffies;
+}
+
+/**
+ * Copies the top talkers to @result (which needs to be able to hold
+ * TOP_TALKERS entries), along with their current session counts.
+ * Returns the number of talkers copied.
+ */
+unsigned int subscriber_top(struct subscriber_table *table,
+		struct top_talker *result)
+{
+	struct subscriber *subscriber;
+	unsigned int i;
+
+	for (i = 0; i < table->top_len; i++) {
+		result[i] = table->top[i];
+		subscriber = rbtree_find(&result[i].prefix, &table->tree,
+				compare_prefix, struct subscriber, hook);
+		result[i].sessions = subscriber ? subscriber->sessions : 0;
+	}
+
+	return table->top_len;
+}
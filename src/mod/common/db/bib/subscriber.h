@@ -0,0 +1,80 @@
+#ifndef SRC_MOD_NAT64_BIB_SUBSCRIBER_H_
+#define SRC_MOD_NAT64_BIB_SUBSCRIBER_H_
+
+/**
+ * @file
+ * Per-subscriber session accounting.
+ *
+ * A subscriber is a src6 masked to session-quota-prefix-length. Each BIB table
+ * keeps track of two things about them:
+ *
+ * 1. The number of sessions each subscriber currently holds, so session-quota
+ *    can be enforced. These counters are exact, but they are only created
+ *    while session-quota is enabled, and only live as long as the subscriber
+ *    holds sessions.
+ * 2. A count-min sketch of the number of sessions each subscriber has
+ *    requested lately (whether it got them or not), along with the
+ *    subscribers that have the highest estimates (the "top talkers"). The
+ *    sketch has constant size, so it can follow everyone, all the time. It's
+ *    halved periodically, so old activity fades away.
+ *
+ * Everything is owned by the BIB table, and protected by its spinlock.
+ */
+
+#include <linux/rbtree.h>
+#include "common/types.h"
+
+/* Rows of the count-min sketch. (ie. number of hash functions.) */
+#define SKETCH_DEPTH 4
+/* Number of subscribers in the top talkers list. */
+#define TOP_TALKERS 16
+
+struct subscriber {
+	/** src6 masked to session-quota-prefix-length. */
+	struct ipv6_prefix prefix;
+	/** Number of sessions that currently belong to the subscriber. */
+	unsigned int sessions;
+	struct rb_node hook;
+};
+
+struct top_talker {
+	struct ipv6_prefix prefix;
+	/** Sketch's estimate of the sessions the subscriber requested lately. */
+	__u32 requests;
+	/**
+	 * Number of sessions the subscriber currently holds, if it has a
+	 * counter. Only set by subscriber_top().
+	 */
+	__u32 sessions;
+};
+
+struct subscriber_table {
+	/** Indexes the struct subscribers by prefix. */
+	struct rb_root tree;
+
+	/** SKETCH_DEPTH rows of SKETCH_WIDTH counters. */
+	__u32 *sketch;
+	__u32 seeds[SKETCH_DEPTH];
+	/** Last time the sketch was halved. (jiffies) */
+	unsigned long last_decay;
+
+	/** Unsorted. */
+	struct top_talker top[TOP_TALKERS];
+	unsigned int top_len;
+};
+
+int subscriber_init(struct subscriber_table *table);
+void subscriber_destroy(struct subscriber_table *table);
+
+int subscriber_get(struct subscriber_table *table,
+		struct ipv6_prefix const *prefix, struct subscriber **result);
+void subscriber_put(struct subscriber_table *table,
+		struct subscriber *subscriber, unsigned int sessions);
+
+void subscriber_request(struct subscriber_table *table,
+		struct ipv6_prefix const *prefix);
+void subscriber_decay(struct subscriber_table *table);
+unsigned int subscriber_top(struct subscriber_table *table,
+		struct top_talker *result);
+
+#endif /* SRC_MOD_NAT64_BIB_SUBSCRIBER_H_ */
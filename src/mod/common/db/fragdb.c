@@ -0,0 +1,541 @@
+#include "mod/common/db/fragdb.h"
+
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/kref.h>
+#include <linux/random.h>
+#include "mod/common/log.h"
+#include "mod/common/wkmalloc.h"
+
+/*
+ * Maximum time the fragments of a datagram can take to arrive.
+ * (Same as the kernel's default net.ipv4.ipfrag_time.)
+ */
+#define FRAGDB_TIMEOUT msecs_to_jiffies(30 * 1000)
+/*
+ * Maximum number of datagrams tracked at the same time. If a new one needs to
+ * be tracked while the database is full, the oldest one is evicted.
+ */
+#define FRAGDB_MAX_ENTRIES 4096
+#define FRAGDB_HASH_BITS 10
+/*
+ * Maximum number of disjoint chunks of a datagram's payload that are tracked.
+ * (Contiguous chunks are merged, so this is only reached if the fragments
+ * arrive very out of order.)
+ */
+#define FRAGDB_MAX_CHUNKS 16
+
+/* A [start, end) range of a datagram's layer 3 payload. */
+struct fragdb_chunk {
+	unsigned int start;
+	unsigned int end;
+};
+
+/* Identifies a datagram. (RFC 791, section 2.3; RFC 8200, section 4.5) */
+struct fragdb_key {
+	union {
+		struct {
+			struct in6_addr src;
+			struct in6_addr dst;
+		} v6;
+		struct {
+			struct in_addr src;
+			struct in_addr dst;
+		} v4;
+	};
+	__be32 id;
+	__u8 l3_proto;
+	__u8 l4_proto;
+	__u16 padding;
+};
+
+struct fragdb_entry {
+	struct fragdb_key key;
+
+	/* Have @in and @out been set? (ie. Was the first fragment seen?) */
+	bool mapped;
+	struct tuple in;
+	struct tuple out;
+
+	/* Fragments that arrived before the first one. */
+	struct sk_buff_head early;
+
+	/*
+	 * Length of the datagram's layer 3 payload, as defined by its last
+	 * fragment. Zero if the last fragment hasn't been translated yet.
+	 */
+	unsigned int total;
+	/*
+	 * Layer 3 payload chunks translated so far. Sorted, and neither
+	 * overlapping nor adjacent.
+	 */
+	struct fragdb_chunk chunks[FRAGDB_MAX_CHUNKS];
+	unsigned int chunk_count;
+
+	unsigned long expires;
+	struct hlist_node hash_hook;
+	/** Links this entry to fragdb.list. */
+	struct list_head list_hook;
+};
+
+struct fragdb {
+	DECLARE_HASHTABLE(table, FRAGDB_HASH_BITS);
+	/* The entries, sorted by expiration date. (oldest to newest) */
+	struct list_head list;
+	unsigned int entry_count;
+	/* Total length of all the entries' @early queues. */
+	unsigned int early_count;
+	u32 seed;
+
+	spinlock_t lock;
+	struct kref refcounter;
+};
+
+struct fragdb *fragdb_alloc(void)
+{
+	struct fragdb *result;
+
+	result = wkmalloc(struct fragdb, GFP_KERNEL);
+	if (!result)
+		return NULL;
+
+	hash_init(result->table);
+	INIT_LIST_HEAD(&result->list);
+	result->entry_count = 0;
+	result->early_count = 0;
+	get_random_bytes(&result->seed, sizeof(result->seed));
+	spin_lock_init(&result->lock);
+	kref_init(&result->refcounter);
+
+	return result;
+}
+
+void fragdb_get(struct fragdb *db)
+{
+	kref_get(&db->refcounter);
+}
+
+/*
+ * Removes @entry from @db, and moves its stored fragments to @garbage.
+ * Assumes the lock is held.
+ */
+static void rm_entry(struct fragdb *db, struct fragdb_entry *entry,
+		struct sk_buff_head *garbage)
+{
+	db->early_count -= skb_queue_len(&entry->early);
+	skb_queue_splice_tail_init(&entry->early, garbage);
+
+	hash_del(&entry->hash_hook);
+	list_del(&entry->list_hook);
+	db->entry_count--;
+	wkfree(struct fragdb_entry, entry);
+}
+
+/*
+ * Drops the fragments whose first fragment never showed up.
+ * Do not hold the lock while calling this.
+ */
+static void purge(struct xlator *jool, struct sk_buff_head *garbage)
+{
+	unsigned int count;
+
+	count = skb_queue_len(garbage);
+	if (!count)
+		return;
+
+	__skb_queue_purge(garbage);
+	if (jool)
+		jstat_add(jool->stats, JSTAT_FRAG_EXPIRED, count);
+}
+
+static void fragdb_release(struct kref *refcounter)
+{
+	struct fragdb *db;
+	struct fragdb_entry *entry;
+	struct fragdb_entry *tmp;
+	struct sk_buff_head garbage;
+
+	db = container_of(refcounter, struct fragdb, refcounter);
+	__skb_queue_head_init(&garbage);
+
+	list_for_each_entry_safe(entry, tmp, &db->list, list_hook)
+		rm_entry(db, entry, &garbage);
+	purge(NULL, &garbage);
+
+	wkfree(struct fragdb, db);
+}
+
+void fragdb_put(struct fragdb *db)
+{
+	kref_put(&db->refcounter, fragdb_release);
+}
+
+/**
+ * Returns whether virtual reassembly is supposed to handle @state's packet.
+ * If it is, @first will tell whether the packet is its datagram's first
+ * fragment.
+ *
+ * ICMP fragments are not included, because pkt_init_ipv*() already drops them.
+ */
+bool fragdb_is_fragment(struct xlation *state, bool *first)
+{
+	struct packet *in = &state->in;
+	struct frag_hdr *hdr_frag;
+	struct iphdr *hdr4;
+
+	if (!state->jool.globals.nat64.virtual_reassembly)
+		return false;
+
+	switch (pkt_l4_proto(in)) {
+	case L4PROTO_TCP:
+	case L4PROTO_UDP:
+		break;
+	default:
+		return false;
+	}
+
+	switch (pkt_l3_proto(in)) {
+	case L3PROTO_IPV6:
+		hdr_frag = pkt_frag_hdr(in);
+		if (!is_fragmented_ipv6(hdr_frag))
+			return false;
+		*first = is_first_frag6(hdr_frag);
+		return true;
+	case L3PROTO_IPV4:
+		hdr4 = pkt_ip4_hdr(in);
+		if (!is_fragmented_ipv4(hdr4))
+			return false;
+		*first = is_first_frag4(hdr4);
+		return true;
+	}
+
+	return false;
+}
+
+static void init_key(struct packet *pkt, struct fragdb_key *key)
+{
+	struct ipv6hdr *hdr6;
+	struct iphdr *hdr4;
+
+	memset(key, 0, sizeof(*key));
+	key->l3_proto = pkt_l3_proto(pkt);
+	key->l4_proto = pkt_l4_proto(pkt);
+
+	switch (pkt_l3_proto(pkt)) {
+	case L3PROTO_IPV6:
+		hdr6 = pkt_ip6_hdr(pkt);
+		key->v6.src = hdr6->saddr;
+		key->v6.dst = hdr6->daddr;
+		key->id = pkt_frag_hdr(pkt)->identification;
+		break;
+	case L3PROTO_IPV4:
+		hdr4 = pkt_ip4_hdr(pkt);
+		key->v4.src.s_addr = hdr4->saddr;
+		key->v4.dst.s_addr = hdr4->daddr;
+		key->id = cpu_to_be32(be16_to_cpu(hdr4->id));
+		break;
+	}
+}
+
+static u32 hash_key(struct fragdb *db, struct fragdb_key const *key)
+{
+	return jhash(key, sizeof(*key), db->seed);
+}
+
+static struct fragdb_entry *find_entry(struct fragdb *db,
+		struct fragdb_key const *key, u32 hash)
+{
+	struct fragdb_entry *entry;
+
+	hash_for_each_possible(db->table, entry, hash_hook, hash)
+		if (memcmp(&entry->key, key, sizeof(*key)) == 0)
+			return entry;
+
+	return NULL;
+}
+
+/* Assumes the lock is held. */
+static struct fragdb_entry *create_entry(struct fragdb *db,
+		struct fragdb_key const *key, u32 hash,
+		struct sk_buff_head *garbage)
+{
+	struct fragdb_entry *entry;
+
+	if (db->entry_count >= FRAGDB_MAX_ENTRIES) {
+		entry = list_first_entry(&db->list, struct fragdb_entry,
+				list_hook);
+		rm_entry(db, entry, garbage);
+	}
+
+	entry = wkmalloc(struct fragdb_entry, GFP_ATOMIC);
+	if (!entry)
+		return NULL;
+
+	entry->key = *key;
+	entry->mapped = false;
+	__skb_queue_head_init(&entry->early);
+	entry->total = 0;
+	entry->chunk_count = 0;
+	entry->expires = jiffies + FRAGDB_TIMEOUT;
+	hash_add(db->table, &entry->hash_hook, hash);
+	list_add_tail(&entry->list_hook, &db->list);
+	db->entry_count++;
+
+	return entry;
+}
+
+/*
+ * Adds the [@start, @end) chunk to @entry's coverage.
+ *
+ * If there's no room for it, it is silently not recorded. That only means the
+ * entry will not be able to tell when the datagram is complete (so it will
+ * have to wait until it expires), and that duplicates of this chunk will not
+ * be detected.
+ */
+static int add_chunk(struct fragdb_entry *entry, unsigned int start,
+		unsigned int end)
+{
+	struct fragdb_chunk *chunks = entry->chunks;
+	unsigned int i;
+
+	/* Find the first chunk that doesn't end before @start. */
+	for (i = 0; i < entry->chunk_count; i++)
+		if (chunks[i].end >= start)
+			break;
+
+	if (i < entry->chunk_count && chunks[i].start < end
+			&& start < chunks[i].end)
+		return -EEXIST;
+	if (i + 1 < entry->chunk_count && chunks[i + 1].start < end)
+		return -EEXIST;
+
+	if (i < entry->chunk_count && chunks[i].end == start) {
+		chunks[i].end = end;
+		if (i + 1 < entry->chunk_count && chunks[i + 1].start == end) {
+			chunks[i].end = chunks[i + 1].end;
+			entry->chunk_count--;
+			memmove(&chunks[i + 1], &chunks[i + 2],
+					(entry->chunk_count - i - 1)
+					* sizeof(*chunks));
+		}
+		return 0;
+	}
+	if (i < entry->chunk_count && chunks[i].start == end) {
+		chunks[i].start = start;
+		return 0;
+	}
+
+	if (entry->chunk_count >= FRAGDB_MAX_CHUNKS)
+		return 0;
+	memmove(&chunks[i + 1], &chunks[i],
+			(entry->chunk_count - i) * sizeof(*chunks));
+	chunks[i].start = start;
+	chunks[i].end = end;
+	entry->chunk_count++;
+	return 0;
+}
+
+/*
+ * Takes note of @pkt's chunk of the datagram's payload.
+ *
+ * Returns 1 if the entire datagram has been translated, 0 if it hasn't, and
+ * -EEXIST if @pkt overlaps a chunk that had already been translated. (In
+ * which case @pkt is not recorded.)
+ */
+static int account(struct fragdb_entry *entry, struct packet *pkt)
+{
+	unsigned int offset;
+	unsigned int len;
+	bool last;
+	int error;
+
+	switch (pkt_l3_proto(pkt)) {
+	case L3PROTO_IPV6:
+		offset = get_fragment_offset_ipv6(pkt_frag_hdr(pkt));
+		last = !is_mf_set_ipv6(pkt_frag_hdr(pkt));
+		break;
+	case L3PROTO_IPV4:
+		offset = get_fragment_offset_ipv4(pkt_ip4_hdr(pkt));
+		last = !is_mf_set_ipv4(pkt_ip4_hdr(pkt));
+		break;
+	default:
+		return 0;
+	}
+
+	len = pkt_len(pkt) - (pkt_l4hdr(pkt) - pkt_data(pkt));
+	if (len) {
+		error = add_chunk(entry, offset, offset + len);
+		if (error)
+			return error;
+	}
+	if (last)
+		entry->total = offset + len;
+
+	return entry->total && entry->chunk_count == 1
+			&& entry->chunks[0].start == 0
+			&& entry->chunks[0].end == entry->total;
+}
+
+/*
+ * RFC 5722: IPv6 datagrams that contain overlapping fragments need to be
+ * discarded entirely. (This can only drop the fragments that haven't been
+ * translated yet, of course.) IPv4 allows overlaps, but there's no reason to
+ * translate the same bytes twice, so only the offending fragment is dropped.
+ */
+static bool overlap_kills_datagram(struct packet *pkt)
+{
+	return pkt_l3_proto(pkt) == L3PROTO_IPV6;
+}
+
+/**
+ * Assumes @state's packet is a subsequent fragment, and fills its tuples with
+ * the ones that were computed for its datagram's first fragment.
+ *
+ * If the first fragment hasn't been translated yet, and @queue is true, the
+ * packet is stored until it is. (In which case the packet is stolen.)
+ */
+verdict fragdb_find(struct xlation *state, bool queue)
+{
+	struct fragdb *db = state->jool.nat64.fragdb;
+	struct fragdb_key key;
+	struct fragdb_entry *entry;
+	struct sk_buff_head garbage;
+	u32 hash;
+	verdict result;
+	int error;
+
+	init_key(&state->in, &key);
+	hash = hash_key(db, &key);
+	__skb_queue_head_init(&garbage);
+
+	spin_lock_bh(&db->lock);
+
+	entry = find_entry(db, &key, hash);
+	if (entry && entry->mapped) {
+		error = account(entry, &state->in);
+		if (error < 0) {
+			log_debug(state, "The fragment overlaps a previous one.");
+			if (overlap_kills_datagram(&state->in))
+				rm_entry(db, entry, &garbage);
+			result = drop(state, JSTAT_FRAG_OVERLAP);
+			goto end;
+		}
+
+		state->in.tuple = entry->in;
+		state->out.tuple = entry->out;
+		if (error)
+			rm_entry(db, entry, &garbage);
+		result = VERDICT_CONTINUE;
+		goto end;
+	}
+
+	if (!queue) {
+		log_debug(state, "The fragment's datagram is unknown.");
+		result = drop(state, JSTAT_FRAG_UNKNOWN);
+		goto end;
+	}
+	if (db->early_count >= state->jool.globals.nat64.max_stored_frags) {
+		log_debug(state, "Too many fragments are already waiting for their first fragment.");
+		result = drop(state, JSTAT_FRAG_QUEUE_FULL);
+		goto end;
+	}
+	if (!entry) {
+		entry = create_entry(db, &key, hash, &garbage);
+		if (!entry) {
+			result = drop(state, JSTAT_ENOMEM);
+			goto end;
+		}
+	}
+
+	log_debug(state, "The first fragment hasn't arrived yet; storing.");
+	__skb_queue_tail(&entry->early, state->in.skb);
+	db->early_count++;
+	result = stolen(state, JSTAT_FRAG_QUEUED);
+	/* Fall through. */
+
+end:
+	spin_unlock_bh(&db->lock);
+	purge(&state->jool, &garbage);
+	return result;
+}
+
+/**
+ * Assumes @state's packet is a first fragment whose tuples have already been
+ * computed, and remembers them, so the rest of the datagram can be translated
+ * without them.
+ *
+ * The fragments that had been waiting for @state's packet are moved to @early,
+ * so the caller can translate them. (If @early is NULL, they are left alone.)
+ *
+ * Failure is not fatal; the rest of the datagram will simply be dropped.
+ */
+void fragdb_add(struct xlation *state, struct sk_buff_head *early)
+{
+	struct fragdb *db = state->jool.nat64.fragdb;
+	struct fragdb_key key;
+	struct fragdb_entry *entry;
+	struct sk_buff_head garbage;
+	u32 hash;
+	int error;
+
+	init_key(&state->in, &key);
+	hash = hash_key(db, &key);
+	__skb_queue_head_init(&garbage);
+
+	spin_lock_bh(&db->lock);
+
+	entry = find_entry(db, &key, hash);
+	if (!entry) {
+		entry = create_entry(db, &key, hash, &garbage);
+		if (!entry) {
+			jstat_inc(state->jool.stats, JSTAT_ENOMEM);
+			goto end;
+		}
+	}
+
+	entry->mapped = true;
+	entry->in = state->in.tuple;
+	entry->out = state->out.tuple;
+
+	if (early) {
+		db->early_count -= skb_queue_len(&entry->early);
+		skb_queue_splice_tail_init(&entry->early, early);
+	}
+
+	/*
+	 * (If this is a duplicate first fragment, it's too late to drop it,
+	 * since it has already been translated. But RFC 5722 still applies to
+	 * the rest of the datagram.)
+	 */
+	error = account(entry, &state->in);
+	if (error > 0 || (error < 0 && overlap_kills_datagram(&state->in)))
+		rm_entry(db, entry, &garbage);
+	/* Fall through. */
+
+end:
+	spin_unlock_bh(&db->lock);
+	purge(&state->jool, &garbage);
+}
+
+/**
+ * Forgets the datagrams whose fragments have taken too long to arrive.
+ */
+void fragdb_clean(struct xlator *jool)
+{
+	struct fragdb *db = jool->nat64.fragdb;
+	struct fragdb_entry *entry;
+	struct fragdb_entry *tmp;
+	struct sk_buff_head garbage;
+
+	__skb_queue_head_init(&garbage);
+
+	spin_lock_bh(&db->lock);
+	list_for_each_entry_safe(entry, tmp, &db->list, list_hook) {
+		if (time_before(jiffies, entry->expires))
+			break;
+		rm_entry(db, entry, &garbage);
+	}
+	spin_unlock_bh(&db->lock);
+
+	purge(jool, &garbage);
+}
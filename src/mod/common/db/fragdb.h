@@ -0,0 +1,45 @@
+#ifndef SRC_MOD_COMMON_DB_FRAGDB_H_
+#define SRC_MOD_COMMON_DB_FRAGDB_H_
+
+/**
+ * @file
+ * Virtual reassembly. (Stateful NAT64 only.)
+ *
+ * By default, NAT64 Jool asks nf_defrag_ipv4 and nf_defrag_ipv6 to collect
+ * every fragment of a datagram before the datagram is handed to the
+ * translator, because only the first fragment carries the ports the session
+ * lookup needs. But that means the whole datagram has to be buffered, and
+ * often refragmented on the way out.
+ *
+ * When the virtual-reassembly global is enabled, the defrag modules are left
+ * alone, and this database is used instead. Once a datagram's first fragment
+ * has been translated, its tuples are stored here, indexed by the fields that
+ * identify the datagram (addresses, protocol and fragment identification).
+ * The remaining fragments borrow those tuples, and are translated and
+ * forwarded as soon as they arrive.
+ *
+ * Fragments that show up before their first fragment are stored (at most
+ * maximum-stored-fragments of them, per instance) until it does. If it takes
+ * too long, they are dropped.
+ *
+ * Entries die when all of their datagram's payload has been translated, or
+ * when they time out, whichever happens first.
+ */
+
+#include <linux/skbuff.h>
+#include "mod/common/translation_state.h"
+
+struct fragdb;
+
+struct fragdb *fragdb_alloc(void);
+void fragdb_get(struct fragdb *db);
+void fragdb_put(struct fragdb *db);
+
+bool fragdb_is_fragment(struct xlation *state, bool *first);
+
+verdict fragdb_find(struct xlation *state, bool queue);
+void fragdb_add(struct xlation *state, struct sk_buff_head *early);
+
+void fragdb_clean(struct xlator *jool);
+
+#endif /* SRC_MOD_COMMON_DB_FRAGDB_H_ */
@@ -5,6 +5,7 @@
 #include <linux/string.h>
 
 #include "common/constants.h"
+#include "common/session.h"
 #include "mod/common/address.h"
 #include "mod/common/log.h"
 #include "mod/common/nl/global.h"
@@ -79,6 +80,10 @@ int globals_init(struct jool_globals *config, xlator_type type,
 	config->lowest_ipv6_mtu = DEFAULT_LOWEST_IPV6_MTU;
 	memcpy(config->plateaus.values, &PLATEAUS, sizeof(PLATEAUS));
 	config->plateaus.count = ARRAY_SIZE(PLATEAUS);
+	config->icmp_errors_rate = DEFAULT_ICMP_ERRORS_RATE;
+	config->icmp_errors_burst = DEFAULT_ICMP_ERRORS_BURST;
+	config->latency_histograms = DEFAULT_LATENCY_HISTOGRAMS;
+	config->stats_push_interval = DEFAULT_STATS_PUSH_INTERVAL;
 
 	switch (type) {
 	case XT_SIIT:
@@ -94,6 +99,9 @@ int globals_init(struct jool_globals *config, xlator_type type,
 		config->nat64.src_icmp6errs_better = DEFAULT_SRC_ICMP6ERRS_BETTER;
 		config->nat64.f_args = DEFAULT_F_ARGS;
 		config->nat64.handle_rst_during_fin_rcv = DEFAULT_HANDLE_FIN_RCV_RST;
+		config->nat64.virtual_reassembly = DEFAULT_VIRTUAL_REASSEMBLY;
+		config->nat64.max_stored_frags = DEFAULT_MAX_STORED_FRAGS;
+		config->nat64.lock_statistics = DEFAULT_LOCK_STATISTICS;
 
 		config->nat64.bib.ttl.tcp_est = 1000 * TCP_EST;
 		config->nat64.bib.ttl.tcp_trans = 1000 * TCP_TRANS;
@@ -101,9 +109,15 @@ int globals_init(struct jool_globals *config, xlator_type type,
 		config->nat64.bib.ttl.icmp = 1000 * ICMP_DEFAULT;
 		config->nat64.bib.bib_logging = DEFAULT_BIB_LOGGING;
 		config->nat64.bib.session_logging = DEFAULT_SESSION_LOGGING;
+		config->nat64.bib.ring_logging = DEFAULT_RING_LOGGING;
 		config->nat64.bib.drop_by_addr = DEFAULT_ADDR_DEPENDENT_FILTERING;
 		config->nat64.bib.drop_external_tcp = DEFAULT_DROP_EXTERNAL_CONNECTIONS;
 		config->nat64.bib.max_stored_pkts = DEFAULT_MAX_STORED_PKTS;
+		config->nat64.bib.pba_block_size = DEFAULT_PBA_BLOCK_SIZE;
+		config->nat64.bib.pba_prefix_len = DEFAULT_PBA_PREFIX_LEN;
+		config->nat64.bib.pba_det_prefix.set = false;
+		config->nat64.bib.session_quota = DEFAULT_SESSION_QUOTA;
+		config->nat64.bib.session_quota_prefix_len = DEFAULT_SESSION_QUOTA_PREFIX_LEN;
 
 		config->nat64.joold.enabled = DEFAULT_JOOLD_ENABLED;
 		config->nat64.joold.flush_asap = false;
@@ -111,6 +125,14 @@ int globals_init(struct jool_globals *config, xlator_type type,
 		config->nat64.joold.capacity = DEFAULT_JOOLD_CAPACITY;
 		config->nat64.joold.max_payload = DEFAULT_JOOLD_MAX_PAYLOAD;
 		config->nat64.joold.max_sessions_per_pkt = DEFAULT_JOOLD_MAX_SESSIONS_PER_PKT;
+		config->nat64.joold.filter.tcp.min_age = DEFAULT_JOOLD_MIN_AGE;
+		config->nat64.joold.filter.tcp.min_pkts = DEFAULT_JOOLD_MIN_PKTS;
+		config->nat64.joold.filter.udp.min_age = DEFAULT_JOOLD_MIN_AGE;
+		config->nat64.joold.filter.udp.min_pkts = DEFAULT_JOOLD_MIN_PKTS;
+		config->nat64.joold.filter.icmp.min_age = DEFAULT_JOOLD_MIN_AGE;
+		config->nat64.joold.filter.icmp.min_pkts = DEFAULT_JOOLD_MIN_PKTS;
+		config->nat64.joold.tcp_states = DEFAULT_JOOLD_TCP_STATES;
+		config->nat64.joold.marks.count = 0;
 		break;
 
 	default:
@@ -4,7 +4,9 @@
 #include <linux/list.h>
 #include <linux/slab.h>
 
+#include "common/deterministic.h"
 #include "common/types.h"
+#include "mod/common/lockstat.h"
 #include "mod/common/log.h"
 #include "mod/common/wkmalloc.h"
 #include "mod/common/db/rbtree.h"
@@ -92,7 +94,7 @@ struct pool4 {
 	/** Entries indexed via address. (Normally used in 4->6) */
 	struct pool4_trees tree_addr;
 
-	spinlock_t lock;
+	struct jool_lock lock;
 	struct kref refcounter;
 };
 
@@ -108,6 +110,10 @@ struct mask_domain {
 	struct ipv4_range *current_range;
 	int current_port;
 
+	/* Port Block Allocation counterparts of the taddr counters. */
+	unsigned int block_count;
+	unsigned int block_counter;
+
 	/**
 	 * A "dynamic" domain is one that was generated on the fly - that is,
 	 * Jool queried the interface addresses, picked one and used it to
@@ -274,7 +280,7 @@ struct pool4 *pool4db_alloc(void)
 	result->tree_addr.tcp = RB_ROOT;
 	result->tree_addr.udp = RB_ROOT;
 	result->tree_addr.icmp = RB_ROOT;
-	spin_lock_init(&result->lock);
+	jlock_init(&result->lock);
 	kref_init(&result->refcounter);
 
 	return result;
@@ -321,6 +327,16 @@ void pool4db_put(struct pool4 *pool)
 	kref_put(&pool->refcounter, pool4db_release);
 }
 
+void pool4db_lockstat_enable(struct pool4 *pool, bool enable)
+{
+	jlock_enable(&pool->lock, enable);
+}
+
+void pool4db_lockstat_query(struct pool4 *pool, struct jool_lock_stats *result)
+{
+	jlock_query(&pool->lock, result);
+}
+
 static int max_iterations_validate(__u8 flags, __u32 iterations)
 {
 	bool automatic = flags & ITERATIONS_AUTO;
@@ -551,14 +567,14 @@ int pool4db_add(struct pool4 *pool, const struct pool4_entry *entry)
 
 	addend.prefix.len = 32;
 	foreach_addr4(addend.prefix.addr, tmp, &entry->range.prefix) {
-		spin_lock_bh(&pool->lock);
+		jlock_lock(&pool->lock);
 		error = add_to_mark_tree(pool, entry, &addend);
 		if (!error) {
 			error = add_to_addr_tree(pool, entry, &addend);
 			if (error)
 				goto trainwreck;
 		}
-		spin_unlock_bh(&pool->lock);
+		jlock_unlock(&pool->lock);
 		if (error)
 			return error;
 	}
@@ -566,7 +582,7 @@ int pool4db_add(struct pool4 *pool, const struct pool4_entry *entry)
 	return 0;
 
 trainwreck:
-	spin_unlock_bh(&pool->lock);
+	jlock_unlock(&pool->lock);
 	/*
 	 * We're in a serious conundrum.
 	 * We cannot revert the add_to_mark_tree() because of port range fusing;
@@ -591,17 +607,17 @@ int pool4db_update(struct pool4 *pool, const struct pool4_update *update)
 	if (error)
 		return error;
 
-	spin_lock_bh(&pool->lock);
+	jlock_lock(&pool->lock);
 
 	tree = get_tree(&pool->tree_mark, update->l4_proto);
 	if (!tree) {
-		spin_unlock_bh(&pool->lock);
+		jlock_unlock(&pool->lock);
 		return -EINVAL;
 	}
 
 	table = find_by_mark(tree, update->mark);
 	if (!table) {
-		spin_unlock_bh(&pool->lock);
+		jlock_unlock(&pool->lock);
 		log_err("No entries match mark %u (protocol %s).", update->mark,
 				l4proto_to_string(update->l4_proto));
 		return -ESRCH;
@@ -612,7 +628,7 @@ int pool4db_update(struct pool4 *pool, const struct pool4_update *update)
 		table->max_iterations_allowed = update->iterations;
 	}
 
-	spin_unlock_bh(&pool->lock);
+	jlock_unlock(&pool->lock);
 	return 0;
 }
 
@@ -762,13 +778,13 @@ int pool4db_rm(struct pool4 *pool, const __u32 mark, l4_protocol proto,
 	if (range->ports.min > range->ports.max)
 		swap(range->ports.min, range->ports.max);
 
-	spin_lock_bh(&pool->lock);
+	jlock_lock(&pool->lock);
 
 	error = rm_from_mark_tree(pool, mark, proto, range);
 	if (!error)
 		error = rm_from_addr_tree(pool, proto, range);
 
-	spin_unlock_bh(&pool->lock);
+	jlock_unlock(&pool->lock);
 	return error;
 }
 
@@ -779,9 +795,9 @@ int pool4db_rm_usr(struct pool4 *pool, struct pool4_entry *entry)
 
 void pool4db_flush(struct pool4 *pool)
 {
-	spin_lock_bh(&pool->lock);
+	jlock_lock(&pool->lock);
 	clear_trees(pool);
-	spin_unlock_bh(&pool->lock);
+	jlock_unlock(&pool->lock);
 }
 
 static struct ipv4_range *find_port_range(struct pool4_table *entry, __u16 port)
@@ -817,10 +833,10 @@ bool pool4db_contains(struct pool4 *pool, struct net *ns, l4_protocol proto,
 	struct pool4_table *table;
 	bool found = false;
 
-	spin_lock_bh(&pool->lock);
+	jlock_lock(&pool->lock);
 
 	if (is_empty(pool)) {
-		spin_unlock_bh(&pool->lock);
+		jlock_unlock(&pool->lock);
 		return pool4empty_contains(ns, addr);
 	}
 
@@ -828,7 +844,7 @@ bool pool4db_contains(struct pool4 *pool, struct net *ns, l4_protocol proto,
 	if (table)
 		found = find_port_range(table, addr->l4) != NULL;
 
-	spin_unlock_bh(&pool->lock);
+	jlock_unlock(&pool->lock);
 	return found;
 }
 
@@ -947,7 +963,7 @@ int pool4db_foreach_sample(struct pool4 *pool, l4_protocol proto,
 	struct pool4_entry sample = { .proto = proto };
 	int error = 0;
 
-	spin_lock_bh(&pool->lock);
+	jlock_lock(&pool->lock);
 
 	tree = get_tree(&pool->tree_mark, proto);
 	if (!tree) {
@@ -983,11 +999,11 @@ offset_start:; /* <- The semicolon prevents a compiler error. */
 	}
 
 end:
-	spin_unlock_bh(&pool->lock);
+	jlock_unlock(&pool->lock);
 	return error;
 
 eagain:
-	spin_unlock_bh(&pool->lock);
+	jlock_unlock(&pool->lock);
 	log_err("Oops. Pool4 changed while I was iterating so I lost track of where I was. Try again.");
 	return -EAGAIN;
 }
@@ -1067,6 +1083,7 @@ static verdict find_empty(struct xlation *state, unsigned int offset,
 	masks->range_count = 1;
 	masks->current_range = range;
 	masks->current_port = range->ports.min + offset % masks->taddr_count;
+	masks->block_counter = 0;
 	masks->dynamic = true;
 
 	*out = masks;
@@ -1087,10 +1104,10 @@ verdict mask_domain_find(struct xlation *state, struct mask_domain **out)
 	offset += atomic_read(&next_ephemeral);
 
 	pool = state->jool.nat64.pool4;
-	spin_lock_bh(&pool->lock);
+	jlock_lock(&pool->lock);
 
 	if (is_empty(pool)) {
-		spin_unlock_bh(&pool->lock);
+		jlock_unlock(&pool->lock);
 		return find_empty(state, offset, out);
 	}
 
@@ -1112,10 +1129,11 @@ verdict mask_domain_find(struct xlation *state, struct mask_domain **out)
 	masks->max_iterations = compute_max_iterations(table);
 	masks->range_count = table->sample_count;
 
-	spin_unlock_bh(&pool->lock);
+	jlock_unlock(&pool->lock);
 
 	masks->pool_mark = state->in.skb->mark;
 	masks->taddr_counter = 0;
+	masks->block_counter = 0;
 	masks->dynamic = false;
 	offset %= masks->taddr_count;
 
@@ -1134,7 +1152,7 @@ verdict mask_domain_find(struct xlation *state, struct mask_domain **out)
 	return drop(state, JSTAT_UNKNOWN);
 
 fail:
-	spin_unlock_bh(&pool->lock);
+	jlock_unlock(&pool->lock);
 	return drop(state, JSTAT_MASK_DOMAIN_NOT_FOUND);
 }
 
@@ -1170,6 +1188,78 @@ int mask_domain_next(struct mask_domain *masks,
 	return 0;
 }
 
+/**
+ * mask_domain_next_block - Port Block Allocation version of
+ * mask_domain_next(). Iterates through @masks' blocks of @size contiguous
+ * ports, starting from the one that contains the RFC 6056 offset.
+ *
+ * Blocks are aligned to the beginning of their range. Ports that don't fit in a
+ * whole block at the end of a range are never returned. max-iterations does not
+ * apply.
+ *
+ * @first will be the block's first transport address.
+ */
+int mask_domain_next_block(struct mask_domain *masks, unsigned int size,
+		struct ipv4_transport_addr *first)
+{
+	struct ipv4_range *range;
+	unsigned int i;
+
+	if (masks->block_counter == 0) {
+		masks->block_count = 0;
+		foreach_domain_range(range, masks)
+			masks->block_count += port_range_count(&range->ports) / size;
+
+		range = masks->current_range;
+		if (masks->current_port < range->ports.min)
+			masks->current_port = range->ports.min;
+		masks->current_port -= (masks->current_port - range->ports.min)
+				% size;
+	} else {
+		masks->current_port += size;
+	}
+
+	masks->block_counter++;
+	if (masks->block_counter > masks->block_count)
+		return -ENOENT;
+
+	/* Skip the range remainders that can't hold a whole block. */
+	for (i = 0; i <= masks->range_count; i++) {
+		range = masks->current_range;
+		if (masks->current_port + size - 1 <= range->ports.max) {
+			first->l3 = range->prefix.addr;
+			first->l4 = masks->current_port;
+			return 0;
+		}
+
+		masks->current_range++;
+		if (masks->current_range >= first_domain_entry(masks) + masks->range_count)
+			masks->current_range = first_domain_entry(masks);
+		masks->current_port = masks->current_range->ports.min;
+	}
+
+	WARN(true, "Bug: pool4 block counter does not match block count.");
+	return -ENOENT;
+}
+
+/**
+ * mask_domain_det_block - Deterministic version of mask_domain_next_block().
+ * Returns the first transport address of @masks' block number @index.
+ * (See common/deterministic.h.)
+ *
+ * Dynamic domains change along with the interface addresses, so they are
+ * refused.
+ */
+int mask_domain_det_block(struct mask_domain *masks, unsigned int size,
+		__u64 index, struct ipv4_transport_addr *first)
+{
+	if (masks->dynamic)
+		return -ESRCH;
+
+	return det_nth_block(first_domain_entry(masks), masks->range_count,
+			size, index, first);
+}
+
 /*
  * According to the kernel, adding to an atomic integer is "much slower"
  * (https://elixir.bootlin.com/linux/v5.0/source/arch/alpha/include/asm/atomic.h#L13)
@@ -9,6 +9,7 @@
 
 #include <linux/net.h>
 #include "common/config.h"
+#include "common/stats.h"
 #include "mod/common/route.h"
 #include "mod/common/translation_state.h"
 #include "mod/common/types.h"
@@ -23,6 +24,9 @@ struct pool4 *pool4db_alloc(void);
 void pool4db_get(struct pool4 *pool);
 void pool4db_put(struct pool4 *pool);
 
+void pool4db_lockstat_enable(struct pool4 *pool, bool enable);
+void pool4db_lockstat_query(struct pool4 *pool, struct jool_lock_stats *result);
+
 int pool4db_add(struct pool4 *pool, const struct pool4_entry *entry);
 int pool4db_update(struct pool4 *pool, const struct pool4_update *update);
 int pool4db_rm(struct pool4 *pool, const __u32 mark, enum l4_protocol proto,
@@ -49,6 +53,10 @@ void mask_domain_put(struct mask_domain *masks);
 int mask_domain_next(struct mask_domain *masks,
 		struct ipv4_transport_addr *addr,
 		bool *consecutive);
+int mask_domain_next_block(struct mask_domain *masks, unsigned int size,
+		struct ipv4_transport_addr *first);
+int mask_domain_det_block(struct mask_domain *masks, unsigned int size,
+		__u64 index, struct ipv4_transport_addr *first);
 void mask_domain_commit(struct mask_domain *masks);
 bool mask_domain_matches(struct mask_domain *masks,
 		struct ipv4_transport_addr *addr);
@@ -0,0 +1,163 @@
+#include "mod/common/icmp_ratelimit.h"
+
+#include <linux/jhash.h>
+#include <linux/kref.h>
+#include <linux/math64.h>
+#include <linux/random.h>
+#include <linux/spinlock.h>
+#include "mod/common/wkmalloc.h"
+
+/*
+ * Buckets are not chained; a key whose slot is held by another key simply
+ * takes it over, along with its remaining tokens. So colliding keys
+ * effectively share a bucket, and a collision can only cause fewer errors to
+ * be sent, never more. (Otherwise, a flood spread over more prefixes than
+ * there are slots would get a full burst on every takeover.)
+ *
+ * Tokens are scaled by HZ, so refilling doesn't need divisions: an error costs
+ * HZ tokens, and every jiffy adds icmp-errors-rate tokens.
+ */
+
+/* Must be a power of two. */
+#define ICMPRL_SLOTS 256
+
+struct icmprl_key {
+	/* IPv4: First word is the /24, second word is zero. IPv6: The /64. */
+	__be32 prefix[2];
+	__u8 l3proto;
+	__u8 error;
+	__u16 padding;
+};
+
+struct icmprl_bucket {
+	spinlock_t lock;
+	struct icmprl_key key;
+	unsigned long last; /* jiffies */
+	u64 tokens;
+};
+
+struct icmp_ratelimit {
+	struct icmprl_bucket buckets[ICMPRL_SLOTS];
+	u32 seed;
+	struct kref refcounter;
+};
+
+struct icmp_ratelimit *icmprl_alloc(void)
+{
+	struct icmp_ratelimit *result;
+	unsigned int i;
+
+	result = wkmalloc(struct icmp_ratelimit, GFP_KERNEL);
+	if (!result)
+		return NULL;
+
+	for (i = 0; i < ICMPRL_SLOTS; i++) {
+		spin_lock_init(&result->buckets[i].lock);
+		memset(&result->buckets[i].key, 0, sizeof(struct icmprl_key));
+		result->buckets[i].last = 0;
+		/* Unused slots start full. (consume() clamps this to burst.) */
+		result->buckets[i].tokens = U64_MAX;
+	}
+	get_random_bytes(&result->seed, sizeof(result->seed));
+	kref_init(&result->refcounter);
+
+	return result;
+}
+
+void icmprl_get(struct icmp_ratelimit *rl)
+{
+	kref_get(&rl->refcounter);
+}
+
+static void icmprl_release(struct kref *refcount)
+{
+	struct icmp_ratelimit *rl;
+	rl = container_of(refcount, struct icmp_ratelimit, refcounter);
+	wkfree(struct icmp_ratelimit, rl);
+}
+
+void icmprl_put(struct icmp_ratelimit *rl)
+{
+	kref_put(&rl->refcounter, icmprl_release);
+}
+
+static bool consume(struct icmp_ratelimit *rl, struct icmprl_key const *key,
+		__u32 rate, __u32 burst)
+{
+	struct icmprl_bucket *bucket;
+	unsigned long now;
+	unsigned long elapsed;
+	u64 max;
+	bool result;
+
+	bucket = &rl->buckets[jhash(key, sizeof(*key), rl->seed)
+			& (ICMPRL_SLOTS - 1)];
+	now = jiffies;
+	max = (u64)burst * HZ;
+
+	spin_lock_bh(&bucket->lock);
+
+	if (memcmp(&bucket->key, key, sizeof(*key)) != 0)
+		bucket->key = *key;
+
+	if (bucket->tokens < max) {
+		elapsed = now - bucket->last;
+		/* (Written this way so elapsed * rate cannot overflow.) */
+		if (elapsed > div_u64(max - bucket->tokens, rate))
+			bucket->tokens = max;
+		else
+			bucket->tokens += (u64)elapsed * rate;
+	} else {
+		/* Burst might have been lowered since the last error. */
+		bucket->tokens = max;
+	}
+	bucket->last = now;
+
+	result = bucket->tokens >= HZ;
+	if (result)
+		bucket->tokens -= HZ;
+
+	spin_unlock_bh(&bucket->lock);
+	return result;
+}
+
+/**
+ * Returns true if @jool is allowed to send an ICMPv4 error of type @error
+ * towards @dst right now, and charges it to @dst's bucket if so.
+ */
+bool icmprl_allow4(struct xlator *jool, __be32 dst, icmp_error_code error)
+{
+	struct icmprl_key key;
+
+	if (!jool->globals.icmp_errors_rate)
+		return true;
+
+	memset(&key, 0, sizeof(key));
+	key.prefix[0] = dst & cpu_to_be32(0xFFFFFF00u);
+	key.l3proto = L3PROTO_IPV4;
+	key.error = error;
+
+	return consume(jool->icmprl, &key, jool->globals.icmp_errors_rate,
+			jool->globals.icmp_errors_burst);
+}
+
+/**
+ * IPv6 version of icmprl_allow4().
+ */
+bool icmprl_allow6(struct xlator *jool, struct in6_addr const *dst,
+		icmp_error_code error)
+{
+	struct icmprl_key key;
+
+	if (!jool->globals.icmp_errors_rate)
+		return true;
+
+	memset(&key, 0, sizeof(key));
+	key.prefix[0] = dst->s6_addr32[0];
+	key.prefix[1] = dst->s6_addr32[1];
+	key.l3proto = L3PROTO_IPV6;
+	key.error = error;
+
+	return consume(jool->icmprl, &key, jool->globals.icmp_errors_rate,
+			jool->globals.icmp_errors_burst);
+}
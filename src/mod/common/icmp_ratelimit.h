@@ -0,0 +1,31 @@
+#ifndef SRC_MOD_COMMON_ICMP_RATELIMIT_H_
+#define SRC_MOD_COMMON_ICMP_RATELIMIT_H_
+
+/**
+ * @file
+ * Limits the rate at which a translator generates ICMP errors.
+ *
+ * Every packet Jool fails to translate can elicit an ICMP error, and every
+ * error costs a route lookup and an icmp_send()/icmpv6_send(). A host that
+ * floods the translator with untranslatable packets would otherwise get an
+ * error for each one of them.
+ *
+ * Errors are accounted in token buckets, one per error type and destination
+ * prefix (/24 for IPv4, /64 for IPv6). Buckets are refilled at
+ * icmp-errors-rate tokens per second, and can hold up to icmp-errors-burst
+ * tokens. An icmp-errors-rate of zero disables the limiter.
+ */
+
+#include "mod/common/icmp_wrapper.h"
+
+struct icmp_ratelimit;
+
+struct icmp_ratelimit *icmprl_alloc(void);
+void icmprl_get(struct icmp_ratelimit *rl);
+void icmprl_put(struct icmp_ratelimit *rl);
+
+bool icmprl_allow4(struct xlator *jool, __be32 dst, icmp_error_code error);
+bool icmprl_allow6(struct xlator *jool, struct in6_addr const *dst,
+		icmp_error_code error);
+
+#endif /* SRC_MOD_COMMON_ICMP_RATELIMIT_H_ */
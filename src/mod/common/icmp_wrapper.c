@@ -3,7 +3,9 @@
 #include <linux/icmpv6.h>
 #include <net/icmp.h>
 #include "common/types.h"
+#include "mod/common/icmp_ratelimit.h"
 #include "mod/common/log.h"
+#include "mod/common/tracepoints.h"
 
 static int route4_input(struct xlator *jool, struct sk_buff *skb)
 {
@@ -55,14 +57,7 @@ bool icmp64_send4(struct xlator *jool, struct sk_buff *skb,
 	int type, code;
 
 	if (unlikely(!skb) || !skb->dev)
-		return false;
-
-	/*
-	 * I don't know why the kernel needs this nonsense,
-	 * but it's not my fault.
-	 */
-	if (route4_input(jool, skb))
-		return false;
+		goto failure;
 
 	switch (error) {
 	case ICMPERR_ADDR_UNREACHABLE:
@@ -94,13 +89,35 @@ bool icmp64_send4(struct xlator *jool, struct sk_buff *skb,
 		code = ICMP_SR_FAILED;
 		break;
 	default:
-		return false; /* Not supported or needed. */
+		goto failure; /* Not supported or needed. */
+	}
+
+	if (jool && !icmprl_allow4(jool, ip_hdr(skb)->saddr, error)) {
+		__log_debug(jool, "Rate-limited ICMPv4 error: %s",
+				icmp_error_to_string(error));
+		jstat_inc(jool->stats, JSTAT_ICMP4ERR_LIMITED);
+		return false;
 	}
 
+	/*
+	 * I don't know why the kernel needs this nonsense,
+	 * but it's not my fault.
+	 */
+	if (route4_input(jool, skb))
+		goto failure;
+
 	__log_debug(jool, "Sending ICMPv4 error: %s, type: %d, code: %d, rest: %u.",
 			icmp_error_to_string(error), type, code, info);
 	icmp_send(skb, type, code, cpu_to_be32(info));
+	trace_jool_icmp_err(jool, skb, error, type, code);
+	if (jool)
+		jstat_inc(jool->stats, JSTAT_ICMP4ERR_SUCCESS);
 	return true;
+
+failure:
+	if (jool)
+		jstat_inc(jool->stats, JSTAT_ICMP4ERR_FAILURE);
+	return false;
 }
 
 bool icmp64_send6(struct xlator *jool, struct sk_buff *skb,
@@ -109,7 +126,7 @@ bool icmp64_send6(struct xlator *jool, struct sk_buff *skb,
 	int type, code;
 
 	if (unlikely(!skb) || !skb->dev)
-		return false;
+		goto failure;
 
 	switch (error) {
 	case ICMPERR_ADDR_UNREACHABLE:
@@ -139,13 +156,28 @@ bool icmp64_send6(struct xlator *jool, struct sk_buff *skb,
 		code = 0; /* No code. */
 		break;
 	default:
-		return false; /* Not supported or needed. */
+		goto failure; /* Not supported or needed. */
+	}
+
+	if (jool && !icmprl_allow6(jool, &ipv6_hdr(skb)->saddr, error)) {
+		__log_debug(jool, "Rate-limited ICMPv6 error: %s",
+				icmp_error_to_string(error));
+		jstat_inc(jool->stats, JSTAT_ICMP6ERR_LIMITED);
+		return false;
 	}
 
 	__log_debug(jool, "Sending ICMPv6 error: %s, type: %d, code: %d, rest: %u",
 			icmp_error_to_string(error), type, code, info);
 	icmpv6_send(skb, type, code, info);
+	trace_jool_icmp_err(jool, skb, error, type, code);
+	if (jool)
+		jstat_inc(jool->stats, JSTAT_ICMP6ERR_SUCCESS);
 	return true;
+
+failure:
+	if (jool)
+		jstat_inc(jool->stats, JSTAT_ICMP6ERR_FAILURE);
+	return false;
 }
 
 bool icmp64_send(struct xlator *jool, struct sk_buff *skb,
@@ -35,6 +35,9 @@ typedef enum icmp_errcode {
 
 /**
  * Wrappers for icmp_send() and icmpv6_send().
+ *
+ * If @jool is not NULL, the error is subject to @jool's rate limits (see
+ * icmp_ratelimit.h), and its outcome is counted in @jool's stats.
  */
 bool icmp64_send6(struct xlator *jool, struct sk_buff *skb,
 		icmp_error_code error, __u32 info);
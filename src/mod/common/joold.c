@@ -3,6 +3,7 @@
 #include <linux/inet.h>
 
 #include "common/constants.h"
+#include "mod/common/lockstat.h"
 #include "mod/common/log.h"
 #include "mod/common/wkmalloc.h"
 #include "mod/common/xlator.h"
@@ -39,7 +40,7 @@ struct joold_queue {
 	 */
 	unsigned long last_flush_time;
 
-	spinlock_t lock;
+	struct jool_lock lock;
 	struct kref refs;
 };
 
@@ -297,7 +298,7 @@ struct joold_queue *joold_alloc(void)
 	INIT_LIST_HEAD(&queue->deferred.list);
 	queue->deferred.count = 0;
 	queue->last_flush_time = jiffies;
-	spin_lock_init(&queue->lock);
+	jlock_init(&queue->lock);
 	kref_init(&queue->refs);
 
 	return queue;
@@ -321,6 +322,68 @@ void joold_put(struct joold_queue *queue)
 	kref_put(&queue->refs, joold_release);
 }
 
+void joold_lockstat_enable(struct joold_queue *queue, bool enable)
+{
+	jlock_enable(&queue->lock, enable);
+}
+
+void joold_lockstat_query(struct joold_queue *queue,
+		struct jool_lock_stats *result)
+{
+	jlock_query(&queue->lock, result);
+}
+
+static bool mark_wanted(struct mark_ranges const *ranges, __u32 mark)
+{
+	unsigned int i;
+
+	if (ranges->count == 0)
+		return true;
+
+	for (i = 0; i < ranges->count; i++)
+		if (ranges->ranges[i].min <= mark && mark <= ranges->ranges[i].max)
+			return true;
+
+	return false;
+}
+
+/*
+ * Returns true if @session passes the user's sync filters.
+ *
+ * Note that the filters are evaluated every time the session is updated, so a
+ * session that is too young (or has too few packets) will simply be synced
+ * later, once it has matured.
+ */
+static bool should_sync(struct joold_config *cfg,
+		struct session_entry const *session)
+{
+	struct joold_sync_filter *filter;
+
+	switch (session->proto) {
+	case L4PROTO_TCP:
+		if (!(cfg->tcp_states & (1u << session->state)))
+			return false;
+		filter = &cfg->filter.tcp;
+		break;
+	case L4PROTO_UDP:
+		filter = &cfg->filter.udp;
+		break;
+	case L4PROTO_ICMP:
+		filter = &cfg->filter.icmp;
+		break;
+	default:
+		return true;
+	}
+
+	if (session->pkts < filter->min_pkts)
+		return false;
+	if (filter->min_age && time_before(jiffies, session->creation_time
+			+ msecs_to_jiffies(filter->min_age)))
+		return false;
+
+	return mark_wanted(&cfg->marks, session->mark);
+}
+
 /**
  * joold_add - Add @session to @jool->nat64.joold.
  *
@@ -336,6 +399,10 @@ void joold_add(struct xlator *jool, struct session_entry *_session)
 
 	if (!GLOBALS(jool).enabled)
 		return;
+	if (!should_sync(&GLOBALS(jool), _session)) {
+		jstat_inc(jool->stats, JSTAT_JOOLD_SSS_FILTERED);
+		return;
+	}
 
 	session = ALLOC_DEFERRED;
 	if (!session)
@@ -344,9 +411,9 @@ void joold_add(struct xlator *jool, struct session_entry *_session)
 	queue = jool->nat64.joold;
 	INIT_LIST_HEAD(&prepared);
 
-	spin_lock_bh(&queue->lock);
+	jlock_lock(&queue->lock);
 	send_to_userspace_prepare(jool, session, &prepared);
-	spin_unlock_bh(&queue->lock);
+	jlock_unlock(&queue->lock);
 
 	send_to_userspace(jool, &prepared);
 	jstat_inc(jool->stats, JSTAT_JOOLD_SSS_QUEUED);
@@ -476,10 +543,10 @@ int joold_advertise(struct xlator *jool)
 	queue = jool->nat64.joold;
 	INIT_LIST_HEAD(&prepared);
 
-	spin_lock_bh(&queue->lock);
+	jlock_lock(&queue->lock);
 
 	if (queue->flags & JQF_AD_ONGOING) {
-		spin_unlock_bh(&queue->lock);
+		jlock_unlock(&queue->lock);
 		delete_sessions(&sessions.list);
 		log_err("joold advertisement already in progress.");
 		return -EINVAL;
@@ -491,7 +558,7 @@ int joold_advertise(struct xlator *jool)
 
 	send_to_userspace_prepare(jool, NULL, &prepared);
 
-	spin_unlock_bh(&queue->lock);
+	jlock_unlock(&queue->lock);
 
 	send_to_userspace(jool, &prepared);
 	jstat_inc(jool->stats, JSTAT_JOOLD_ADS);
@@ -509,10 +576,10 @@ void joold_ack(struct xlator *jool)
 	queue = jool->nat64.joold;
 	INIT_LIST_HEAD(&prepared);
 
-	spin_lock_bh(&queue->lock);
+	jlock_lock(&queue->lock);
 	queue->flags |= JQF_ACK_RECEIVED;
 	send_to_userspace_prepare(jool, NULL, &prepared);
-	spin_unlock_bh(&queue->lock);
+	jlock_unlock(&queue->lock);
 
 	send_to_userspace(jool, &prepared);
 	jstat_inc(jool->stats, JSTAT_JOOLD_ACKS);
@@ -526,7 +593,7 @@ void joold_ack(struct xlator *jool)
  */
 void joold_clean(struct xlator *jool)
 {
-	spinlock_t *lock;
+	struct jool_lock *lock;
 	struct list_head prepared;
 
 	if (!GLOBALS(jool).enabled)
@@ -535,9 +602,9 @@ void joold_clean(struct xlator *jool)
 	lock = &jool->nat64.joold->lock;
 	INIT_LIST_HEAD(&prepared);
 
-	spin_lock_bh(lock);
+	jlock_lock(lock);
 	send_to_userspace_prepare(jool, NULL, &prepared);
-	spin_unlock_bh(lock);
+	jlock_unlock(lock);
 
 	send_to_userspace(jool, &prepared);
 }
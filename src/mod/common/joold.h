@@ -2,6 +2,7 @@
 #define SRC_MOD_NAT64_JOOLD_H_
 
 #include "common/config.h"
+#include "common/stats.h"
 #include "mod/common/xlator.h"
 #include "mod/common/db/bib/entry.h"
 
@@ -19,6 +20,10 @@ struct joold_queue *joold_alloc(void);
 void joold_get(struct joold_queue *queue);
 void joold_put(struct joold_queue *queue);
 
+void joold_lockstat_enable(struct joold_queue *queue, bool enable);
+void joold_lockstat_query(struct joold_queue *queue,
+		struct jool_lock_stats *result);
+
 int joold_sync(struct xlator *jool, struct nlattr *root);
 void joold_add(struct xlator *jool, struct session_entry *entry);
 
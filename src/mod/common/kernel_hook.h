@@ -14,6 +14,11 @@ unsigned int hook_ipv6(void *priv, struct sk_buff *skb,
 unsigned int hook_ipv4(void *priv, struct sk_buff *skb,
 		const struct nf_hook_state *nhs);
 
+#ifdef CONFIG_NETFILTER_INGRESS
+unsigned int hook_ingress(void *priv, struct sk_buff *skb,
+		const struct nf_hook_state *nhs);
+#endif
+
 #ifndef XTABLES_DISABLED
 
 int target_checkentry(const struct xt_tgchk_param *param);
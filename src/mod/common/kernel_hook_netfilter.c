@@ -1,5 +1,6 @@
 #include "mod/common/kernel_hook.h"
 
+#include <net/ip.h>
 #include "mod/common/log.h"
 #include "mod/common/core.h"
 
@@ -106,3 +107,103 @@ end:	xlation_destroy(state);
 	return verdict2netfilter(result, enable_debug);
 }
 EXPORT_SYMBOL_GPL(hook_ipv4);
+
+#ifdef CONFIG_NETFILTER_INGRESS
+
+/*
+ * The ingress hook runs before ip_rcv(), so these are the sanity checks it
+ * would have performed. (The rest of Jool assumes they have already happened.)
+ * Packets that fail them are returned to the kernel, which will drop them.
+ */
+static bool ingress_validate_ipv4(struct sk_buff *skb)
+{
+	struct iphdr *hdr;
+	unsigned int len;
+
+	if (!pskb_may_pull(skb, sizeof(struct iphdr)))
+		return false;
+	hdr = ip_hdr(skb);
+	if (hdr->ihl < 5 || hdr->version != 4)
+		return false;
+	if (!pskb_may_pull(skb, hdr->ihl << 2))
+		return false;
+	hdr = ip_hdr(skb);
+	if (unlikely(ip_fast_csum((u8 *)hdr, hdr->ihl)))
+		return false;
+
+	len = ntohs(hdr->tot_len);
+	if (skb->len < len || len < (hdr->ihl << 2))
+		return false;
+	/* Get rid of the link layer padding. */
+	return !pskb_trim_rcsum(skb, len);
+}
+
+/* Same, for ipv6_rcv(). */
+static bool ingress_validate_ipv6(struct sk_buff *skb)
+{
+	struct ipv6hdr *hdr;
+	unsigned int len;
+
+	if (!pskb_may_pull(skb, sizeof(struct ipv6hdr)))
+		return false;
+	hdr = ipv6_hdr(skb);
+	if (hdr->version != 6)
+		return false;
+
+	len = ntohs(hdr->payload_len);
+	if (len == 0)
+		return false; /* Jumbogram; not supported. */
+	len += sizeof(struct ipv6hdr);
+	if (skb->len < len)
+		return false;
+	return !pskb_trim_rcsum(skb, len);
+}
+
+/**
+ * This is the function that the kernel calls whenever a packet reaches the
+ * ingress of one of the interfaces an XF_INGRESS instance is hooked to.
+ *
+ * @priv is the instance's binding, so there is no instance lookup.
+ */
+unsigned int hook_ingress(void *priv, struct sk_buff *skb,
+		const struct nf_hook_state *nhs)
+{
+	struct xlation *state;
+	verdict result;
+	bool enable_debug;
+
+	/* ip_rcv() and ipv6_rcv() drop these, or unshare them. */
+	if (skb->pkt_type == PACKET_OTHERHOST || skb_shared(skb))
+		return NF_ACCEPT;
+
+	switch (ntohs(skb->protocol)) {
+	case ETH_P_IPV6:
+		if (!ingress_validate_ipv6(skb))
+			return NF_ACCEPT;
+		break;
+	case ETH_P_IP:
+		if (!ingress_validate_ipv4(skb))
+			return NF_ACCEPT;
+		break;
+	default:
+		return NF_ACCEPT;
+	}
+
+	state = xlation_create(NULL);
+	if (!state)
+		return NF_DROP;
+
+	xlator_find_ingress(priv, &state->jool);
+	enable_debug = state->jool.globals.debug;
+
+	result = (skb->protocol == htons(ETH_P_IPV6))
+			? core_6to4(skb, state)
+			: core_4to6(skb, state);
+
+	xlator_put(&state->jool);
+	xlation_destroy(state);
+	return verdict2netfilter(result, enable_debug);
+}
+EXPORT_SYMBOL_GPL(hook_ingress);
+
+#endif /* CONFIG_NETFILTER_INGRESS */
@@ -0,0 +1,31 @@
+#include "mod/common/lockstat.h"
+
+#include <linux/string.h>
+
+void jlock_init(struct jool_lock *lock)
+{
+	spin_lock_init(&lock->lock);
+	lock->enabled = false;
+	lock->acquired = 0;
+	memset(&lock->stats, 0, sizeof(lock->stats));
+}
+
+/**
+ * Starts or stops measuring @lock. The statistics are reset every time the
+ * measurement starts, so they always describe the current run.
+ */
+void jlock_enable(struct jool_lock *lock, bool enable)
+{
+	spin_lock_bh(&lock->lock);
+	if (enable && !lock->enabled)
+		memset(&lock->stats, 0, sizeof(lock->stats));
+	WRITE_ONCE(lock->enabled, enable);
+	spin_unlock_bh(&lock->lock);
+}
+
+void jlock_query(struct jool_lock *lock, struct jool_lock_stats *result)
+{
+	spin_lock_bh(&lock->lock);
+	*result = lock->stats;
+	spin_unlock_bh(&lock->lock);
+}
@@ -0,0 +1,74 @@
+#ifndef SRC_MOD_COMMON_LOCKSTAT_H_
+#define SRC_MOD_COMMON_LOCKSTAT_H_
+
+/**
+ * @file
+ * A spinlock that can count its acquisitions, contended acquisitions and hold
+ * times. Used by the NAT64 databases whose locks are fought over by the packet
+ * path (the BIB tables, pool4 and the joold queue).
+ *
+ * Measurement is toggled per lock, by means of jlock_enable(). (Which the
+ * xlator module does according to the instance's lock-statistics global.)
+ * While it's disabled, jlock_lock() and jlock_unlock() only add a couple of
+ * predictable branches over spin_lock_bh() and spin_unlock_bh().
+ *
+ * The statistics are protected by the lock itself.
+ */
+
+#include <linux/compiler.h>
+#include <linux/spinlock.h>
+#include <linux/timekeeping.h>
+#include "common/stats.h"
+
+struct jool_lock {
+	spinlock_t lock;
+	bool enabled;
+	/* Moment the current holder got the lock. Zero if it's not measuring. */
+	__u64 acquired;
+	struct jool_lock_stats stats;
+};
+
+void jlock_init(struct jool_lock *lock);
+void jlock_enable(struct jool_lock *lock, bool enable);
+void jlock_query(struct jool_lock *lock, struct jool_lock_stats *result);
+
+static inline void jlock_lock(struct jool_lock *lock)
+{
+	bool contended;
+
+	if (likely(!READ_ONCE(lock->enabled))) {
+		spin_lock_bh(&lock->lock);
+		return;
+	}
+
+	contended = !spin_trylock_bh(&lock->lock);
+	if (contended)
+		spin_lock_bh(&lock->lock);
+
+	/* jlock_enable() might have raced us; it's fine either way. */
+	lock->stats.acquisitions++;
+	if (contended)
+		lock->stats.contended++;
+	lock->acquired = ktime_get_ns();
+}
+
+static inline void jlock_unlock(struct jool_lock *lock)
+{
+	__u64 held;
+
+	/*
+	 * Not checking @enabled here, because it might have changed since
+	 * jlock_lock().
+	 */
+	if (unlikely(lock->acquired)) {
+		held = ktime_get_ns() - lock->acquired;
+		lock->stats.hold_total += held;
+		if (held > lock->stats.hold_max)
+			lock->stats.hold_max = held;
+		lock->acquired = 0;
+	}
+
+	spin_unlock_bh(&lock->lock);
+}
+
+#endif /* SRC_MOD_COMMON_LOCKSTAT_H_ */
@@ -0,0 +1,279 @@
+#include "mod/common/natlog.h"
+
+#include <linux/kref.h>
+#include <linux/percpu.h>
+#include <linux/timekeeping.h>
+#include "common/config.h"
+#include "common/xlat.h"
+#include "mod/common/log.h"
+#include "mod/common/stats.h"
+#include "mod/common/wkmalloc.h"
+#include "mod/common/nl/nl_handler.h"
+
+/*
+ * Each ring has exactly one producer (its own CPU, with bottom halves disabled,
+ * since the BIB holds its table spinlock) and is drained under @lock, which
+ * only consumers take. So the producer never waits, and never contends with
+ * anyone.
+ *
+ * @head and @tail are free-running counters; the slot is the counter modulo
+ * NATLOG_SLOTS.
+ */
+
+/* Per CPU. Must be a power of two. (Keep it below percpu's 32 KB unit.) */
+#define NATLOG_SLOTS 256
+/* Records per Netlink message. Also the packet path's flush threshold. */
+#define NATLOG_BATCH 64
+
+struct natlog_ring {
+	/* Only written by the producer. */
+	unsigned int head;
+	/* Only written by consumers. */
+	unsigned int tail;
+	spinlock_t lock;
+	struct natlog_record records[NATLOG_SLOTS];
+};
+
+struct natlog {
+	struct natlog_ring __percpu *rings;
+	struct kref refcounter;
+};
+
+struct natlog *natlog_alloc(void)
+{
+	struct natlog *result;
+	struct natlog_ring *ring;
+	unsigned int cpu;
+
+	result = wkmalloc(struct natlog, GFP_KERNEL);
+	if (!result)
+		return NULL;
+
+	result->rings = alloc_percpu(struct natlog_ring);
+	if (!result->rings) {
+		wkfree(struct natlog, result);
+		return NULL;
+	}
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(result->rings, cpu);
+		ring->head = 0;
+		ring->tail = 0;
+		spin_lock_init(&ring->lock);
+	}
+	kref_init(&result->refcounter);
+
+	return result;
+}
+
+void natlog_get(struct natlog *log)
+{
+	kref_get(&log->refcounter);
+}
+
+static void natlog_release(struct kref *refcount)
+{
+	struct natlog *log;
+	log = container_of(refcount, struct natlog, refcounter);
+
+	free_percpu(log->rings);
+	wkfree(struct natlog, log);
+}
+
+void natlog_put(struct natlog *log)
+{
+	kref_put(&log->refcounter, natlog_release);
+}
+
+static __u8 l4proto_to_iana(l4_protocol proto)
+{
+	switch (proto) {
+	case L4PROTO_TCP:
+		return IPPROTO_TCP;
+	case L4PROTO_UDP:
+		return IPPROTO_UDP;
+	case L4PROTO_ICMP:
+		return IPPROTO_ICMP;
+	case L4PROTO_OTHER:
+		break;
+	}
+
+	return 0;
+}
+
+/**
+ * Queues an event in the current CPU's ring.
+ *
+ * Has to be called with bottom halves disabled. (The BIB always calls it with
+ * its table spinlock held.) @dst6 and @dst4 can be NULL.
+ */
+void natlog_add(struct xlator *jool, enum natlog_event event,
+		l4_protocol proto,
+		struct ipv6_transport_addr const *src6,
+		struct ipv6_transport_addr const *dst6,
+		struct ipv4_transport_addr const *src4,
+		struct ipv4_transport_addr const *dst4)
+{
+	struct natlog_ring *ring;
+	struct natlog_record *record;
+	unsigned int head;
+
+	ring = this_cpu_ptr(jool->nat64.natlog->rings);
+	head = ring->head;
+	/* Pairs with the release in drain(). */
+	if (head - smp_load_acquire(&ring->tail) >= NATLOG_SLOTS) {
+		jstat_inc(jool->stats, JSTAT_NATLOG_RING_FULL);
+		return;
+	}
+
+	record = &ring->records[head & (NATLOG_SLOTS - 1)];
+	memset(record, 0, sizeof(*record));
+	record->timestamp = cpu_to_be64(ktime_to_ns(ktime_get_real()));
+	record->src6 = src6->l3;
+	record->src6_port = cpu_to_be16(src6->l4);
+	record->src4 = src4->l3;
+	record->src4_port = cpu_to_be16(src4->l4);
+	if (dst6) {
+		record->dst6 = dst6->l3;
+		record->dst6_port = cpu_to_be16(dst6->l4);
+	}
+	if (dst4) {
+		record->dst4 = dst4->l3;
+		record->dst4_port = cpu_to_be16(dst4->l4);
+	}
+	record->proto = l4proto_to_iana(proto);
+	record->event = event;
+
+	/* Publish the record. Pairs with the acquire in drain(). */
+	smp_store_release(&ring->head, head + 1);
+}
+
+/*
+ * Moves up to NATLOG_BATCH records from @ring to a new Netlink message.
+ * Returns the message (NULL if the ring was empty or we're out of memory).
+ *
+ * Assumes @ring->lock is held.
+ */
+static struct sk_buff *drain(struct xlator *jool, struct natlog_ring *ring)
+{
+	struct sk_buff *skb;
+	struct joolnlhdr *jhdr;
+	struct nlattr *attr;
+	struct natlog_record *records;
+	unsigned int tail;
+	unsigned int count;
+	unsigned int i;
+
+	tail = ring->tail;
+	count = smp_load_acquire(&ring->head) - tail;
+	if (count == 0)
+		return NULL;
+	if (count > NATLOG_BATCH)
+		count = NATLOG_BATCH;
+
+	skb = genlmsg_new(nla_total_size(count * sizeof(struct natlog_record)),
+			GFP_ATOMIC);
+	if (!skb)
+		goto drop;
+
+	jhdr = genlmsg_put(skb, 0, 0, jnl_family(), 0, 0);
+	if (WARN(!jhdr, "genlmsg_put() returned NULL"))
+		goto revert_skb;
+
+	memset(jhdr, 0, sizeof(*jhdr));
+	memcpy(jhdr->magic, JOOLNL_HDR_MAGIC, JOOLNL_HDR_MAGIC_LEN);
+	jhdr->version = cpu_to_be32(xlat_version());
+	jhdr->xt = XT_NAT64;
+	memcpy(jhdr->iname, jool->iname, INAME_MAX_SIZE);
+
+	attr = nla_reserve(skb, JNLAR_NATLOG_RECORDS,
+			count * sizeof(struct natlog_record));
+	if (WARN(!attr, "nla_reserve() returned NULL"))
+		goto revert_skb;
+
+	records = nla_data(attr);
+	for (i = 0; i < count; i++)
+		records[i] = ring->records[(tail + i) & (NATLOG_SLOTS - 1)];
+
+	/* Free the slots. Pairs with the acquire in natlog_add(). */
+	smp_store_release(&ring->tail, tail + count);
+
+	genlmsg_end(skb, jhdr);
+	jstat_add(jool->stats, JSTAT_NATLOG_SENT, count);
+	return skb;
+
+revert_skb:
+	kfree_skb(skb);
+drop:
+	/* Don't let the ring clog because of this. */
+	smp_store_release(&ring->tail, tail + count);
+	jstat_add(jool->stats, JSTAT_NATLOG_ENOMEM, count);
+	return NULL;
+}
+
+static void send(struct xlator *jool, struct sk_buff *skb)
+{
+	int error;
+
+	/* -ESRCH means nobody is listening; the records are lost. */
+	error = genlmsg_multicast_netns(jnl_family(), jool->ns, skb, 0,
+			JNL_MCGRP_NATLOG, GFP_ATOMIC);
+	if (error)
+		jstat_inc(jool->stats, JSTAT_NATLOG_UNHEARD);
+}
+
+/**
+ * Sends the current CPU's queued events to userspace, but only if there are
+ * enough of them to fill a message. Meant to be called from the packet path,
+ * once the BIB is done with the packet.
+ */
+void natlog_flush(struct xlator *jool)
+{
+	struct natlog_ring *ring;
+	struct sk_buff *skb;
+
+	if (!jool->globals.nat64.bib.ring_logging)
+		return;
+
+	local_bh_disable();
+
+	ring = this_cpu_ptr(jool->nat64.natlog->rings);
+	if (ring->head - READ_ONCE(ring->tail) < NATLOG_BATCH)
+		goto end;
+	/* Someone else is already draining it; let them. */
+	if (!spin_trylock(&ring->lock))
+		goto end;
+	skb = drain(jool, ring);
+	spin_unlock(&ring->lock);
+
+	if (skb)
+		send(jool, skb);
+
+end:
+	local_bh_enable();
+}
+
+/**
+ * Sends every queued event to userspace, from all CPUs.
+ * Meant to be called by the timer.
+ */
+void natlog_clean(struct xlator *jool)
+{
+	struct natlog_ring *ring;
+	struct sk_buff *skb;
+	unsigned int cpu;
+	unsigned int i;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(jool->nat64.natlog->rings, cpu);
+		/* (Bounded, in case the producer is faster than us.) */
+		for (i = 0; i < NATLOG_SLOTS / NATLOG_BATCH; i++) {
+			spin_lock_bh(&ring->lock);
+			skb = drain(jool, ring);
+			spin_unlock_bh(&ring->lock);
+
+			if (!skb)
+				break;
+			send(jool, skb);
+		}
+	}
+}
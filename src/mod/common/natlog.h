@@ -0,0 +1,39 @@
+#ifndef SRC_MOD_COMMON_NATLOG_H_
+#define SRC_MOD_COMMON_NATLOG_H_
+
+/**
+ * @file
+ * The NAT event log; a binary, per-CPU alternative to logging-bib and
+ * logging-session's printks. (See common/natlog.h.)
+ *
+ * Events are queued from the BIB while its table spinlock is held, so queuing
+ * only involves a copy into the current CPU's ring; there is no locking, no
+ * formatting and no allocation. If the ring is full, the event is dropped (and
+ * counted).
+ *
+ * Rings are drained towards userspace by natlog_flush() (which the packet path
+ * calls after the BIB is done, and only does work once the CPU has queued a
+ * full batch) and natlog_clean() (which the timer calls, and empties every
+ * ring).
+ */
+
+#include "common/natlog.h"
+#include "mod/common/xlator.h"
+
+struct natlog;
+
+struct natlog *natlog_alloc(void);
+void natlog_get(struct natlog *log);
+void natlog_put(struct natlog *log);
+
+void natlog_add(struct xlator *jool, enum natlog_event event,
+		l4_protocol proto,
+		struct ipv6_transport_addr const *src6,
+		struct ipv6_transport_addr const *dst6,
+		struct ipv4_transport_addr const *src4,
+		struct ipv4_transport_addr const *dst4);
+
+void natlog_flush(struct xlator *jool);
+void natlog_clean(struct xlator *jool);
+
+#endif /* SRC_MOD_COMMON_NATLOG_H_ */
@@ -2,16 +2,10 @@
 
 #include <linux/sort.h>
 #include "common/constants.h"
+#include "common/session.h"
 #include "mod/common/log.h"
 #include "mod/common/rfc6052.h"
 
-#define SERIALIZED_SESSION_SIZE (		\
-		sizeof(struct in6_addr)		\
-		+ 2 * sizeof(struct in_addr)	\
-		+ sizeof(__be32)		\
-		+ 4 * sizeof(__be16)		\
-)
-
 static int validate_null(struct nlattr *attr, char const *name)
 {
 	if (!attr) {
@@ -405,9 +399,8 @@ static int get_timeout(struct bib_config *config, struct session_entry *entry)
 	return 0;
 }
 
-#define READ_RAW(serialized, field)					\
-	memcpy(&field, serialized, sizeof(field));			\
-	serialized += sizeof(field);
+#define READ_RAW(serialized, offset, field)				\
+	memcpy(&field, serialized + offset, sizeof(field))
 
 int jnla_get_session_joold(struct nlattr *attr, char const *name,
 		struct jool_globals *cfg, struct session_entry *se)
@@ -423,28 +416,28 @@ int jnla_get_session_joold(struct nlattr *attr, char const *name,
 	if (error)
 		return error;
 
-	if (attr->nla_len < SERIALIZED_SESSION_SIZE) {
-		log_err("Invalid request: Session size (%u) < %zu",
-				attr->nla_len, SERIALIZED_SESSION_SIZE);
+	if (attr->nla_len < JOOLD_SESSION_SIZE) {
+		log_err("Invalid request: Session size (%u) < %u",
+				attr->nla_len, JOOLD_SESSION_SIZE);
 		return -EINVAL;
 	}
 
 	memset(se, 0, sizeof(*se));
 	serialized = nla_data(attr);
 
-	READ_RAW(serialized, se->src6.l3);
-	READ_RAW(serialized, se->src4.l3);
-	READ_RAW(serialized, se->dst4.l3);
-	READ_RAW(serialized, tmp32);
+	READ_RAW(serialized, JOOLD_SESSION_SRC6, se->src6.l3);
+	READ_RAW(serialized, JOOLD_SESSION_SRC4, se->src4.l3);
+	READ_RAW(serialized, JOOLD_SESSION_DST4, se->dst4.l3);
+	READ_RAW(serialized, JOOLD_SESSION_EXPIRATION, tmp32);
 
-	READ_RAW(serialized, tmp16);
+	READ_RAW(serialized, JOOLD_SESSION_SRC6_PORT, tmp16);
 	se->src6.l4 = ntohs(tmp16);
-	READ_RAW(serialized, tmp16);
+	READ_RAW(serialized, JOOLD_SESSION_SRC4_PORT, tmp16);
 	se->src4.l4 = ntohs(tmp16);
-	READ_RAW(serialized, tmp16);
+	READ_RAW(serialized, JOOLD_SESSION_DST4_PORT, tmp16);
 	se->dst4.l4 = ntohs(tmp16);
 
-	READ_RAW(serialized, tmp16);
+	READ_RAW(serialized, JOOLD_SESSION_META, tmp16);
 	__tmp16 = ntohs(tmp16);
 	se->proto = (__tmp16 >> 5) & 3;
 	se->state = (__tmp16 >> 2) & 7;
@@ -535,6 +528,56 @@ int jnla_get_plateaus(struct nlattr *root, struct mtu_plateaus *out)
 	return validate_plateaus(out);
 }
 
+int jnla_get_mark_ranges(struct nlattr *root, struct mark_ranges *out)
+{
+	struct nlattr *attr;
+	struct nlattr *attrs[JNLAMR_COUNT];
+	struct mark_range *range;
+	int rem;
+	int error;
+
+	error = validate_null(root, "Mark ranges");
+	if (error)
+		return error;
+	error = nla_validate(nla_data(root), nla_len(root), JNLAL_MAX,
+			joolnl_struct_list_policy, NULL);
+	if (error)
+		return error;
+
+	out->count = 0;
+	nla_for_each_nested(attr, root, rem) {
+		if (out->count >= MARK_RANGES_MAX) {
+			log_err("Too many mark ranges. (Max: %u)",
+					MARK_RANGES_MAX);
+			return -EINVAL;
+		}
+
+		error = jnla_parse_nested(attrs, JNLAMR_MAX, attr,
+				joolnl_mark_range_policy, "Mark range");
+		if (error)
+			return error;
+
+		range = &out->ranges[out->count];
+		error = jnla_get_u32(attrs[JNLAMR_LOW], "Minimum mark",
+				&range->min);
+		if (error)
+			return error;
+		error = jnla_get_u32(attrs[JNLAMR_HIGH], "Maximum mark",
+				&range->max);
+		if (error)
+			return error;
+		if (range->min > range->max) {
+			log_err("Mark range %u-%u is inverted.",
+					range->min, range->max);
+			return -EINVAL;
+		}
+
+		out->count++;
+	}
+
+	return 0;
+}
+
 int jnla_put_addr6(struct sk_buff *skb, int attrtype,
 		struct in6_addr const *addr)
 {
@@ -684,6 +727,18 @@ cancel:
 	return error;
 }
 
+static int __jnla_put_pool4(struct sk_buff *skb,
+		struct pool4_entry const *entry)
+{
+	return nla_put_u32(skb, JNLAP4_MARK, entry->mark)
+		|| nla_put_u32(skb, JNLAP4_ITERATIONS, entry->iterations)
+		|| nla_put_u8(skb, JNLAP4_FLAGS, entry->flags)
+		|| nla_put_u8(skb, JNLAP4_PROTO, entry->proto)
+		|| jnla_put_prefix4(skb, JNLAP4_PREFIX, &entry->range.prefix)
+		|| nla_put_u16(skb, JNLAP4_PORT_MIN, entry->range.ports.min)
+		|| nla_put_u16(skb, JNLAP4_PORT_MAX, entry->range.ports.max);
+}
+
 int jnla_put_pool4(struct sk_buff *skb, int attrtype,
 		struct pool4_entry const *entry)
 {
@@ -694,13 +749,29 @@ int jnla_put_pool4(struct sk_buff *skb, int attrtype,
 	if (!root)
 		return -EMSGSIZE;
 
-	error = nla_put_u32(skb, JNLAP4_MARK, entry->mark)
-		|| nla_put_u32(skb, JNLAP4_ITERATIONS, entry->iterations)
-		|| nla_put_u8(skb, JNLAP4_FLAGS, entry->flags)
-		|| nla_put_u8(skb, JNLAP4_PROTO, entry->proto)
-		|| jnla_put_prefix4(skb, JNLAP4_PREFIX, &entry->range.prefix)
-		|| nla_put_u16(skb, JNLAP4_PORT_MIN, entry->range.ports.min)
-		|| nla_put_u16(skb, JNLAP4_PORT_MAX, entry->range.ports.max);
+	error = __jnla_put_pool4(skb, entry);
+	if (error) {
+		nla_nest_cancel(skb, root);
+		return error;
+	}
+
+	nla_nest_end(skb, root);
+	return 0;
+}
+
+/* Same as jnla_put_pool4(), except it also includes @used. */
+int jnla_put_pool4_usage(struct sk_buff *skb, int attrtype,
+		struct pool4_entry const *entry, __u32 used)
+{
+	struct nlattr *root;
+	int error;
+
+	root = nla_nest_start(skb, attrtype);
+	if (!root)
+		return -EMSGSIZE;
+
+	error = __jnla_put_pool4(skb, entry)
+		|| nla_put_u32(skb, JNLAP4_USED, used);
 	if (error) {
 		nla_nest_cancel(skb, root);
 		return error;
@@ -767,15 +838,35 @@ int jnla_put_session(struct sk_buff *skb, int attrtype,
 	return 0;
 }
 
+int jnla_put_talker(struct sk_buff *skb, int attrtype,
+		struct top_talker const *talker)
+{
+	struct nlattr *root;
+	int error;
+
+	root = nla_nest_start(skb, attrtype);
+	if (!root)
+		return -EMSGSIZE;
+
+	error = jnla_put_prefix6(skb, JNLATK_PREFIX, &talker->prefix)
+		|| nla_put_u32(skb, JNLATK_REQUESTS, talker->requests)
+		|| nla_put_u32(skb, JNLATK_SESSIONS, talker->sessions);
+	if (error) {
+		nla_nest_cancel(skb, root);
+		return error;
+	}
+
+	nla_nest_end(skb, root);
+	return 0;
+}
+
 #define ADD_RAW(buffer, offset, content)				\
-	memcpy(buffer + offset, &content, sizeof(content));		\
-	offset += sizeof(content)
+	memcpy(buffer + offset, &content, sizeof(content))
 
 int jnla_put_session_joold(struct sk_buff *skb, int attrtype,
 		struct session_entry const *entry)
 {
-	__u8 buffer[SERIALIZED_SESSION_SIZE];
-	size_t offset;
+	__u8 buffer[JOOLD_SESSION_SIZE];
 	unsigned long dying_time;
 	__be32 tmp32;
 	__be16 tmp16;
@@ -787,15 +878,13 @@ int jnla_put_session_joold(struct sk_buff *skb, int attrtype,
 	 * we'll do some low level byte hacking.
 	 */
 
-	offset = 0;
-
 	/* 128 bit fields */
-	ADD_RAW(buffer, offset, entry->src6.l3);
+	ADD_RAW(buffer, JOOLD_SESSION_SRC6, entry->src6.l3);
 	/* Skip dst6; it can be inferred from dst4. */
 
 	/* 32 bit fields */
-	ADD_RAW(buffer, offset, entry->src4.l3);
-	ADD_RAW(buffer, offset, entry->dst4.l3);
+	ADD_RAW(buffer, JOOLD_SESSION_SRC4, entry->src4.l3);
+	ADD_RAW(buffer, JOOLD_SESSION_DST4, entry->dst4.l3);
 
 	dying_time = entry->update_time + entry->timeout;
 	dying_time = (dying_time > jiffies)
@@ -805,15 +894,15 @@ int jnla_put_session_joold(struct sk_buff *skb, int attrtype,
 		dying_time = MAX_U32;
 
 	tmp32 = htonl(dying_time);
-	ADD_RAW(buffer, offset, tmp32);
+	ADD_RAW(buffer, JOOLD_SESSION_EXPIRATION, tmp32);
 
 	/* 16 bit fields */
 	tmp16 = htons(entry->src6.l4);
-	ADD_RAW(buffer, offset, tmp16);
+	ADD_RAW(buffer, JOOLD_SESSION_SRC6_PORT, tmp16);
 	tmp16 = htons(entry->src4.l4);
-	ADD_RAW(buffer, offset, tmp16);
+	ADD_RAW(buffer, JOOLD_SESSION_SRC4_PORT, tmp16);
 	tmp16 = htons(entry->dst4.l4);
-	ADD_RAW(buffer, offset, tmp16);
+	ADD_RAW(buffer, JOOLD_SESSION_DST4_PORT, tmp16);
 
 	/* Well, this fits in a byte, but use 2 to avoid slop */
 	tmp16 = htons(
@@ -821,7 +910,7 @@ int jnla_put_session_joold(struct sk_buff *skb, int attrtype,
 		| (entry->state << 2) /* 3 bits */
 		| entry->timer_type /* 2 bits */
 	);
-	ADD_RAW(buffer, offset, tmp16);
+	ADD_RAW(buffer, JOOLD_SESSION_META, tmp16);
 
 	return nla_put(skb, attrtype, sizeof(buffer), buffer);
 }
@@ -849,6 +938,35 @@ int jnla_put_plateaus(struct sk_buff *skb, int attrtype,
 	return 0;
 }
 
+int jnla_put_mark_ranges(struct sk_buff *skb, int attrtype,
+		struct mark_ranges const *ranges)
+{
+	struct nlattr *root;
+	struct nlattr *entry;
+	unsigned int i;
+
+	root = nla_nest_start(skb, attrtype);
+	if (!root)
+		return -EMSGSIZE;
+
+	for (i = 0; i < ranges->count; i++) {
+		entry = nla_nest_start(skb, JNLAL_ENTRY);
+		if (!entry)
+			goto cancel;
+		if (nla_put_u32(skb, JNLAMR_LOW, ranges->ranges[i].min)
+				|| nla_put_u32(skb, JNLAMR_HIGH, ranges->ranges[i].max))
+			goto cancel;
+		nla_nest_end(skb, entry);
+	}
+
+	nla_nest_end(skb, root);
+	return 0;
+
+cancel:
+	nla_nest_cancel(skb, root);
+	return -EMSGSIZE;
+}
+
 int jnla_parse_nested(struct nlattr *tb[], int maxtype,
 		const struct nlattr *nla, const struct nla_policy *policy,
 		char const *name)
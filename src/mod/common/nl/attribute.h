@@ -4,6 +4,7 @@
 #include <linux/netlink.h>
 #include "common/config.h"
 #include "mod/common/db/bib/entry.h"
+#include "mod/common/db/bib/subscriber.h"
 
 int jnla_get_u8(struct nlattr *attr, char const *name, __u8 *out);
 int jnla_get_u16(struct nlattr *attr, char const *name, __u16 *out);
@@ -22,6 +23,7 @@ int jnla_get_pool4(struct nlattr *attr, char const *name, struct pool4_entry *en
 int jnla_get_bib(struct nlattr *attr, char const *name, struct bib_entry *entry);
 int jnla_get_session_joold(struct nlattr *attr, char const *name, struct jool_globals *cfg, struct session_entry *entry);
 int jnla_get_plateaus(struct nlattr *attr, struct mtu_plateaus *out);
+int jnla_get_mark_ranges(struct nlattr *attr, struct mark_ranges *out);
 
 /* Note: None of these print error messages. */
 int jnla_put_addr6(struct sk_buff *skb, int attrtype, struct in6_addr const *addr);
@@ -32,10 +34,13 @@ int jnla_put_taddr6(struct sk_buff *skb, int attrtype, struct ipv6_transport_add
 int jnla_put_taddr4(struct sk_buff *skb, int attrtype, struct ipv4_transport_addr const *prefix);
 int jnla_put_eam(struct sk_buff *skb, int attrtype, struct eamt_entry const *eam);
 int jnla_put_pool4(struct sk_buff *skb, int attrtype, struct pool4_entry const *bib);
+int jnla_put_pool4_usage(struct sk_buff *skb, int attrtype, struct pool4_entry const *entry, __u32 used);
 int jnla_put_bib(struct sk_buff *skb, int attrtype, struct bib_entry const *bib);
 int jnla_put_session(struct sk_buff *skb, int attrtype, struct session_entry const *entry);
 int jnla_put_session_joold(struct sk_buff *skb, int attrtype, struct session_entry const *entry);
+int jnla_put_talker(struct sk_buff *skb, int attrtype, struct top_talker const *talker);
 int jnla_put_plateaus(struct sk_buff *skb, int attrtype, struct mtu_plateaus const *plateaus);
+int jnla_put_mark_ranges(struct sk_buff *skb, int attrtype, struct mark_ranges const *ranges);
 
 int jnla_parse_nested(struct nlattr *tb[], int maxtype,
 		const struct nlattr *nla, const struct nla_policy *policy,
@@ -77,6 +77,8 @@ int handle_denylist4_add(struct sk_buff *skb, struct genl_info *info)
 
 	error = denylist4_add(jool.siit.denylist4, &operand,
 			get_jool_hdr(info)->flags & JOOLNLHDR_FLAGS_FORCE);
+	if (!error)
+		xlator_touch(&jool);
 	/* Fall through */
 
 revert_start:
@@ -102,6 +104,8 @@ int handle_denylist4_rm(struct sk_buff *skb, struct genl_info *info)
 		goto revert_start;
 
 	error = denylist4_rm(jool.siit.denylist4, &operand);
+	if (!error)
+		xlator_touch(&jool);
 revert_start:
 	error = jresponse_send_simple(&jool, info, error);
 	request_handle_end(&jool);
@@ -120,6 +124,8 @@ int handle_denylist4_flush(struct sk_buff *skb, struct genl_info *info)
 	__log_debug(&jool, "Flushing the denylist4...");
 
 	error = denylist4_flush(jool.siit.denylist4);
+	if (!error)
+		xlator_touch(&jool);
 	error = jresponse_send_simple(&jool, info, error);
 	request_handle_end(&jool);
 	return error;
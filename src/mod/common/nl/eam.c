@@ -81,6 +81,8 @@ int handle_eamt_add(struct sk_buff *skb, struct genl_info *info)
 
 	error = eamt_add(jool.siit.eamt, &addend,
 			get_jool_hdr(info)->flags & JOOLNLHDR_FLAGS_FORCE, true);
+	if (!error)
+		xlator_touch(&jool);
 revert_start:
 	error = jresponse_send_simple(&jool, info, error);
 	request_handle_end(&jool);
@@ -131,6 +133,8 @@ int handle_eamt_rm(struct sk_buff *skb, struct genl_info *info)
 	}
 
 	error = eamt_rm(jool.siit.eamt, prefix6_ptr, prefix4_ptr);
+	if (!error)
+		xlator_touch(&jool);
 revert_start:
 	error = jresponse_send_simple(&jool, info, error);
 	request_handle_end(&jool);
@@ -149,6 +153,7 @@ int handle_eamt_flush(struct sk_buff *skb, struct genl_info *info)
 	__log_debug(&jool, "Flushing the EAMT.");
 
 	eamt_flush(jool.siit.eamt);
+	xlator_touch(&jool);
 
 	error = jresponse_send_simple(&jool, info, error);
 	request_handle_end(&jool);
@@ -103,9 +103,14 @@ int handle_instance_add(struct sk_buff *skb, struct genl_info *info)
 	static struct nla_policy add_policy[JNLAIA_COUNT] = {
 		[JNLAIA_XF] = { .type = NLA_U8 },
 		[JNLAIA_POOL6] = { .type = NLA_NESTED, },
+		[JNLAIA_DEVICES] = {
+			.type = NLA_NUL_STRING,
+			.len = INGRESS_DEVS_MAX_SIZE - 1,
+		},
 	};
 	struct nlattr *attrs[JNLAIA_COUNT];
 	struct config_prefix6 pool6;
+	char devices[INGRESS_DEVS_MAX_SIZE];
 	__u8 xf;
 	int error;
 
@@ -136,11 +141,19 @@ int handle_instance_add(struct sk_buff *skb, struct genl_info *info)
 		if (error)
 			goto revert_start;
 	}
+	devices[0] = '\0';
+	if (attrs[JNLAIA_DEVICES]) {
+		error = jnla_get_str(attrs[JNLAIA_DEVICES], "devices",
+				INGRESS_DEVS_MAX_SIZE, devices);
+		if (error)
+			goto revert_start;
+	}
 
 	return jresponse_send_simple(NULL, info, xlator_add(
 		xf | get_jool_hdr(info)->xt,
 		get_jool_hdr(info)->iname,
 		pool6.set ? &pool6.prefix : NULL,
+		devices,
 		NULL
 	));
 
@@ -152,6 +165,7 @@ abort:
 
 int handle_instance_hello(struct sk_buff *skb, struct genl_info *info)
 {
+	struct xlator jool;
 	struct jool_response response;
 	int error;
 
@@ -166,10 +180,15 @@ int handle_instance_hello(struct sk_buff *skb, struct genl_info *info)
 		goto revert_start;
 
 	error = xlator_find_current(get_jool_hdr(info)->iname,
-			XF_ANY | get_jool_hdr(info)->xt, NULL);
+			XF_ANY | get_jool_hdr(info)->xt, &jool);
 	switch (error) {
 	case 0:
 		error = nla_put_u8(response.skb, JNLAIS_STATUS, IHS_ALIVE);
+		if (!error)
+			error = nla_put_u64_64bit(response.skb,
+					JNLAIS_GENERATION, jool.generation,
+					JNLAIS_PADDING);
+		xlator_put(&jool);
 		if (error)
 			goto put_failure;
 		break;
@@ -70,10 +70,9 @@ static int validate_version(struct joolnlhdr *hdr)
 	return -EINVAL;
 }
 
-int request_handle_start(struct genl_info *info, xlator_type xt,
-		struct xlator *jool, bool require_net_admin)
+static int validate_request(struct joolnlhdr *hdr, xlator_type xt,
+		bool require_net_admin)
 {
-	struct joolnlhdr *hdr;
 	int error;
 
 	if (require_net_admin && !capable(CAP_NET_ADMIN)) {
@@ -81,12 +80,6 @@ int request_handle_start(struct genl_info *info, xlator_type xt,
 		return -EPERM;
 	}
 
-	if (!info->attrs) {
-		log_err("Userspace request lacks Netlink attributes.");
-		return -EINVAL;
-	}
-
-	hdr = get_jool_hdr(info);
 	if (!hdr) {
 		log_err("Userspace request lacks a Jool header.");
 		return -EINVAL;
@@ -106,15 +99,38 @@ int request_handle_start(struct genl_info *info, xlator_type xt,
 		return -EINVAL;
 	}
 
-	if (jool) {
-		error = xlator_find_current(get_iname(info), XF_ANY | hdr->xt, jool);
-		if (error == -ESRCH)
-			log_err("This namespace lacks an instance named '%s'.", get_iname(info));
-		if (error)
-			return error;
+	return 0;
+}
+
+static int find_instance(struct joolnlhdr *hdr, struct xlator *jool)
+{
+	char *iname;
+	int error;
+
+	iname = (hdr->iname[0] != 0) ? hdr->iname : INAME_DEFAULT;
+	error = xlator_find_current(iname, XF_ANY | hdr->xt, jool);
+	if (error == -ESRCH)
+		log_err("This namespace lacks an instance named '%s'.", iname);
+	return error;
+}
+
+int request_handle_start(struct genl_info *info, xlator_type xt,
+		struct xlator *jool, bool require_net_admin)
+{
+	struct joolnlhdr *hdr;
+	int error;
+
+	if (!info->attrs) {
+		log_err("Userspace request lacks Netlink attributes.");
+		return -EINVAL;
 	}
 
-	return 0;
+	hdr = get_jool_hdr(info);
+	error = validate_request(hdr, xt, require_net_admin);
+	if (error)
+		return error;
+
+	return jool ? find_instance(hdr, jool) : 0;
 }
 
 void request_handle_end(struct xlator *jool)
@@ -122,3 +138,40 @@ void request_handle_end(struct xlator *jool)
 	if (jool)
 		xlator_put(jool);
 }
+
+struct joolnlhdr *get_dump_jool_hdr(struct netlink_callback *cb)
+{
+	if (nlmsg_len(cb->nlh) < GENL_HDRLEN + sizeof(struct joolnlhdr))
+		return NULL;
+	return nlmsg_data(cb->nlh) + GENL_HDRLEN;
+}
+
+/*
+ * Returns the @attrtype attribute of the request that started the @cb dump, or
+ * NULL if the request lacks it.
+ * (We can't rely on genl_dumpit_info(); it's too recent.)
+ */
+struct nlattr *get_dump_attr(struct netlink_callback *cb, int attrtype)
+{
+	return nlmsg_find_attr(cb->nlh, GENL_HDRLEN + sizeof(struct joolnlhdr),
+			attrtype);
+}
+
+/*
+ * Same as request_handle_start(), except for Netlink dumps.
+ * Needs to be called by the first dumpit() call only, and reverted by
+ * request_handle_end().
+ */
+int dump_handle_start(struct netlink_callback *cb, xlator_type xt,
+		struct xlator *jool, bool require_net_admin)
+{
+	struct joolnlhdr *hdr;
+	int error;
+
+	hdr = get_dump_jool_hdr(cb);
+	error = validate_request(hdr, xt, require_net_admin);
+	if (error)
+		return error;
+
+	return find_instance(hdr, jool);
+}
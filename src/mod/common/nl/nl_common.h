@@ -12,4 +12,9 @@ int request_handle_start(struct genl_info *info, xlator_type xt,
 		struct xlator *jool, bool require_net_admin);
 void request_handle_end(struct xlator *jool);
 
+struct joolnlhdr *get_dump_jool_hdr(struct netlink_callback *cb);
+struct nlattr *get_dump_attr(struct netlink_callback *cb, int attrtype);
+int dump_handle_start(struct netlink_callback *cb, xlator_type xt,
+		struct xlator *jool, bool require_net_admin);
+
 #endif /* SRC_MOD_COMMON_NL_COMMON_H_ */
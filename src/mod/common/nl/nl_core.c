@@ -147,3 +147,76 @@ revert_msg:
 	return error;
 }
 
+/*
+ * Starts a new message in the @skb of the @cb dump.
+ * Returns the message's Jool header, which needs to be closed with
+ * genlmsg_end() or genlmsg_cancel().
+ */
+struct joolnlhdr *jdump_put_hdr(struct sk_buff *skb,
+		struct netlink_callback *cb)
+{
+	struct genlmsghdr *ghdr;
+	struct joolnlhdr *request;
+	struct joolnlhdr *hdr;
+
+	ghdr = nlmsg_data(cb->nlh);
+	hdr = genlmsg_put(skb, NETLINK_CB(cb->skb).portid, cb->nlh->nlmsg_seq,
+			jnl_family(), NLM_F_MULTI, ghdr->cmd);
+	if (!hdr)
+		return NULL;
+
+	request = get_dump_jool_hdr(cb);
+	if (request)
+		memcpy(hdr, request, sizeof(*hdr));
+	else
+		memset(hdr, 0, sizeof(*hdr));
+	hdr->flags = 0;
+	return hdr;
+}
+
+/*
+ * Dump version of jresponse_send_simple().
+ * Assumes @error_code is nonzero, and the error pool is active.
+ * Returns the value dumpit() should return.
+ */
+int jdump_put_error(struct sk_buff *skb, struct netlink_callback *cb,
+		int error_code)
+{
+	struct joolnlhdr *hdr;
+	char *error_msg;
+	size_t error_msg_size;
+	int error;
+
+	error_code = abs(error_code);
+	if (error_code > MAX_U16)
+		error_code = MAX_U16;
+
+	error = error_pool_get_message(&error_msg, &error_msg_size);
+	if (error)
+		return error;
+
+	hdr = jdump_put_hdr(skb, cb);
+	if (!hdr) {
+		error = -EMSGSIZE;
+		goto end;
+	}
+	hdr->flags |= JOOLNLHDR_FLAGS_ERROR;
+
+	if (nla_put_u16(skb, JNLAERR_CODE, error_code)) {
+		genlmsg_cancel(skb, hdr);
+		error = -EMSGSIZE;
+		goto end;
+	}
+	if (nla_put_string(skb, JNLAERR_MSG, error_msg)) {
+		error_msg[128] = '\0';
+		nla_put_string(skb, JNLAERR_MSG, error_msg);
+	}
+
+	genlmsg_end(skb, hdr);
+	error = skb->len;
+	/* Fall through. */
+
+end:
+	__wkfree("Error msg out", error_msg);
+	return error;
+}
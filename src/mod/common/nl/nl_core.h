@@ -22,5 +22,10 @@ int jresponse_send_array(struct xlator *jool, struct jool_response *response,
 int jresponse_send_simple(struct xlator *jool, struct genl_info *info,
 		int error);
 
+struct joolnlhdr *jdump_put_hdr(struct sk_buff *skb,
+		struct netlink_callback *cb);
+int jdump_put_error(struct sk_buff *skb, struct netlink_callback *cb,
+		int error);
+
 
 #endif /* SRC_MOD_COMMON_NL_CORE_H_ */
@@ -96,6 +96,14 @@ static const struct genl_ops ops[] = {
 		.cmd = JNLOP_STATS_FOREACH,
 		.doit = handle_stats_foreach,
 		JOOL_POLICY
+	}, {
+		.cmd = JNLOP_STATS_LATENCY,
+		.doit = handle_stats_latency,
+		JOOL_POLICY
+	}, {
+		.cmd = JNLOP_STATS_LOCKS,
+		.doit = handle_stats_locks,
+		JOOL_POLICY
 	}, {
 		.cmd = JNLOP_GLOBAL_FOREACH,
 		.doit = handle_global_foreach,
@@ -152,6 +160,14 @@ static const struct genl_ops ops[] = {
 		.cmd = JNLOP_POOL4_FLUSH,
 		.doit = handle_pool4_flush,
 		JOOL_POLICY
+	}, {
+		.cmd = JNLOP_POOL4_USAGE,
+		.doit = handle_pool4_usage,
+		JOOL_POLICY
+	}, {
+		.cmd = JNLOP_POOL4_ITERATIONS,
+		.doit = handle_pool4_iterations,
+		JOOL_POLICY
 	}, {
 		.cmd = JNLOP_BIB_FOREACH,
 		.doit = handle_bib_foreach,
@@ -167,6 +183,12 @@ static const struct genl_ops ops[] = {
 	}, {
 		.cmd = JNLOP_SESSION_FOREACH,
 		.doit = handle_session_foreach,
+		.dumpit = handle_session_dump,
+		.done = handle_session_dump_done,
+		JOOL_POLICY
+	}, {
+		.cmd = JNLOP_SESSION_TOP,
+		.doit = handle_session_top,
 		JOOL_POLICY
 	}, {
 		.cmd = JNLOP_FILE_HANDLE,
@@ -188,9 +210,15 @@ static const struct genl_ops ops[] = {
 };
 
 static struct genl_multicast_group mc_groups[] = {
-	{
+	[JNL_MCGRP_JOOLD] = {
 		.name = JOOLNL_MULTICAST_GRP_NAME,
 	},
+	[JNL_MCGRP_NATLOG] = {
+		.name = JOOLNL_NATLOG_GRP_NAME,
+	},
+	[JNL_MCGRP_STATS] = {
+		.name = JOOLNL_STATS_GRP_NAME,
+	},
 };
 
 static struct genl_family jool_family = {
@@ -10,6 +10,13 @@
 #include <linux/skbuff.h>
 #include <net/genetlink.h>
 
+/* Multicast groups, as indexed by genlmsg_multicast_netns(). */
+enum jnl_mcgrp {
+	JNL_MCGRP_JOOLD,
+	JNL_MCGRP_NATLOG,
+	JNL_MCGRP_STATS,
+};
+
 int nlhandler_setup(void);
 void nlhandler_teardown(void);
 
@@ -1,6 +1,7 @@
 #include "mod/common/nl/pool4.h"
 
 #include "mod/common/log.h"
+#include "mod/common/stats.h"
 #include "mod/common/xlator.h"
 #include "mod/common/nl/attribute.h"
 #include "mod/common/nl/nl_common.h"
@@ -13,6 +14,88 @@ static int serialize_pool4_entry(struct pool4_entry const *entry, void *arg)
 	return jnla_put_pool4(arg, JNLAL_ENTRY, entry) ? 1 : 0;
 }
 
+/*
+ * Maximum number of pool4 entries a single usage request reports. (They are
+ * counted after the pool4 lock is released, so they need to be copied first.)
+ * Userspace asks for the rest later, like in any other foreach.
+ */
+#define USAGE_MAX_SAMPLES 64
+
+struct usage_args {
+	struct pool4_entry *samples;
+	unsigned int count;
+};
+
+static int collect_pool4_sample(struct pool4_entry const *entry, void *arg)
+{
+	struct usage_args *args = arg;
+
+	if (args->count >= USAGE_MAX_SAMPLES)
+		return 1;
+	args->samples[args->count++] = *entry;
+	return 0;
+}
+
+/*
+ * Note: Takes the BIB table's lock, so it must not run with the pool4 lock
+ * held.
+ */
+static int serialize_pool4_usage(struct xlator *jool, struct sk_buff *skb,
+		struct usage_args *args)
+{
+	struct pool4_entry *entry;
+	unsigned int i;
+	__u32 used;
+	int error;
+
+	for (i = 0; i < args->count; i++) {
+		entry = &args->samples[i];
+		error = bib_count_range(jool->nat64.bib, entry->proto,
+				&entry->range, &used);
+		if (error)
+			return error;
+		if (jnla_put_pool4_usage(skb, JNLAL_ENTRY, entry, used))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Extracts the foreach request's iteration offset. If this is the first
+ * request, it only extracts the protocol, and @offset_ptr becomes NULL.
+ */
+static int get_offset(struct xlator *jool, struct genl_info *info,
+		struct pool4_entry *offset, struct pool4_entry **offset_ptr)
+{
+	int error;
+
+	if (info->attrs[JNLAR_OFFSET]) {
+		error = jnla_get_pool4(info->attrs[JNLAR_OFFSET],
+				"Iteration offset", offset);
+		if (error)
+			return error;
+		*offset_ptr = offset;
+		__log_debug(jool, "Offset: [%pI4/%u %u-%u %u %u %u %u]",
+				&offset->range.prefix.addr,
+				offset->range.prefix.len,
+				offset->range.ports.min,
+				offset->range.ports.max,
+				offset->mark,
+				offset->iterations,
+				offset->flags,
+				offset->proto);
+	} else if (info->attrs[JNLAR_PROTO]) {
+		offset->proto = nla_get_u8(info->attrs[JNLAR_PROTO]);
+		*offset_ptr = NULL;
+	} else {
+		log_err("The request is missing a protocol.");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
 int handle_pool4_foreach(struct sk_buff *skb, struct genl_info *info)
 {
 	struct xlator jool;
@@ -30,29 +113,9 @@ int handle_pool4_foreach(struct sk_buff *skb, struct genl_info *info)
 	if (error)
 		goto revert_start;
 
-	if (info->attrs[JNLAR_OFFSET]) {
-		error = jnla_get_pool4(info->attrs[JNLAR_OFFSET],
-				"Iteration offset", &offset);
-		if (error)
-			goto revert_response;
-		offset_ptr = &offset;
-		__log_debug(&jool, "Offset: [%pI4/%u %u-%u %u %u %u %u]",
-				&offset.range.prefix.addr,
-				offset.range.prefix.len,
-				offset.range.ports.min,
-				offset.range.ports.max,
-				offset.mark,
-				offset.iterations,
-				offset.flags,
-				offset.proto);
-	} else if (info->attrs[JNLAR_PROTO]) {
-		offset.proto = nla_get_u8(info->attrs[JNLAR_PROTO]);
-		offset_ptr = NULL;
-	} else {
-		log_err("The request is missing a protocol.");
-		error = -EINVAL;
+	error = get_offset(&jool, info, &offset, &offset_ptr);
+	if (error)
 		goto revert_response;
-	}
 
 	error = pool4db_foreach_sample(jool.nat64.pool4,
 			offset.proto, serialize_pool4_entry, response.skb,
@@ -73,6 +136,105 @@ revert_start:
 	return error;
 }
 
+int handle_pool4_usage(struct sk_buff *skb, struct genl_info *info)
+{
+	struct xlator jool;
+	struct jool_response response;
+	struct pool4_entry offset, *offset_ptr;
+	struct usage_args args;
+	int usage_error;
+	int error;
+
+	error = request_handle_start(info, XT_NAT64, &jool, true);
+	if (error)
+		return jresponse_send_simple(NULL, info, error);
+
+	__log_debug(&jool, "Sending pool4 usage to userspace.");
+
+	error = jresponse_init(&response, info);
+	if (error)
+		goto revert_start;
+
+	error = get_offset(&jool, info, &offset, &offset_ptr);
+	if (error)
+		goto revert_response;
+
+	args.samples = kmalloc_array(USAGE_MAX_SAMPLES, sizeof(*args.samples),
+			GFP_KERNEL);
+	if (!args.samples) {
+		error = -ENOMEM;
+		goto revert_response;
+	}
+	args.count = 0;
+
+	error = pool4db_foreach_sample(jool.nat64.pool4,
+			offset.proto, collect_pool4_sample, &args,
+			offset_ptr);
+	if (error >= 0) {
+		usage_error = serialize_pool4_usage(&jool, response.skb, &args);
+		if (usage_error)
+			error = usage_error;
+	}
+	kfree(args.samples);
+
+	error = jresponse_send_array(&jool, &response, error);
+	if (error)
+		goto revert_response;
+
+	request_handle_end(&jool);
+	return 0;
+
+revert_response:
+	jresponse_cleanup(&response);
+revert_start:
+	error = jresponse_send_simple(&jool, info, error);
+	request_handle_end(&jool);
+	return error;
+}
+
+int handle_pool4_iterations(struct sk_buff *skb, struct genl_info *info)
+{
+	struct xlator jool;
+	struct jool_mask_iterations *iterations;
+	struct jool_response response;
+	int error;
+
+	error = request_handle_start(info, XT_NAT64, &jool, true);
+	if (error)
+		return jresponse_send_simple(NULL, info, error);
+
+	__log_debug(&jool, "Returning pool4 iteration counters.");
+
+	iterations = jstat_iterations_query(jool.stats);
+	if (!iterations) {
+		error = -ENOMEM;
+		goto revert_start;
+	}
+
+	error = jresponse_init(&response, info);
+	if (error)
+		goto revert_query;
+
+	error = nla_put(response.skb, JNLAR_POOL4_ITERATIONS,
+			JITER_PROTO_COUNT * sizeof(*iterations), iterations);
+	if (error)
+		goto revert_response;
+
+	kfree(iterations);
+	request_handle_end(&jool);
+	return jresponse_send(&response);
+
+revert_response:
+	report_put_failure();
+	jresponse_cleanup(&response);
+revert_query:
+	kfree(iterations);
+revert_start:
+	error = jresponse_send_simple(&jool, info, error);
+	request_handle_end(&jool);
+	return error;
+}
+
 int handle_pool4_add(struct sk_buff *skb, struct genl_info *info)
 {
 	struct xlator jool;
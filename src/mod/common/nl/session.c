@@ -1,6 +1,8 @@
 #include "mod/common/nl/session.h"
 
+#include "mod/common/error_pool.h"
 #include "mod/common/log.h"
+#include "mod/common/wkmalloc.h"
 #include "mod/common/xlator.h"
 #include "mod/common/nl/attribute.h"
 #include "mod/common/nl/nl_common.h"
@@ -93,3 +95,236 @@ revert_start:
 	request_handle_end(&jool);
 	return error;
 }
+
+int handle_session_top(struct sk_buff *skb, struct genl_info *info)
+{
+	struct xlator jool;
+	struct jool_response response;
+	struct top_talker talkers[TOP_TALKERS];
+	int count;
+	int i;
+	int error;
+
+	error = request_handle_start(info, XT_NAT64, &jool, true);
+	if (error)
+		return jresponse_send_simple(NULL, info, error);
+
+	__log_debug(&jool, "Sending top talkers to userspace.");
+
+	if (!info->attrs[JNLAR_PROTO]) {
+		log_err("The request is missing a transport protocol.");
+		error = -EINVAL;
+		goto revert_start;
+	}
+
+	count = bib_top_talkers(jool.nat64.bib,
+			nla_get_u8(info->attrs[JNLAR_PROTO]), talkers);
+	if (count < 0) {
+		error = count;
+		goto revert_start;
+	}
+
+	error = jresponse_init(&response, info);
+	if (error)
+		goto revert_start;
+
+	/* TOP_TALKERS is small, so they always fit in one message. */
+	for (i = 0; i < count; i++) {
+		error = jnla_put_talker(response.skb, JNLAL_ENTRY, &talkers[i]);
+		if (error) {
+			report_put_failure();
+			goto revert_response;
+		}
+	}
+
+	error = jresponse_send_array(&jool, &response, 0);
+	if (error)
+		goto revert_response;
+
+	request_handle_end(&jool);
+	return 0;
+
+revert_response:
+	jresponse_cleanup(&response);
+revert_start:
+	error = jresponse_send_simple(&jool, info, error);
+	request_handle_end(&jool);
+	return error;
+}
+
+/*
+ * Netlink dump version of the session foreach.
+ *
+ * The old foreach (above) needs a full userspace round trip per page, and
+ * serializes while holding the table's spinlock. This one instead copies small
+ * batches of sessions while holding the lock, and serializes them after
+ * releasing it. The cursor is the key of the last session copied, so it
+ * remains valid even if sessions are added or removed between batches.
+ * (Deleted sessions simply will not be printed, and new sessions will be
+ * printed if they land after the cursor.)
+ *
+ * Netlink takes care of streaming the pages.
+ */
+
+#define SESSION_DUMP_BATCH 64
+
+struct session_dump {
+	struct xlator jool;
+	l4_protocol proto;
+
+	/* Key of the last session copied into @batch. */
+	struct session_foreach_offset offset;
+	/* Is @offset valid? (Has the first batch been copied yet?) */
+	bool started;
+	/* Has the table been exhausted? */
+	bool done;
+
+	struct session_entry batch[SESSION_DUMP_BATCH];
+	unsigned int batch_len;
+	/* Index of the first @batch session that has not been serialized. */
+	unsigned int batch_next;
+};
+
+static int copy_session_entry(struct session_entry const *entry, void *arg)
+{
+	struct session_dump *dump = arg;
+
+	dump->batch[dump->batch_len] = *entry;
+	dump->batch_len++;
+	return (dump->batch_len >= SESSION_DUMP_BATCH) ? 1 : 0;
+}
+
+static int refill_batch(struct session_dump *dump)
+{
+	struct session_entry *last;
+	int error;
+
+	dump->batch_len = 0;
+	dump->batch_next = 0;
+
+	error = bib_foreach_session(&dump->jool, dump->proto,
+			copy_session_entry, dump,
+			dump->started ? &dump->offset : NULL);
+	if (error < 0)
+		return error;
+	/* 0 means the foreach ran out of sessions before filling the batch. */
+	if (error == 0)
+		dump->done = true;
+
+	if (dump->batch_len > 0) {
+		last = &dump->batch[dump->batch_len - 1];
+		dump->offset.offset.src = last->src4;
+		dump->offset.offset.dst = last->dst4;
+		dump->offset.include_offset = false;
+		dump->started = true;
+	}
+
+	return 0;
+}
+
+static struct session_dump *session_dump_alloc(struct netlink_callback *cb)
+{
+	struct session_dump *dump;
+	struct nlattr *proto;
+	int error;
+
+	dump = wkmalloc(struct session_dump, GFP_KERNEL);
+	if (!dump)
+		return ERR_PTR(-ENOMEM);
+
+	error = dump_handle_start(cb, XT_NAT64, &dump->jool, true);
+	if (error)
+		goto revert_alloc;
+
+	proto = get_dump_attr(cb, JNLAR_PROTO);
+	if (!proto || nla_len(proto) < sizeof(__u8)) {
+		log_err("The request is missing a transport protocol.");
+		error = -EINVAL;
+		goto revert_start;
+	}
+
+	dump->proto = nla_get_u8(proto);
+	dump->started = false;
+	dump->done = false;
+	dump->batch_len = 0;
+	dump->batch_next = 0;
+	return dump;
+
+revert_start:
+	request_handle_end(&dump->jool);
+revert_alloc:
+	wkfree(struct session_dump, dump);
+	return ERR_PTR(error);
+}
+
+int handle_session_dump(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct session_dump *dump;
+	struct joolnlhdr *hdr;
+	unsigned int initial_len;
+	int error;
+
+	/* cb->args[0]: struct session_dump. cb->args[1]: "error reported" */
+	if (cb->args[1])
+		return 0;
+
+	dump = (struct session_dump *)cb->args[0];
+	if (!dump) {
+		error_pool_activate();
+		dump = session_dump_alloc(cb);
+		if (IS_ERR(dump)) {
+			cb->args[1] = true;
+			error = jdump_put_error(skb, cb, PTR_ERR(dump));
+			error_pool_deactivate();
+			return error;
+		}
+		error_pool_deactivate();
+		cb->args[0] = (long)dump;
+		__log_debug(&dump->jool, "Dumping sessions to userspace.");
+	}
+
+	hdr = jdump_put_hdr(skb, cb);
+	if (!hdr)
+		return -EMSGSIZE;
+	initial_len = skb->len;
+
+	while (dump->batch_next < dump->batch_len || !dump->done) {
+		if (dump->batch_next == dump->batch_len) {
+			error = refill_batch(dump);
+			if (error) {
+				genlmsg_cancel(skb, hdr);
+				return error;
+			}
+			continue;
+		}
+
+		if (jnla_put_session(skb, JNLAL_ENTRY,
+				&dump->batch[dump->batch_next]))
+			break; /* Packet full; resume on the next call. */
+		dump->batch_next++;
+	}
+
+	if (skb->len == initial_len) {
+		genlmsg_cancel(skb, hdr);
+		if (dump->done)
+			return 0;
+		report_put_failure();
+		return -EMSGSIZE;
+	}
+
+	genlmsg_end(skb, hdr);
+	return skb->len;
+}
+
+int handle_session_dump_done(struct netlink_callback *cb)
+{
+	struct session_dump *dump;
+
+	dump = (struct session_dump *)cb->args[0];
+	if (dump) {
+		request_handle_end(&dump->jool);
+		wkfree(struct session_dump, dump);
+	}
+
+	return 0;
+}
@@ -4,5 +4,8 @@
 #include <net/genetlink.h>
 
 int handle_session_foreach(struct sk_buff *skb, struct genl_info *info);
+int handle_session_dump(struct sk_buff *skb, struct netlink_callback *cb);
+int handle_session_dump_done(struct netlink_callback *cb);
+int handle_session_top(struct sk_buff *skb, struct genl_info *info);
 
 #endif /* SRC_MOD_COMMON_NL_SESSION_H_ */
@@ -1,10 +1,19 @@
 #include "mod/common/nl/stats.h"
 
+#include "common/xlat.h"
+#include "mod/common/joold.h"
 #include "mod/common/log.h"
 #include "mod/common/stats.h"
+#include "mod/common/db/bib/db.h"
+#include "mod/common/db/pool4/db.h"
 #include "mod/common/nl/attribute.h"
 #include "mod/common/nl/nl_common.h"
 #include "mod/common/nl/nl_core.h"
+#include "mod/common/nl/nl_handler.h"
+
+/* Worst case (keyframe) size of a stats push's attributes. */
+#define PUSH_SIZE (nla_total_size(sizeof(__u32)) + nla_total_size(0) \
+		+ nla_total_size(JSTAT_COUNT * nla_total_size_64bit(sizeof(__u64))))
 
 int handle_stats_foreach(struct sk_buff *skb, struct genl_info *info)
 {
@@ -67,3 +76,164 @@ revert_start:
 	request_handle_end(&jool);
 	return error;
 }
+
+int handle_stats_latency(struct sk_buff *skb, struct genl_info *info)
+{
+	struct xlator jool;
+	struct jool_latency *latency;
+	struct jool_response response;
+	int error;
+
+	error = request_handle_start(info, XT_ANY, &jool, false);
+	if (error)
+		return jresponse_send_simple(NULL, info, error);
+
+	__log_debug(&jool, "Returning latency histograms.");
+
+	latency = jstat_latency_query(jool.stats);
+	if (!latency) {
+		error = -ENOMEM;
+		goto revert_start;
+	}
+
+	error = jresponse_init(&response, info);
+	if (error)
+		goto revert_query;
+
+	error = nla_put(response.skb, JNLAR_LATENCY, sizeof(*latency), latency);
+	if (error)
+		goto revert_response;
+
+	kfree(latency);
+	request_handle_end(&jool);
+	return jresponse_send(&response);
+
+revert_response:
+	report_put_failure();
+	jresponse_cleanup(&response);
+revert_query:
+	kfree(latency);
+revert_start:
+	error = jresponse_send_simple(&jool, info, error);
+	request_handle_end(&jool);
+	return error;
+}
+
+int handle_stats_locks(struct sk_buff *skb, struct genl_info *info)
+{
+	struct xlator jool;
+	struct jool_locks locks;
+	struct jool_response response;
+	int error;
+
+	error = request_handle_start(info, XT_NAT64, &jool, false);
+	if (error)
+		return jresponse_send_simple(NULL, info, error);
+
+	__log_debug(&jool, "Returning lock statistics.");
+
+	bib_lockstat_query(jool.nat64.bib, &locks);
+	pool4db_lockstat_query(jool.nat64.pool4, &locks.classes[JLOCK_POOL4]);
+	joold_lockstat_query(jool.nat64.joold, &locks.classes[JLOCK_JOOLD]);
+
+	error = jresponse_init(&response, info);
+	if (error)
+		goto revert_start;
+
+	error = nla_put(response.skb, JNLAR_LOCKS, sizeof(locks), &locks);
+	if (error)
+		goto revert_response;
+
+	request_handle_end(&jool);
+	return jresponse_send(&response);
+
+revert_response:
+	report_put_failure();
+	jresponse_cleanup(&response);
+revert_start:
+	error = jresponse_send_simple(&jool, info, error);
+	request_handle_end(&jool);
+	return error;
+}
+
+/**
+ * Sends @jool's stats to the JOOLNL_STATS_GRP_NAME multicast group, if
+ * stats-push-interval says it's time. Meant to be called by the timer, once per
+ * second.
+ *
+ * The message carries a JNLAR_STATS_SEQ, a JNLAR_STATS_KEYFRAME if it's a
+ * keyframe, and a JNLAR_STATS_DELTAS, which contains the counters in the same
+ * format as the JNLOP_STATS_FOREACH response. (See jstat_push_tick().)
+ */
+void jstat_push(struct xlator *jool)
+{
+	struct sk_buff *skb;
+	struct joolnlhdr *jhdr;
+	struct nlattr *root;
+	enum jool_stat_id id;
+	unsigned int written;
+	__u64 value;
+	__u32 seq;
+	bool keyframe;
+
+	if (!jool->globals.stats_push_interval)
+		return;
+	if (!jstat_push_tick(jool->stats, jool->globals.stats_push_interval,
+			&seq, &keyframe))
+		return;
+
+	/* (The deltas keep accumulating, so failing here loses nothing.) */
+	skb = genlmsg_new(PUSH_SIZE, GFP_ATOMIC);
+	if (!skb)
+		return;
+
+	jhdr = genlmsg_put(skb, 0, 0, jnl_family(), 0, 0);
+	if (WARN(!jhdr, "genlmsg_put() returned NULL"))
+		goto revert_skb;
+
+	memset(jhdr, 0, sizeof(*jhdr));
+	memcpy(jhdr->magic, JOOLNL_HDR_MAGIC, JOOLNL_HDR_MAGIC_LEN);
+	jhdr->version = cpu_to_be32(xlat_version());
+	jhdr->xt = xlator_get_type(jool);
+	memcpy(jhdr->iname, jool->iname, INAME_MAX_SIZE);
+
+	if (WARN(nla_put_u32(skb, JNLAR_STATS_SEQ, seq), "Push too small"))
+		goto revert_skb;
+	if (keyframe && WARN(nla_put_flag(skb, JNLAR_STATS_KEYFRAME),
+			"Push too small"))
+		goto revert_skb;
+	root = nla_nest_start(skb, JNLAR_STATS_DELTAS);
+	if (WARN(!root, "Push too small"))
+		goto revert_skb;
+
+	written = 0;
+	for (id = 1; id <= JSTAT_UNKNOWN; id++) {
+		value = jstat_push_value(jool->stats, id, keyframe);
+		if (!keyframe && !value)
+			continue;
+		if (WARN(nla_put_u64_64bit(skb, id, value, JSTAT_PADDING),
+				"Push too small"))
+			goto abort;
+		written++;
+	}
+
+	if (!written) {
+		/* Nothing changed; don't bother. */
+		kfree_skb(skb);
+		return;
+	}
+
+	nla_nest_end(skb, root);
+	genlmsg_end(skb, jhdr);
+	jstat_push_commit(jool->stats);
+
+	/* -ESRCH means nobody is listening, which is fine. */
+	genlmsg_multicast_netns(jnl_family(), jool->ns, skb, 0,
+			JNL_MCGRP_STATS, GFP_ATOMIC);
+	return;
+
+abort:
+	jstat_push_abort(jool->stats);
+revert_skb:
+	kfree_skb(skb);
+}
@@ -2,7 +2,12 @@
 #define SRC_MOD_COMMON_NL_STATS_H_
 
 #include <net/genetlink.h>
+#include "mod/common/xlator.h"
 
 int handle_stats_foreach(struct sk_buff *jool, struct genl_info *info);
+int handle_stats_latency(struct sk_buff *jool, struct genl_info *info);
+int handle_stats_locks(struct sk_buff *jool, struct genl_info *info);
+
+void jstat_push(struct xlator *jool);
 
 #endif /* SRC_MOD_COMMON_NL_STATS_H_ */
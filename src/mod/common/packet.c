@@ -29,6 +29,11 @@ struct pkt_metadata {
 	unsigned int l4_offset;
 	/* Offset is from skb->data. */
 	unsigned int payload_offset;
+
+	/* IPv6 only. Offset is from skb->data. Zero if there's no routing hdr */
+	unsigned int rthdr_offset;
+	/* IPv6 only. Last nexthdr value in the header chain. */
+	__u8 nexthdr;
 };
 
 #define skb_hdr_ptr(skb, offset, buffer) \
@@ -127,75 +132,81 @@ static verdict paranoid_validations(struct xlation *state, size_t min_hdr_size)
 }
 
 /**
- * Walks through @skb's headers, collecting data and adding it to @meta.
+ * Fills the layer 4 fields of @meta; @nexthdr is the last nexthdr from the
+ * chain, and @offset is its header's offset.
+ */
+static verdict summarize_l4_6(struct xlation *state, __u8 nexthdr,
+		unsigned int offset, bool is_first, struct pkt_metadata *meta)
+{
+	struct tcphdr buffer, *ptr;
+
+	meta->nexthdr = nexthdr;
+	meta->l4_offset = offset;
+	meta->payload_offset = offset;
+
+	switch (nexthdr) {
+	case NEXTHDR_TCP:
+		meta->l4_proto = L4PROTO_TCP;
+		if (is_first) {
+			ptr = skb_hdr_ptr(state->in.skb, offset, buffer);
+			if (!ptr)
+				return truncated(state, "TCP header");
+			meta->payload_offset += tcp_hdr_len(ptr);
+		}
+		return VERDICT_CONTINUE;
+
+	case NEXTHDR_UDP:
+		meta->l4_proto = L4PROTO_UDP;
+		if (is_first)
+			meta->payload_offset += sizeof(struct udphdr);
+		return VERDICT_CONTINUE;
+
+	case NEXTHDR_ICMP:
+		meta->l4_proto = L4PROTO_ICMP;
+		if (is_first)
+			meta->payload_offset += sizeof(struct icmp6hdr);
+		return VERDICT_CONTINUE;
+	}
+
+	meta->l4_proto = L4PROTO_OTHER;
+	return VERDICT_CONTINUE;
+}
+
+/**
+ * Walks through @skb's headers (once), collecting data and adding it to @meta.
  *
  * @hdr6_offset number of bytes between skb->data and the IPv6 header.
+ * @nexthdr the IPv6 header's nexthdr field.
  *
  * BTW: You might want to read summarize_skb4() first, since it's a lot simpler.
  */
 static verdict summarize_skb6(struct xlation *state,
-		unsigned int hdr6_offset,
+		unsigned int hdr6_offset, __u8 nexthdr,
 		struct pkt_metadata *meta)
 {
 	union {
 		struct ipv6_opt_hdr opt;
 		struct frag_hdr frag;
-		struct tcphdr tcp;
 	} buffer;
 	union {
 		struct ipv6_opt_hdr *opt;
 		struct frag_hdr *frag;
-		struct tcphdr *tcp;
-		u8 *nexthdr;
 	} ptr;
 
 	struct sk_buff *skb = state->in.skb;
-	u8 nexthdr;
 	unsigned int offset;
 	bool is_first = true;
 
-	ptr.nexthdr = skb_hdr_ptr(skb,
-			hdr6_offset + offsetof(struct ipv6hdr, nexthdr),
-			nexthdr);
-	if (!ptr.nexthdr)
-		return truncated(state, "IPv6 header");
-	nexthdr = *ptr.nexthdr;
 	offset = hdr6_offset + sizeof(struct ipv6hdr);
-
 	meta->fhdr_offset = 0;
+	meta->rthdr_offset = 0;
+
+	/* Fast path: No extension headers. (ie. the vast majority of traffic) */
+	if (likely(!ipv6_ext_hdr(nexthdr)))
+		return summarize_l4_6(state, nexthdr, offset, true, meta);
 
 	do {
 		switch (nexthdr) {
-		case NEXTHDR_TCP:
-			meta->l4_proto = L4PROTO_TCP;
-			meta->l4_offset = offset;
-			meta->payload_offset = offset;
-
-			if (is_first) {
-				ptr.tcp = skb_hdr_ptr(skb, offset, buffer.tcp);
-				if (!ptr.tcp)
-					return truncated(state, "TCP header");
-				meta->payload_offset += tcp_hdr_len(ptr.tcp);
-			}
-
-			return VERDICT_CONTINUE;
-
-		case NEXTHDR_UDP:
-			meta->l4_proto = L4PROTO_UDP;
-			meta->l4_offset = offset;
-			meta->payload_offset = is_first
-					? (offset + sizeof(struct udphdr))
-					: offset;
-			return VERDICT_CONTINUE;
-
-		case NEXTHDR_ICMP:
-			meta->l4_proto = L4PROTO_ICMP;
-			meta->l4_offset = offset;
-			meta->payload_offset = is_first
-					? (offset + sizeof(struct icmp6hdr))
-					: offset;
-			return VERDICT_CONTINUE;
-
 		case NEXTHDR_FRAGMENT:
 			if (meta->fhdr_offset) {
 				log_debug(state, "Double fragment header.");
@@ -227,15 +238,16 @@ static verdict summarize_skb6(struct xlation *state,
 			if (!ptr.opt)
 				return truncated(state, "extension header");
 
+			if (nexthdr == NEXTHDR_ROUTING && !meta->rthdr_offset)
+				meta->rthdr_offset = offset;
+
 			offset += ipv6_optlen(ptr.opt);
 			nexthdr = ptr.opt->nexthdr;
 			break;
 
 		default:
-			meta->l4_proto = L4PROTO_OTHER;
-			meta->l4_offset = offset;
-			meta->payload_offset = offset;
-			return VERDICT_CONTINUE;
+			return summarize_l4_6(state, nexthdr, offset, is_first,
+					meta);
 		}
 	} while (true);
 
@@ -266,7 +278,8 @@ static verdict validate_inner6(struct xlation *state,
 	if (unlikely(ptr.ip6->version != 6))
 		return inhdr6(state, "Version is not 6.");
 
-	result = summarize_skb6(state, outer_meta->payload_offset, &meta);
+	result = summarize_skb6(state, outer_meta->payload_offset,
+			ptr.ip6->nexthdr, &meta);
 	if (result != VERDICT_CONTINUE)
 		return result;
 
@@ -293,6 +306,9 @@ static verdict validate_inner6(struct xlation *state,
 		return truncated(state, "inner headers");
 	}
 
+	state->in.hdrs6.inner_l3hdr_len = meta.l4_offset
+			- outer_meta->payload_offset;
+	state->in.hdrs6.inner_nexthdr = meta.nexthdr;
 	return VERDICT_CONTINUE;
 }
 
@@ -356,7 +372,9 @@ verdict pkt_init_ipv6(struct xlation *state, struct sk_buff *skb)
 	if (skb->len != get_tot_len_ipv6(skb))
 		return inhdr6(state, "Packet size doesn't match the IPv6 header's payload length field.");
 
-	result = summarize_skb6(state, skb_network_offset(skb), &meta);
+	memset(&state->in.hdrs6, 0, sizeof(state->in.hdrs6));
+	result = summarize_skb6(state, skb_network_offset(skb),
+			ipv6_hdr(skb)->nexthdr, &meta);
 	if (result != VERDICT_CONTINUE)
 		return result;
 
@@ -376,6 +394,10 @@ verdict pkt_init_ipv6(struct xlation *state, struct sk_buff *skb)
 	state->in.frag_offset = meta.fhdr_offset;
 	skb_set_transport_header(skb, meta.l4_offset);
 	state->in.payload_offset = meta.payload_offset;
+	state->in.hdrs6.nexthdr = meta.nexthdr;
+	if (meta.rthdr_offset)
+		state->in.hdrs6.rt_offset = meta.rthdr_offset
+				- skb_network_offset(skb);
 	state->in.original_pkt = &state->in;
 
 	return VERDICT_CONTINUE;
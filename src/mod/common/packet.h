@@ -194,6 +194,24 @@ static inline unsigned int tcp_hdr_len(const struct tcphdr *hdr)
  * Do **not** use control buffers (skb->cb) for this purpose. The kernel is
  * known to misbehave and store information there which we should not override.
  */
+/**
+ * The parts of an IPv6 packet's extension header chain Jool cares about,
+ * collected by pkt_init_ipv6() so later steps don't need to walk the chain
+ * again.
+ *
+ * Offsets and lengths are from the network header. Zero means "absent."
+ */
+struct pkt_hdrs6 {
+	/** Offset of the Routing header. */
+	__u16 rt_offset;
+	/** Length of the ICMP error's inner packet's IPv6 header chain. */
+	__u16 inner_l3hdr_len;
+	/** Last nexthdr of the chain. (ie. the actual layer 4 protocol.) */
+	__u8 nexthdr;
+	/** Last nexthdr of the ICMP error's inner packet's chain. */
+	__u8 inner_nexthdr;
+};
+
 struct packet {
 	struct sk_buff *skb;
 	struct tuple tuple;
@@ -229,6 +247,22 @@ struct packet {
 	 * carelessly.
 	 */
 	unsigned int payload_offset;
+	/** IPv6 only; see struct pkt_hdrs6. Only filled on incoming packets. */
+	struct pkt_hdrs6 hdrs6;
+	/**
+	 * Normally NULL; the headers are wherever @skb says they are.
+	 *
+	 * In-place translation (see ttpcomm_in_place_skb()) moves the incoming
+	 * headers towards head, and then turns @skb into the outgoing packet.
+	 * From then on, this points to the moved headers (ie. to what used to
+	 * be skb->data), and @moved_l4_offset and @moved_len remember the rest
+	 * of the layout @skb no longer describes.
+	 */
+	unsigned char *moved_hdrs;
+	/** Offset of the layer-4 header, from @moved_hdrs. */
+	unsigned int moved_l4_offset;
+	/** What skb->len used to be. */
+	unsigned int moved_len;
 	/**
 	 * If this is an incoming packet (as in, incoming to Jool), this points
 	 * to the same packet (pkt->original_pkt = pkt). Otherwise (which
@@ -253,6 +287,7 @@ static inline void pkt_fill(struct packet *pkt, struct sk_buff *skb,
 	/* pkt->is_hairpin = false; */
 	pkt->frag_offset = frag ? ((unsigned char *)frag - skb->data) : 0;
 	pkt->payload_offset = (unsigned char *)payload - skb->data;
+	pkt->moved_hdrs = NULL;
 	pkt->original_pkt = original_pkt;
 }
 
@@ -261,16 +296,47 @@ static inline l3_protocol pkt_l3_proto(const struct packet *pkt)
 	return pkt->l3_proto;
 }
 
+/*
+ * Use these instead of skb->data, skb_network_header(), skb_transport_header()
+ * and skb->len; they also work on packets whose headers were moved.
+ * (See packet.moved_hdrs.)
+ */
+
+static inline unsigned char *pkt_data(const struct packet *pkt)
+{
+	return unlikely(pkt->moved_hdrs) ? pkt->moved_hdrs : pkt->skb->data;
+}
+
+static inline unsigned char *pkt_l3hdr(const struct packet *pkt)
+{
+	/* ttpcomm_in_place_skb() only moves skbs whose network offset is 0. */
+	return unlikely(pkt->moved_hdrs)
+			? pkt->moved_hdrs
+			: skb_network_header(pkt->skb);
+}
+
+static inline unsigned char *pkt_l4hdr(const struct packet *pkt)
+{
+	return unlikely(pkt->moved_hdrs)
+			? (pkt->moved_hdrs + pkt->moved_l4_offset)
+			: skb_transport_header(pkt->skb);
+}
+
+static inline unsigned int pkt_len(const struct packet *pkt)
+{
+	return unlikely(pkt->moved_hdrs) ? pkt->moved_len : pkt->skb->len;
+}
+
 /* l3_proto must be IPv4. */
 static inline struct iphdr *pkt_ip4_hdr(const struct packet *pkt)
 {
-	return ip_hdr(pkt->skb);
+	return (struct iphdr *)pkt_l3hdr(pkt);
 }
 
 /* l3_proto must be IPv6. */
 static inline struct ipv6hdr *pkt_ip6_hdr(const struct packet *pkt)
 {
-	return ipv6_hdr(pkt->skb);
+	return (struct ipv6hdr *)pkt_l3hdr(pkt);
 }
 
 static inline l4_protocol pkt_l4_proto(const struct packet *pkt)
@@ -281,25 +347,25 @@ static inline l4_protocol pkt_l4_proto(const struct packet *pkt)
 /* Incompatible with subsequent fragments, l4_proto must be TCP. */
 static inline struct udphdr *pkt_udp_hdr(const struct packet *pkt)
 {
-	return udp_hdr(pkt->skb);
+	return (struct udphdr *)pkt_l4hdr(pkt);
 }
 
 /* Incompatible with subsequent fragments, l4_proto must be UDP. */
 static inline struct tcphdr *pkt_tcp_hdr(const struct packet *pkt)
 {
-	return tcp_hdr(pkt->skb);
+	return (struct tcphdr *)pkt_l4hdr(pkt);
 }
 
 /* l4_proto must be ICMP. */
 static inline struct icmphdr *pkt_icmp4_hdr(const struct packet *pkt)
 {
-	return icmp_hdr(pkt->skb);
+	return (struct icmphdr *)pkt_l4hdr(pkt);
 }
 
 /* l4_proto must be ICMP. */
 static inline struct icmp6hdr *pkt_icmp6_hdr(const struct packet *pkt)
 {
-	return icmp6_hdr(pkt->skb);
+	return (struct icmp6hdr *)pkt_l4hdr(pkt);
 }
 
 /* l3_proto must be IPv6. */
@@ -307,12 +373,12 @@ static inline struct frag_hdr *pkt_frag_hdr(const struct packet *pkt)
 {
 	if (!pkt->frag_offset)
 		return NULL;
-	return (struct frag_hdr *)(pkt->skb->data + pkt->frag_offset);
+	return (struct frag_hdr *)(pkt_data(pkt) + pkt->frag_offset);
 }
 
 static inline void *pkt_payload(const struct packet *pkt)
 {
-	return pkt->skb->data + pkt->payload_offset;
+	return pkt_data(pkt) + pkt->payload_offset;
 }
 
 static inline bool pkt_is_inner(const struct packet *pkt)
@@ -342,7 +408,7 @@ static inline struct packet *pkt_original_pkt(const struct packet *pkt)
  */
 static inline unsigned int pkt_l3hdr_len(const struct packet *pkt)
 {
-	return skb_transport_header(pkt->skb) - skb_network_header(pkt->skb);
+	return pkt_l4hdr(pkt) - pkt_l3hdr(pkt);
 }
 
 /**
@@ -357,7 +423,7 @@ static inline unsigned int pkt_l3hdr_len(const struct packet *pkt)
  */
 static inline unsigned int pkt_l4hdr_len(const struct packet *pkt)
 {
-	return pkt_payload(pkt) - (void *)skb_transport_header(pkt->skb);
+	return pkt_payload(pkt) - (void *)pkt_l4hdr(pkt);
 }
 
 /**
@@ -387,7 +453,7 @@ static inline unsigned int pkt_hdrs_len(const struct packet *pkt)
  */
 static inline unsigned int pkt_datagram_len(const struct packet *pkt)
 {
-	return pkt->skb->len - pkt_l3hdr_len(pkt);
+	return pkt_len(pkt) - pkt_l3hdr_len(pkt);
 }
 
 static inline bool pkt_is_icmp6_error(const struct packet *pkt)
@@ -7,6 +7,7 @@
 #include "mod/common/log.h"
 #include "mod/common/rfc6052.h"
 #include "mod/common/route.h"
+#include "mod/common/stats.h"
 #include "mod/common/steps/compute_outgoing_tuple.h"
 
 /* Layer 3 only */
@@ -377,6 +378,35 @@ static bool fragment_exceeds_mtu46(struct packet *in, unsigned int mtu)
 	return (out_hdrs_len + out_payload_len) > mtu;
 }
 
+/*
+ * Is @in a TCP GRO super-packet?
+ *
+ * TCP segments are never IP fragments, so if this is true, there is no Fragment
+ * Identification to preserve, and the output device's GSO can be trusted with
+ * any MTU we need.
+ */
+static bool is_tcp_gso(struct packet *in)
+{
+	return skb_is_gso(in->skb)
+			&& (skb_shinfo(in->skb)->gso_type & SKB_GSO_TCPV4)
+			&& !will_need_frag_hdr(pkt_ip4_hdr(in));
+}
+
+/*
+ * Returns the gso_size that will make the output device's GSO cut @in's
+ * translated segments down to @mpl bytes, at most.
+ */
+static unsigned short get_gso_size46(struct packet *in, unsigned int mpl)
+{
+	unsigned int gso_size;
+	unsigned int max_size;
+
+	gso_size = skb_shinfo(in->skb)->gso_size;
+	max_size = mpl - sizeof(struct ipv6hdr) - pkt_l4hdr_len(in);
+
+	return min(gso_size, max_size);
+}
+
 static verdict allocate_fast(struct xlation *state, bool ignore_df,
 		unsigned short gso_size)
 {
@@ -392,14 +422,25 @@ static verdict allocate_fast(struct xlation *state, bool ignore_df,
 	if (delta < 0)
 		delta = 0;
 
-	/* Allocate the outgoing packet as a copy of @in with shared pages. */
-	out = __pskb_copy(in->skb, delta + skb_headroom(in->skb), GFP_ATOMIC);
+	/*
+	 * Reuse @in if nobody else needs it. Otherwise allocate the outgoing
+	 * packet as a copy of @in with shared pages.
+	 */
+	out = ttpcomm_in_place_skb(state, sizeof(struct ipv6hdr)
+			+ (will_need_frag_hdr(pkt_ip4_hdr(in))
+					? sizeof(struct frag_hdr) : 0)
+			+ pkt_l4hdr_len(in));
 	if (!out) {
-		log_debug(state, "__pskb_copy() returned NULL.");
-		return drop(state, JSTAT46_PSKB_COPY);
-	}
+		out = __pskb_copy(in->skb, delta + skb_headroom(in->skb),
+				GFP_ATOMIC);
+		if (!out) {
+			log_debug(state, "__pskb_copy() returned NULL.");
+			return drop(state, JSTAT46_PSKB_COPY);
+		}
 
-	skb_cleanup_copy(out);
+		skb_cleanup_copy(out);
+		jstat_inc(state->jool.stats, JSTAT_XLAT_COPY);
+	}
 
 	/* Remove outer l3 and l4 headers from the copy. */
 	skb_pull(out, pkt_hdrs_len(in));
@@ -447,16 +488,161 @@ static verdict allocate_fast(struct xlation *state, bool ignore_df,
 	out->protocol = htons(ETH_P_IPV6);
 
 	shinfo = skb_shinfo(out);
-	if (shinfo->gso_size && gso_size)
+	if (shinfo->gso_size && gso_size && shinfo->gso_size != gso_size) {
 		shinfo->gso_size = gso_size;
+		/* Make the kernel recompute the segment count. */
+		shinfo->gso_type |= SKB_GSO_DODGY;
+		shinfo->gso_segs = 0;
+	}
 	if (shinfo->gso_type & SKB_GSO_TCPV4) {
-		shinfo->gso_type &= ~SKB_GSO_TCPV4;
+		/* FIXEDID is about the IPv4 Identification; meaningless here */
+		shinfo->gso_type &= ~(SKB_GSO_TCPV4 | SKB_GSO_TCP_FIXEDID);
 		shinfo->gso_type |= SKB_GSO_TCPV6;
 	}
 
 	return VERDICT_CONTINUE;
 }
 
+/*
+ * Appends @page[@offset, @offset + @len) to @skb's paged area. Steals the
+ * caller's reference to @page.
+ */
+static int add_frag(struct sk_buff *skb, struct page *page,
+		unsigned int offset, unsigned int len)
+{
+	int i;
+
+	i = skb_shinfo(skb)->nr_frags;
+	if (i > 0 && skb_can_coalesce(skb, i, page, offset)) {
+		skb_coalesce_rx_frag(skb, i - 1, len, len);
+		put_page(page);
+		return 0;
+	}
+
+	if (i == MAX_SKB_FRAGS) {
+		/* Out of slots; move what we have so far to the head. */
+		if (skb_linearize(skb)) {
+			put_page(page);
+			return -ENOMEM;
+		}
+		i = 0;
+	}
+
+	skb_add_rx_frag(skb, i, page, offset, len, len);
+	return 0;
+}
+
+/*
+ * Appends @len bytes of @from's head area (starting at @offset) to @to's paged
+ * area.
+ */
+static int share_head(struct sk_buff *to, struct sk_buff *from,
+		unsigned int offset, unsigned int len)
+{
+	unsigned char *data;
+	struct page *page;
+	unsigned int chunk;
+	int error;
+
+	data = from->data + offset;
+
+	if (from->head_frag) {
+		page = virt_to_head_page(from->head);
+		get_page(page);
+		return add_frag(to, page, data - (unsigned char *)page_address(page),
+				len);
+	}
+
+	/* kmalloc()'d head; it cannot be referenced, so copy it. */
+	while (len > 0) {
+		chunk = min_t(unsigned int, len, PAGE_SIZE);
+		page = alloc_page(GFP_ATOMIC);
+		if (!page)
+			return -ENOMEM;
+		memcpy(page_address(page), data, chunk);
+		error = add_frag(to, page, 0, chunk);
+		if (error)
+			return error;
+		data += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+/*
+ * Appends @len bytes of @from's data (starting at @offset) to @to's paged area,
+ * by way of page references. This is skb_copy_bits(), except payload is
+ * shared, not copied.
+ */
+static int share_range(struct sk_buff *to, struct sk_buff *from,
+		unsigned int offset, unsigned int len)
+{
+	struct skb_shared_info *shinfo;
+	skb_frag_t *frag;
+	struct sk_buff *iter;
+	unsigned int start;
+	unsigned int end;
+	unsigned int chunk;
+	int i;
+	int error;
+
+	start = skb_headlen(from);
+	if (offset < start) {
+		chunk = min(start - offset, len);
+		error = share_head(to, from, offset, chunk);
+		if (error)
+			return error;
+		offset += chunk;
+		len -= chunk;
+		if (!len)
+			return 0;
+	}
+
+	shinfo = skb_shinfo(from);
+	for (i = 0; i < shinfo->nr_frags; i++) {
+		frag = &shinfo->frags[i];
+		end = start + skb_frag_size(frag);
+		if (offset < end) {
+			chunk = min(end - offset, len);
+			get_page(skb_frag_page(frag));
+			error = add_frag(to, skb_frag_page(frag),
+					skb_frag_off(frag) + offset - start,
+					chunk);
+			if (error)
+				return error;
+			offset += chunk;
+			len -= chunk;
+			if (!len)
+				return 0;
+		}
+		start = end;
+	}
+
+	skb_walk_frags(from, iter) {
+		end = start + iter->len;
+		if (offset < end) {
+			chunk = min(end - offset, len);
+			error = share_range(to, iter, offset - start, chunk);
+			if (error)
+				return error;
+			offset += chunk;
+			len -= chunk;
+			if (!len)
+				return 0;
+		}
+		start = end;
+	}
+
+	return -EFAULT;
+}
+
+/*
+ * Slow Path. Each fragment gets a freshly allocated head, which holds the
+ * IPv6 and fragment headers (plus the L4 header, in the first fragment's case,
+ * since it will be rewritten). The payload is not copied; the fragments'
+ * paged areas reference @in's pages instead.
+ */
 static verdict allocate_slow(struct xlation *state, unsigned int mpl)
 {
 	struct packet *in;
@@ -467,9 +653,11 @@ static verdict allocate_slow(struct xlation *state, unsigned int mpl)
 	unsigned int payload_per_frag;
 	/* Current fragment's layer 3 payload length */
 	unsigned int fragment_payload_len;
+	/* Bytes of the current fragment's payload that go to the head */
+	unsigned int head_len;
 	unsigned int bytes_consumed;
 	struct frag_hdr *frag;
-	unsigned char *l3_payload;
+	unsigned char *l4_hdr;
 
 	in = &state->in;
 	previous = &state->out.skb;
@@ -477,6 +665,10 @@ static verdict allocate_slow(struct xlation *state, unsigned int mpl)
 	payload_per_frag = (mpl - HDRS_LEN) & 0xFFFFFFF8U;
 	bytes_consumed = 0;
 
+	/* Userspace pages must not be shared. */
+	if (skb_orphan_frags_rx(in->skb, GFP_ATOMIC))
+		return drop(state, JSTAT_ENOMEM);
+
 	while (payload_left > 0) {
 		if (payload_left > payload_per_frag) {
 			fragment_payload_len = payload_per_frag;
@@ -486,8 +678,12 @@ static verdict allocate_slow(struct xlation *state, unsigned int mpl)
 			payload_left = 0;
 		}
 
-		out = alloc_skb(skb_headroom(in->skb) + HDRS_LEN
-				+ fragment_payload_len, GFP_ATOMIC);
+		head_len = (bytes_consumed == 0)
+				? min(pkt_l4hdr_len(in), fragment_payload_len)
+				: 0;
+
+		out = alloc_skb(skb_headroom(in->skb) + HDRS_LEN + head_len,
+				GFP_ATOMIC);
 		if (!out)
 			goto fail;
 
@@ -498,28 +694,41 @@ static verdict allocate_slow(struct xlation *state, unsigned int mpl)
 		skb_reset_mac_header(out);
 		skb_reset_network_header(out);
 		skb_put(out, sizeof(struct ipv6hdr));
-		frag = (struct frag_hdr *)skb_put(out, sizeof(struct frag_hdr));
-		l3_payload = skb_put(out, fragment_payload_len);
-
+		skb_put(out, sizeof(struct frag_hdr));
 		skb_set_transport_header(out, HDRS_LEN);
-		if (out == state->out.skb) {
-			pkt_fill(&state->out, out, L3PROTO_IPV6,
-					pkt_l4_proto(in), frag,
-					l3_payload + pkt_l4hdr_len(in),
-					pkt_original_pkt(in));
+
+		/* The L4 header will be rewritten, so it needs its own copy. */
+		l4_hdr = skb_put(out, head_len);
+		if (skb_copy_bits(in->skb,
+				skb_transport_offset(in->skb) + bytes_consumed,
+				l4_hdr, head_len))
+			goto fail;
+		bytes_consumed += head_len;
+		fragment_payload_len -= head_len;
+
+		if (fragment_payload_len) {
+			if (share_range(out, in->skb,
+					skb_transport_offset(in->skb)
+							+ bytes_consumed,
+					fragment_payload_len))
+				goto fail;
+			bytes_consumed += fragment_payload_len;
 		}
 
 		out->ignore_df = false;
 		out->mark = in->skb->mark;
 		out->protocol = htons(ETH_P_IPV6);
-
-		if (skb_copy_bits(in->skb,
-				skb_transport_offset(in->skb) + bytes_consumed,
-				l3_payload, fragment_payload_len))
-			goto fail;
-		bytes_consumed += fragment_payload_len;
 	}
 
+	/* share_range() might have moved the headers, so do this last. */
+	out = state->out.skb;
+	frag = (struct frag_hdr *)(skb_network_header(out)
+			+ sizeof(struct ipv6hdr));
+	pkt_fill(&state->out, out, L3PROTO_IPV6, pkt_l4_proto(in), frag,
+			skb_transport_header(out) + pkt_l4hdr_len(in),
+			pkt_original_pkt(in));
+
+	jstat_inc(state->jool.stats, JSTAT_XLAT_COPY);
 	return VERDICT_CONTINUE;
 
 fail:
@@ -551,8 +760,8 @@ static verdict ttp46_alloc_skb(struct xlation *state)
 	 * - IPL: Ideal (Outgoing) Packet Length
 	 * - MPL: Maximum (allowed) Packet Length
 	 * - LIM: lowest-ipv6-mtu (Configuration option)
-	 * - Slow Path: Out packets will have to be created from scratch, data
-	 *   will have to be copied from In to Out(s)
+	 * - Slow Path: Out packets will have to be created from scratch; their
+	 *   payloads will reference In's pages
 	 * - Fast Path: Out packet will share In packet's fragment and paged
 	 *   data if possible
 	 * - PTB: Packet Too Big (ICMPv6 error type 2 code 0)
@@ -649,14 +858,20 @@ static verdict ttp46_alloc_skb(struct xlation *state)
 	 *
 	 * 2. If fragmentation is allowed, GSO might lead us to translate a
 	 * large DF-disabled IPv4 packet into a large IPv6 packet, so we need to
-	 * impose LIM. If the packet is already fragmented, we need to preserve
-	 * the Fragmentation ID, which AFAIK, is impossible through the kernel
-	 * API. Therefore, Slow Path.
+	 * impose LIM. If the packet is TCP, it was never fragmented, and GSO
+	 * will cut it back into segments of any size we want. So we simply
+	 * shrink gso_size until the IPv6 segments fit LIM, and stay on Fast
+	 * Path. Linearizing or segmenting the super-packet ourselves would
+	 * only throw away the work GRO did.
 	 *
-	 * (Note: GRO enabled on !DF suggests there might exist some potential
-	 * optimization I could be missing somewhere.)
+	 * 3. If fragmentation is allowed and the packet is not TCP (ie. GRO'd
+	 * UDP, or it's already fragmented), changing gso_size would alter the
+	 * datagram boundaries, and we need to preserve the Fragmentation ID,
+	 * which AFAIK, is impossible through the kernel API. Therefore, Slow
+	 * Path.
 	 *
-	 * Therefore: If users want performance, they need to enable DF or GTFO.
+	 * Therefore: Slow Path is only for non-TCP traffic that genuinely
+	 * needs to be fragmented.
 	 *
 	 * # LRO
 	 *
@@ -719,6 +934,14 @@ static verdict ttp46_alloc_skb(struct xlation *state)
 					skb_shinfo(in->skb)->gso_size);
 		}
 
+	} else if (is_tcp_gso(in)) {
+		/*
+		 * Not fragmented, so no Fragmentation ID to preserve either.
+		 * Impose LIM by way of gso_size, and leave segmentation to
+		 * GSO.
+		 */
+		result = allocate_fast(state, false, get_gso_size46(in, mpl));
+
 	} else if (fragment_exceeds_mtu46(in, mpl)) {
 		/*
 		 * Force LIM and Fragmentation ID preservation through manual
@@ -1099,28 +1322,25 @@ static verdict icmp4_to_icmp6_param_prob(struct xlation *state)
 }
 
 /*
- * Removes L4 header, adds L4 header, adds IPv6 pseudoheader.
+ * Replaces the ICMPv4 header with the ICMPv6 header, adds the IPv6
+ * pseudoheader. (ICMP info messages only; the payload does not change.)
  */
-static void update_icmp6_csum(struct xlation *state)
+static __sum16 update_icmp6_csum(struct icmphdr const *in_icmp,
+		struct ipv6hdr const *out_ip6, struct icmp6hdr const *out_icmp,
+		unsigned int datagram_len)
 {
-	struct ipv6hdr *out_ip6 = pkt_ip6_hdr(&state->out);
-	struct icmphdr *in_icmp = pkt_icmp4_hdr(&state->in);
-	struct icmp6hdr *out_icmp = pkt_icmp6_hdr(&state->out);
-	struct icmphdr copy_hdr;
+	__be16 const *in_words = (__be16 const *)in_icmp;
+	__be16 const *out_words = (__be16 const *)out_icmp;
 	__wsum csum;
 
-	out_icmp->icmp6_cksum = 0;
-
 	csum = ~csum_unfold(in_icmp->checksum);
+	/* Type and code */
+	csum = wsum_replace16(csum, in_words[0], out_words[0]);
+	/* Identifier and sequence number */
+	csum = wsum_replace32(csum, in_icmp->icmp4_unused,
+			out_icmp->icmp6_dataun.un_data32[0]);
 
-	memcpy(&copy_hdr, in_icmp, sizeof(*in_icmp));
-	copy_hdr.checksum = 0;
-	csum = csum_sub(csum, csum_partial(&copy_hdr, sizeof(copy_hdr), 0));
-
-	csum = csum_add(csum, csum_partial(out_icmp, sizeof(*out_icmp), 0));
-
-	out_icmp->icmp6_cksum = csum_ipv6_magic(&out_ip6->saddr,
-			&out_ip6->daddr, pkt_datagram_len(&state->in),
+	return csum_ipv6_magic(&out_ip6->saddr, &out_ip6->daddr, datagram_len,
 			IPPROTO_ICMPV6, csum);
 }
 
@@ -1293,7 +1513,9 @@ static verdict ttp46_icmp(struct xlation *state)
 				? cpu_to_be16(state->out.tuple.icmp6_id)
 				: icmpv4_hdr->un.echo.id;
 		icmpv6_hdr->icmp6_sequence = icmpv4_hdr->un.echo.sequence;
-		update_icmp6_csum(state);
+		icmpv6_hdr->icmp6_cksum = update_icmp6_csum(icmpv4_hdr,
+				pkt_ip6_hdr(&state->out), icmpv6_hdr,
+				pkt_datagram_len(&state->in));
 		return VERDICT_CONTINUE;
 
 	case ICMP_DEST_UNREACH:
@@ -1359,29 +1581,26 @@ static __sum16 skb_list_csum(struct sk_buff *out, __u8 proto)
 }
 
 /**
- * Removes the IPv4 pseudoheader and L4 header, adds the IPv6 pseudoheader and
- * L4 header. Input and result are folded.
+ * Replaces the IPv4 pseudoheader with the IPv6 pseudoheader, and @in_l4_hdr's
+ * ports with @out_l4_hdr's. Input and result are folded.
+ *
+ * This is an RFC 1624 incremental update. Nothing else in the TCP/UDP header
+ * changes, and the pseudoheaders' length and protocol weigh the same in both
+ * families.
  */
 static __sum16 update_csum_4to6(__sum16 csum16,
-		struct iphdr *in_ip4, void *in_l4_hdr,
-		struct ipv6hdr *out_ip6, void *out_l4_hdr,
-		size_t l4_hdr_len)
+		struct iphdr const *in_ip4, void const *in_l4_hdr,
+		struct ipv6hdr const *out_ip6, void const *out_l4_hdr)
 {
-	__wsum csum, pseudohdr_csum;
-
-	/* See comments at update_csum_6to4(). */
+	__wsum csum;
 
 	csum = ~csum_unfold(csum16);
 
-	pseudohdr_csum = csum_tcpudp_nofold(in_ip4->saddr, in_ip4->daddr,
-			0, 0, 0);
-	csum = csum_sub(csum, pseudohdr_csum);
-	csum = csum_sub(csum, csum_partial(in_l4_hdr, l4_hdr_len, 0));
-
-	pseudohdr_csum = ~csum_unfold(csum_ipv6_magic(&out_ip6->saddr,
-			&out_ip6->daddr, 0, 0, 0));
-	csum = csum_add(csum, pseudohdr_csum);
-	csum = csum_add(csum, csum_partial(out_l4_hdr, l4_hdr_len, 0));
+	csum = csum_sub(csum, (__force __wsum)in_ip4->saddr);
+	csum = csum_sub(csum, (__force __wsum)in_ip4->daddr);
+	csum = wsum_add_addr6(csum, &out_ip6->saddr);
+	csum = wsum_add_addr6(csum, &out_ip6->daddr);
+	csum = wsum_replace_ports(csum, in_l4_hdr, out_l4_hdr);
 
 	return csum_fold(csum);
 }
@@ -1428,7 +1647,6 @@ static verdict ttp46_tcp(struct xlation *state)
 	struct packet *out = &state->out;
 	struct tcphdr *tcp_in = pkt_tcp_hdr(in);
 	struct tcphdr *tcp_out = pkt_tcp_hdr(out);
-	struct tcphdr tcp_copy;
 
 	/* Header */
 	memcpy(tcp_out, tcp_in, pkt_l4hdr_len(in));
@@ -1439,14 +1657,9 @@ static verdict ttp46_tcp(struct xlation *state)
 
 	/* Header.checksum */
 	if (in->skb->ip_summed != CHECKSUM_PARTIAL) {
-		memcpy(&tcp_copy, tcp_in, sizeof(*tcp_in));
-		tcp_copy.check = 0;
-
-		tcp_out->check = 0;
 		tcp_out->check = update_csum_4to6(tcp_in->check,
-				pkt_ip4_hdr(in), &tcp_copy,
-				pkt_ip6_hdr(out), tcp_out,
-				sizeof(*tcp_out));
+				pkt_ip4_hdr(in), tcp_in,
+				pkt_ip6_hdr(out), tcp_out);
 
 	} else if (out->skb->next) {
 		tcp_out->check = 0;
@@ -1468,7 +1681,6 @@ static verdict ttp46_udp(struct xlation *state)
 	struct packet *out = &state->out;
 	struct udphdr *udp_in = pkt_udp_hdr(in);
 	struct udphdr *udp_out = pkt_udp_hdr(out);
-	struct udphdr udp_copy;
 
 	/* Header */
 	memcpy(udp_out, udp_in, pkt_l4hdr_len(in));
@@ -1486,14 +1698,12 @@ static verdict ttp46_udp(struct xlation *state)
 				ICMPERR_FILTER, 0);
 
 	} else if (in->skb->ip_summed != CHECKSUM_PARTIAL) {
-		memcpy(&udp_copy, udp_in, sizeof(*udp_in));
-		udp_copy.check = 0;
-
-		udp_out->check = 0;
 		udp_out->check = update_csum_4to6(udp_in->check,
-				pkt_ip4_hdr(in), &udp_copy,
-				pkt_ip6_hdr(out), udp_out,
-				sizeof(*udp_out));
+				pkt_ip4_hdr(in), udp_in,
+				pkt_ip6_hdr(out), udp_out);
+		/* Zero means "no checksum" in IPv4, and is illegal in IPv6. */
+		if (udp_out->check == 0)
+			udp_out->check = CSUM_MANGLED_0;
 
 	} else if (out->skb->next) {
 		udp_out->check = 0;
@@ -5,10 +5,10 @@
 #include <net/udp.h>
 #include <net/tcp.h>
 
-#include "mod/common/ipv6_hdr_iterator.h"
 #include "mod/common/linux_version.h"
 #include "mod/common/log.h"
 #include "mod/common/route.h"
+#include "mod/common/stats.h"
 #include "mod/common/steps/compute_outgoing_tuple.h"
 
 static __u8 xlat_tos(struct jool_globals const *config, struct ipv6hdr const *hdr)
@@ -19,13 +19,14 @@ static __u8 xlat_tos(struct jool_globals const *config, struct ipv6hdr const *hd
 /**
  * One-liner for creating the IPv4 header's Protocol field.
  */
-static __u8 xlat_proto(struct ipv6hdr const *hdr6)
+static __u8 xlat_proto(struct packet const *in)
 {
-	struct hdr_iterator iterator = HDR_ITERATOR_INIT(hdr6);
-	hdr_iterator_last(&iterator);
-	return (iterator.hdr_type == NEXTHDR_ICMP)
-			? IPPROTO_ICMP
-			: iterator.hdr_type;
+	__u8 nexthdr;
+
+	nexthdr = pkt_is_inner(in)
+			? in->hdrs6.inner_nexthdr
+			: in->hdrs6.nexthdr;
+	return (nexthdr == NEXTHDR_ICMP) ? IPPROTO_ICMP : nexthdr;
 }
 
 static verdict xlat64_external_addresses(struct xlation *state)
@@ -205,7 +206,7 @@ static verdict compute_flowix64(struct xlation *state)
 	flow4->flowi4_mark = state->in.skb->mark;
 	flow4->flowi4_tos = xlat_tos(&state->jool.globals, hdr6);
 	flow4->flowi4_scope = RT_SCOPE_UNIVERSE;
-	flow4->flowi4_proto = xlat_proto(hdr6);
+	flow4->flowi4_proto = xlat_proto(&state->in);
 	/*
 	 * ANYSRC disables the source address reachable validation.
 	 * It's best to include it because none of the xlat addresses are
@@ -457,27 +458,30 @@ static verdict ttp64_alloc_skb(struct xlation *state)
 	 * tail area without knowing it. (I'm reading the Linux 4.4 code.)
 	 *
 	 * We will therefore *not* attempt to allocate less.
+	 *
+	 * Better yet, if nobody else needs @in, simply reuse it.
 	 */
 
-	out = pskb_copy(in->skb, GFP_ATOMIC);
+	out = ttpcomm_in_place_skb(state,
+			sizeof(struct iphdr) + pkt_l4hdr_len(in));
 	if (!out) {
-		log_debug(state, "pskb_copy() returned NULL.");
-		result = drop(state, JSTAT64_PSKB_COPY);
-		goto revert;
-	}
+		out = pskb_copy(in->skb, GFP_ATOMIC);
+		if (!out) {
+			log_debug(state, "pskb_copy() returned NULL.");
+			result = drop(state, JSTAT64_PSKB_COPY);
+			goto revert;
+		}
 
-	skb_cleanup_copy(out);
+		skb_cleanup_copy(out);
+		jstat_inc(state->jool.stats, JSTAT_XLAT_COPY);
+	}
 
 	/* Remove outer l3 and l4 headers from the copy. */
 	skb_pull(out, pkt_hdrs_len(in));
 
 	if (is_first_frag6(pkt_frag_hdr(in)) && pkt_is_icmp6_error(in)) {
-		struct ipv6hdr *hdr = pkt_payload(in);
-		struct hdr_iterator iterator = HDR_ITERATOR_INIT(hdr);
-		hdr_iterator_last(&iterator);
-
 		/* Remove inner l3 headers from the copy. */
-		skb_pull(out, iterator.data - (void *)hdr);
+		skb_pull(out, in->hdrs6.inner_l3hdr_len);
 
 		/* Add inner l3 headers to the copy. */
 		skb_push(out, sizeof(struct iphdr));
@@ -589,28 +593,27 @@ static __be16 xlat_frag_off(struct frag_hdr const *hdr_frag,
 }
 
 /**
- * has_nonzero_segments_left - Returns true if @hdr6's packet has a routing
- * header, and its Segments Left field is not zero.
+ * has_nonzero_segments_left - Returns true if @in has a routing header, and
+ * its Segments Left field is not zero.
  *
  * @location: if the packet has nonzero segments left, the offset
- *		of the segments left field (from the start of @hdr6) will be
- *		stored here.
+ *		of the segments left field (from the start of the IPv6 header)
+ *		will be stored here.
  */
-static bool has_nonzero_segments_left(struct ipv6hdr const *hdr6,
+static bool has_nonzero_segments_left(struct packet const *in,
 		__u32 *location)
 {
 	struct ipv6_rt_hdr const *rt_hdr;
-	unsigned int offset;
 
-	rt_hdr = hdr_iterator_find(hdr6, NEXTHDR_ROUTING);
-	if (!rt_hdr)
+	if (!in->hdrs6.rt_offset)
 		return false;
 
+	rt_hdr = (void *)pkt_ip6_hdr(in) + in->hdrs6.rt_offset;
 	if (rt_hdr->segments_left == 0)
 		return false;
 
-	offset = ((void *)rt_hdr) - (void *)hdr6;
-	*location = offset + offsetof(struct ipv6_rt_hdr, segments_left);
+	*location = in->hdrs6.rt_offset
+			+ offsetof(struct ipv6_rt_hdr, segments_left);
 	return true;
 }
 
@@ -633,7 +636,7 @@ static verdict ttp64_ipv4_external(struct xlation *state)
 		log_debug(state, "Packet's hop limit <= 1.");
 		return drop_icmp(state, JSTAT64_TTL, ICMPERR_TTL, 0);
 	}
-	if (has_nonzero_segments_left(hdr6, &nonzero_location)) {
+	if (has_nonzero_segments_left(&state->in, &nonzero_location)) {
 		log_debug(state, "Packet's segments left field is nonzero.");
 		return drop_icmp(state, JSTAT64_SEGMENTS_LEFT,
 				ICMPERR_HDR_FIELD, nonzero_location);
@@ -679,7 +682,7 @@ static verdict ttp64_ipv4_internal(struct xlation *state)
 	generate_ipv4_id(state, hdr4, hdr_frag);
 	hdr4->frag_off = xlat_frag_off(hdr_frag, state);
 	hdr4->ttl = hdr6->hop_limit;
-	hdr4->protocol = xlat_proto(hdr6);
+	hdr4->protocol = xlat_proto(in);
 	hdr4->saddr = state->flowx.v4.inner_src.s_addr;
 	hdr4->daddr = state->flowx.v4.inner_dst.s_addr;
 	hdr4->check = 0;
@@ -812,38 +815,28 @@ static verdict icmp6_to_icmp4_param_prob(struct xlation *state)
  * Use this when only the ICMP header changed, so all there is to do is subtract
  * the old data from the checksum and add the new one.
  */
-static void update_icmp4_csum(struct xlation const *state)
+static __sum16 update_icmp4_csum(struct ipv6hdr const *in_ip6,
+		struct icmp6hdr const *in_icmp, struct icmphdr const *out_icmp,
+		unsigned int datagram_len)
 {
-	struct ipv6hdr const *in_ip6 = pkt_ip6_hdr(&state->in);
-	struct icmp6hdr const *in_icmp = pkt_icmp6_hdr(&state->in);
-	struct icmphdr *out_icmp = pkt_icmp4_hdr(&state->out);
-	struct icmp6hdr copy_hdr;
+	__be16 const *in_words = (__be16 const *)in_icmp;
+	__be16 const *out_words = (__be16 const *)out_icmp;
 	__wsum csum, tmp;
 
 	csum = ~csum_unfold(in_icmp->icmp6_cksum);
 
-	/* Remove the ICMPv6 pseudo-header. */
+	/* Remove the ICMPv6 pseudo-header. There's no ICMPv4 pseudo-header. */
 	tmp = ~csum_unfold(csum_ipv6_magic(&in_ip6->saddr, &in_ip6->daddr,
-			pkt_datagram_len(&state->in), NEXTHDR_ICMP, 0));
+			datagram_len, NEXTHDR_ICMP, 0));
 	csum = csum_sub(csum, tmp);
 
-	/*
-	 * Remove the ICMPv6 header.
-	 * I'm working on a copy because I need to zero out its checksum.
-	 * If I did that directly on the skb, I'd need to make it writable
-	 * first.
-	 */
-	memcpy(&copy_hdr, in_icmp, sizeof(*in_icmp));
-	copy_hdr.icmp6_cksum = 0;
-	tmp = csum_partial(&copy_hdr, sizeof(copy_hdr), 0);
-	csum = csum_sub(csum, tmp);
+	/* Type and code */
+	csum = wsum_replace16(csum, in_words[0], out_words[0]);
+	/* Identifier and sequence number */
+	csum = wsum_replace32(csum, in_icmp->icmp6_dataun.un_data32[0],
+			out_icmp->icmp4_unused);
 
-	/* Add the ICMPv4 header. There's no ICMPv4 pseudo-header. */
-	out_icmp->checksum = 0;
-	tmp = csum_partial(out_icmp, sizeof(*out_icmp), 0);
-	csum = csum_add(csum, tmp);
-
-	out_icmp->checksum = csum_fold(csum);
+	return csum_fold(csum);
 }
 
 /**
@@ -1009,7 +1002,9 @@ static verdict ttp64_icmp(struct xlation *state)
 				? cpu_to_be16(state->out.tuple.icmp4_id)
 				: icmpv6_hdr->icmp6_identifier;
 		icmpv4_hdr->un.echo.sequence = icmpv6_hdr->icmp6_sequence;
-		update_icmp4_csum(state);
+		icmpv4_hdr->checksum = update_icmp4_csum(
+				pkt_ip6_hdr(&state->in), icmpv6_hdr, icmpv4_hdr,
+				pkt_datagram_len(&state->in));
 		return VERDICT_CONTINUE;
 
 	case ICMPV6_DEST_UNREACH:
@@ -1057,19 +1052,16 @@ static __be16 get_dst_port64(struct xlation *state)
 			: cpu_to_be16(state->out.tuple.dst.addr4.l4);
 }
 
-static __wsum pseudohdr6_csum(struct ipv6hdr const *hdr)
-{
-	return ~csum_unfold(csum_ipv6_magic(&hdr->saddr, &hdr->daddr, 0, 0, 0));
-}
-
-static __wsum pseudohdr4_csum(struct iphdr const *hdr)
-{
-	return csum_tcpudp_nofold(hdr->saddr, hdr->daddr, 0, 0, 0);
-}
-
+/**
+ * Replaces the IPv6 pseudoheader with the IPv4 pseudoheader, and @in_l4_hdr's
+ * ports with @out_l4_hdr's. Input and result are folded.
+ *
+ * This is an RFC 1624 incremental update. Nothing else in the TCP/UDP header
+ * changes.
+ */
 static __sum16 update_csum_6to4(__sum16 csum16,
-		struct ipv6hdr const *in_ip6, void const *in_l4_hdr, size_t in_l4_hdr_len,
-		struct iphdr const *out_ip4, void const *out_l4_hdr, size_t out_l4_hdr_len)
+		struct ipv6hdr const *in_ip6, void const *in_l4_hdr,
+		struct iphdr const *out_ip4, void const *out_l4_hdr)
 {
 	__wsum csum;
 
@@ -1079,18 +1071,14 @@ static __sum16 update_csum_6to4(__sum16 csum16,
 	 * Regarding the pseudoheaders:
 	 * The length is pretty hard to obtain if there's TCP and fragmentation,
 	 * and whatever it is, it's not going to change. Therefore, instead of
-	 * computing it only to cancel it out with itself later, simply sum
-	 * (and substract) zero.
+	 * computing it only to cancel it out with itself later, leave it alone.
 	 * Do the same with proto since we're feeling ballsy.
 	 */
-
-	/* Remove the IPv6 stuff. */
-	csum = csum_sub(csum, pseudohdr6_csum(in_ip6));
-	csum = csum_sub(csum, csum_partial(in_l4_hdr, in_l4_hdr_len, 0));
-
-	/* Add the IPv4 stuff. */
-	csum = csum_add(csum, pseudohdr4_csum(out_ip4));
-	csum = csum_add(csum, csum_partial(out_l4_hdr, out_l4_hdr_len, 0));
+	csum = wsum_sub_addr6(csum, &in_ip6->saddr);
+	csum = wsum_sub_addr6(csum, &in_ip6->daddr);
+	csum = csum_add(csum, (__force __wsum)out_ip4->saddr);
+	csum = csum_add(csum, (__force __wsum)out_ip4->daddr);
+	csum = wsum_replace_ports(csum, in_l4_hdr, out_l4_hdr);
 
 	return csum_fold(csum);
 }
@@ -1101,7 +1089,6 @@ static verdict ttp64_tcp(struct xlation *state)
 	struct packet *out = &state->out;
 	struct tcphdr const *tcp_in = pkt_tcp_hdr(in);
 	struct tcphdr *tcp_out = pkt_tcp_hdr(out);
-	struct tcphdr tcp_copy;
 
 	/* Header */
 	memcpy(tcp_out, tcp_in, pkt_l4hdr_len(in));
@@ -1112,13 +1099,9 @@ static verdict ttp64_tcp(struct xlation *state)
 
 	/* Header.checksum */
 	if (in->skb->ip_summed != CHECKSUM_PARTIAL) {
-		memcpy(&tcp_copy, tcp_in, sizeof(*tcp_in));
-		tcp_copy.check = 0;
-
-		tcp_out->check = 0;
 		tcp_out->check = update_csum_6to4(tcp_in->check,
-				pkt_ip6_hdr(in), &tcp_copy, sizeof(tcp_copy),
-				pkt_ip4_hdr(out), tcp_out, sizeof(*tcp_out));
+				pkt_ip6_hdr(in), tcp_in,
+				pkt_ip4_hdr(out), tcp_out);
 		out->skb->ip_summed = CHECKSUM_NONE;
 
 	} else {
@@ -1137,7 +1120,6 @@ static verdict ttp64_udp(struct xlation *state)
 	struct packet *out = &state->out;
 	struct udphdr const *udp_in = pkt_udp_hdr(in);
 	struct udphdr *udp_out = pkt_udp_hdr(out);
-	struct udphdr udp_copy;
 
 	/* Header */
 	memcpy(udp_out, udp_in, pkt_l4hdr_len(in));
@@ -1148,13 +1130,9 @@ static verdict ttp64_udp(struct xlation *state)
 
 	/* Header.checksum */
 	if (in->skb->ip_summed != CHECKSUM_PARTIAL) {
-		memcpy(&udp_copy, udp_in, sizeof(*udp_in));
-		udp_copy.check = 0;
-
-		udp_out->check = 0;
 		udp_out->check = update_csum_6to4(udp_in->check,
-				pkt_ip6_hdr(in), &udp_copy, sizeof(udp_copy),
-				pkt_ip4_hdr(out), udp_out, sizeof(*udp_out));
+				pkt_ip6_hdr(in), udp_in,
+				pkt_ip4_hdr(out), udp_out);
 		if (udp_out->check == 0)
 			udp_out->check = CSUM_MANGLED_0;
 		out->skb->ip_summed = CHECKSUM_NONE;
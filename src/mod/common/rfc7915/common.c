@@ -2,7 +2,6 @@
 
 #include <linux/icmp.h>
 #include "common/config.h"
-#include "mod/common/ipv6_hdr_iterator.h"
 #include "mod/common/linux_version.h"
 #include "mod/common/log.h"
 #include "mod/common/packet.h"
@@ -99,14 +98,10 @@ static int move_pointers4(struct packet *in, struct packet *out, bool do_out)
 
 static int move_pointers6(struct packet *in, struct packet *out, bool do_out)
 {
-	struct ipv6hdr *hdr6 = pkt_payload(in);
-	struct hdr_iterator iterator = HDR_ITERATOR_INIT(hdr6);
 	int error;
 
-	hdr_iterator_last(&iterator);
-
-	error = move_pointers_in(in, iterator.hdr_type,
-			iterator.data - (void *)hdr6);
+	error = move_pointers_in(in, in->hdrs6.inner_nexthdr,
+			in->hdrs6.inner_l3hdr_len);
 	if (error)
 		return error;
 
@@ -420,3 +415,150 @@ void skb_cleanup_copy(struct sk_buff *skb)
 	skb->tstamp = 0;
 #endif
 }
+
+/*
+ * Can @state's incoming skb also become its outgoing skb?
+ */
+static bool can_xlat_in_place(struct xlation *state)
+{
+	struct packet *in = &state->in;
+
+	/* Hairpinned packets still belong to the previous translation. */
+	if (pkt_original_pkt(in) != in)
+		return false;
+
+	/*
+	 * TCP and UDP translation only reads the incoming headers, which we
+	 * can save. ICMP checksum translation reads the payload, and ICMP
+	 * errors also modify it.
+	 */
+	switch (pkt_l4_proto(in)) {
+	case L4PROTO_TCP:
+	case L4PROTO_UDP:
+		break;
+	default:
+		return false;
+	}
+
+	return !skb_shared(in->skb) && skb_network_offset(in->skb) == 0;
+}
+
+/**
+ * Prepares @state's incoming skb so it can be reused as the outgoing packet,
+ * whose l3 and l4 headers will measure @out_hdrs_len bytes.
+ *
+ * The translation steps read the incoming headers while they write the
+ * outgoing ones, and both sets would occupy the same area. So the incoming
+ * headers are moved towards the head, out of the way, and @state->in's
+ * accessors are told where they went. (See packet.moved_hdrs.)
+ *
+ * The caller must then skb_pull() the incoming headers and skb_push() the
+ * outgoing ones from the returned skb, just as it would on a copy.
+ *
+ * Returns NULL if the packet cannot be translated in place. (In which case
+ * nothing was done, and the caller should copy it instead.)
+ */
+struct sk_buff *ttpcomm_in_place_skb(struct xlation *state,
+		unsigned int out_hdrs_len)
+{
+	struct packet *in = &state->in;
+	struct sk_buff *skb = in->skb;
+	struct xlation_in_place *bkp = &state->in_place;
+	struct skb_shared_info *shinfo;
+
+	if (!can_xlat_in_place(state))
+		return NULL;
+	/* Also unshares the head, if it was cloned. */
+	if (skb_cow_head(skb, out_hdrs_len))
+		return NULL;
+
+	/* The outgoing packet will need its own dst; keep the original. */
+	skb_dst_force(skb);
+	bkp->dst = skb_dst(skb);
+	skb_dst_set(skb, NULL);
+
+	shinfo = skb_shinfo(skb);
+	bkp->shift = out_hdrs_len;
+	bkp->headroom = skb_headroom(skb);
+	bkp->l2_offset = skb_mac_header_was_set(skb) ? skb_mac_offset(skb) : -1;
+	bkp->l3_offset = skb_network_offset(skb);
+	bkp->l4_offset = skb_transport_offset(skb);
+	bkp->protocol = skb->protocol;
+	bkp->mark = skb->mark;
+	bkp->ignore_df = skb->ignore_df;
+	bkp->ip_summed = skb->ip_summed;
+	bkp->csum = skb->csum;
+	memcpy(bkp->cb, skb->cb, sizeof(bkp->cb));
+	bkp->gso_size = shinfo->gso_size;
+	bkp->gso_segs = shinfo->gso_segs;
+	bkp->gso_type = shinfo->gso_type;
+
+	memmove(skb->data - out_hdrs_len, skb->data, pkt_hdrs_len(in));
+	in->moved_hdrs = skb->data - out_hdrs_len;
+	in->moved_l4_offset = skb_transport_offset(skb);
+	in->moved_len = skb->len;
+
+	bkp->active = true;
+
+	jstat_inc(state->jool.stats, JSTAT_XLAT_IN_PLACE);
+	return skb;
+}
+
+/**
+ * Releases the original skb's leftovers, once the in-place translation has
+ * succeeded.
+ */
+void ttpcomm_in_place_commit(struct xlation *state)
+{
+	dst_release(state->in_place.dst);
+	state->in_place.dst = NULL;
+	/*
+	 * Unlike the copy, this one needed to wait, because it drops the
+	 * conntrack reference.
+	 */
+	skb_cleanup_copy(state->out.skb);
+}
+
+/**
+ * Undoes ttpcomm_in_place_skb() (and whatever the translation steps did to the
+ * skb afterwards), so the incoming packet can be replied or returned to the
+ * kernel.
+ */
+void ttpcomm_in_place_revert(struct xlation *state)
+{
+	struct packet *in = &state->in;
+	struct sk_buff *skb = in->skb;
+	struct xlation_in_place *bkp = &state->in_place;
+	struct skb_shared_info *shinfo;
+
+	skb_dst_drop(skb);
+	skb_dst_set(skb, bkp->dst);
+	bkp->dst = NULL;
+
+	memmove(in->moved_hdrs + bkp->shift, in->moved_hdrs, pkt_hdrs_len(in));
+	in->moved_hdrs = NULL;
+
+	if (skb_headroom(skb) > bkp->headroom)
+		skb_push(skb, skb_headroom(skb) - bkp->headroom);
+	else
+		skb_pull(skb, bkp->headroom - skb_headroom(skb));
+	if (bkp->l2_offset != -1)
+		skb_set_mac_header(skb, bkp->l2_offset);
+	skb_set_network_header(skb, bkp->l3_offset);
+	skb_set_transport_header(skb, bkp->l4_offset);
+
+	skb->protocol = bkp->protocol;
+	skb->mark = bkp->mark;
+	skb->ignore_df = bkp->ignore_df;
+	skb->ip_summed = bkp->ip_summed;
+	skb->csum = bkp->csum;
+	memcpy(skb->cb, bkp->cb, sizeof(bkp->cb));
+
+	shinfo = skb_shinfo(skb);
+	shinfo->gso_size = bkp->gso_size;
+	shinfo->gso_segs = bkp->gso_segs;
+	shinfo->gso_type = bkp->gso_type;
+
+	bkp->active = false;
+	state->out.skb = NULL;
+}
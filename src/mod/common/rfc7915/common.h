@@ -1,7 +1,9 @@
 #ifndef SRC_MOD_COMMON_RFC7915_COMMON_H_
 #define SRC_MOD_COMMON_RFC7915_COMMON_H_
 
+#include <linux/in6.h>
 #include <linux/ip.h>
+#include <net/checksum.h>
 #include "common/types.h"
 #include "mod/common/packet.h"
 #include "mod/common/translation_state.h"
@@ -32,6 +34,11 @@ struct translation_steps {
 	 *
 	 * There's also the issue that the incoming packet might not have enough
 	 * room for the header length expansion from v4 to v6.
+	 *
+	 * That said, when the packet is TCP or UDP and nobody else holds a
+	 * reference to it, we *do* override its headers, after moving the
+	 * original ones to the headroom so they can be restored if something
+	 * fails. See ttpcomm_in_place_skb().
 	 */
 	skb_alloc_fn skb_alloc;
 	/** The function that will translate the external IP header. */
@@ -50,6 +57,55 @@ struct translation_steps {
 	header_xlat_fn xlat_icmp;
 };
 
+/*
+ * RFC 1624 incremental checksum update helpers.
+ *
+ * They operate on unfolded sums. Each value weighs the same as it does in the
+ * header it was read from, so they only need to be 16-bit aligned there.
+ */
+
+static inline __wsum wsum_replace16(__wsum csum, __be16 old, __be16 new)
+{
+	csum = csum_sub(csum, (__force __wsum)(__force u16)old);
+	return csum_add(csum, (__force __wsum)(__force u16)new);
+}
+
+static inline __wsum wsum_replace32(__wsum csum, __be32 old, __be32 new)
+{
+	csum = csum_sub(csum, (__force __wsum)old);
+	return csum_add(csum, (__force __wsum)new);
+}
+
+static inline __wsum wsum_add_addr6(__wsum csum, struct in6_addr const *addr)
+{
+	csum = csum_add(csum, (__force __wsum)addr->s6_addr32[0]);
+	csum = csum_add(csum, (__force __wsum)addr->s6_addr32[1]);
+	csum = csum_add(csum, (__force __wsum)addr->s6_addr32[2]);
+	return csum_add(csum, (__force __wsum)addr->s6_addr32[3]);
+}
+
+static inline __wsum wsum_sub_addr6(__wsum csum, struct in6_addr const *addr)
+{
+	csum = csum_sub(csum, (__force __wsum)addr->s6_addr32[0]);
+	csum = csum_sub(csum, (__force __wsum)addr->s6_addr32[1]);
+	csum = csum_sub(csum, (__force __wsum)addr->s6_addr32[2]);
+	return csum_sub(csum, (__force __wsum)addr->s6_addr32[3]);
+}
+
+/*
+ * Source and destination ports are the only TCP/UDP header fields translation
+ * changes, and both headers start with them.
+ */
+static inline __wsum wsum_replace_ports(__wsum csum, void const *old_l4_hdr,
+		void const *new_l4_hdr)
+{
+	__be16 const *old_ports = old_l4_hdr;
+	__be16 const *new_ports = new_l4_hdr;
+
+	csum = wsum_replace16(csum, old_ports[0], new_ports[0]);
+	return wsum_replace16(csum, old_ports[1], new_ports[1]);
+}
+
 void partialize_skb(struct sk_buff *skb, __u16 csum_offset);
 bool will_need_frag_hdr(const struct iphdr *hdr);
 verdict ttpcomm_translate_inner_packet(struct xlation *state,
@@ -99,4 +155,9 @@ verdict handle_icmp_extension(struct xlation *state,
 
 void skb_cleanup_copy(struct sk_buff *skb);
 
+struct sk_buff *ttpcomm_in_place_skb(struct xlation *state,
+		unsigned int out_hdrs_len);
+void ttpcomm_in_place_commit(struct xlation *state);
+void ttpcomm_in_place_revert(struct xlation *state);
+
 #endif /* SRC_MOD_COMMON_RFC7915_COMMON_H_ */
@@ -90,11 +90,17 @@ verdict translating_the_packet(struct xlation *state)
 			goto revert;
 	}
 
+	if (state->in_place.active)
+		ttpcomm_in_place_commit(state);
+
 	if (xlation_is_nat64(state))
 		log_debug(state, "Done step 4.");
 	return VERDICT_CONTINUE;
 
 revert:
-	__kfree_skb_list(state);
+	if (state->in_place.active)
+		ttpcomm_in_place_revert(state);
+	else
+		__kfree_skb_list(state);
 	return result;
 }
@@ -5,6 +5,12 @@
 #include <net/flow.h>
 #include "mod/common/xlator.h"
 
+struct route_cache;
+
+struct route_cache *rtcache_alloc(void);
+void rtcache_get(struct route_cache *cache);
+void rtcache_put(struct route_cache *cache);
+
 /* Wrappers for the kernel's routing functions. */
 struct dst_entry *route4(struct xlator *jool, struct flowi4 *flow);
 struct dst_entry *route6(struct xlator *jool, struct flowi6 *flow);
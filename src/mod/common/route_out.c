@@ -1,10 +1,266 @@
 #include "mod/common/route.h"
 
+#include <linux/jhash.h>
+#include <linux/kref.h>
+#include <linux/percpu.h>
+#include <linux/random.h>
+#include <net/ip6_fib.h>
 #include <net/ip6_route.h>
 #include <net/route.h>
 #include "mod/common/log.h"
+#include "mod/common/tracepoints.h"
+#include "mod/common/wkmalloc.h"
 
-struct dst_entry *route4(struct xlator *jool, struct flowi4 *flow)
+/*
+ * Route cache.
+ *
+ * Most translated packets belong to established flows, whose routes almost
+ * never change. So instead of querying the FIB for every packet, each CPU
+ * remembers the last routes it found, indexed by the fields of the flow that
+ * can affect routing.
+ *
+ * Cached routes are revalidated through dst_check() before they are used.
+ * (IPv4 routes are invalidated by the routing table's generation ID, IPv6
+ * routes by the fib6 serial number captured in the cookie.)
+ */
+
+/* Per CPU, per family. Must be a power of two. */
+#define RTCACHE_SLOTS 256
+
+/* Everything in flowi4 route4() cares about, minus the outputs. */
+struct rtcache_key4 {
+	__be32 saddr;
+	__be32 daddr;
+	/* Or ICMP type and code */
+	__be16 sport;
+	__be16 dport;
+	__u32 mark;
+	int oif;
+	__u8 tos;
+	__u8 proto;
+	__u8 scope;
+	__u8 flags;
+};
+
+struct rtcache_key6 {
+	struct in6_addr saddr;
+	struct in6_addr daddr;
+	__be16 sport;
+	__be16 dport;
+	__u32 mark;
+	int oif;
+	__be32 flowlabel;
+	__u8 proto;
+	__u8 flags;
+};
+
+struct rtcache_entry4 {
+	struct rtcache_key4 key;
+	struct dst_entry *dst;
+};
+
+struct rtcache_entry6 {
+	struct rtcache_key6 key;
+	u32 cookie;
+	struct dst_entry *dst;
+};
+
+struct rtcache_table {
+	struct rtcache_entry4 v4[RTCACHE_SLOTS];
+	struct rtcache_entry6 v6[RTCACHE_SLOTS];
+};
+
+struct route_cache {
+	struct rtcache_table __percpu *tables;
+	u32 seed;
+	struct kref refcounter;
+};
+
+struct route_cache *rtcache_alloc(void)
+{
+	struct route_cache *result;
+
+	result = wkmalloc(struct route_cache, GFP_KERNEL);
+	if (!result)
+		return NULL;
+
+	result->tables = alloc_percpu(struct rtcache_table);
+	if (!result->tables) {
+		wkfree(struct route_cache, result);
+		return NULL;
+	}
+	get_random_bytes(&result->seed, sizeof(result->seed));
+	kref_init(&result->refcounter);
+
+	return result;
+}
+
+void rtcache_get(struct route_cache *cache)
+{
+	kref_get(&cache->refcounter);
+}
+
+static void rtcache_release(struct kref *refcount)
+{
+	struct route_cache *cache;
+	struct rtcache_table *table;
+	unsigned int cpu;
+	unsigned int i;
+
+	cache = container_of(refcount, struct route_cache, refcounter);
+
+	for_each_possible_cpu(cpu) {
+		table = per_cpu_ptr(cache->tables, cpu);
+		for (i = 0; i < RTCACHE_SLOTS; i++) {
+			if (table->v4[i].dst)
+				dst_release(table->v4[i].dst);
+			if (table->v6[i].dst)
+				dst_release(table->v6[i].dst);
+		}
+	}
+
+	free_percpu(cache->tables);
+	wkfree(struct route_cache, cache);
+}
+
+void rtcache_put(struct route_cache *cache)
+{
+	kref_put(&cache->refcounter, rtcache_release);
+}
+
+static void init_key4(struct rtcache_key4 *key, struct flowi4 const *flow)
+{
+	memset(key, 0, sizeof(*key));
+	key->saddr = flow->saddr;
+	key->daddr = flow->daddr;
+	key->sport = flow->fl4_sport;
+	key->dport = flow->fl4_dport;
+	key->mark = flow->flowi4_mark;
+	key->oif = flow->flowi4_oif;
+	key->tos = flow->flowi4_tos;
+	key->proto = flow->flowi4_proto;
+	key->scope = flow->flowi4_scope;
+	key->flags = flow->flowi4_flags;
+}
+
+static void init_key6(struct rtcache_key6 *key, struct flowi6 const *flow)
+{
+	memset(key, 0, sizeof(*key));
+	key->saddr = flow->saddr;
+	key->daddr = flow->daddr;
+	key->sport = flow->fl6_sport;
+	key->dport = flow->fl6_dport;
+	key->mark = flow->flowi6_mark;
+	key->oif = flow->flowi6_oif;
+	key->flowlabel = flow->flowlabel;
+	key->proto = flow->flowi6_proto;
+	key->flags = flow->flowi6_flags;
+}
+
+static struct rtcache_entry4 *get_entry4(struct route_cache *cache,
+		struct rtcache_key4 const *key)
+{
+	u32 hash;
+
+	hash = jhash_3words((__force u32)key->saddr, (__force u32)key->daddr,
+			((__force u32)key->sport << 16) | (__force u32)key->dport,
+			cache->seed ^ key->mark);
+	return &this_cpu_ptr(cache->tables)->v4[hash & (RTCACHE_SLOTS - 1)];
+}
+
+static struct rtcache_entry6 *get_entry6(struct route_cache *cache,
+		struct rtcache_key6 const *key)
+{
+	u32 hash;
+
+	hash = jhash2((u32 const *)key, sizeof(*key) / sizeof(u32),
+			cache->seed);
+	return &this_cpu_ptr(cache->tables)->v6[hash & (RTCACHE_SLOTS - 1)];
+}
+
+/* Returns a new reference to the cached route, or NULL. */
+static struct dst_entry *rtcache_find4(struct route_cache *cache,
+		struct rtcache_key4 const *key)
+{
+	struct rtcache_entry4 *entry;
+	struct dst_entry *dst;
+
+	local_bh_disable();
+
+	entry = get_entry4(cache, key);
+	dst = entry->dst;
+	if (!dst || memcmp(&entry->key, key, sizeof(*key))) {
+		dst = NULL;
+	} else if (!dst_check(dst, 0)) {
+		dst_release(dst);
+		entry->dst = NULL;
+		dst = NULL;
+	} else {
+		dst_hold(dst);
+	}
+
+	local_bh_enable();
+	return dst;
+}
+
+static void rtcache_add4(struct route_cache *cache,
+		struct rtcache_key4 const *key, struct dst_entry *dst)
+{
+	struct rtcache_entry4 *entry;
+
+	local_bh_disable();
+
+	entry = get_entry4(cache, key);
+	if (entry->dst)
+		dst_release(entry->dst);
+	entry->key = *key;
+	entry->dst = dst_clone(dst);
+
+	local_bh_enable();
+}
+
+static struct dst_entry *rtcache_find6(struct route_cache *cache,
+		struct rtcache_key6 const *key)
+{
+	struct rtcache_entry6 *entry;
+	struct dst_entry *dst;
+
+	local_bh_disable();
+
+	entry = get_entry6(cache, key);
+	dst = entry->dst;
+	if (!dst || memcmp(&entry->key, key, sizeof(*key))) {
+		dst = NULL;
+	} else if (!dst_check(dst, entry->cookie)) {
+		dst_release(dst);
+		entry->dst = NULL;
+		dst = NULL;
+	} else {
+		dst_hold(dst);
+	}
+
+	local_bh_enable();
+	return dst;
+}
+
+static void rtcache_add6(struct route_cache *cache,
+		struct rtcache_key6 const *key, struct dst_entry *dst)
+{
+	struct rtcache_entry6 *entry;
+
+	local_bh_disable();
+
+	entry = get_entry6(cache, key);
+	if (entry->dst)
+		dst_release(entry->dst);
+	entry->key = *key;
+	entry->cookie = rt6_get_cookie((struct rt6_info *)dst);
+	entry->dst = dst_clone(dst);
+
+	local_bh_enable();
+}
+
+static struct dst_entry *__route4(struct xlator *jool, struct flowi4 *flow)
 {
 	struct rtable *table;
 	struct dst_entry *dst;
@@ -17,6 +273,7 @@ struct dst_entry *route4(struct xlator *jool, struct flowi4 *flow)
 	if (!table || IS_ERR(table)) {
 		__log_debug(jool, "__ip_route_output_key() returned %ld. Cannot route packet.",
 				PTR_ERR(table));
+		trace_jool_route4_fail(jool, flow);
 		return NULL;
 	}
 
@@ -37,25 +294,81 @@ struct dst_entry *route4(struct xlator *jool, struct flowi4 *flow)
 
 revert:
 	dst_release(dst);
+	trace_jool_route4_fail(jool, flow);
 	return NULL;
 }
 
-struct dst_entry *route6(struct xlator *jool, struct flowi6 *flow)
+struct dst_entry *route4(struct xlator *jool, struct flowi4 *flow)
+{
+	struct rtcache_key4 key;
+	struct dst_entry *dst;
+
+	/*
+	 * Zero source means the caller wants the kernel to choose one, which
+	 * is an output the cache does not remember.
+	 */
+	if (!flow->saddr)
+		return __route4(jool, flow);
+
+	/* The lookup modifies @flow, so compute the key first. */
+	init_key4(&key, flow);
+	dst = rtcache_find4(jool->rtcache, &key);
+	if (dst) {
+		jstat_inc(jool->stats, JSTAT_ROUTE_CACHE_HIT);
+		__log_debug(jool, "Packet routed via device '%s'. (Cached)",
+				dst->dev->name);
+		return dst;
+	}
+
+	jstat_inc(jool->stats, JSTAT_ROUTE_CACHE_MISS);
+	dst = __route4(jool, flow);
+	if (dst)
+		rtcache_add4(jool->rtcache, &key, dst);
+	return dst;
+}
+
+static struct dst_entry *__route6(struct xlator *jool, struct flowi6 *flow)
 {
 	struct dst_entry *dst;
 
 	dst = ip6_route_output(jool->ns, NULL, flow);
 	if (!dst) {
 		__log_debug(jool, "ip6_route_output() returned NULL. Cannot route packet.");
+		trace_jool_route6_fail(jool, flow);
 		return NULL;
 	}
 	if (dst->error) {
 		__log_debug(jool, "ip6_route_output() returned error %d. Cannot route packet.",
 				dst->error);
 		dst_release(dst);
+		trace_jool_route6_fail(jool, flow);
 		return NULL;
 	}
 
 	__log_debug(jool, "Packet routed via device '%s'.", dst->dev->name);
 	return dst;
 }
+
+struct dst_entry *route6(struct xlator *jool, struct flowi6 *flow)
+{
+	struct rtcache_key6 key;
+	struct dst_entry *dst;
+
+	if (ipv6_addr_any(&flow->saddr))
+		return __route6(jool, flow);
+
+	init_key6(&key, flow);
+	dst = rtcache_find6(jool->rtcache, &key);
+	if (dst) {
+		jstat_inc(jool->stats, JSTAT_ROUTE_CACHE_HIT);
+		__log_debug(jool, "Packet routed via device '%s'. (Cached)",
+				dst->dev->name);
+		return dst;
+	}
+
+	jstat_inc(jool->stats, JSTAT_ROUTE_CACHE_MISS);
+	dst = __route6(jool, flow);
+	if (dst)
+		rtcache_add6(jool->rtcache, &key, dst);
+	return dst;
+}
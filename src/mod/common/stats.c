@@ -1,5 +1,6 @@
 #include "mod/common/stats.h"
 
+#include <linux/bitops.h>
 #include <linux/kref.h>
 #include <net/ip.h>
 #include <net/snmp.h>
@@ -9,11 +10,33 @@ struct jool_mib {
 	unsigned long mibs[JSTAT_COUNT];
 };
 
+/*
+ * Stats push state. (See jstat_push_tick().)
+ * Only the stats timer touches it, so it doesn't need a lock.
+ */
+struct jool_push {
+	/* The values the previous push's deltas added up to. */
+	__u64 last[JSTAT_COUNT];
+	/* Seconds since the previous push. */
+	unsigned int ticks;
+	/* Sequence number of the next push. */
+	__u32 seq;
+};
+
+struct jool_iterations {
+	struct jool_mask_iterations protos[JITER_PROTO_COUNT];
+};
+
 struct jool_stats {
 	DEFINE_SNMP_STAT(struct jool_mib, mib);
+	struct jool_latency __percpu *latency;
+	struct jool_iterations __percpu *iterations;
+	struct jool_push push;
 	struct kref refcounter;
 };
 
+DEFINE_STATIC_KEY_FALSE(jstat_latency_key);
+
 struct jool_stats *jstat_alloc(void)
 {
 	struct jool_stats *result;
@@ -23,13 +46,26 @@ struct jool_stats *jstat_alloc(void)
 		return NULL;
 
 	result->mib = alloc_percpu(struct jool_mib);
-	if (!result->mib) {
-		wkfree(struct jool_stats, result);
-		return NULL;
-	}
+	if (!result->mib)
+		goto mib_fail;
+	result->latency = alloc_percpu(struct jool_latency);
+	if (!result->latency)
+		goto latency_fail;
+	result->iterations = alloc_percpu(struct jool_iterations);
+	if (!result->iterations)
+		goto iterations_fail;
+	memset(&result->push, 0, sizeof(result->push));
 	kref_init(&result->refcounter);
 
 	return result;
+
+iterations_fail:
+	free_percpu(result->latency);
+latency_fail:
+	free_percpu(result->mib);
+mib_fail:
+	wkfree(struct jool_stats, result);
+	return NULL;
 }
 
 void jstat_get(struct jool_stats *stats)
@@ -42,6 +78,8 @@ static void jstat_release(struct kref *refcount)
 	struct jool_stats *stats;
 	stats = container_of(refcount, struct jool_stats, refcounter);
 
+	free_percpu(stats->iterations);
+	free_percpu(stats->latency);
 	free_percpu(stats->mib);
 	wkfree(struct jool_stats, stats);
 }
@@ -85,6 +123,181 @@ __u64 *jstat_query(struct jool_stats *stats)
 	return result;
 }
 
+/**
+ * Called by the stats timer once per second. Returns whether it's time to push
+ * @stats. If so, also returns the push's sequence number and whether it has to
+ * be a keyframe.
+ *
+ * Keyframes carry every counter, while the other pushes only carry the counters
+ * that changed. Sequence numbers let the listener notice lost pushes, after
+ * which it needs to wait for the next keyframe.
+ */
+bool jstat_push_tick(struct jool_stats *stats, unsigned int interval,
+		__u32 *seq, bool *keyframe)
+{
+	struct jool_push *push = &stats->push;
+
+	push->ticks++;
+	if (push->ticks < interval)
+		return false;
+
+	push->ticks = 0;
+	*seq = push->seq;
+	*keyframe = (push->seq % JSTAT_PUSH_KEYFRAME) == 0;
+	return true;
+}
+
+/**
+ * Returns the value the current push should carry for @id, and assumes it will
+ * be pushed.
+ *
+ * In keyframes, this is the counter's value. Otherwise, it's how much the
+ * counter changed since the previous push. (Unsigned wraparound makes deltas
+ * work for gauges too.)
+ */
+__u64 jstat_push_value(struct jool_stats *stats, enum jool_stat_id id,
+		bool keyframe)
+{
+	__u64 current_value;
+	__u64 delta;
+
+	current_value = snmp_fold_field(stats->mib, id);
+	delta = current_value - stats->push.last[id];
+	stats->push.last[id] = current_value;
+
+	return keyframe ? current_value : delta;
+}
+
+/**
+ * Forgets the push that jstat_push_tick() announced. (The deltas that were
+ * computed in the meantime are lost, so the next push has to be a keyframe.)
+ */
+void jstat_push_abort(struct jool_stats *stats)
+{
+	stats->push.seq = 0;
+}
+
+/**
+ * Records that the push announced by jstat_push_tick() was sent.
+ */
+void jstat_push_commit(struct jool_stats *stats)
+{
+	stats->push.seq++;
+}
+
+void jstat_latency_enable(void)
+{
+	static_branch_inc(&jstat_latency_key);
+}
+
+void jstat_latency_disable(void)
+{
+	static_branch_dec(&jstat_latency_key);
+}
+
+/**
+ * Records that the @stage stage of a @dir translation took @ns nanoseconds.
+ */
+void jstat_latency_add(struct jool_stats *stats, enum jool_latency_dir dir,
+		enum jool_latency_stage stage, __u64 ns)
+{
+	unsigned int bucket;
+
+	bucket = ns ? (fls64(ns) - 1) : 0;
+	if (bucket >= JLAT_BUCKETS)
+		bucket = JLAT_BUCKETS - 1;
+
+	this_cpu_inc(stats->latency->buckets[dir][stage][bucket]);
+}
+
+/**
+ * Returns the sum of every CPU's histograms. You will have to free it.
+ */
+struct jool_latency *jstat_latency_query(struct jool_stats *stats)
+{
+	struct jool_latency *result;
+	struct jool_latency *cpu_latency;
+	unsigned int cpu, d, s, b;
+
+	result = kzalloc(sizeof(*result), GFP_KERNEL);
+	if (!result)
+		return NULL;
+
+	for_each_possible_cpu(cpu) {
+		cpu_latency = per_cpu_ptr(stats->latency, cpu);
+		for (d = 0; d < JLAT_DIR_COUNT; d++)
+			for (s = 0; s < JLAT_STAGE_COUNT; s++)
+				for (b = 0; b < JLAT_BUCKETS; b++)
+					result->buckets[d][s][b] +=
+						cpu_latency->buckets[d][s][b];
+	}
+
+	return result;
+}
+
+/**
+ * Records that a transport address allocation (for a @proto BIB entry) tried
+ * @iterations pool4 candidates. @success is whether one of them was available.
+ *
+ * Has to be called with bottom halves disabled. (ie. with the BIB table's lock
+ * held.)
+ */
+void jstat_iterations_add(struct jool_stats *stats, l4_protocol proto,
+		unsigned int iterations, bool success)
+{
+	struct jool_mask_iterations *counters;
+	unsigned int bucket;
+
+	if (WARN(proto >= JITER_PROTO_COUNT, "Unknown protocol: %u", proto))
+		return;
+
+	counters = &this_cpu_ptr(stats->iterations)->protos[proto];
+
+	if (success)
+		counters->successes++;
+	else
+		counters->failures++;
+	counters->total += iterations;
+	if (iterations > counters->max)
+		counters->max = iterations;
+
+	bucket = iterations ? (fls(iterations) - 1) : 0;
+	if (bucket >= JITER_BUCKETS)
+		bucket = JITER_BUCKETS - 1;
+	counters->buckets[bucket]++;
+}
+
+/**
+ * Returns the sum of every CPU's iteration counters. (One per protocol.) You
+ * will have to free it.
+ */
+struct jool_mask_iterations *jstat_iterations_query(struct jool_stats *stats)
+{
+	struct jool_mask_iterations *result;
+	struct jool_mask_iterations *src, *dst;
+	unsigned int cpu, p, b;
+
+	result = kcalloc(JITER_PROTO_COUNT, sizeof(*result), GFP_KERNEL);
+	if (!result)
+		return NULL;
+
+	for_each_possible_cpu(cpu) {
+		for (p = 0; p < JITER_PROTO_COUNT; p++) {
+			src = &per_cpu_ptr(stats->iterations, cpu)->protos[p];
+			dst = &result[p];
+			dst->successes += src->successes;
+			dst->failures += src->failures;
+			dst->total += src->total;
+			if (src->max > dst->max)
+				dst->max = src->max;
+			for (b = 0; b < JITER_BUCKETS; b++)
+				dst->buckets[b] += src->buckets[b];
+		}
+	}
+
+	return result;
+}
+
 #ifdef UNIT_TESTING
 int jstat_refcount(struct jool_stats *stats)
 {
@@ -1,6 +1,7 @@
 #ifndef SRC_MOD_COMMON_STATS_H_
 #define SRC_MOD_COMMON_STATS_H_
 
+#include <linux/jump_label.h>
 #include "common/stats.h"
 #include "mod/common/packet.h"
 
@@ -16,6 +17,34 @@ void jstat_add(struct jool_stats *stats, enum jool_stat_id stat, int addend);
 
 __u64 *jstat_query(struct jool_stats *stats);
 
+/* One in every JSTAT_PUSH_KEYFRAME stat pushes carries every counter. */
+#define JSTAT_PUSH_KEYFRAME 16
+
+bool jstat_push_tick(struct jool_stats *stats, unsigned int interval,
+		__u32 *seq, bool *keyframe);
+__u64 jstat_push_value(struct jool_stats *stats, enum jool_stat_id id,
+		bool keyframe);
+void jstat_push_abort(struct jool_stats *stats);
+void jstat_push_commit(struct jool_stats *stats);
+
+/*
+ * Latency histograms.
+ *
+ * The key is enabled while at least one instance has latency-histograms
+ * enabled, so the timing code is patched out of the packet path otherwise.
+ */
+DECLARE_STATIC_KEY_FALSE(jstat_latency_key);
+
+void jstat_latency_enable(void);
+void jstat_latency_disable(void);
+void jstat_latency_add(struct jool_stats *stats, enum jool_latency_dir dir,
+		enum jool_latency_stage stage, __u64 ns);
+struct jool_latency *jstat_latency_query(struct jool_stats *stats);
+
+void jstat_iterations_add(struct jool_stats *stats, l4_protocol proto,
+		unsigned int iterations, bool success);
+struct jool_mask_iterations *jstat_iterations_query(struct jool_stats *stats);
+
 #ifdef UNIT_TESTING
 int jstat_refcount(struct jool_stats *stats);
 #endif
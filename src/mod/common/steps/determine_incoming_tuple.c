@@ -1,7 +1,6 @@
 #include "mod/common/steps/determine_incoming_tuple.h"
 
 #include "mod/common/icmp_wrapper.h"
-#include "mod/common/ipv6_hdr_iterator.h"
 #include "mod/common/log.h"
 #include "mod/common/stats.h"
 
@@ -199,7 +198,7 @@ static verdict ipv6_icmp_err(struct xlation *state)
 {
 	struct packet *pkt = &state->in;
 	struct tuple *tuple6 = &pkt->tuple;
-	struct hdr_iterator iterator;
+	void const *inner_l4;
 	union {
 		struct ipv6hdr const *ip6;
 		struct udphdr const *udp;
@@ -212,26 +211,25 @@ static verdict ipv6_icmp_err(struct xlation *state)
 	tuple6->src.addr6.l3 = inner.ip6->daddr;
 	tuple6->dst.addr6.l3 = inner.ip6->saddr;
 
-	hdr_iterator_init(&iterator, inner.ip6);
-	hdr_iterator_last(&iterator);
+	inner_l4 = (void const *)inner.ip6 + pkt->hdrs6.inner_l3hdr_len;
 
-	switch (iterator.hdr_type) {
+	switch (pkt->hdrs6.inner_nexthdr) {
 	case NEXTHDR_UDP:
-		inner.udp = iterator.data;
+		inner.udp = inner_l4;
 		tuple6->src.addr6.l4 = be16_to_cpu(inner.udp->dest);
 		tuple6->dst.addr6.l4 = be16_to_cpu(inner.udp->source);
 		tuple6->l4_proto = L4PROTO_UDP;
 		break;
 
 	case NEXTHDR_TCP:
-		inner.tcp = iterator.data;
+		inner.tcp = inner_l4;
 		tuple6->src.addr6.l4 = be16_to_cpu(inner.tcp->dest);
 		tuple6->dst.addr6.l4 = be16_to_cpu(inner.tcp->source);
 		tuple6->l4_proto = L4PROTO_TCP;
 		break;
 
 	case NEXTHDR_ICMP:
-		inner.icmp = iterator.data;
+		inner.icmp = inner_l4;
 
 		if (is_icmp6_error(inner.icmp->icmp6_type)) {
 			log_debug(state, "Bogus pkt: ICMP error inside ICMP error.");
@@ -245,7 +243,7 @@ static verdict ipv6_icmp_err(struct xlation *state)
 		break;
 
 	default:
-		return unknown_inner_proto(state, iterator.hdr_type);
+		return unknown_inner_proto(state, pkt->hdrs6.inner_nexthdr);
 	}
 
 	tuple6->l3_proto = L3PROTO_IPV6;
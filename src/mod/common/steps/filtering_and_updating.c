@@ -10,6 +10,7 @@
 
 #include "mod/common/icmp_wrapper.h"
 #include "mod/common/log.h"
+#include "mod/common/natlog.h"
 #include "mod/common/rfc6052.h"
 #include "mod/common/stats.h"
 #include "mod/common/rfc7915/6to4.h"
@@ -93,6 +94,7 @@ static verdict succeed(struct xlation *state)
 	 */
 	if (state->entries.session_set)
 		joold_add(&state->jool, &state->entries.session);
+	natlog_flush(&state->jool);
 
 	return VERDICT_CONTINUE;
 }
@@ -140,6 +142,10 @@ static verdict ipv6_simple(struct xlation *state)
 	switch (error) {
 	case 0:
 		return succeed(state);
+	case -EDQUOT:
+		return drop(state, JSTAT_SESSION_QUOTA);
+	case -ENOMEM:
+		return drop(state, JSTAT_ENOMEM);
 	default:
 		/*
 		 * Error msg already printed, but since bib_add6() sprawls
@@ -5,6 +5,7 @@
 #include "mod/common/steps/send_packet.h"
 #include "mod/common/steps/compute_outgoing_tuple.h"
 #include "mod/common/steps/filtering_and_updating.h"
+#include "mod/common/db/fragdb.h"
 #include "mod/common/db/pool4/db.h"
 
 
@@ -43,6 +44,8 @@ bool is_hairpin_nat64(struct xlation *state)
 verdict handling_hairpinning_nat64(struct xlation *old)
 {
 	struct xlation *new;
+	bool is_frag;
+	bool is_first = true;
 	verdict result;
 
 	log_debug(old, "Step 5: Handling Hairpinning...");
@@ -53,15 +56,23 @@ verdict handling_hairpinning_nat64(struct xlation *old)
 	new->in = old->out;
 	new->is_hairpin = true;
 
-	result = filtering_and_updating(new);
-	if (result != VERDICT_CONTINUE)
-		goto end;
-	result = compute_out_tuple(new);
+	is_frag = fragdb_is_fragment(new, &is_first);
+	if (is_first) {
+		result = filtering_and_updating(new);
+		if (result != VERDICT_CONTINUE)
+			goto end;
+		result = compute_out_tuple(new);
+	} else {
+		/* @new's skb belongs to @old; it cannot be stored. */
+		result = fragdb_find(new, false);
+	}
 	if (result != VERDICT_CONTINUE)
 		goto end;
 	result = translating_the_packet(new);
 	if (result != VERDICT_CONTINUE)
 		goto end;
+	if (is_frag && is_first)
+		fragdb_add(new, NULL);
 	result = sendpkt_send(new);
 	if (result != VERDICT_CONTINUE)
 		goto end;
@@ -3,7 +3,10 @@
 #include "mod/common/linux_version.h"
 #include "mod/common/xlator.h"
 #include "mod/common/joold.h"
+#include "mod/common/natlog.h"
+#include "mod/common/db/fragdb.h"
 #include "mod/common/db/bib/db.h"
+#include "mod/common/nl/stats.h"
 
 /*
  * TODO (performance) We don't cancel the timer much at all; it seems like we
@@ -19,13 +22,18 @@
  */
 
 #define TIMER_PERIOD msecs_to_jiffies(2000)
+/* stats-push-interval is measured in ticks of this timer. */
+#define STATS_TIMER_PERIOD msecs_to_jiffies(1000)
 
 static struct timer_list timer;
+static struct timer_list stats_timer;
 
 static int clean_state(struct xlator *jool, void *args)
 {
 	bib_clean(jool);
+	natlog_clean(jool);
 	joold_clean(jool);
+	fragdb_clean(jool);
 	return 0;
 }
 
@@ -41,6 +49,24 @@ static void timer_function(
 	mod_timer(&timer, jiffies + TIMER_PERIOD);
 }
 
+static int push_stats(struct xlator *jool, void *args)
+{
+	jstat_push(jool);
+	return 0;
+}
+
+static void stats_timer_function(
+#if LINUX_VERSION_AT_LEAST(4, 15, 0, 8, 0)
+		struct timer_list *arg
+#else
+		unsigned long arg
+#endif
+		)
+{
+	xlator_foreach(XT_ANY, push_stats, NULL, NULL);
+	mod_timer(&stats_timer, jiffies + STATS_TIMER_PERIOD);
+}
+
 /**
  * This function should be always called *after* other init()s.
  */
@@ -48,13 +74,19 @@ int jtimer_setup(void)
 {
 #if LINUX_VERSION_AT_LEAST(4, 15, 0, 8, 0)
 	timer_setup(&timer, timer_function, 0);
+	timer_setup(&stats_timer, stats_timer_function, 0);
 #else
 	init_timer(&timer);
 	timer.function = timer_function;
 	timer.expires = 0;
 	timer.data = 0;
+	init_timer(&stats_timer);
+	stats_timer.function = stats_timer_function;
+	stats_timer.expires = 0;
+	stats_timer.data = 0;
 #endif
 	mod_timer(&timer, jiffies + TIMER_PERIOD);
+	mod_timer(&stats_timer, jiffies + STATS_TIMER_PERIOD);
 	return 0;
 }
 
@@ -63,5 +95,6 @@ int jtimer_setup(void)
  */
 void jtimer_teardown(void)
 {
+	del_timer_sync(&stats_timer);
 	del_timer_sync(&timer);
 }
@@ -2,6 +2,9 @@
 
 #include "mod/common/log.h"
 
+#define CREATE_TRACE_POINTS
+#include "mod/common/tracepoints.h"
+
 void pkt_trace4(struct xlation *state)
 {
 	union {
@@ -81,3 +84,55 @@ void pkt_trace6(struct xlation *state)
 		log_debug(state, "Unknown l4 protocol");
 	}
 }
+
+/*
+ * Returns the identifiers jool_rcv4 and jool_rcv6 print: Ports in TCP and UDP,
+ * the ICMP identifier in ICMP, zero otherwise.
+ */
+static void get_ids(struct packet *pkt, bool first, __u16 *src, __u16 *dst)
+{
+	*src = 0;
+	*dst = 0;
+
+	switch (pkt_l4_proto(pkt)) {
+	case L4PROTO_TCP:
+		if (first) {
+			*src = be16_to_cpu(pkt_tcp_hdr(pkt)->source);
+			*dst = be16_to_cpu(pkt_tcp_hdr(pkt)->dest);
+		}
+		break;
+	case L4PROTO_UDP:
+		if (first) {
+			*src = be16_to_cpu(pkt_udp_hdr(pkt)->source);
+			*dst = be16_to_cpu(pkt_udp_hdr(pkt)->dest);
+		}
+		break;
+	case L4PROTO_ICMP:
+		/* Both ICMP headers have the identifier in the same place. */
+		*src = be16_to_cpu(pkt_icmp6_hdr(pkt)->icmp6_identifier);
+		*dst = *src;
+		break;
+	case L4PROTO_OTHER:
+		break;
+	}
+}
+
+/* Only call if trace_jool_rcv4_enabled(). */
+void pkt_tracepoint4(struct xlation *state)
+{
+	__u16 src, dst;
+
+	get_ids(&state->in, is_first_frag4(pkt_ip4_hdr(&state->in)),
+			&src, &dst);
+	trace_jool_rcv4(state, src, dst);
+}
+
+/* Only call if trace_jool_rcv6_enabled(). */
+void pkt_tracepoint6(struct xlation *state)
+{
+	__u16 src, dst;
+
+	get_ids(&state->in, is_first_frag6(pkt_frag_hdr(&state->in)),
+			&src, &dst);
+	trace_jool_rcv6(state, src, dst);
+}
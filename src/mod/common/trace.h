@@ -6,4 +6,7 @@
 void pkt_trace6(struct xlation *state);
 void pkt_trace4(struct xlation *state);
 
+void pkt_tracepoint6(struct xlation *state);
+void pkt_tracepoint4(struct xlation *state);
+
 #endif /* SRC_MOD_COMMON_TRACE_H_ */
@@ -0,0 +1,323 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM jool
+
+#if !defined(SRC_MOD_COMMON_TRACEPOINTS_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define SRC_MOD_COMMON_TRACEPOINTS_H_
+
+/**
+ * @file
+ * Kernel tracepoints. (See /sys/kernel/tracing/events/jool/.)
+ *
+ * Unlike log_debug(), these are meant to be left enabled in production: They
+ * cost a static branch while disabled, and when enabled they write binary
+ * records to the trace ring buffer instead of formatting strings into dmesg.
+ * perf, bpftrace and trace-cmd can all attach to them.
+ *
+ * The field names and meanings are a user-facing interface. Add fields if
+ * needed, but do not rename or remove them.
+ *
+ * CREATE_TRACE_POINTS lives in trace.c.
+ */
+
+#include <linux/tracepoint.h>
+#include "mod/common/translation_state.h"
+#include "mod/common/xlator.h"
+
+#define JOOL_TRACE_INAME(entry, jool) \
+	strscpy(entry->iname, (jool) ? (jool)->iname : "", INAME_MAX_SIZE)
+
+#define show_verdict(verdict) __print_symbolic(verdict,		\
+		{ VERDICT_CONTINUE,		"CONTINUE" },		\
+		{ VERDICT_DROP,			"DROP" },		\
+		{ VERDICT_UNTRANSLATABLE,	"UNTRANSLATABLE" },	\
+		{ VERDICT_STOLEN,		"STOLEN" })
+
+#define show_l4proto(proto) __print_symbolic(proto,			\
+		{ L4PROTO_TCP,			"TCP" },		\
+		{ L4PROTO_UDP,			"UDP" },		\
+		{ L4PROTO_ICMP,			"ICMP" },		\
+		{ L4PROTO_OTHER,		"Other" })
+
+/*
+ * A packet was accepted by the instance's hook, and its headers were found
+ * to be sane. @sport and @dport are the ICMP identifier in ICMP packets, and
+ * zero in subsequent fragments.
+ */
+TRACE_EVENT(jool_rcv6,
+	TP_PROTO(struct xlation *state, __u16 sport, __u16 dport),
+	TP_ARGS(state, sport, dport),
+
+	TP_STRUCT__entry(
+		__array(char, iname, INAME_MAX_SIZE)
+		__array(__u8, saddr, 16)
+		__array(__u8, daddr, 16)
+		__field(__u8, proto)
+		__field(__u16, sport)
+		__field(__u16, dport)
+		__field(unsigned int, len)
+	),
+
+	TP_fast_assign(
+		JOOL_TRACE_INAME(__entry, &state->jool);
+		memcpy(__entry->saddr, &pkt_ip6_hdr(&state->in)->saddr, 16);
+		memcpy(__entry->daddr, &pkt_ip6_hdr(&state->in)->daddr, 16);
+		__entry->proto = pkt_l4_proto(&state->in);
+		__entry->sport = sport;
+		__entry->dport = dport;
+		__entry->len = state->in.skb->len;
+	),
+
+	TP_printk("%s %s [%pI6c]#%u -> [%pI6c]#%u len=%u", __entry->iname,
+		show_l4proto(__entry->proto),
+		__entry->saddr, __entry->sport,
+		__entry->daddr, __entry->dport, __entry->len)
+);
+
+/* IPv4 version of jool_rcv6. */
+TRACE_EVENT(jool_rcv4,
+	TP_PROTO(struct xlation *state, __u16 sport, __u16 dport),
+	TP_ARGS(state, sport, dport),
+
+	TP_STRUCT__entry(
+		__array(char, iname, INAME_MAX_SIZE)
+		__field(__be32, saddr)
+		__field(__be32, daddr)
+		__field(__u8, proto)
+		__field(__u16, sport)
+		__field(__u16, dport)
+		__field(unsigned int, len)
+	),
+
+	TP_fast_assign(
+		JOOL_TRACE_INAME(__entry, &state->jool);
+		__entry->saddr = pkt_ip4_hdr(&state->in)->saddr;
+		__entry->daddr = pkt_ip4_hdr(&state->in)->daddr;
+		__entry->proto = pkt_l4_proto(&state->in);
+		__entry->sport = sport;
+		__entry->dport = dport;
+		__entry->len = state->in.skb->len;
+	),
+
+	TP_printk("%s %s %pI4#%u -> %pI4#%u len=%u", __entry->iname,
+		show_l4proto(__entry->proto),
+		&__entry->saddr, __entry->sport,
+		&__entry->daddr, __entry->dport, __entry->len)
+);
+
+/*
+ * The translation of a packet ended. @stat is the jool_stat_id that was
+ * incremented because of it; see `jool stats display --all --explain`.
+ */
+TRACE_EVENT(jool_verdict,
+	TP_PROTO(struct xlation *state, verdict result,
+		enum jool_stat_id stat),
+	TP_ARGS(state, result, stat),
+
+	TP_STRUCT__entry(
+		__array(char, iname, INAME_MAX_SIZE)
+		__field(int, verdict)
+		__field(unsigned int, stat)
+	),
+
+	TP_fast_assign(
+		JOOL_TRACE_INAME(__entry, &state->jool);
+		__entry->verdict = result;
+		__entry->stat = stat;
+	),
+
+	TP_printk("%s %s stat=%u", __entry->iname,
+		show_verdict(__entry->verdict), __entry->stat)
+);
+
+DECLARE_EVENT_CLASS(jool_bib_class,
+	TP_PROTO(struct xlator *jool, l4_protocol proto,
+		struct ipv6_transport_addr const *src6,
+		struct ipv4_transport_addr const *src4),
+	TP_ARGS(jool, proto, src6, src4),
+
+	TP_STRUCT__entry(
+		__array(char, iname, INAME_MAX_SIZE)
+		__array(__u8, src6, 16)
+		__field(__u16, src6_port)
+		__field(__be32, src4)
+		__field(__u16, src4_port)
+		__field(__u8, proto)
+	),
+
+	TP_fast_assign(
+		JOOL_TRACE_INAME(__entry, jool);
+		memcpy(__entry->src6, &src6->l3, 16);
+		__entry->src6_port = src6->l4;
+		__entry->src4 = src4->l3.s_addr;
+		__entry->src4_port = src4->l4;
+		__entry->proto = proto;
+	),
+
+	TP_printk("%s %s [%pI6c]#%u <-> %pI4#%u", __entry->iname,
+		show_l4proto(__entry->proto),
+		__entry->src6, __entry->src6_port,
+		&__entry->src4, __entry->src4_port)
+);
+
+/* A dynamic BIB entry was created. */
+DEFINE_EVENT(jool_bib_class, jool_bib_add,
+	TP_PROTO(struct xlator *jool, l4_protocol proto,
+		struct ipv6_transport_addr const *src6,
+		struct ipv4_transport_addr const *src4),
+	TP_ARGS(jool, proto, src6, src4)
+);
+
+/* A dynamic BIB entry died, because its last session did. */
+DEFINE_EVENT(jool_bib_class, jool_bib_rm,
+	TP_PROTO(struct xlator *jool, l4_protocol proto,
+		struct ipv6_transport_addr const *src6,
+		struct ipv4_transport_addr const *src4),
+	TP_ARGS(jool, proto, src6, src4)
+);
+
+DECLARE_EVENT_CLASS(jool_session_class,
+	TP_PROTO(struct xlator *jool, l4_protocol proto,
+		struct ipv6_transport_addr const *src6,
+		struct ipv6_transport_addr const *dst6,
+		struct ipv4_transport_addr const *src4,
+		struct ipv4_transport_addr const *dst4),
+	TP_ARGS(jool, proto, src6, dst6, src4, dst4),
+
+	TP_STRUCT__entry(
+		__array(char, iname, INAME_MAX_SIZE)
+		__array(__u8, src6, 16)
+		__array(__u8, dst6, 16)
+		__field(__u16, src6_port)
+		__field(__u16, dst6_port)
+		__field(__be32, src4)
+		__field(__be32, dst4)
+		__field(__u16, src4_port)
+		__field(__u16, dst4_port)
+		__field(__u8, proto)
+	),
+
+	TP_fast_assign(
+		JOOL_TRACE_INAME(__entry, jool);
+		memcpy(__entry->src6, &src6->l3, 16);
+		memcpy(__entry->dst6, &dst6->l3, 16);
+		__entry->src6_port = src6->l4;
+		__entry->dst6_port = dst6->l4;
+		__entry->src4 = src4->l3.s_addr;
+		__entry->dst4 = dst4->l3.s_addr;
+		__entry->src4_port = src4->l4;
+		__entry->dst4_port = dst4->l4;
+		__entry->proto = proto;
+	),
+
+	TP_printk("%s %s [%pI6c]#%u|[%pI6c]#%u|%pI4#%u|%pI4#%u",
+		__entry->iname, show_l4proto(__entry->proto),
+		__entry->src6, __entry->src6_port,
+		__entry->dst6, __entry->dst6_port,
+		&__entry->src4, __entry->src4_port,
+		&__entry->dst4, __entry->dst4_port)
+);
+
+/* A session was created. */
+DEFINE_EVENT(jool_session_class, jool_session_add,
+	TP_PROTO(struct xlator *jool, l4_protocol proto,
+		struct ipv6_transport_addr const *src6,
+		struct ipv6_transport_addr const *dst6,
+		struct ipv4_transport_addr const *src4,
+		struct ipv4_transport_addr const *dst4),
+	TP_ARGS(jool, proto, src6, dst6, src4, dst4)
+);
+
+/* A session expired, or was otherwise removed. */
+DEFINE_EVENT(jool_session_class, jool_session_rm,
+	TP_PROTO(struct xlator *jool, l4_protocol proto,
+		struct ipv6_transport_addr const *src6,
+		struct ipv6_transport_addr const *dst6,
+		struct ipv4_transport_addr const *src4,
+		struct ipv4_transport_addr const *dst4),
+	TP_ARGS(jool, proto, src6, dst6, src4, dst4)
+);
+
+/* The kernel could not find a route for a translated IPv4 packet. */
+TRACE_EVENT(jool_route4_fail,
+	TP_PROTO(struct xlator *jool, struct flowi4 const *flow),
+	TP_ARGS(jool, flow),
+
+	TP_STRUCT__entry(
+		__array(char, iname, INAME_MAX_SIZE)
+		__field(__be32, saddr)
+		__field(__be32, daddr)
+		__field(__u32, mark)
+	),
+
+	TP_fast_assign(
+		JOOL_TRACE_INAME(__entry, jool);
+		__entry->saddr = flow->saddr;
+		__entry->daddr = flow->daddr;
+		__entry->mark = flow->flowi4_mark;
+	),
+
+	TP_printk("%s %pI4 -> %pI4 mark=%u", __entry->iname,
+		&__entry->saddr, &__entry->daddr, __entry->mark)
+);
+
+/* IPv6 version of jool_route4_fail. */
+TRACE_EVENT(jool_route6_fail,
+	TP_PROTO(struct xlator *jool, struct flowi6 const *flow),
+	TP_ARGS(jool, flow),
+
+	TP_STRUCT__entry(
+		__array(char, iname, INAME_MAX_SIZE)
+		__array(__u8, saddr, 16)
+		__array(__u8, daddr, 16)
+		__field(__u32, mark)
+	),
+
+	TP_fast_assign(
+		JOOL_TRACE_INAME(__entry, jool);
+		memcpy(__entry->saddr, &flow->saddr, 16);
+		memcpy(__entry->daddr, &flow->daddr, 16);
+		__entry->mark = flow->flowi6_mark;
+	),
+
+	TP_printk("%s %pI6c -> %pI6c mark=%u", __entry->iname,
+		__entry->saddr, __entry->daddr, __entry->mark)
+);
+
+/*
+ * An ICMP error was handed to the kernel, to be sent to the source of @skb.
+ * (Rate-limited and failed errors are not reported.)
+ */
+TRACE_EVENT(jool_icmp_err,
+	TP_PROTO(struct xlator *jool, struct sk_buff *skb, icmp_error_code error,
+		int type, int code),
+	TP_ARGS(jool, skb, error, type, code),
+
+	TP_STRUCT__entry(
+		__array(char, iname, INAME_MAX_SIZE)
+		__field(__u16, family)
+		__field(int, error)
+		__field(__u8, type)
+		__field(__u8, code)
+	),
+
+	TP_fast_assign(
+		JOOL_TRACE_INAME(__entry, jool);
+		__entry->family = ntohs(skb->protocol);
+		__entry->error = error;
+		__entry->type = type;
+		__entry->code = code;
+	),
+
+	TP_printk("%s %s type=%u code=%u error=%d", __entry->iname,
+		(__entry->family == ETH_P_IPV6) ? "ICMPv6" : "ICMPv4",
+		__entry->type, __entry->code, __entry->error)
+);
+
+#endif /* SRC_MOD_COMMON_TRACEPOINTS_H_ */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH mod/common
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE tracepoints
+#include <trace/define_trace.h>
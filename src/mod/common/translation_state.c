@@ -1,5 +1,6 @@
 #include "mod/common/translation_state.h"
 
+#include "mod/common/tracepoints.h"
 #include "mod/common/wkmalloc.h"
 
 static struct kmem_cache *xlation_cache;
@@ -45,6 +46,7 @@ void xlation_destroy(struct xlation *state)
 verdict untranslatable(struct xlation *state, enum jool_stat_id stat)
 {
 	jstat_inc(state->jool.stats, stat);
+	trace_jool_verdict(state, VERDICT_UNTRANSLATABLE, stat);
 	return VERDICT_UNTRANSLATABLE;
 }
 
@@ -54,12 +56,14 @@ verdict untranslatable_icmp(struct xlation *state, enum jool_stat_id stat,
 	jstat_inc(state->jool.stats, stat);
 	state->result.icmp = icmp;
 	state->result.info = info;
+	trace_jool_verdict(state, VERDICT_UNTRANSLATABLE, stat);
 	return VERDICT_UNTRANSLATABLE;
 }
 
 verdict drop(struct xlation *state, enum jool_stat_id stat)
 {
 	jstat_inc(state->jool.stats, stat);
+	trace_jool_verdict(state, VERDICT_DROP, stat);
 	return VERDICT_DROP;
 }
 
@@ -69,11 +73,13 @@ verdict drop_icmp(struct xlation *state, enum jool_stat_id stat,
 	jstat_inc(state->jool.stats, stat);
 	state->result.icmp = icmp;
 	state->result.info = info;
+	trace_jool_verdict(state, VERDICT_DROP, stat);
 	return VERDICT_DROP;
 }
 
 verdict stolen(struct xlation *state, enum jool_stat_id stat)
 {
 	jstat_inc(state->jool.stats, stat);
+	trace_jool_verdict(state, VERDICT_STOLEN, stat);
 	return VERDICT_STOLEN;
 }
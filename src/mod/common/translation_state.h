@@ -28,6 +28,44 @@ union flowix {
 	} v6;
 };
 
+/*
+ * In-place translation state. (See ttpcomm_in_place_skb().)
+ */
+struct xlation_in_place {
+	/**
+	 * Is @out the incoming skb itself (with rewritten headers), rather than
+	 * a copy?
+	 */
+	bool active;
+
+	/*
+	 * Everything below is what the translation steps change in the skb,
+	 * backed up so ttpcomm_in_place_revert() can undo it.
+	 * (The incoming headers are found through packet.moved_hdrs.)
+	 */
+
+	/** Distance (in bytes) the incoming headers were moved towards head. */
+	unsigned int shift;
+	/** skb_headroom() of the incoming packet. */
+	unsigned int headroom;
+	/** skb_mac_offset(), or -1 if the mac header was not set. */
+	int l2_offset;
+	int l3_offset;
+	int l4_offset;
+	__be16 protocol;
+	__u32 mark;
+	bool ignore_df;
+	__u8 ip_summed;
+	/* Also covers csum_start and csum_offset. */
+	__wsum csum;
+	char cb[48];
+	/* Owned by us while @active, since the outgoing packet needs its own. */
+	struct dst_entry *dst;
+	unsigned short gso_size;
+	unsigned short gso_segs;
+	unsigned int gso_type;
+};
+
 struct xlation_result {
 	enum icmp_errcode icmp;
 	__u32 info;
@@ -70,6 +108,11 @@ struct xlation {
 	 */
 	bool is_hairpin;
 
+	struct xlation_in_place in_place;
+
+	/** Start of the current stage; see the latency histograms in core.c. */
+	__u64 latency_ts;
+
 	struct xlation_result result;
 };
 
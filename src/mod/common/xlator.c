@@ -1,20 +1,31 @@
 #include "mod/common/xlator.h"
 
 #include <linux/hashtable.h>
+#include <linux/netdevice.h>
 #include <linux/sched.h>
+#include <linux/btf.h>
+#include <linux/btf_ids.h>
+#include <net/xdp.h>
 
 #include "common/types.h"
 #include "common/xlat.h"
+#include "common/xdp.h"
 #include "db/global.h"
 #include "mod/common/atomic_config.h"
+#include "mod/common/icmp_ratelimit.h"
 #include "mod/common/joold.h"
+#include "mod/common/natlog.h"
 #include "mod/common/kernel_hook.h"
+#include "mod/common/linux_version.h"
 #include "mod/common/log.h"
 #include "mod/common/rcu.h"
+#include "mod/common/route.h"
+#include "mod/common/stats.h"
 #include "mod/common/compat_32_64.h"
 #include "mod/common/wkmalloc.h"
 #include "mod/common/db/denylist4.h"
 #include "mod/common/db/eam.h"
+#include "mod/common/db/fragdb.h"
 #include "mod/common/db/pool4/db.h"
 #include "mod/common/db/bib/db.h"
 #include "mod/common/steps/handling_hairpinning_nat64.h"
@@ -35,6 +46,23 @@ static struct nf_hook_ops netfilter_hooks[] = {
 	},
 };
 
+/**
+ * The ingress hooks of an XF_INGRESS instance; one per interface.
+ *
+ * The hooks' private pointer is the binding itself, so they find their
+ * instance without looking it up by name. Like @nf_ops, the binding survives
+ * atomic configuration; only @instance changes.
+ */
+struct ingress_binding {
+	struct jool_instance __rcu *instance;
+	unsigned int count;
+	/*
+	 * Every ops holds a reference to its .dev. If the interface dies, the
+	 * ops is unregistered and its .dev becomes NULL. (See ingress_event().)
+	 */
+	struct nf_hook_ops ops[INGRESS_MAX_DEVS];
+};
+
 /**
  * An xlator, except it's the database node version.
  */
@@ -62,11 +90,15 @@ struct jool_instance {
 	 * This is only set if @jool.flags matches FW_NETFILTER.
 	 */
 	struct nf_hook_ops *nf_ops;
+	/** This is only set if @jool.flags matches XF_INGRESS. */
+	struct ingress_binding *ingress;
 };
 
 static DEFINE_HASHTABLE(instances, 6); /* The identifier is (ns, xt, iname). */
 static struct list_head __rcu *netfilter_instances;
 static DEFINE_MUTEX(lock);
+/* Source of the instances' generations. (See xlator.generation.) */
+static atomic64_t generations = ATOMIC64_INIT(0);
 
 static void (*defrag_enable)(struct net *ns);
 
@@ -111,8 +143,189 @@ static struct jool_instance *find_instance(struct net *ns, xlator_type xt,
 	return NULL;
 }
 
+#ifdef CONFIG_NETFILTER_INGRESS
+
+/* Requires the mutex to be locked, unless @binding is no longer listed. */
+static void unhook_ingress(struct net *ns, struct ingress_binding *binding,
+		struct net_device *dev)
+{
+	struct nf_hook_ops *ops;
+	unsigned int i;
+
+	for (i = 0; i < binding->count; i++) {
+		ops = &binding->ops[i];
+		if (!ops->dev || (dev && ops->dev != dev))
+			continue;
+		nf_unregister_net_hook(ns, ops);
+		dev_put(ops->dev);
+		ops->dev = NULL;
+	}
+}
+
+/**
+ * Hooks @instance to the ingress of every interface listed in @devices.
+ * (@devices is comma-separated, and will be mangled.)
+ *
+ * Requires the mutex to be locked.
+ */
+static int hook_ingress_devs(struct jool_instance *instance, char *devices)
+{
+	struct ingress_binding *binding;
+	struct nf_hook_ops *ops;
+	struct net_device *dev;
+	char *name;
+	int error;
+
+	binding = wkmalloc(struct ingress_binding, GFP_KERNEL);
+	if (!binding)
+		return -ENOMEM;
+	memset(binding, 0, sizeof(*binding));
+	RCU_INIT_POINTER(binding->instance, instance);
+
+	while (devices && (name = strsep(&devices, ",")) != NULL) {
+		if (!name[0])
+			continue;
+		if (binding->count >= INGRESS_MAX_DEVS) {
+			log_err("Ingress instances can only be hooked to %u interfaces.",
+					INGRESS_MAX_DEVS);
+			error = -EINVAL;
+			goto fail;
+		}
+
+		dev = dev_get_by_name(instance->jool.ns, name);
+		if (!dev) {
+			log_err("Interface '%s' does not exist in this namespace.",
+					name);
+			error = -ENODEV;
+			goto fail;
+		}
+
+		ops = &binding->ops[binding->count];
+		ops->hook = hook_ingress;
+		ops->pf = NFPROTO_NETDEV;
+		ops->hooknum = NF_NETDEV_INGRESS;
+		ops->priority = 0;
+		ops->dev = dev;
+		ops->priv = binding;
+
+		error = nf_register_net_hook(instance->jool.ns, ops);
+		if (error) {
+			log_err("Cannot hook to interface '%s' (error code %d).",
+					name, error);
+			dev_put(dev);
+			ops->dev = NULL;
+			goto fail;
+		}
+		binding->count++;
+	}
+
+	if (binding->count == 0) {
+		log_err("Ingress instances need at least one interface. (Atomic configuration cannot create them; please use `instance add` first.)");
+		error = -EINVAL;
+		goto fail;
+	}
+
+	instance->ingress = binding;
+	return 0;
+
+fail:
+	unhook_ingress(instance->jool.ns, binding, NULL);
+	/* Some of the hooks might still be running. */
+	synchronize_net();
+	wkfree(struct ingress_binding, binding);
+	return error;
+}
+
+/**
+ * Interfaces can die while instances are still hooked to them. Their hooks
+ * need to be unregistered, and their references returned, or the interface
+ * will never finish dying.
+ */
+static int ingress_event(struct notifier_block *nb, unsigned long event,
+		void *ptr)
+{
+	struct net_device *dev;
+	struct jool_instance *instance;
+	size_t i;
+
+	if (event != NETDEV_UNREGISTER)
+		return NOTIFY_DONE;
+	dev = netdev_notifier_info_to_dev(ptr);
+
+	mutex_lock(&lock);
+	hash_for_each(instances, i, instance, table_hook) {
+		if (instance->ingress && instance->jool.ns == dev_net(dev)) {
+			unhook_ingress(instance->jool.ns, instance->ingress,
+					dev);
+		}
+	}
+	mutex_unlock(&lock);
+
+	return NOTIFY_DONE;
+}
+
+#else /* !CONFIG_NETFILTER_INGRESS */
+
+static void unhook_ingress(struct net *ns, struct ingress_binding *binding,
+		struct net_device *dev)
+{
+	/* No code. */
+}
+
+static int hook_ingress_devs(struct jool_instance *instance, char *devices)
+{
+	log_err("This kernel was compiled without CONFIG_NETFILTER_INGRESS, so ingress instances are not available.");
+	return -EINVAL;
+}
+
+static int ingress_event(struct notifier_block *nb, unsigned long event,
+		void *ptr)
+{
+	return NOTIFY_DONE;
+}
+
+#endif /* CONFIG_NETFILTER_INGRESS */
+
+static struct notifier_block ingress_notifier = {
+	.notifier_call = ingress_event,
+};
+
+/*
+ * Every listed or about-to-be-listed instance whose latency-histograms is
+ * enabled holds a reference to jstat_latency_key. It's acquired when the
+ * instance is created, and returned by destroy_jool_instance().
+ * (Changing a global replaces the instance, so this also covers toggling.)
+ */
+static void latency_key_get(struct jool_instance *instance)
+{
+	if (instance->jool.globals.latency_histograms)
+		jstat_latency_enable();
+}
+
+/*
+ * Tells the BIB, pool4 and joold whether they should measure their locks.
+ * Unlike the latency histograms, these belong to the databases, which survive
+ * instance replacements. So this needs to be called whenever an instance
+ * acquires its databases (or someone else's).
+ */
+static void lockstat_update(struct xlator *jool)
+{
+	bool enable;
+
+	if (!xlator_is_nat64(jool))
+		return;
+
+	enable = jool->globals.nat64.lock_statistics;
+	bib_lockstat_enable(jool->nat64.bib, enable);
+	pool4db_lockstat_enable(jool->nat64.pool4, enable);
+	joold_lockstat_enable(jool->nat64.joold, enable);
+}
+
 static void destroy_jool_instance(struct jool_instance *instance, bool unhook)
 {
+	if (instance->jool.globals.latency_histograms)
+		jstat_latency_disable();
+
 	if (xlator_is_netfilter(&instance->jool)) {
 		if (unhook) {
 			nf_unregister_net_hooks(instance->jool.ns,
@@ -121,6 +334,12 @@ static void destroy_jool_instance(struct jool_instance *instance, bool unhook)
 		}
 		__wkfree("nf_hook_ops", instance->nf_ops);
 	}
+	/*
+	 * The ingress hooks were already unregistered by detach_instance(),
+	 * before the grace period, because they hold a pointer to the binding.
+	 */
+	if (instance->ingress)
+		wkfree(struct ingress_binding, instance->ingress);
 
 	xlator_put(&instance->jool);
 	log_info("Deleted instance '%s'.", instance->jool.iname);
@@ -130,6 +349,8 @@ static void destroy_jool_instance(struct jool_instance *instance, bool unhook)
 static void xlator_get(struct xlator *jool)
 {
 	jstat_get(jool->stats);
+	rtcache_get(jool->rtcache);
+	icmprl_get(jool->icmprl);
 
 	switch (xlator_get_type(jool)) {
 	case XT_SIIT:
@@ -140,10 +361,30 @@ static void xlator_get(struct xlator *jool)
 		pool4db_get(jool->nat64.pool4);
 		bib_get(jool->nat64.bib);
 		joold_get(jool->nat64.joold);
+		fragdb_get(jool->nat64.fragdb);
+		natlog_get(jool->nat64.natlog);
 		break;
 	}
 }
 
+/**
+ * Unlists @instance, and unhooks its ingress hooks. The caller needs to hold
+ * the mutex, and wait for a grace period before destroying the instance.
+ *
+ * (Unlike the Netfilter hooks, whose callbacks find their instance by looking
+ * it up, the ingress hooks dereference the binding directly. Therefore, they
+ * need to be gone before the grace period starts, or they might run after
+ * the binding is freed.)
+ */
+static void detach_instance(struct jool_instance *instance)
+{
+	hash_del_rcu(&instance->table_hook);
+	if (instance->jool.flags & XF_NETFILTER)
+		list_del_rcu(&instance->list_hook);
+	if (instance->ingress)
+		unhook_ingress(instance->jool.ns, instance->ingress, NULL);
+}
+
 /**
  * Moves the jool_instance nodes from the database (that match the @ns
  * namespace and the @xt type) to the @detached list.
@@ -157,10 +398,8 @@ static void __flush_detach(struct net *ns, xlator_type xt,
 
 	hash_for_each_safe(instances, i, tmp, instance, table_hook) {
 		if (instance->jool.ns == ns && (instance->jool.flags & xt)) {
-			hash_del_rcu(&instance->table_hook);
+			detach_instance(instance);
 			hlist_add_head(&instance->table_hook, detached);
-			if (instance->jool.flags & XF_NETFILTER)
-				list_del_rcu(&instance->list_hook);
 		}
 	}
 }
@@ -222,12 +461,73 @@ void jool_xlator_flush_batch(struct list_head *net_exit_list, xlator_type xt)
 }
 EXPORT_SYMBOL_GPL(jool_xlator_flush_batch);
 
+#if LINUX_VERSION_AT_LEAST(6, 9, 0, 10, 0) \
+		&& IS_ENABLED(CONFIG_DEBUG_INFO_BTF_MODULES)
+
+__bpf_kfunc_start_defs();
+
+/**
+ * bpf_jool_siit_generation - Returns the generation of the SIIT instance named
+ * @iname, from the namespace @ctx arrived to. Zero means the instance is gone
+ * or disabled, and the XDP fast path must leave the packet alone.
+ *
+ * (Because the fast path calls this, it pins the module while attached.)
+ */
+__bpf_kfunc u64 bpf_jool_siit_generation(struct xdp_md *ctx,
+		const char *iname, u32 iname__sz)
+{
+	struct xdp_buff *xdp = (struct xdp_buff *)ctx;
+	struct jool_instance *instance;
+	u64 result;
+
+	BUILD_BUG_ON(JOOL_XDP_INAME_SIZE != INAME_MAX_SIZE);
+
+	if (iname__sz != INAME_MAX_SIZE || iname[INAME_MAX_SIZE - 1] != '\0')
+		return 0;
+
+	result = 0;
+	rcu_read_lock_bh();
+	instance = find_instance(dev_net(xdp->rxq->dev), XT_SIIT, iname);
+	if (instance && instance->jool.globals.enabled)
+		result = READ_ONCE(instance->jool.generation);
+	rcu_read_unlock_bh();
+
+	return result;
+}
+
+__bpf_kfunc_end_defs();
+
+BTF_KFUNCS_START(xdp_kfunc_ids)
+BTF_ID_FLAGS(func, bpf_jool_siit_generation)
+BTF_KFUNCS_END(xdp_kfunc_ids)
+
+static const struct btf_kfunc_id_set xdp_kfunc_set = {
+	.owner = THIS_MODULE,
+	.set = &xdp_kfunc_ids,
+};
+
+static int register_xdp_kfuncs(void)
+{
+	return register_btf_kfunc_id_set(BPF_PROG_TYPE_XDP, &xdp_kfunc_set);
+}
+
+#else
+
+/* The fast path will fail to load, which is what we want. */
+static int register_xdp_kfuncs(void)
+{
+	return 0;
+}
+
+#endif
+
 /**
  * Initializes this module. Do not call other functions before this one.
  */
 int xlator_setup(void)
 {
 	struct list_head *list;
+	int error;
 
 	list = __wkmalloc("xlator DB", sizeof(struct list_head), GFP_KERNEL);
 	if (!list)
@@ -235,7 +535,20 @@ int xlator_setup(void)
 	INIT_LIST_HEAD(list);
 	RCU_INIT_POINTER(netfilter_instances, list);
 
+	error = register_netdevice_notifier(&ingress_notifier);
+	if (error)
+		goto notifier_fail;
+	error = register_xdp_kfuncs();
+	if (error)
+		goto kfuncs_fail;
+
 	return 0;
+
+kfuncs_fail:
+	unregister_netdevice_notifier(&ingress_notifier);
+notifier_fail:
+	__wkfree("xlator DB", list);
+	return error;
 }
 
 void xlator_set_defrag(void (*_defrag_enable)(struct net *ns))
@@ -251,6 +564,8 @@ void xlator_teardown(void)
 {
 	struct list_head *ni;
 
+	unregister_netdevice_notifier(&ingress_notifier);
+
 	WARN(!hash_empty(instances), "There are elements in the xlator table after a cleanup.");
 	ni = rcu_dereference_raw(netfilter_instances);
 	WARN(!list_empty(ni), "There are elements in the xlator list after a cleanup.");
@@ -268,6 +583,12 @@ static int init_siit(struct xlator *jool, struct ipv6_prefix *pool6)
 	jool->stats = jstat_alloc();
 	if (!jool->stats)
 		goto stats_fail;
+	jool->rtcache = rtcache_alloc();
+	if (!jool->rtcache)
+		goto rtcache_fail;
+	jool->icmprl = icmprl_alloc();
+	if (!jool->icmprl)
+		goto icmprl_fail;
 	jool->siit.eamt = eamt_alloc();
 	if (!jool->siit.eamt)
 		goto eamt_fail;
@@ -282,6 +603,10 @@ static int init_siit(struct xlator *jool, struct ipv6_prefix *pool6)
 denylist4_fail:
 	eamt_put(jool->siit.eamt);
 eamt_fail:
+	icmprl_put(jool->icmprl);
+icmprl_fail:
+	rtcache_put(jool->rtcache);
+rtcache_fail:
 	jstat_put(jool->stats);
 stats_fail:
 	return -ENOMEM;
@@ -298,6 +623,12 @@ static int init_nat64(struct xlator *jool, struct ipv6_prefix *pool6)
 	jool->stats = jstat_alloc();
 	if (!jool->stats)
 		goto stats_fail;
+	jool->rtcache = rtcache_alloc();
+	if (!jool->rtcache)
+		goto rtcache_fail;
+	jool->icmprl = icmprl_alloc();
+	if (!jool->icmprl)
+		goto icmprl_fail;
 	jool->nat64.pool4 = pool4db_alloc();
 	if (!jool->nat64.pool4)
 		goto pool4_fail;
@@ -307,16 +638,30 @@ static int init_nat64(struct xlator *jool, struct ipv6_prefix *pool6)
 	jool->nat64.joold = joold_alloc();
 	if (!jool->nat64.joold)
 		goto joold_fail;
+	jool->nat64.fragdb = fragdb_alloc();
+	if (!jool->nat64.fragdb)
+		goto fragdb_fail;
+	jool->nat64.natlog = natlog_alloc();
+	if (!jool->nat64.natlog)
+		goto natlog_fail;
 
 	jool->is_hairpin = is_hairpin_nat64;
 	jool->handling_hairpinning = handling_hairpinning_nat64;
 	return 0;
 
+natlog_fail:
+	fragdb_put(jool->nat64.fragdb);
+fragdb_fail:
+	joold_put(jool->nat64.joold);
 joold_fail:
 	bib_put(jool->nat64.bib);
 bib_fail:
 	pool4db_put(jool->nat64.pool4);
 pool4_fail:
+	icmprl_put(jool->icmprl);
+icmprl_fail:
+	rtcache_put(jool->rtcache);
+rtcache_fail:
 	jstat_put(jool->stats);
 stats_fail:
 	return -ENOMEM;
@@ -336,6 +681,7 @@ int xlator_init(struct xlator *jool, struct net *ns, char *iname,
 	jool->ns = ns;
 	strcpy(jool->iname, iname);
 	jool->flags = flags;
+	jool->generation = atomic64_inc_return(&generations);
 
 	switch (xlator_flags2xt(flags)) {
 	case XT_SIIT:
@@ -424,13 +770,14 @@ static int validate_collision(struct net *ns, char *iname, xlator_flags flags)
 /**
  * Requires the mutex to be locked.
  */
-static int __xlator_add(struct jool_instance *new, struct xlator *result)
+static int __xlator_add(struct jool_instance *new, char *devices,
+		struct xlator *result)
 {
 	struct list_head *list;
+	int error;
 
 	if (xlator_is_netfilter(&new->jool)) {
 		struct nf_hook_ops *ops;
-		int error;
 
 		ops = __wkmalloc("nf_hook_ops",
 		    ARRAY_SIZE(netfilter_hooks) * sizeof(struct nf_hook_ops),
@@ -452,6 +799,12 @@ static int __xlator_add(struct jool_instance *new, struct xlator *result)
 		new->nf_ops = ops;
 	}
 
+	if (xlator_is_ingress(&new->jool)) {
+		error = hook_ingress_devs(new, devices);
+		if (error)
+			return error;
+	}
+
 	hash_add_rcu(instances, &new->table_hook, get_instance_hash(new));
 	if (new->jool.flags & XF_NETFILTER) {
 		list = rcu_dereference_protected(netfilter_instances,
@@ -459,7 +812,14 @@ static int __xlator_add(struct jool_instance *new, struct xlator *result)
 		list_add_tail_rcu(&new->list_hook, list);
 	}
 
-	if (new->jool.flags & XT_NAT64)
+	/*
+	 * Virtual reassembly needs the fragments to reach the instance
+	 * untouched, and there's no way to undo defrag_enable(). So the global
+	 * can only be set when the instance is created. (See xlator_replace().)
+	 * (Ingress instances run before defrag, so it's pointless for them.)
+	 */
+	if ((new->jool.flags & XT_NAT64) && !xlator_is_ingress(&new->jool)
+			&& !new->jool.globals.nat64.virtual_reassembly)
 		defrag_enable(new->jool.ns);
 
 	if (result) {
@@ -473,11 +833,13 @@ static int __xlator_add(struct jool_instance *new, struct xlator *result)
 /**
  * Adds a new Jool instance to the current namespace.
  *
+ * @devices: Comma-separated interfaces to hook the instance to. Only used (and
+ *     mandatory) if @flags includes XF_INGRESS. Will be mangled.
  * @result: Will be initialized with a clone of the new translator. Send NULL
  *     if you're not interested.
  */
 int xlator_add(xlator_flags flags, char *iname, struct ipv6_prefix *pool6,
-		struct xlator *result)
+		char *devices, struct xlator *result)
 {
 	struct jool_instance *instance;
 	struct net *ns;
@@ -512,6 +874,9 @@ int xlator_add(xlator_flags flags, char *iname, struct ipv6_prefix *pool6,
 	instance->hash_set = false;
 	instance->hash = 0;
 	instance->nf_ops = NULL;
+	instance->ingress = NULL;
+	latency_key_get(instance);
+	lockstat_update(&instance->jool);
 
 	/* Error roads from now no longer need to free @instance. */
 	/* Error roads from now need to properly destroy @instance. */
@@ -524,7 +889,7 @@ int xlator_add(xlator_flags flags, char *iname, struct ipv6_prefix *pool6,
 	if (error)
 		goto mutex_fail;
 
-	error = __xlator_add(instance, result);
+	error = __xlator_add(instance, devices, result);
 	if (error)
 		goto mutex_fail;
 
@@ -553,9 +918,7 @@ static int __xlator_rm(struct net *ns, char *iname, xlator_type xt)
 		return -ESRCH;
 	}
 
-	hash_del_rcu(&instance->table_hook);
-	if (instance->jool.flags & XF_NETFILTER)
-		list_del_rcu(&instance->list_hook);
+	detach_instance(instance);
 
 	mutex_unlock(&lock);
 	synchronize_rcu_bh();
@@ -623,6 +986,11 @@ static int basic_replace_validations(struct xlator *jool)
 {
 	struct check_bib_arg arg;
 
+	if (jool->globals.icmp_errors_rate && !jool->globals.icmp_errors_burst) {
+		log_err("icmp-errors-burst cannot be zero while icmp-errors-rate is enabled; no ICMP errors would ever be sent.");
+		return -EINVAL;
+	}
+
 	if (!xlator_is_nat64(jool))
 		return 0; // Nothing to validate for SIIT.
 
@@ -662,16 +1030,20 @@ int xlator_replace(struct xlator *jool)
 	if (!new)
 		return -ENOMEM;
 	memcpy(&new->jool, jool, sizeof(*jool));
+	new->jool.generation = atomic64_inc_return(&generations);
 	xlator_get(&new->jool);
 	new->hash_set = false;
 	new->nf_ops = NULL;
+	new->ingress = NULL;
+	latency_key_get(new);
 
 	mutex_lock(&lock);
 
 	old = find_instance(jool->ns, xlator_flags2xt(jool->flags), jool->iname);
 	if (!old) {
 		/* Not found, hence not replacing. Add it instead. */
-		error = __xlator_add(new, NULL);
+		lockstat_update(&new->jool);
+		error = __xlator_add(new, NULL, NULL);
 		if (error)
 			destroy_jool_instance(new, false);
 
@@ -689,21 +1061,38 @@ int xlator_replace(struct xlator *jool)
 		log_err("Sorry; you can't change a NAT64 instance's pool6 for now.");
 		goto abort;
 	}
+	/*
+	 * defrag_enable() cannot be undone, and the fragment database would
+	 * not see the fragments defrag already reassembled. So the flag is
+	 * frozen once the instance exists.
+	 */
+	if (xlator_is_nat64(&new->jool)
+			&& old->jool.globals.nat64.virtual_reassembly
+			!= new->jool.globals.nat64.virtual_reassembly) {
+		log_err("virtual-reassembly can only be set while the instance is being created.");
+		goto abort;
+	}
 
 	new->hash_set = old->hash_set;
 	new->hash = old->hash;
 	new->nf_ops = old->nf_ops;
+	new->ingress = old->ingress;
 
 	/*
-	 * The old BIB and joold must survive,
-	 * because they shouldn't be reset by atomic configuration.
+	 * The old BIB, joold, fragment database and NAT event log must
+	 * survive, because they shouldn't be reset by atomic configuration.
 	 */
 	if (xlator_is_nat64(&new->jool)) {
 		bib_put(new->jool.nat64.bib);
 		joold_put(new->jool.nat64.joold);
+		fragdb_put(new->jool.nat64.fragdb);
+		natlog_put(new->jool.nat64.natlog);
 		new->jool.nat64.bib = old->jool.nat64.bib;
 		new->jool.nat64.joold = old->jool.nat64.joold;
+		new->jool.nat64.fragdb = old->jool.nat64.fragdb;
+		new->jool.nat64.natlog = old->jool.nat64.natlog;
 	}
+	lockstat_update(&new->jool);
 
 	hash_del(&old->table_hook);
 	hash_add(instances, &new->table_hook, get_instance_hash(new));
@@ -713,15 +1102,20 @@ int xlator_replace(struct xlator *jool)
 		list_del_rcu(&old->list_hook);
 		list_add_rcu(&new->list_hook, list);
 	}
+	if (new->ingress)
+		rcu_assign_pointer(new->ingress->instance, new);
 	mutex_unlock(&lock);
 
 	synchronize_rcu_bh();
 
 	old->nf_ops = NULL;
+	old->ingress = NULL;
 
 	if (xlator_is_nat64(&old->jool)) {
 		old->jool.nat64.bib = NULL;
 		old->jool.nat64.joold = NULL;
+		old->jool.nat64.fragdb = NULL;
+		old->jool.nat64.natlog = NULL;
 	}
 
 	destroy_jool_instance(old, false);
@@ -734,6 +1128,25 @@ abort:
 	return -EINVAL;
 }
 
+/**
+ * Tells the XDP fast path that @jool's EAMT or denylist4 changed, so it stops
+ * translating until its maps are mirrored again. (The databases are edited in
+ * place, so the instance isn't replaced.)
+ */
+void xlator_touch(struct xlator const *jool)
+{
+	struct jool_instance *instance;
+
+	mutex_lock(&lock);
+	instance = find_instance(jool->ns, xlator_flags2xt(jool->flags),
+			jool->iname);
+	if (instance) {
+		WRITE_ONCE(instance->jool.generation,
+				atomic64_inc_return(&generations));
+	}
+	mutex_unlock(&lock);
+}
+
 int xlator_flush(xlator_type xt)
 {
 	struct net *ns;
@@ -853,6 +1266,25 @@ int xlator_find_netfilter(struct net *ns, struct xlator *result)
 	return -ESRCH;
 }
 
+/**
+ * Returns (in @result) the instance @binding's ingress hooks lead to.
+ * Unlike the other find functions, this one cannot fail: Removals unregister
+ * the hooks before waiting for the grace period that precedes the release of
+ * the binding and its instance, so no hook that can still see @binding will
+ * outlive them. (See detach_instance().)
+ */
+void xlator_find_ingress(struct ingress_binding *binding,
+		struct xlator *result)
+{
+	struct jool_instance *instance;
+
+	rcu_read_lock_bh();
+	instance = rcu_dereference_bh(binding->instance);
+	xlator_get(&instance->jool);
+	memcpy(result, &instance->jool, sizeof(*result));
+	rcu_read_unlock_bh();
+}
+
 /*
  * I am kref_put()ting and there's no lock.
  * This can be dangerous: http://lwn.net/Articles/93617/
@@ -865,6 +1297,8 @@ int xlator_find_netfilter(struct net *ns, struct xlator *result)
 void xlator_put(struct xlator *jool)
 {
 	jstat_put(jool->stats);
+	rtcache_put(jool->rtcache);
+	icmprl_put(jool->icmprl);
 
 	switch (xlator_get_type(jool)) {
 	case XT_SIIT:
@@ -882,6 +1316,10 @@ void xlator_put(struct xlator *jool)
 			bib_put(jool->nat64.bib);
 		if (jool->nat64.joold)
 			joold_put(jool->nat64.joold);
+		if (jool->nat64.fragdb)
+			fragdb_put(jool->nat64.fragdb);
+		if (jool->nat64.natlog)
+			natlog_put(jool->nat64.natlog);
 		return;
 	}
 
@@ -934,5 +1372,5 @@ xlator_type xlator_get_type(struct xlator const *instance)
 
 xlator_framework xlator_get_framework(struct xlator const *instance)
 {
-	return xlator_is_netfilter(instance) ? XF_NETFILTER : XF_IPTABLES;
+	return xlator_flags2xf(instance->flags);
 }
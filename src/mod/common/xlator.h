@@ -5,6 +5,12 @@
 #include "mod/common/stats.h"
 #include "mod/common/types.h"
 
+struct fragdb;
+struct icmp_ratelimit;
+struct ingress_binding;
+struct natlog;
+struct route_cache;
+
 /**
  * A Jool translator "instance". The point is that each network namespace has
  * a separate instance (if Jool has been loaded there).
@@ -30,8 +36,16 @@ struct xlator {
 	struct net *ns;
 	char iname[INAME_MAX_SIZE];
 	xlator_flags flags;
+	/*
+	 * Changes whenever the instance's translation rules do. (Replacement,
+	 * EAMT and denylist4 edits.) Never zero. The XDP fast path compares it
+	 * to the one its maps were mirrored from, to notice they went stale.
+	 */
+	u64 generation;
 
 	struct jool_stats *stats;
+	struct route_cache *rtcache;
+	struct icmp_ratelimit *icmprl;
 	struct jool_globals globals;
 	union {
 		struct {
@@ -42,6 +56,8 @@ struct xlator {
 			struct pool4 *pool4;
 			struct bib *bib;
 			struct joold_queue *joold;
+			struct fragdb *fragdb;
+			struct natlog *natlog;
 		} nat64;
 	};
 
@@ -56,7 +72,7 @@ void xlator_set_defrag(void (*defrag_enable)(struct net *ns));
 void xlator_teardown(void);
 
 int xlator_add(xlator_flags flags, char *iname, struct ipv6_prefix *pool6,
-		struct xlator *result);
+		char *devices, struct xlator *result);
 int xlator_rm(xlator_type xt, char *iname);
 int xlator_flush(xlator_type xt);
 void jool_xlator_flush_net(struct net *ns, xlator_type xt);
@@ -65,6 +81,7 @@ void jool_xlator_flush_batch(struct list_head *net_exit_list, xlator_type xt);
 int xlator_init(struct xlator *jool, struct net *ns, char *iname,
 		xlator_flags flags, struct ipv6_prefix *pool6);
 int xlator_replace(struct xlator *jool);
+void xlator_touch(struct xlator const *jool);
 
 /* Any context (reads) */
 
@@ -73,6 +90,8 @@ int xlator_find(struct net *ns, xlator_flags flags, const char *iname,
 int xlator_find_current(const char *iname, xlator_flags flags,
 		struct xlator *result);
 int xlator_find_netfilter(struct net *ns, struct xlator *result);
+void xlator_find_ingress(struct ingress_binding *binding,
+		struct xlator *result);
 void xlator_put(struct xlator *instance);
 
 typedef int (*xlator_foreach_cb)(struct xlator *, void *);
@@ -102,5 +121,10 @@ static inline bool xlator_is_iptables(struct xlator const *instance)
 	return instance->flags & XF_IPTABLES;
 }
 
+static inline bool xlator_is_ingress(struct xlator const *instance)
+{
+	return instance->flags & XF_INGRESS;
+}
+
 
 #endif /* SRC_MOD_COMMON_XLATOR_H_ */
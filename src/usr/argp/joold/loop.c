@@ -0,0 +1,113 @@
+#include "usr/argp/joold/loop.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <syslog.h>
+#include <sys/epoll.h>
+
+#include "usr/argp/log.h"
+
+/* Maximum number of handlers that can have a flush callback. */
+#define MAX_FLUSHERS 16
+/* Maximum number of events handled per round. */
+#define MAX_EVENTS 64
+
+static int epfd = -1;
+static struct loop_handler *flushers[MAX_FLUSHERS];
+static unsigned int flusher_count;
+
+int loop_setup(void)
+{
+	int error;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		error = errno;
+		pr_perror("epoll_create1() failed", error);
+		return error;
+	}
+
+	return 0;
+}
+
+static int ctl(struct loop_handler *handler, int op, unsigned int events)
+{
+	struct epoll_event event = { 0 };
+	int error;
+
+	event.events = events;
+	event.data.ptr = handler;
+	if (epoll_ctl(epfd, op, handler->fd, &event)) {
+		error = errno;
+		pr_perror("epoll_ctl() failed", error);
+		return error;
+	}
+
+	return 0;
+}
+
+int loop_add(struct loop_handler *handler)
+{
+	int error;
+
+	if (handler->flush && flusher_count >= MAX_FLUSHERS) {
+		syslog(LOG_ERR, "Too many sockets registered in the event loop.");
+		return ENOSPC;
+	}
+
+	error = ctl(handler, EPOLL_CTL_ADD, EPOLLIN);
+	if (error)
+		return error;
+
+	if (handler->flush)
+		flushers[flusher_count++] = handler;
+	return 0;
+}
+
+int loop_watch_write(struct loop_handler *handler, bool enable)
+{
+	return ctl(handler, EPOLL_CTL_MOD, enable ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+}
+
+/*
+ * Stops watching @handler's file descriptor. Only meant for handlers without a
+ * flush callback.
+ * (Note: Events for @handler might still be pending in the current round.)
+ */
+void loop_del(struct loop_handler *handler)
+{
+	epoll_ctl(epfd, EPOLL_CTL_DEL, handler->fd, NULL);
+}
+
+int loop_run(void)
+{
+	struct epoll_event events[MAX_EVENTS];
+	struct loop_handler *handler;
+	int count;
+	int i;
+
+	syslog(LOG_INFO, "Listening...");
+
+	do {
+		count = epoll_wait(epfd, events, MAX_EVENTS, -1);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			pr_perror("epoll_wait() failed", errno);
+			return errno;
+		}
+
+		for (i = 0; i < count; i++) {
+			handler = events[i].data.ptr;
+			if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+				handler->read(handler);
+			if ((events[i].events & EPOLLOUT) && handler->write)
+				handler->write(handler);
+		}
+
+		for (i = 0; i < (int)flusher_count; i++)
+			flushers[i]->flush(flushers[i]);
+	} while (true);
+
+	return 0;
+}
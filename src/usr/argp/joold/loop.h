@@ -0,0 +1,36 @@
+#ifndef SRC_USR_ARGP_JOOLD_LOOP_H_
+#define SRC_USR_ARGP_JOOLD_LOOP_H_
+
+/*
+ * joold's event loop.
+ *
+ * Every socket the daemon reads from is registered here, and all of them are
+ * served by a single thread that waits on an epoll instance. Handlers are
+ * expected to drain their file descriptors without blocking.
+ */
+
+#include <stdbool.h>
+
+struct loop_handler {
+	int fd;
+	/* Called whenever @fd becomes readable (or fails). */
+	void (*read)(struct loop_handler *);
+	/*
+	 * Called whenever @fd becomes writable, as long as the handler asked
+	 * for it (see loop_watch_write()). Optional.
+	 */
+	void (*write)(struct loop_handler *);
+	/*
+	 * Called (if not NULL) after every round of reads, so the handler can
+	 * send whatever the round queued. Optional.
+	 */
+	void (*flush)(struct loop_handler *);
+};
+
+int loop_setup(void);
+int loop_add(struct loop_handler *handler);
+int loop_watch_write(struct loop_handler *handler, bool enable);
+void loop_del(struct loop_handler *handler);
+int loop_run(void);
+
+#endif /* SRC_USR_ARGP_JOOLD_LOOP_H_ */
@@ -0,0 +1,612 @@
+#define _GNU_SOURCE /* accept4() */
+#include "usr/argp/joold/metrics.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/genl/genl.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+
+#include "common/config.h"
+#include "usr/argp/log.h"
+#include "usr/argp/joold/loop.h"
+#include "usr/nl/core.h"
+#include "usr/nl/stats.h"
+
+/* Requested size of the kernel socket's receive buffer. */
+#define METRICS_SKBUF_SIZE (1 << 20)
+/* Maximum number of kernel messages handled per event loop round. */
+#define METRICS_BATCH 64
+/* Maximum length of an HTTP request's head. (We ignore bodies.) */
+#define REQUEST_MAX_LEN 2048
+
+#define CONTENT_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/* The last known counters of one of the namespace's instances. */
+struct instance {
+	char iname[INAME_MAX_SIZE];
+	xlator_type xt;
+	/* Are @values usable? (false until a keyframe arrives.) */
+	bool synced;
+	/* Sequence number of the last push that was applied. */
+	__u32 seq;
+	__u64 values[JSTAT_COUNT];
+	SLIST_ENTRY(instance) hook;
+};
+
+SLIST_HEAD(instances, instance);
+
+/* An HTTP client. */
+struct client {
+	/* Must be the first member. */
+	struct loop_handler handler;
+
+	char request[REQUEST_MAX_LEN];
+	size_t request_len;
+
+	/* Response; NULL until the request's head is complete. */
+	char *response;
+	size_t response_len;
+	size_t response_sent;
+
+	struct client *next_dead;
+};
+
+static struct metrics_cfg {
+	char *address;
+	char *port;
+} cfg;
+
+static struct joolnl_socket jsocket;
+static struct loop_handler kernel_handler;
+static struct loop_handler listener;
+
+static struct instances instances = SLIST_HEAD_INITIALIZER(instances);
+/* Clients that were closed during the current event loop round. */
+static struct client *graveyard;
+
+extern unsigned long modsocket_pkts_sent;
+extern unsigned long modsocket_bytes_sent;
+extern unsigned long modsocket_add_pkts;
+extern unsigned long modsocket_add_bytes;
+extern unsigned long netsocket_pkts_rcvd;
+extern unsigned long netsocket_bytes_rcvd;
+extern unsigned long netsocket_sessions_rcvd;
+extern unsigned long netsocket_pkts_sent;
+extern unsigned long netsocket_bytes_sent;
+extern unsigned long netsocket_sessions_sent;
+extern unsigned long tcpsocket_resyncs;
+extern unsigned long tcpsocket_advertises;
+extern unsigned long tcpsocket_gaps;
+
+static struct instance *instance_get(struct joolnlhdr *jhdr)
+{
+	struct instance *instance;
+
+	SLIST_FOREACH(instance, &instances, hook)
+		if (instance->xt == jhdr->xt
+				&& strncmp(instance->iname, jhdr->iname,
+						INAME_MAX_SIZE) == 0)
+			return instance;
+
+	instance = calloc(1, sizeof(struct instance));
+	if (!instance)
+		return NULL;
+	memcpy(instance->iname, jhdr->iname, INAME_MAX_SIZE);
+	instance->iname[INAME_MAX_SIZE - 1] = '\0';
+	instance->xt = jhdr->xt;
+	SLIST_INSERT_HEAD(&instances, instance, hook);
+	return instance;
+}
+
+static void unsync_all(void)
+{
+	struct instance *instance;
+
+	SLIST_FOREACH(instance, &instances, hook)
+		instance->synced = false;
+}
+
+static void apply_push(struct instance *instance,
+		struct joolnl_stats_push *push)
+{
+	struct nlattr *attr;
+	int rem;
+	int id;
+
+	if (push->keyframe) {
+		memset(instance->values, 0, sizeof(instance->values));
+		instance->synced = true;
+	} else if (!instance->synced || push->seq != instance->seq + 1) {
+		/* We missed a push; wait for the next keyframe. */
+		instance->synced = false;
+		return;
+	}
+
+	nla_for_each_nested(attr, push->deltas, rem) {
+		id = nla_type(attr);
+		if (id < 1 || JSTAT_COUNT <= id || nla_len(attr) < sizeof(__u64))
+			continue;
+		/* Unsigned wraparound also handles negative gauge deltas. */
+		instance->values[id] += nla_get_u64(attr);
+	}
+
+	instance->seq = push->seq;
+}
+
+static int push_cb(struct nl_msg *msg, void *arg)
+{
+	struct nlmsghdr *nhdr;
+	struct joolnlhdr *jhdr;
+	struct joolnl_stats_push push;
+	struct instance *instance;
+	struct jool_result result;
+
+	nhdr = nlmsg_hdr(msg);
+	if (!genlmsg_valid_hdr(nhdr, sizeof(struct joolnlhdr))) {
+		syslog(LOG_ERR, "Kernel sent invalid stats: Message too short to contain headers");
+		return 0;
+	}
+
+	jhdr = genlmsg_user_hdr(genlmsg_hdr(nhdr));
+	result = validate_joolnlhdr(jhdr, XT_ANY);
+	if (result.error) {
+		pr_result_syslog(&result);
+		return 0;
+	}
+
+	result = joolnl_stats_push_parse(msg, &push);
+	if (result.error) {
+		pr_result_syslog(&result);
+		return 0;
+	}
+
+	instance = instance_get(jhdr);
+	if (!instance) {
+		syslog(LOG_ERR, "Out of memory; ignoring stats push.");
+		return 0;
+	}
+
+	apply_push(instance, &push);
+	return 0;
+}
+
+static void kernel_read(struct loop_handler *handler)
+{
+	unsigned int i;
+	int error;
+
+	for (i = 0; i < METRICS_BATCH; i++) {
+		error = nl_recvmsgs_default(jsocket.sk);
+		if (error == -NLE_AGAIN)
+			return;
+		if (error == -NLE_NOMEM) {
+			/* The socket overflowed, so we lost pushes. */
+			syslog(LOG_WARNING, "Stats pushes were dropped; waiting for keyframes.");
+			unsync_all();
+			continue;
+		}
+		if (error < 0) {
+			syslog(LOG_ERR, "Error receiving stats from kernelspace: %s",
+					nl_geterror(error));
+			return;
+		}
+	}
+}
+
+static int kernel_setup(void)
+{
+	int grp;
+	int error;
+	struct jool_result result;
+
+	/* (The type only matters for requests, and we don't send any.) */
+	result = joolnl_setup(&jsocket, XT_NAT64);
+	if (result.error)
+		return pr_result_syslog(&result);
+
+	nl_socket_disable_seq_check(jsocket.sk);
+	error = nl_socket_modify_cb(jsocket.sk, NL_CB_VALID, NL_CB_CUSTOM,
+			push_cb, NULL);
+	if (error) {
+		syslog(LOG_ERR, "Couldn't modify the stats socket's callbacks.");
+		goto fail;
+	}
+
+	grp = genl_ctrl_resolve_grp(jsocket.sk, JOOLNL_FAMILY,
+			JOOLNL_STATS_GRP_NAME);
+	if (grp < 0) {
+		syslog(LOG_ERR, "Unable to resolve the stats multicast group.");
+		error = grp;
+		goto fail;
+	}
+
+	error = nl_socket_add_membership(jsocket.sk, grp);
+	if (error) {
+		syslog(LOG_ERR, "Can't register to the stats multicast group.");
+		goto fail;
+	}
+
+	error = nl_socket_set_nonblocking(jsocket.sk);
+	if (error) {
+		syslog(LOG_ERR, "Can't make the stats socket nonblocking.");
+		goto fail;
+	}
+
+	error = nl_socket_set_buffer_size(jsocket.sk, METRICS_SKBUF_SIZE, 0);
+	if (error) {
+		/* Not fatal; we'll just resync more often. */
+		syslog(LOG_WARNING, "Can't enlarge the stats socket's buffer: %s",
+				nl_geterror(error));
+	}
+
+	kernel_handler.fd = nl_socket_get_fd(jsocket.sk);
+	kernel_handler.read = kernel_read;
+	kernel_handler.write = NULL;
+	kernel_handler.flush = NULL;
+	error = loop_add(&kernel_handler);
+	if (error) {
+		joolnl_teardown(&jsocket);
+		return error;
+	}
+
+	return 0;
+
+fail:
+	joolnl_teardown(&jsocket);
+	syslog(LOG_ERR, "Netlink error message: %s", nl_geterror(error));
+	return error;
+}
+
+/* Prints @str as an OpenMetrics escaped string. */
+static void print_escaped(FILE *out, char const *str)
+{
+	for (; *str; str++) {
+		switch (*str) {
+		case '\\':
+			fputs("\\\\", out);
+			break;
+		case '"':
+			fputs("\\\"", out);
+			break;
+		case '\n':
+			fputs("\\n", out);
+			break;
+		default:
+			fputc(*str, out);
+		}
+	}
+}
+
+static bool is_gauge(enum jool_stat_id id)
+{
+	return id == JSTAT_BIB_ENTRIES || id == JSTAT_SESSIONS;
+}
+
+
+/* "JSTAT_FOO" -> "jool_foo" */
+static void print_name(FILE *out, struct joolnl_stat_metadata const *meta)
+{
+	char const *c;
+
+	fputs("jool_", out);
+	for (c = meta->name + strlen("JSTAT_"); *c; c++)
+		fputc((*c >= 'A' && *c <= 'Z') ? (*c - 'A' + 'a') : *c, out);
+}
+
+static void print_stat(FILE *out, struct joolnl_stat_metadata const *meta)
+{
+	struct instance *instance;
+	bool gauge;
+
+	gauge = is_gauge(meta->id);
+
+	fputs("# TYPE ", out);
+	print_name(out, meta);
+	fprintf(out, " %s\n", gauge ? "gauge" : "counter");
+
+	fputs("# HELP ", out);
+	print_name(out, meta);
+	fputc(' ', out);
+	print_escaped(out, meta->doc);
+	fputc('\n', out);
+
+	SLIST_FOREACH(instance, &instances, hook) {
+		if (!instance->synced)
+			continue;
+		print_name(out, meta);
+		fprintf(out, "%s{jool_instance=\"", gauge ? "" : "_total");
+		print_escaped(out, instance->iname);
+		fprintf(out, "\",type=\"%s\"} %llu\n",
+				(instance->xt == XT_SIIT) ? "siit" : "nat64",
+				(unsigned long long)instance->values[meta->id]);
+	}
+}
+
+static void print_proxy_stat(FILE *out, char const *name, char const *help,
+		unsigned long value)
+{
+	fprintf(out, "# TYPE jool_proxy_%s counter\n", name);
+	fprintf(out, "# HELP jool_proxy_%s %s\n", name, help);
+	fprintf(out, "jool_proxy_%s_total %lu\n", name, value);
+}
+
+/* Returns the OpenMetrics exposition; the caller has to free() it. */
+static char *print_metrics(size_t *len)
+{
+	struct joolnl_stat_metadata const *meta;
+	char *result;
+	FILE *out;
+	int id;
+
+	out = open_memstream(&result, len);
+	if (!out)
+		return NULL;
+
+	for (id = 1; id < JSTAT_COUNT; id++) {
+		meta = joolnl_stats_meta(id);
+		if (meta)
+			print_stat(out, meta);
+	}
+
+	print_proxy_stat(out, "kernel_sent_pkts", "Packets sent to the kernel module.", modsocket_pkts_sent);
+	print_proxy_stat(out, "kernel_sent_bytes", "Session bytes sent to the kernel module.", modsocket_bytes_sent);
+	print_proxy_stat(out, "kernel_add_pkts", "Session batches handed to the kernel module.", modsocket_add_pkts);
+	print_proxy_stat(out, "kernel_add_bytes", "Session bytes handed to the kernel module.", modsocket_add_bytes);
+	print_proxy_stat(out, "net_rcvd_pkts", "Packets received from the network.", netsocket_pkts_rcvd);
+	print_proxy_stat(out, "net_rcvd_bytes", "Session bytes received from the network.", netsocket_bytes_rcvd);
+	print_proxy_stat(out, "net_rcvd_sessions", "Sessions received from the network.", netsocket_sessions_rcvd);
+	print_proxy_stat(out, "net_sent_pkts", "Packets sent to the network.", netsocket_pkts_sent);
+	print_proxy_stat(out, "net_sent_bytes", "Session bytes sent to the network.", netsocket_bytes_sent);
+	print_proxy_stat(out, "net_sent_sessions", "Sessions sent to the network.", netsocket_sessions_sent);
+	print_proxy_stat(out, "tcp_resyncs", "Batches resent to reconnecting TCP peers.", tcpsocket_resyncs);
+	print_proxy_stat(out, "tcp_advertises", "Times a TCP peer fell so far behind that a full advertisement had to be requested.", tcpsocket_advertises);
+	print_proxy_stat(out, "tcp_gaps", "Batches a remote proxy failed to deliver.", tcpsocket_gaps);
+
+	fputs("# EOF\n", out);
+
+	if (fclose(out)) {
+		free(result);
+		return NULL;
+	}
+	return result;
+}
+
+static void client_close(struct client *client)
+{
+	if (client->handler.fd < 0)
+		return;
+
+	loop_del(&client->handler);
+	close(client->handler.fd);
+	client->handler.fd = -1;
+	client->next_dead = graveyard;
+	graveyard = client;
+}
+
+static char *print_response(struct client *client, size_t *len)
+{
+	static char const *NOT_FOUND = "HTTP/1.0 404 Not Found\r\n"
+			"Content-Length: 0\r\n"
+			"Connection: close\r\n"
+			"\r\n";
+	char *body, *result;
+	size_t body_len;
+	int written;
+
+	if (strncmp(client->request, "GET /metrics ", strlen("GET /metrics ")) != 0
+			&& strncmp(client->request, "GET /metrics?", strlen("GET /metrics?")) != 0) {
+		*len = strlen(NOT_FOUND);
+		return strdup(NOT_FOUND);
+	}
+
+	body = print_metrics(&body_len);
+	if (!body)
+		return NULL;
+
+	written = asprintf(&result, "HTTP/1.0 200 OK\r\n"
+			"Content-Type: " CONTENT_TYPE "\r\n"
+			"Content-Length: %zu\r\n"
+			"Connection: close\r\n"
+			"\r\n"
+			"%s", body_len, body);
+	free(body);
+	if (written < 0)
+		return NULL;
+
+	*len = written;
+	return result;
+}
+
+static void client_write(struct loop_handler *handler)
+{
+	struct client *client = (struct client *)handler;
+	ssize_t bytes;
+
+	if (!client->response)
+		return;
+
+	while (handler->fd >= 0 && client->response_sent < client->response_len) {
+		bytes = send(handler->fd, client->response + client->response_sent,
+				client->response_len - client->response_sent,
+				MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (bytes < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				loop_watch_write(handler, true);
+				return;
+			}
+			pr_perror("Cannot send metrics", errno);
+			client_close(client);
+			return;
+		}
+		client->response_sent += bytes;
+	}
+
+	/* HTTP/1.0: The response ends with the connection. */
+	client_close(client);
+}
+
+static void client_read(struct loop_handler *handler)
+{
+	struct client *client = (struct client *)handler;
+	ssize_t bytes;
+
+	while (handler->fd >= 0 && !client->response) {
+		bytes = recv(handler->fd, client->request + client->request_len,
+				sizeof(client->request) - client->request_len - 1,
+				MSG_DONTWAIT);
+		if (bytes == 0) {
+			client_close(client);
+			return;
+		}
+		if (bytes < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				client_close(client);
+			return;
+		}
+
+		client->request_len += bytes;
+		client->request[client->request_len] = '\0';
+
+		if (!strstr(client->request, "\r\n\r\n")
+				&& !strstr(client->request, "\n\n")) {
+			if (client->request_len >= sizeof(client->request) - 1) {
+				syslog(LOG_WARNING, "Metrics request is too long; dropping.");
+				client_close(client);
+			}
+			continue;
+		}
+
+		client->response = print_response(client, &client->response_len);
+		if (!client->response) {
+			syslog(LOG_ERR, "Out of memory; dropping metrics request.");
+			client_close(client);
+			return;
+		}
+		client_write(handler);
+	}
+
+	if (handler->fd >= 0 && client->response) {
+		/* Drain whatever else the client sends. (We ignore it.) */
+		while (recv(handler->fd, client->request, sizeof(client->request),
+				MSG_DONTWAIT) > 0)
+			;
+	}
+}
+
+static void listener_read(struct loop_handler *handler)
+{
+	struct client *client;
+	int fd;
+
+	do {
+		fd = accept4(handler->fd, NULL, NULL,
+				SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				pr_perror("accept() failed", errno);
+			return;
+		}
+
+		client = calloc(1, sizeof(struct client));
+		if (!client) {
+			syslog(LOG_ERR, "Out of memory; rejecting metrics client.");
+			close(fd);
+			continue;
+		}
+		client->handler.fd = fd;
+		client->handler.read = client_read;
+		client->handler.write = client_write;
+
+		if (loop_add(&client->handler)) {
+			close(fd);
+			free(client);
+			continue;
+		}
+	} while (true);
+}
+
+static void metrics_flush(struct loop_handler *handler)
+{
+	struct client *client;
+
+	while (graveyard) {
+		client = graveyard;
+		graveyard = client->next_dead;
+		free(client->response);
+		free(client);
+	}
+}
+
+static int create_listener(void)
+{
+	struct addrinfo hints = { 0 };
+	struct addrinfo *ais, *ai;
+	const int yes = 1;
+	int sk;
+	int error;
+
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	error = getaddrinfo(cfg.address, cfg.port, &hints, &ais);
+	if (error) {
+		syslog(LOG_ERR, "getaddrinfo() failed: %s", gai_strerror(error));
+		return error;
+	}
+
+	for (ai = ais; ai; ai = ai->ai_next) {
+		sk = socket(ai->ai_family,
+				ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+				ai->ai_protocol);
+		if (sk < 0) {
+			pr_perror("socket() failed", errno);
+			continue;
+		}
+		if (setsockopt(sk, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes))
+				|| bind(sk, ai->ai_addr, ai->ai_addrlen)
+				|| listen(sk, SOMAXCONN)) {
+			pr_perror("Cannot listen for metrics clients", errno);
+			close(sk);
+			continue;
+		}
+
+		freeaddrinfo(ais);
+		listener.fd = sk;
+		listener.read = listener_read;
+		listener.flush = metrics_flush;
+		return loop_add(&listener);
+	}
+
+	freeaddrinfo(ais);
+	syslog(LOG_ERR, "None of the candidates yielded a listening socket.");
+	return 1;
+}
+
+int metrics_start(struct statsocket_cfg *statcfg)
+{
+	int error;
+
+	if (!statcfg->metrics_enabled)
+		return 0;
+
+	cfg.address = statcfg->metrics_address;
+	cfg.port = statcfg->metrics_port;
+	syslog(LOG_INFO, "Opening metrics exporter on [%s]:%s...", cfg.address,
+			cfg.port);
+
+	error = kernel_setup();
+	if (error)
+		return error;
+	error = create_listener();
+	if (error)
+		return error;
+
+	syslog(LOG_INFO, "Metrics exporter ready.");
+	return 0;
+}
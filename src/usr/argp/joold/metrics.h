@@ -0,0 +1,16 @@
+#ifndef SRC_USR_ARGP_JOOLD_METRICS_H_
+#define SRC_USR_ARGP_JOOLD_METRICS_H_
+
+/*
+ * OpenMetrics exporter.
+ *
+ * Listens to the kernel module's stats pushes (see stats-push-interval), and
+ * serves the counters of every instance in the namespace (plus the proxy's own)
+ * over HTTP, in OpenMetrics text format.
+ */
+
+#include "usr/argp/joold/statsocket.h"
+
+int metrics_start(struct statsocket_cfg *cfg);
+
+#endif /* SRC_USR_ARGP_JOOLD_METRICS_H_ */
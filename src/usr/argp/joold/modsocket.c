@@ -3,12 +3,12 @@
 #include <errno.h>
 #include <netlink/genl/ctrl.h>
 #include <netlink/genl/genl.h>
-#include <stdatomic.h>
 #include <stdbool.h>
 #include <syslog.h>
 
 #include "common/session.h"
 #include "usr/nl/joold.h"
+#include "usr/argp/joold/loop.h"
 #include "usr/argp/joold/netsocket.h"
 #include "usr/argp/log.h"
 #include "usr/util/str_utils.h"
@@ -16,24 +16,31 @@
 static char const *iname;
 
 static struct joolnl_socket jsocket;
+static struct loop_handler mod_handler;
 
-atomic_int modsocket_pkts_sent;
-atomic_int modsocket_bytes_sent;
+/* Requested size of the socket's kernel buffers. */
+#define MODSOCKET_SKBUF_SIZE (4 << 20)
+/* Maximum number of kernel messages handled per event loop round. */
+#define MODSOCKET_BATCH 64
+
+unsigned long modsocket_pkts_sent;
+unsigned long modsocket_bytes_sent;
+unsigned long modsocket_add_pkts;
+unsigned long modsocket_add_bytes;
 
 /* Called by the net socket whenever joold receives data from the network. */
 void modsocket_send(void *request, size_t request_len)
 {
 	struct jool_result result;
 	result = joolnl_joold_add(&jsocket, iname, request, request_len);
-	pr_result_syslog(&result);
-}
+	if (result.error) {
+		pr_result_syslog(&result);
+		return;
+	}
 
-#define SERIALIZED_SESSION_SIZE (		\
-		sizeof(struct in6_addr)		\
-		+ 2 * sizeof(struct in_addr)	\
-		+ sizeof(__be32)		\
-		+ 4 * sizeof(__be16)		\
-)
+	modsocket_add_pkts++;
+	modsocket_add_bytes += request_len;
+}
 
 typedef enum session_timer_type {
 	SESSION_TIMER_EST,
@@ -52,9 +59,8 @@ struct session_entry {
 	unsigned long expiration;
 };
 
-#define READ_RAW(serialized, field)					\
-	memcpy(&field, serialized, sizeof(field));			\
-	serialized += sizeof(field);
+#define READ_RAW(serialized, offset, field)				\
+	memcpy(&field, serialized + offset, sizeof(field))
 
 static int jnla_get_session_joold(struct nlattr *attr,
 		struct session_entry *entry)
@@ -64,28 +70,28 @@ static int jnla_get_session_joold(struct nlattr *attr,
 	__be16 tmp16;
 	__u16 __tmp16;
 
-	if (attr->nla_len < SERIALIZED_SESSION_SIZE) {
-		syslog(LOG_ERR, "Invalid request: Session size (%u) < %zu\n",
-				attr->nla_len, SERIALIZED_SESSION_SIZE);
+	if (attr->nla_len < JOOLD_SESSION_SIZE) {
+		syslog(LOG_ERR, "Invalid request: Session size (%u) < %u\n",
+				attr->nla_len, JOOLD_SESSION_SIZE);
 		return -EINVAL;
 	}
 
 	memset(entry, 0, sizeof(*entry));
 	serialized = nla_data(attr);
 
-	READ_RAW(serialized, entry->src6.l3);
-	READ_RAW(serialized, entry->src4.l3);
-	READ_RAW(serialized, entry->dst4.l3);
-	READ_RAW(serialized, tmp32);
+	READ_RAW(serialized, JOOLD_SESSION_SRC6, entry->src6.l3);
+	READ_RAW(serialized, JOOLD_SESSION_SRC4, entry->src4.l3);
+	READ_RAW(serialized, JOOLD_SESSION_DST4, entry->dst4.l3);
+	READ_RAW(serialized, JOOLD_SESSION_EXPIRATION, tmp32);
 
-	READ_RAW(serialized, tmp16);
+	READ_RAW(serialized, JOOLD_SESSION_SRC6_PORT, tmp16);
 	entry->src6.l4 = ntohs(tmp16);
-	READ_RAW(serialized, tmp16);
+	READ_RAW(serialized, JOOLD_SESSION_SRC4_PORT, tmp16);
 	entry->src4.l4 = ntohs(tmp16);
-	READ_RAW(serialized, tmp16);
+	READ_RAW(serialized, JOOLD_SESSION_DST4_PORT, tmp16);
 	entry->dst4.l4 = ntohs(tmp16);
 
-	READ_RAW(serialized, tmp16);
+	READ_RAW(serialized, JOOLD_SESSION_META, tmp16);
 	__tmp16 = ntohs(tmp16);
 	entry->proto = (__tmp16 >> 5) & 3;
 	entry->state = (__tmp16 >> 2) & 7;
@@ -119,6 +125,15 @@ static void print_sessions(struct nlattr *root)
 	}
 }
 
+/* Asks the kernel module to send us all of its sessions again. */
+void modsocket_advertise(void)
+{
+	struct jool_result result;
+
+	result = joolnl_joold_advertise(&jsocket, iname);
+	pr_result_syslog(&result);
+}
+
 static void do_ack(void)
 {
 	struct jool_result result;
@@ -168,6 +183,11 @@ static int updated_entries_cb(struct nl_msg *msg, void *arg)
 		goto fail;
 	}
 
+	if (genlmsg_attrlen(ghdr, sizeof(struct joolnlhdr)) == 0) {
+		/* Success response to modsocket_advertise(); not a batch. */
+		return 0;
+	}
+
 	root = genlmsg_attrdata(ghdr, sizeof(struct joolnlhdr));
 	if (nla_type(root) != JNLAR_SESSION_ENTRIES) {
 		syslog(LOG_ERR, "Kernel sent invalid data: Message lacks a session container");
@@ -239,6 +259,49 @@ fail:
 	return result.error;
 }
 
+static void modsocket_read(struct loop_handler *handler)
+{
+	unsigned int i;
+	int error;
+
+	for (i = 0; i < MODSOCKET_BATCH; i++) {
+		error = nl_recvmsgs_default(jsocket.sk);
+		if (error == -NLE_AGAIN)
+			return;
+		if (error < 0) {
+			syslog(LOG_ERR, "Error receiving packet from kernelspace: %s",
+					nl_geterror(error));
+		}
+	}
+}
+
+/* Has the event loop serve the socket, rather than modsocket_listen(). */
+int modsocket_register(void)
+{
+	int error;
+
+	error = nl_socket_set_nonblocking(jsocket.sk);
+	if (error) {
+		syslog(LOG_ERR, "Can't make the kernel socket nonblocking: %s",
+				nl_geterror(error));
+		return error;
+	}
+
+	error = nl_socket_set_buffer_size(jsocket.sk, MODSOCKET_SKBUF_SIZE,
+			MODSOCKET_SKBUF_SIZE);
+	if (error) {
+		/* Not fatal; we'll just drop more under stress. */
+		syslog(LOG_WARNING, "Can't enlarge the kernel socket's buffers: %s",
+				nl_geterror(error));
+	}
+
+	mod_handler.fd = nl_socket_get_fd(jsocket.sk);
+	mod_handler.read = modsocket_read;
+	mod_handler.write = NULL;
+	mod_handler.flush = NULL;
+	return loop_add(&mod_handler);
+}
+
 void *modsocket_listen(void *arg)
 {
 	int error;
@@ -6,8 +6,10 @@
 #include <stddef.h>
 
 int modsocket_setup(char const *iname);
+int modsocket_register(void);
 
 void *modsocket_listen(void *arg);
 void modsocket_send(void *buffer, size_t size);
+void modsocket_advertise(void);
 
 #endif /* SRC_USR_ARGP_JOOLD_MODSOCKET_H_ */
@@ -1,9 +1,10 @@
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
 #include "usr/argp/joold/netsocket.h"
 
 #include <errno.h>
 #include <netdb.h>
-#include <pthread.h>
-#include <stdatomic.h>
+#include <string.h>
+#include <strings.h>
 #include <syslog.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -11,6 +12,8 @@
 #include <net/if.h>
 
 #include "modsocket.h"
+#include "loop.h"
+#include "tcpsocket.h"
 #include "common/config.h"
 #include "usr/argp/log.h"
 #include "usr/joold/json.h"
@@ -24,10 +27,43 @@ static struct addrinfo *addr_candidates;
 /** Candidate from @addr_candidates that we managed to bind the socket with. */
 static struct addrinfo *bound_address;
 
-atomic_int netsocket_pkts_rcvd;
-atomic_int netsocket_bytes_rcvd;
-atomic_int netsocket_pkts_sent;
-atomic_int netsocket_bytes_sent;
+/* Requested size of the socket's kernel buffers. */
+#define NETSOCKET_SKBUF_SIZE (4 << 20)
+
+/* Maximum number of datagrams fetched by a single recvmmsg(). */
+#define RCV_SLOTS 32
+/* Maximum number of recvmmsg()s per event loop round. */
+#define RCV_ROUNDS 8
+/*
+ * Maximum size of the session nests we hand to the kernel.
+ * (Netlink attribute lengths are 16 bits wide.)
+ */
+#define RCV_NEST_MAX 32768
+
+static unsigned char rcv_buffers[RCV_SLOTS][WIRE_MAX_LEN];
+static unsigned char rcv_nest[RCV_NEST_MAX];
+static size_t rcv_nest_len;
+
+/* Maximum number of datagrams sent by a single sendmmsg(). */
+#define SND_SLOTS 64
+/* Space shared by the queued datagrams. */
+#define SND_ARENA_SIZE (256 << 10)
+
+static unsigned char snd_arena[SND_ARENA_SIZE];
+static size_t snd_arena_used;
+static struct iovec snd_iovs[SND_SLOTS];
+static struct mmsghdr snd_msgs[SND_SLOTS];
+static unsigned int snd_sessions[SND_SLOTS];
+static unsigned int snd_count;
+
+static struct loop_handler net_handler;
+
+unsigned long netsocket_pkts_rcvd;
+unsigned long netsocket_bytes_rcvd;
+unsigned long netsocket_sessions_rcvd;
+unsigned long netsocket_pkts_sent;
+unsigned long netsocket_bytes_sent;
+unsigned long netsocket_sessions_sent;
 
 #define _setsockopt(s, p, k, v) setsockopt(sk, p, k, &v, sizeof(v))
 #define setsockopt4(sk, key, val) _setsockopt(sk, IPPROTO_IP, key, val)
@@ -43,6 +79,24 @@ static struct in6_addr *get_addr6(struct addrinfo *addr)
 	return &((struct sockaddr_in6 *)addr->ai_addr)->sin6_addr;
 }
 
+/*
+ * The default buffers are too small to absorb the bursts a busy peer generates.
+ * The FORCE variants ignore net.core.[rw]mem_max, but need CAP_NET_ADMIN; the
+ * fallback is capped by the sysctl. Neither failure is fatal.
+ */
+static void enlarge_buffer(int force_key, int key, char const *name)
+{
+	int size = NETSOCKET_SKBUF_SIZE;
+
+	if (_setsockopt(sk, SOL_SOCKET, force_key, size) == 0)
+		return;
+	if (_setsockopt(sk, SOL_SOCKET, key, size) == 0)
+		return;
+
+	syslog(LOG_WARNING, "Could not enlarge the socket's %s buffer: %s",
+			name, strerror(errno));
+}
+
 static int try_address(void)
 {
 	const int yes = 1;
@@ -67,6 +121,9 @@ static int try_address(void)
 		return 1;
 	}
 
+	enlarge_buffer(SO_RCVBUFFORCE, SO_RCVBUF, "receive");
+	enlarge_buffer(SO_SNDBUFFORCE, SO_SNDBUF, "send");
+
 	syslog(LOG_INFO, "The socket to the network was created.");
 	return 0;
 }
@@ -298,34 +355,144 @@ static int adjust_mcast_opts(void)
 	return 1;
 }
 
-static void *netsocket_listen(void *arg)
+int net_str2transport(char const *str, enum net_transport *result)
 {
-	char buffer[JOOLD_MAX_PAYLOAD];
-	int bytes;
+	if (!str || strcasecmp(str, "udp") == 0) {
+		*result = NET_TRANSPORT_UDP;
+		return 0;
+	}
+	if (strcasecmp(str, "tcp") == 0) {
+		*result = NET_TRANSPORT_TCP;
+		return 0;
+	}
 
-	syslog(LOG_INFO, "Listening...");
+	return EINVAL;
+}
 
-	do {
-		bytes = recv(sk, buffer, sizeof(buffer), 0);
-		if (bytes < 0) {
-			pr_perror("Error receiving packet from the network",
-					errno);
-			continue;
+/* Hands the sessions collected so far over to the kernel module. */
+void netsocket_receive_flush(void)
+{
+	if (rcv_nest_len == 0)
+		return;
+	modsocket_send(rcv_nest, rcv_nest_len);
+	rcv_nest_len = 0;
+}
+
+/*
+ * Queues the sessions contained in @datagram for delivery to the kernel module.
+ * (They are delivered in bulk by netsocket_receive_flush().)
+ */
+void netsocket_receive(unsigned char *datagram, size_t datagram_len)
+{
+	static unsigned char nest[WIRE_MAX_LEN];
+	unsigned int sessions;
+	int nest_len;
+
+	netsocket_pkts_rcvd++;
+	netsocket_bytes_rcvd += datagram_len;
+
+	nest_len = wire_decode(datagram, datagram_len, nest, sizeof(nest),
+			&sessions);
+	if (nest_len < 0)
+		return;
+	netsocket_sessions_rcvd += sessions;
+
+	if (nest_len > RCV_NEST_MAX) {
+		/* Too big to merge; send it by itself. */
+		netsocket_receive_flush();
+		modsocket_send(nest, nest_len);
+		return;
+	}
+
+	if (rcv_nest_len + nest_len > RCV_NEST_MAX)
+		netsocket_receive_flush();
+	memcpy(rcv_nest + rcv_nest_len, nest, nest_len);
+	rcv_nest_len += nest_len;
+}
+
+/*
+ * Drains the socket, merging the sessions of all the datagrams into as few
+ * Netlink messages as possible.
+ */
+static void netsocket_read(struct loop_handler *handler)
+{
+	struct mmsghdr msgs[RCV_SLOTS];
+	struct iovec iovs[RCV_SLOTS];
+	unsigned int round;
+	int count;
+	int i;
+
+	for (i = 0; i < RCV_SLOTS; i++) {
+		iovs[i].iov_base = rcv_buffers[i];
+		iovs[i].iov_len = WIRE_MAX_LEN;
+	}
+
+	for (round = 0; round < RCV_ROUNDS; round++) {
+		memset(msgs, 0, sizeof(msgs));
+		for (i = 0; i < RCV_SLOTS; i++) {
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
 		}
 
-		netsocket_pkts_rcvd++;
-		netsocket_bytes_rcvd += bytes;
+		count = recvmmsg(sk, msgs, RCV_SLOTS, MSG_DONTWAIT, NULL);
+		if (count < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				pr_perror("Error receiving packets from the network",
+						errno);
+			break;
+		}
 
-		syslog(LOG_DEBUG, "Received %d bytes from the network.", bytes);
-		modsocket_send(buffer, bytes);
-	} while (true);
+		syslog(LOG_DEBUG, "Received %d datagrams from the network.",
+				count);
 
-	return NULL;
+		for (i = 0; i < count; i++) {
+			if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+				syslog(LOG_ERR, "Dropping truncated datagram.");
+				continue;
+			}
+			netsocket_receive(rcv_buffers[i], msgs[i].msg_len);
+		}
+
+		if (count < RCV_SLOTS)
+			break;
+	}
+
+	netsocket_receive_flush();
+}
+
+/* Sends the queued datagrams to the network. */
+static void netsocket_flush(struct loop_handler *handler)
+{
+	unsigned int sent;
+	unsigned int i;
+	int result;
+
+	sent = 0;
+	while (sent < snd_count) {
+		result = sendmmsg(sk, &snd_msgs[sent], snd_count - sent, 0);
+		if (result < 0) {
+			if (errno == EINTR)
+				continue;
+			pr_perror("Could not send packets to the network",
+					errno);
+			break;
+		}
+
+		for (i = sent; i < sent + result; i++) {
+			netsocket_pkts_sent++;
+			netsocket_bytes_sent += snd_msgs[i].msg_len;
+			netsocket_sessions_sent += snd_sessions[i];
+		}
+		sent += result;
+	}
+
+	syslog(LOG_DEBUG, "Sent %u datagrams to the network.", sent);
+	snd_count = 0;
+	snd_arena_used = 0;
 }
 
 int netsocket_start(struct netsocket_cfg *cfg)
 {
-	pthread_t net_thread;
 	int error;
 
 	netcfg = *cfg;
@@ -339,6 +506,13 @@ int netsocket_start(struct netsocket_cfg *cfg)
 		syslog(LOG_ERR, "The multicast address is mandatory.");
 		return EINVAL;
 	}
+	if (cfg->wire.compress && !wire_compression_supported()) {
+		syslog(LOG_ERR, "Compression was requested, but I was compiled without zstd.");
+		return EINVAL;
+	}
+
+	if (netcfg.transport == NET_TRANSPORT_TCP)
+		return tcpsocket_start(&netcfg);
 
 	error = create_socket();
 	if (error)
@@ -348,34 +522,66 @@ int netsocket_start(struct netsocket_cfg *cfg)
 	if (error)
 		return error;
 
-	error = pthread_create(&net_thread, NULL, netsocket_listen, NULL);
-	if (error) {
-		pr_perror("Unable to start netsocket thread", error);
+	net_handler.fd = sk;
+	net_handler.read = netsocket_read;
+	net_handler.write = NULL;
+	net_handler.flush = netsocket_flush;
+	error = loop_add(&net_handler);
+	if (error)
 		return error;
-	}
 
 	syslog(LOG_INFO, "Netsocket ready.");
 	return 0;
 }
 
+void netsocket_stop(void)
+{
+	if (netcfg.enabled && netcfg.transport == NET_TRANSPORT_TCP)
+		tcpsocket_stop();
+}
+
 bool netsocket_enabled(void)
 {
 	return netcfg.enabled;
 }
 
-void netsocket_send(void *buffer, size_t size)
+/*
+ * Queues @nest for sending. The datagrams are actually sent in bulk when the
+ * queue fills up, or at the end of the current event loop round.
+ */
+void netsocket_send(void *nest, size_t nest_len)
 {
-	int bytes;
-
-	syslog(LOG_DEBUG, "Sending %zu bytes to the network...", size);
-	bytes = sendto(sk, buffer, size, 0,
-			bound_address->ai_addr,
-			bound_address->ai_addrlen);
-	if (bytes < 0)
-		pr_perror("Could not send a packet to the network", errno);
-	else {
-		syslog(LOG_DEBUG, "Sent %d bytes to the network.\n", bytes);
-		netsocket_pkts_sent++;
-		netsocket_bytes_sent += bytes;
+	struct mmsghdr *msg;
+	unsigned int sessions;
+	int size;
+
+	if (netcfg.transport == NET_TRANSPORT_TCP) {
+		tcpsocket_send(nest, nest_len);
+		return;
 	}
+
+	if (snd_count >= SND_SLOTS
+			|| SND_ARENA_SIZE - snd_arena_used < WIRE_ENCODED_MAX(nest_len))
+		netsocket_flush(&net_handler);
+
+	sessions = 0;
+	size = wire_encode(&netcfg.wire, nest, nest_len,
+			snd_arena + snd_arena_used,
+			SND_ARENA_SIZE - snd_arena_used, &sessions);
+	if (size < 0)
+		return;
+
+	snd_iovs[snd_count].iov_base = snd_arena + snd_arena_used;
+	snd_iovs[snd_count].iov_len = size;
+
+	msg = &snd_msgs[snd_count];
+	memset(msg, 0, sizeof(*msg));
+	msg->msg_hdr.msg_name = bound_address->ai_addr;
+	msg->msg_hdr.msg_namelen = bound_address->ai_addrlen;
+	msg->msg_hdr.msg_iov = &snd_iovs[snd_count];
+	msg->msg_hdr.msg_iovlen = 1;
+	snd_sessions[snd_count] = sessions;
+
+	snd_arena_used += size;
+	snd_count++;
 }
@@ -6,12 +6,30 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "usr/argp/joold/wire.h"
+
+enum net_transport {
+	/* Datagrams multicasted to every other proxy. */
+	NET_TRANSPORT_UDP = 0,
+	/* Sequenced batches unicasted to every peer over TCP. */
+	NET_TRANSPORT_TCP,
+};
+
 struct netsocket_cfg {
 	bool enabled;
-	/** Address where the sessions will be advertised. Lacks a default. */
+	enum net_transport transport;
+	/**
+	 * Address where the sessions will be advertised. Lacks a default.
+	 * (In TCP mode, this is the address the peer listener is bound to.)
+	 */
 	char *mcast_addr;
-	/** UDP port where the sessions will be advertised. Lacks a default. */
+	/** Port where the sessions will be advertised. Lacks a default. */
 	char *mcast_port;
+	/**
+	 * TCP only. Comma-separated list of the proxies we send our sessions
+	 * to, in "<address>[#<port>]" format.
+	 */
+	char *peers;
 
 	/**
 	 * On IPv4, this should be one addresses from the interface where the
@@ -24,10 +42,19 @@ struct netsocket_cfg {
 	char *out_interface;
 
 	int ttl;
+
+	/** How the sessions are encoded on the network. */
+	struct wire_cfg wire;
 };
 
+int net_str2transport(char const *str, enum net_transport *result);
+
 int netsocket_start(struct netsocket_cfg *);
+void netsocket_stop(void);
 bool netsocket_enabled(void);
-void netsocket_send(void *buffer, size_t size);
+void netsocket_send(void *nest, size_t nest_len);
+
+void netsocket_receive(unsigned char *datagram, size_t datagram_len);
+void netsocket_receive_flush(void);
 
 #endif /* SRC_USR_ARGP_JOOLD_NETSOCKET_H_ */
@@ -2,8 +2,6 @@
 
 #include <errno.h>
 #include <netdb.h>
-#include <pthread.h>
-#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -14,22 +12,31 @@
 #include <sys/socket.h>
 
 #include "usr/argp/log.h"
+#include "usr/argp/joold/loop.h"
+#include "usr/argp/joold/metrics.h"
 
 static struct statsocket_cfg statcfg;
 
 struct sockfd {
-	int fd;
+	struct loop_handler handler;
 	SLIST_ENTRY(sockfd) hook;
 };
 
 SLIST_HEAD(sockfds, sockfd);
 
-extern atomic_int modsocket_pkts_sent;
-extern atomic_int modsocket_bytes_sent;
-extern atomic_int netsocket_pkts_rcvd;
-extern atomic_int netsocket_bytes_rcvd;
-extern atomic_int netsocket_pkts_sent;
-extern atomic_int netsocket_bytes_sent;
+extern unsigned long modsocket_pkts_sent;
+extern unsigned long modsocket_bytes_sent;
+extern unsigned long modsocket_add_pkts;
+extern unsigned long modsocket_add_bytes;
+extern unsigned long netsocket_pkts_rcvd;
+extern unsigned long netsocket_bytes_rcvd;
+extern unsigned long netsocket_sessions_rcvd;
+extern unsigned long netsocket_pkts_sent;
+extern unsigned long netsocket_bytes_sent;
+extern unsigned long netsocket_sessions_sent;
+extern unsigned long tcpsocket_resyncs;
+extern unsigned long tcpsocket_advertises;
+extern unsigned long tcpsocket_gaps;
 
 /* buf must length INET6_ADDRSTRLEN. */
 static char const *
@@ -100,7 +107,7 @@ static int create_sockets(struct sockfds *fds)
 		fd = malloc(sizeof(struct sockfd));
 		if (!fd)
 			return ENOMEM;
-		fd->fd = sk;
+		fd->handler.fd = sk;
 		SLIST_INSERT_HEAD(fds, fd, hook);
 	}
 
@@ -110,35 +117,42 @@ static int create_sockets(struct sockfds *fds)
 
 #define BUFFER_SIZE 1024
 
-void *serve_stats(void *arg)
+static void serve_stats(struct loop_handler *handler)
 {
-	struct sockfd *sfd;
 	struct sockaddr_storage peer_addr;
 	socklen_t peer_addr_len;
 	int nread, nstr, nwritten;
 	char buffer[BUFFER_SIZE];
 
-	sfd = (struct sockfd *) arg;
-
 	while (true) {
 		peer_addr_len = sizeof(peer_addr);
-		nread = recvfrom(sfd->fd, buffer, BUFFER_SIZE, 0,
+		nread = recvfrom(handler->fd, buffer, BUFFER_SIZE, MSG_DONTWAIT,
 				(struct sockaddr *) &peer_addr,
 				&peer_addr_len);
 		if (nread == -1)
-			continue; /* Ignore failed request */
+			return; /* Drained, or failed request */
 
 		nstr = snprintf(buffer, BUFFER_SIZE,
-				"KERNEL_SENT_PKTS,%d\nKERNEL_SENT_BYTES,%d\n"
-				"NET_RCVD_PKTS,%d\nNET_RCVD_BYTES,%d\n"
-				"NET_SENT_PKTS,%d\nNET_SENT_BYTES,%d\n",
+				"KERNEL_SENT_PKTS,%lu\nKERNEL_SENT_BYTES,%lu\n"
+				"KERNEL_ADD_PKTS,%lu\nKERNEL_ADD_BYTES,%lu\n"
+				"NET_RCVD_PKTS,%lu\nNET_RCVD_BYTES,%lu\n"
+				"NET_RCVD_SESSIONS,%lu\n"
+				"NET_SENT_PKTS,%lu\nNET_SENT_BYTES,%lu\n"
+				"NET_SENT_SESSIONS,%lu\n"
+				"TCP_RESYNCS,%lu\nTCP_ADVERTISES,%lu\n"
+				"TCP_GAPS,%lu\n",
 				modsocket_pkts_sent, modsocket_bytes_sent,
+				modsocket_add_pkts, modsocket_add_bytes,
 				netsocket_pkts_rcvd, netsocket_bytes_rcvd,
-				netsocket_pkts_sent, netsocket_bytes_sent);
+				netsocket_sessions_rcvd,
+				netsocket_pkts_sent, netsocket_bytes_sent,
+				netsocket_sessions_sent,
+				tcpsocket_resyncs, tcpsocket_advertises,
+				tcpsocket_gaps);
 		if (nstr >= BUFFER_SIZE)
 			snprintf(buffer, BUFFER_SIZE, "Bug!");
 
-		nwritten = sendto(sfd->fd, buffer, nstr, 0,
+		nwritten = sendto(handler->fd, buffer, nstr, 0,
 				(struct sockaddr *) &peer_addr,
 				peer_addr_len);
 		if (nwritten != nstr)
@@ -150,10 +164,14 @@ int statsocket_start(struct statsocket_cfg *cfg)
 {
 	struct sockfds fds;
 	struct sockfd *fd;
-	pthread_t thread;
 	int error;
 
 	statcfg = *cfg;
+
+	error = metrics_start(cfg);
+	if (error)
+		return error;
+
 	syslog(LOG_INFO, "Opening statsocket...");
 
 	if (!statcfg.enabled) {
@@ -168,12 +186,12 @@ int statsocket_start(struct statsocket_cfg *cfg)
 		return error;
 
 	SLIST_FOREACH(fd, &fds, hook) {
-		error = pthread_create(&thread, NULL, serve_stats, fd);
-		if (error) {
-			syslog(LOG_ERR, "Unable to start statsocket thread: %s",
-					strerror(error));
+		fd->handler.read = serve_stats;
+		fd->handler.write = NULL;
+		fd->handler.flush = NULL;
+		error = loop_add(&fd->handler);
+		if (error)
 			return error;
-		}
 	}
 
 	syslog(LOG_INFO, "Statsocket ready.");
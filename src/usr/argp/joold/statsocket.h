@@ -7,6 +7,11 @@ struct statsocket_cfg {
 	bool enabled;
 	char *address;
 	char *port;
+
+	/* OpenMetrics exporter. (See metrics.h.) */
+	bool metrics_enabled;
+	char *metrics_address;
+	char *metrics_port;
 };
 
 int statsocket_start(struct statsocket_cfg *);
@@ -0,0 +1,1003 @@
+#define _GNU_SOURCE /* accept4() */
+#include "usr/argp/joold/tcpsocket.h"
+
+#include <endian.h>
+#include <errno.h>
+#include <netdb.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#include "usr/argp/log.h"
+#include "usr/argp/joold/loop.h"
+#include "usr/argp/joold/modsocket.h"
+
+/*
+ * Frame header:
+ *
+ *	0	'J'
+ *	1	'T'
+ *	2	Type (enum frame_type)
+ *	3	Reserved (zero)
+ *	4-7	Payload length (big endian)
+ *	8-15	Sequence number (big endian); meaning depends on the type
+ */
+#define FRAME_MAGIC0 'J'
+#define FRAME_MAGIC1 'T'
+#define FRAME_HDR_LEN 16
+#define FRAME_MAX_LEN (FRAME_HDR_LEN + WIRE_MAX_LEN)
+
+enum frame_type {
+	/* Sender -> receiver. Seq: The sender's node ID. No payload. */
+	FRAME_HELLO = 1,
+	/* Receiver -> sender. Seq: Last batch received from that node. */
+	FRAME_HELLO_ACK,
+	/* Sender -> receiver. Seq: Batch number. Payload: Encoded sessions. */
+	FRAME_DATA,
+	/* Receiver -> sender. Seq: Last batch received. No payload. */
+	FRAME_ACK,
+};
+
+/* Maximum number of batches kept for resynchronization. */
+#define HISTORY_SLOTS 4096
+/* Maximum number of bytes kept for resynchronization. */
+#define HISTORY_MAX_BYTES (64 << 20)
+/* Seconds between reconnection attempts. */
+#define RECONNECT_INTERVAL 1
+/* Minimum seconds between full advertisement requests. */
+#define ADVERTISE_INTERVAL 10
+/* Size of the @nodes hash table. */
+#define NODE_BUCKETS 64
+/*
+ * Seconds a node can stay disconnected before we forget it. (If it comes back
+ * afterwards, it will simply resend everything it still has.)
+ */
+#define NODE_TIMEOUT 3600
+
+struct batch {
+	uint64_t seq;
+	unsigned int sessions;
+	/* Length of @frame, header included. */
+	size_t len;
+	unsigned char *frame;
+};
+
+static struct batch history[HISTORY_SLOTS];
+/* Sequence number of the oldest batch in @history. */
+static uint64_t history_first = 1;
+/* Sequence number the next batch will get. */
+static uint64_t history_next = 1;
+static size_t history_bytes;
+
+enum peer_state {
+	PEER_DISCONNECTED,
+	PEER_CONNECTING,
+	/* HELLO sent; waiting for HELLO_ACK. */
+	PEER_HELLO,
+	PEER_READY,
+};
+
+/* A proxy we send our sessions to. */
+struct peer {
+	struct loop_handler handler; /* Needs to be first. */
+	char *addr;
+	char *port;
+	struct addrinfo *ai;
+	enum peer_state state;
+	/* Next batch to send. */
+	uint64_t next;
+	/* Bytes from batch @next that have already been sent. */
+	size_t offset;
+	/*
+	 * Last batch the peer confirmed. Batches every peer has confirmed are
+	 * released from the history.
+	 */
+	uint64_t acked;
+	bool watching_write;
+	/* The peer only ever sends us headers. */
+	unsigned char buffer[FRAME_HDR_LEN];
+	size_t buffer_len;
+};
+
+/*
+ * A proxy that sends its sessions to us. Survives its connections, but not
+ * NODE_TIMEOUT seconds without any.
+ */
+struct node {
+	uint64_t id;
+	/* Last batch we received from it. */
+	uint64_t last;
+	/* Open connections that belong to this node. */
+	unsigned int conns;
+	/* When @conns last dropped to zero. */
+	time_t orphaned;
+	struct node *next;
+};
+
+/* A connection from a node. */
+struct conn {
+	struct loop_handler handler; /* Needs to be first. */
+	struct node *node;
+	unsigned char buffer[FRAME_MAX_LEN];
+	size_t buffer_len;
+	bool ack_pending;
+	struct conn *next_dead;
+};
+
+static struct netsocket_cfg *netcfg;
+/* Identifies this process (not the host) to our peers. */
+static uint64_t node_id;
+
+static struct peer *peers;
+static unsigned int peer_count;
+/* Indexed by node ID. (IDs are random, so they need no further hashing.) */
+static struct node *nodes[NODE_BUCKETS];
+/* Closed connections; they're freed at the end of the loop round. */
+static struct conn *graveyard;
+
+static struct loop_handler listener;
+static struct loop_handler timer;
+static time_t last_advertise;
+
+extern unsigned long netsocket_pkts_sent;
+extern unsigned long netsocket_bytes_sent;
+extern unsigned long netsocket_sessions_sent;
+
+/* Batches resent from the history after a reconnection. */
+unsigned long tcpsocket_resyncs;
+/* Times we had to fall back to a full advertisement. */
+unsigned long tcpsocket_advertises;
+/* Batches our nodes were detected to have skipped. */
+unsigned long tcpsocket_gaps;
+
+static void frame_init(unsigned char *frame, enum frame_type type,
+		uint32_t payload_len, uint64_t seq)
+{
+	uint32_t len32 = htobe32(payload_len);
+	uint64_t seq64 = htobe64(seq);
+
+	frame[0] = FRAME_MAGIC0;
+	frame[1] = FRAME_MAGIC1;
+	frame[2] = type;
+	frame[3] = 0;
+	memcpy(frame + 4, &len32, sizeof(len32));
+	memcpy(frame + 8, &seq64, sizeof(seq64));
+}
+
+static int frame_parse(unsigned char const *frame, enum frame_type *type,
+		uint32_t *payload_len, uint64_t *seq)
+{
+	uint32_t len32;
+	uint64_t seq64;
+
+	if (frame[0] != FRAME_MAGIC0 || frame[1] != FRAME_MAGIC1) {
+		syslog(LOG_ERR, "TCP peer sent a frame with a bad magic number.");
+		return EINVAL;
+	}
+
+	memcpy(&len32, frame + 4, sizeof(len32));
+	memcpy(&seq64, frame + 8, sizeof(seq64));
+	*type = frame[2];
+	*payload_len = be32toh(len32);
+	*seq = be64toh(seq64);
+
+	if (*payload_len > WIRE_MAX_LEN) {
+		syslog(LOG_ERR, "TCP peer sent an oversized frame (%u bytes).",
+				*payload_len);
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+/* Returns 0 if sent, EAGAIN if the socket is full, another errno otherwise. */
+static int send_control(int fd, enum frame_type type, uint64_t seq)
+{
+	unsigned char frame[FRAME_HDR_LEN];
+	ssize_t sent;
+
+	frame_init(frame, type, 0, seq);
+	sent = send(fd, frame, sizeof(frame), MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (sent == sizeof(frame))
+		return 0;
+	if (sent < 0)
+		return (errno == EWOULDBLOCK) ? EAGAIN : errno;
+	return EPIPE; /* Partial header; the stream is no longer usable. */
+}
+
+static struct batch *history_get(uint64_t seq)
+{
+	if (seq < history_first || history_next <= seq)
+		return NULL;
+	return &history[seq % HISTORY_SLOTS];
+}
+
+static void peer_disconnect(struct peer *peer)
+{
+	if (peer->state == PEER_DISCONNECTED)
+		return;
+
+	loop_del(&peer->handler);
+	close(peer->handler.fd);
+	peer->handler.fd = -1;
+	peer->state = PEER_DISCONNECTED;
+	peer->offset = 0;
+	peer->buffer_len = 0;
+	peer->watching_write = false;
+}
+
+static void peer_fail(struct peer *peer, char const *reason, int error)
+{
+	syslog(LOG_ERR, "Peer %s#%s: %s: %s", peer->addr, peer->port, reason,
+			strerror(error));
+	peer_disconnect(peer);
+}
+
+static void history_drop_first(void)
+{
+	struct batch *batch;
+	unsigned int i;
+
+	/* A half-sent frame cannot be completed anymore. */
+	for (i = 0; i < peer_count; i++) {
+		if (peers[i].state == PEER_READY
+				&& peers[i].next == history_first
+				&& peers[i].offset > 0)
+			peer_fail(&peers[i], "Fell behind the history", ENOBUFS);
+	}
+
+	batch = &history[history_first % HISTORY_SLOTS];
+	history_bytes -= batch->len;
+	free(batch->frame);
+	batch->frame = NULL;
+	history_first++;
+}
+
+/* Drops the batches every peer has already confirmed. */
+static void history_release(void)
+{
+	uint64_t acked;
+	unsigned int i;
+
+	acked = history_next - 1;
+	for (i = 0; i < peer_count; i++)
+		if (peers[i].acked < acked)
+			acked = peers[i].acked;
+
+	while (history_first <= acked)
+		history_drop_first();
+}
+
+static void watch_write(struct peer *peer, bool enable)
+{
+	if (peer->watching_write == enable)
+		return;
+	if (loop_watch_write(&peer->handler, enable) == 0)
+		peer->watching_write = enable;
+}
+
+/* The peer needs batches we no longer have; ask the kernel for everything. */
+static void resync_full(struct peer *peer)
+{
+	time_t now;
+
+	syslog(LOG_WARNING, "Peer %s#%s: Missing batches are no longer in the history; requesting a full advertisement.",
+			peer->addr, peer->port);
+	peer->next = history_next;
+	tcpsocket_advertises++;
+
+	now = time(NULL);
+	if (now - last_advertise < ADVERTISE_INTERVAL)
+		return; /* The ongoing one will reach this peer too. */
+	last_advertise = now;
+	modsocket_advertise();
+}
+
+static void peer_resync(struct peer *peer, uint64_t last)
+{
+	if (last >= history_next)
+		last = history_next - 1;
+	peer->acked = last;
+
+	if (last + 1 < history_first) {
+		resync_full(peer);
+		return;
+	}
+
+	if (last + 1 < history_next) {
+		syslog(LOG_INFO, "Peer %s#%s: Resending batches %llu-%llu.",
+				peer->addr, peer->port,
+				(unsigned long long)(last + 1),
+				(unsigned long long)(history_next - 1));
+		tcpsocket_resyncs += history_next - last - 1;
+	}
+	peer->next = last + 1;
+}
+
+/* Sends as much of the pending history to @peer as the socket will take. */
+static void peer_pump(struct peer *peer)
+{
+	struct batch *batch;
+	ssize_t sent;
+
+	while (peer->next < history_next) {
+		batch = history_get(peer->next);
+		if (!batch) {
+			resync_full(peer);
+			break;
+		}
+
+		sent = send(peer->handler.fd, batch->frame + peer->offset,
+				batch->len - peer->offset,
+				MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				watch_write(peer, true);
+				return;
+			}
+			peer_fail(peer, "send() failed", errno);
+			return;
+		}
+
+		peer->offset += sent;
+		if (peer->offset < batch->len)
+			continue;
+
+		netsocket_pkts_sent++;
+		netsocket_bytes_sent += batch->len - FRAME_HDR_LEN;
+		netsocket_sessions_sent += batch->sessions;
+		peer->next++;
+		peer->offset = 0;
+	}
+
+	watch_write(peer, false);
+}
+
+static void peer_hello(struct peer *peer)
+{
+	int error;
+
+	error = send_control(peer->handler.fd, FRAME_HELLO, node_id);
+	if (error) {
+		peer_fail(peer, "Cannot send HELLO", error);
+		return;
+	}
+
+	peer->state = PEER_HELLO;
+	watch_write(peer, false);
+}
+
+static int peer_handle_frame(struct peer *peer)
+{
+	enum frame_type type;
+	uint32_t payload_len;
+	uint64_t seq;
+	int error;
+
+	error = frame_parse(peer->buffer, &type, &payload_len, &seq);
+	if (error)
+		return error;
+	if (payload_len != 0)
+		goto unexpected;
+
+	switch (type) {
+	case FRAME_HELLO_ACK:
+		if (peer->state != PEER_HELLO)
+			goto unexpected;
+		syslog(LOG_INFO, "Peer %s#%s: Connected.", peer->addr,
+				peer->port);
+		peer->state = PEER_READY;
+		peer_resync(peer, seq);
+		history_release();
+		peer_pump(peer);
+		return 0;
+	case FRAME_ACK:
+		if (peer->state != PEER_READY)
+			goto unexpected;
+		if (seq <= peer->acked || seq >= peer->next)
+			return 0; /* Stale, or acking something we didn't send */
+		peer->acked = seq;
+		history_release();
+		return 0;
+	default:
+		break;
+	}
+
+unexpected:
+	syslog(LOG_ERR, "Peer %s#%s: Unexpected frame (type %u).", peer->addr,
+			peer->port, type);
+	return EINVAL;
+}
+
+static void peer_write(struct loop_handler *handler);
+
+static void peer_read(struct loop_handler *handler)
+{
+	struct peer *peer = (struct peer *)handler;
+	ssize_t bytes;
+
+	if (peer->state == PEER_CONNECTING) {
+		/* Probably a failed connect(); let peer_write() sort it out. */
+		peer_write(handler);
+		return;
+	}
+
+	while (peer->state != PEER_DISCONNECTED) {
+		bytes = recv(handler->fd, peer->buffer + peer->buffer_len,
+				FRAME_HDR_LEN - peer->buffer_len, MSG_DONTWAIT);
+		if (bytes == 0) {
+			peer_fail(peer, "Connection lost", ECONNRESET);
+			return;
+		}
+		if (bytes < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				peer_fail(peer, "recv() failed", errno);
+			return;
+		}
+
+		peer->buffer_len += bytes;
+		if (peer->buffer_len < FRAME_HDR_LEN)
+			continue;
+
+		peer->buffer_len = 0;
+		if (peer_handle_frame(peer))
+			peer_disconnect(peer);
+	}
+}
+
+static void peer_write(struct loop_handler *handler)
+{
+	struct peer *peer = (struct peer *)handler;
+	socklen_t len;
+	int error;
+
+	switch (peer->state) {
+	case PEER_CONNECTING:
+		len = sizeof(error);
+		if (getsockopt(handler->fd, SOL_SOCKET, SO_ERROR, &error, &len))
+			error = errno;
+		if (error) {
+			/* Likely just not up yet; don't spam the log. */
+			syslog(LOG_DEBUG, "Peer %s#%s: connect() failed: %s",
+					peer->addr, peer->port,
+					strerror(error));
+			peer_disconnect(peer);
+			return;
+		}
+		peer_hello(peer);
+		break;
+	case PEER_READY:
+		peer_pump(peer);
+		break;
+	default:
+		watch_write(peer, false);
+	}
+}
+
+static void set_nodelay(int fd)
+{
+	int yes = 1;
+
+	/* Our frames are already batched; don't delay the (tiny) acks. */
+	if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)))
+		syslog(LOG_WARNING, "setsockopt(TCP_NODELAY) failed: %s",
+				strerror(errno));
+}
+
+static void peer_connect(struct peer *peer)
+{
+	int fd;
+	int error;
+
+	fd = socket(peer->ai->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			0);
+	if (fd < 0) {
+		pr_perror("socket() failed", errno);
+		return;
+	}
+	set_nodelay(fd);
+
+	if (connect(fd, peer->ai->ai_addr, peer->ai->ai_addrlen)
+			&& errno != EINPROGRESS) {
+		/* Likely just not up yet; don't spam the log. */
+		syslog(LOG_DEBUG, "Peer %s#%s: connect() failed: %s",
+				peer->addr, peer->port, strerror(errno));
+		close(fd);
+		return;
+	}
+
+	peer->handler.fd = fd;
+	peer->state = PEER_CONNECTING;
+	error = loop_add(&peer->handler);
+	if (error) {
+		close(fd);
+		peer->handler.fd = -1;
+		peer->state = PEER_DISCONNECTED;
+		return;
+	}
+	watch_write(peer, true);
+}
+
+static struct node *node_get(uint64_t id)
+{
+	struct node **bucket;
+	struct node *node;
+
+	bucket = &nodes[id % NODE_BUCKETS];
+	for (node = *bucket; node; node = node->next)
+		if (node->id == id)
+			return node;
+
+	node = calloc(1, sizeof(struct node));
+	if (!node)
+		return NULL;
+	node->id = id;
+	node->next = *bucket;
+	*bucket = node;
+	return node;
+}
+
+static void node_put(struct node *node)
+{
+	node->conns--;
+	if (node->conns == 0)
+		node->orphaned = time(NULL);
+}
+
+/* Forgets the nodes that have been disconnected for too long. */
+static void nodes_expire(void)
+{
+	struct node **prev, *node;
+	time_t now;
+	unsigned int i;
+
+	now = time(NULL);
+	for (i = 0; i < NODE_BUCKETS; i++) {
+		prev = &nodes[i];
+		while ((node = *prev) != NULL) {
+			if (node->conns == 0
+					&& now - node->orphaned >= NODE_TIMEOUT) {
+				*prev = node->next;
+				free(node);
+			} else {
+				prev = &node->next;
+			}
+		}
+	}
+}
+
+static void conn_close(struct conn *conn)
+{
+	if (conn->handler.fd < 0)
+		return;
+
+	loop_del(&conn->handler);
+	close(conn->handler.fd);
+	conn->handler.fd = -1;
+	if (conn->node) {
+		node_put(conn->node);
+		conn->node = NULL;
+	}
+	conn->next_dead = graveyard;
+	graveyard = conn;
+}
+
+static int conn_handle_frame(struct conn *conn, enum frame_type type,
+		unsigned char *payload, uint32_t payload_len, uint64_t seq)
+{
+	struct node *node;
+	int error;
+
+	switch (type) {
+	case FRAME_HELLO:
+		node = node_get(seq);
+		if (!node)
+			return ENOMEM;
+		if (conn->node)
+			node_put(conn->node);
+		node->conns++;
+		conn->node = node;
+		error = send_control(conn->handler.fd, FRAME_HELLO_ACK,
+				node->last);
+		if (error)
+			syslog(LOG_ERR, "Cannot send HELLO_ACK: %s",
+					strerror(error));
+		return error;
+
+	case FRAME_DATA:
+		node = conn->node;
+		if (!node)
+			break;
+		if (seq <= node->last)
+			return 0; /* Retransmission; already have it */
+		if (seq > node->last + 1) {
+			syslog(LOG_WARNING, "Batches %llu-%llu were lost; the peer should be advertising its sessions.",
+					(unsigned long long)(node->last + 1),
+					(unsigned long long)(seq - 1));
+			tcpsocket_gaps += seq - node->last - 1;
+		}
+		node->last = seq;
+		conn->ack_pending = true;
+		netsocket_receive(payload, payload_len);
+		return 0;
+
+	default:
+		break;
+	}
+
+	syslog(LOG_ERR, "TCP peer sent an unexpected frame (type %u).", type);
+	return EINVAL;
+}
+
+/* Handles all the complete frames in @conn's buffer. */
+static int conn_process(struct conn *conn)
+{
+	unsigned char *frame;
+	size_t remaining;
+	enum frame_type type;
+	uint32_t payload_len;
+	uint64_t seq;
+	int error;
+
+	frame = conn->buffer;
+	remaining = conn->buffer_len;
+
+	while (remaining >= FRAME_HDR_LEN) {
+		error = frame_parse(frame, &type, &payload_len, &seq);
+		if (error)
+			return error;
+		if (remaining < FRAME_HDR_LEN + payload_len)
+			break;
+
+		error = conn_handle_frame(conn, type, frame + FRAME_HDR_LEN,
+				payload_len, seq);
+		if (error)
+			return error;
+
+		frame += FRAME_HDR_LEN + payload_len;
+		remaining -= FRAME_HDR_LEN + payload_len;
+	}
+
+	memmove(conn->buffer, frame, remaining);
+	conn->buffer_len = remaining;
+	return 0;
+}
+
+static void conn_read(struct loop_handler *handler)
+{
+	struct conn *conn = (struct conn *)handler;
+	ssize_t bytes;
+	int error;
+
+	while (handler->fd >= 0) {
+		bytes = recv(handler->fd, conn->buffer + conn->buffer_len,
+				sizeof(conn->buffer) - conn->buffer_len,
+				MSG_DONTWAIT);
+		if (bytes == 0) {
+			syslog(LOG_INFO, "A TCP peer closed its connection.");
+			conn_close(conn);
+			break;
+		}
+		if (bytes < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				pr_perror("recv() failed", errno);
+				conn_close(conn);
+			}
+			break;
+		}
+
+		conn->buffer_len += bytes;
+		if (conn_process(conn))
+			conn_close(conn);
+	}
+
+	netsocket_receive_flush();
+
+	if (conn->ack_pending && handler->fd >= 0) {
+		/* If the socket is full, the next ACK will cover this one. */
+		error = send_control(handler->fd, FRAME_ACK, conn->node->last);
+		if (!error)
+			conn->ack_pending = false;
+		else if (error != EAGAIN)
+			conn_close(conn);
+	}
+}
+
+static void listener_read(struct loop_handler *handler)
+{
+	struct conn *conn;
+	int fd;
+
+	do {
+		fd = accept4(handler->fd, NULL, NULL,
+				SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				pr_perror("accept() failed", errno);
+			return;
+		}
+		set_nodelay(fd);
+
+		conn = malloc(sizeof(struct conn));
+		if (!conn) {
+			syslog(LOG_ERR, "Out of memory; rejecting TCP peer.");
+			close(fd);
+			continue;
+		}
+		memset(&conn->handler, 0, sizeof(conn->handler));
+		conn->handler.fd = fd;
+		conn->handler.read = conn_read;
+		conn->node = NULL;
+		conn->buffer_len = 0;
+		conn->ack_pending = false;
+
+		if (loop_add(&conn->handler)) {
+			close(fd);
+			free(conn);
+			continue;
+		}
+
+		syslog(LOG_INFO, "Accepted a TCP peer.");
+	} while (true);
+}
+
+static void tcpsocket_flush(struct loop_handler *handler)
+{
+	struct conn *conn;
+	unsigned int i;
+
+	for (i = 0; i < peer_count; i++)
+		if (peers[i].state == PEER_READY)
+			peer_pump(&peers[i]);
+
+	while (graveyard) {
+		conn = graveyard;
+		graveyard = conn->next_dead;
+		free(conn);
+	}
+}
+
+static void timer_read(struct loop_handler *handler)
+{
+	uint64_t expirations;
+	unsigned int i;
+
+	if (read(handler->fd, &expirations, sizeof(expirations)) < 0)
+		return;
+
+	for (i = 0; i < peer_count; i++)
+		if (peers[i].state == PEER_DISCONNECTED)
+			peer_connect(&peers[i]);
+
+	nodes_expire();
+}
+
+static int parse_peers(void)
+{
+	struct addrinfo hints = { 0 };
+	struct peer *peer;
+	char *str, *token, *saveptr;
+	unsigned int i;
+	int error;
+
+	if (!netcfg->peers) {
+		syslog(LOG_WARNING, "No TCP peers configured; I will only receive sessions.");
+		return 0;
+	}
+
+	str = strdup(netcfg->peers); /* Lives as long as the daemon. */
+	if (!str)
+		return ENOMEM;
+
+	peer_count = 1;
+	for (i = 0; str[i]; i++)
+		if (str[i] == ',')
+			peer_count++;
+	peers = calloc(peer_count, sizeof(struct peer));
+	if (!peers)
+		return ENOMEM;
+
+	hints.ai_socktype = SOCK_STREAM;
+	peer = peers;
+	for (token = strtok_r(str, ",", &saveptr);
+			token;
+			token = strtok_r(NULL, ",", &saveptr)) {
+		peer->addr = token;
+		peer->port = strchr(token, '#');
+		if (peer->port)
+			*(peer->port++) = '\0';
+		else
+			peer->port = netcfg->mcast_port;
+
+		error = getaddrinfo(peer->addr, peer->port, &hints, &peer->ai);
+		if (error) {
+			syslog(LOG_ERR, "Cannot resolve peer %s#%s: %s",
+					peer->addr, peer->port,
+					gai_strerror(error));
+			return error;
+		}
+
+		peer->handler.fd = -1;
+		peer->handler.read = peer_read;
+		peer->handler.write = peer_write;
+		peer->state = PEER_DISCONNECTED;
+		peer++;
+	}
+
+	peer_count = peer - peers;
+	return 0;
+}
+
+static int create_listener(void)
+{
+	struct addrinfo hints = { 0 };
+	struct addrinfo *ais, *ai;
+	const int yes = 1;
+	int sk;
+	int error;
+
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	error = getaddrinfo(netcfg->mcast_addr, netcfg->mcast_port, &hints,
+			&ais);
+	if (error) {
+		syslog(LOG_ERR, "getaddrinfo() failed: %s", gai_strerror(error));
+		return error;
+	}
+
+	for (ai = ais; ai; ai = ai->ai_next) {
+		sk = socket(ai->ai_family,
+				ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+				ai->ai_protocol);
+		if (sk < 0) {
+			pr_perror("socket() failed", errno);
+			continue;
+		}
+		if (setsockopt(sk, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes))
+				|| bind(sk, ai->ai_addr, ai->ai_addrlen)
+				|| listen(sk, SOMAXCONN)) {
+			pr_perror("Cannot listen for TCP peers", errno);
+			close(sk);
+			continue;
+		}
+
+		freeaddrinfo(ais);
+		listener.fd = sk;
+		listener.read = listener_read;
+		listener.flush = tcpsocket_flush;
+		return loop_add(&listener);
+	}
+
+	freeaddrinfo(ais);
+	syslog(LOG_ERR, "None of the candidates yielded a listening socket.");
+	return 1;
+}
+
+static int create_timer(void)
+{
+	struct itimerspec spec = { 0 };
+	int fd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) {
+		pr_perror("timerfd_create() failed", errno);
+		return errno;
+	}
+
+	spec.it_interval.tv_sec = RECONNECT_INTERVAL;
+	spec.it_value.tv_sec = RECONNECT_INTERVAL;
+	if (timerfd_settime(fd, 0, &spec, NULL)) {
+		pr_perror("timerfd_settime() failed", errno);
+		close(fd);
+		return errno;
+	}
+
+	timer.fd = fd;
+	timer.read = timer_read;
+	return loop_add(&timer);
+}
+
+int tcpsocket_start(struct netsocket_cfg *cfg)
+{
+	unsigned int i;
+	int error;
+
+	netcfg = cfg;
+
+	if (getrandom(&node_id, sizeof(node_id), 0) != sizeof(node_id))
+		node_id = ((uint64_t)time(NULL) << 32) ^ getpid();
+
+	error = parse_peers();
+	if (error)
+		return error;
+	error = create_listener();
+	if (error)
+		return error;
+	error = create_timer();
+	if (error)
+		return error;
+
+	for (i = 0; i < peer_count; i++)
+		peer_connect(&peers[i]);
+
+	syslog(LOG_INFO, "TCP socket ready.");
+	return 0;
+}
+
+/*
+ * Stores @nest in the history. It's sent to the peers at the end of the
+ * current loop round.
+ */
+void tcpsocket_send(void *nest, size_t nest_len)
+{
+	struct batch *batch;
+	unsigned char *frame;
+	size_t max;
+	unsigned int sessions;
+	int size;
+
+	max = WIRE_ENCODED_MAX(nest_len);
+	frame = malloc(FRAME_HDR_LEN + max);
+	if (!frame) {
+		syslog(LOG_ERR, "Out of memory; dropping a session batch.");
+		return;
+	}
+
+	sessions = 0;
+	size = wire_encode(&netcfg->wire, nest, nest_len,
+			frame + FRAME_HDR_LEN, max, &sessions);
+	if (size < 0) {
+		free(frame);
+		return;
+	}
+
+	while (history_first < history_next && (
+			history_next - history_first >= HISTORY_SLOTS
+			|| history_bytes + FRAME_HDR_LEN + size > HISTORY_MAX_BYTES))
+		history_drop_first();
+
+	frame_init(frame, FRAME_DATA, size, history_next);
+
+	batch = &history[history_next % HISTORY_SLOTS];
+	batch->seq = history_next;
+	batch->sessions = sessions;
+	batch->len = FRAME_HDR_LEN + size;
+	batch->frame = frame;
+
+	history_bytes += batch->len;
+	history_next++;
+}
+
+void tcpsocket_stop(void)
+{
+	struct node *node;
+	unsigned int i;
+
+	for (i = 0; i < peer_count; i++) {
+		peer_disconnect(&peers[i]);
+		freeaddrinfo(peers[i].ai);
+	}
+	free(peers);
+	peers = NULL;
+	peer_count = 0;
+
+	while (history_first < history_next)
+		history_drop_first();
+
+	for (i = 0; i < NODE_BUCKETS; i++) {
+		while (nodes[i]) {
+			node = nodes[i];
+			nodes[i] = node->next;
+			free(node);
+		}
+	}
+}
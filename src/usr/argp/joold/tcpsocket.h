@@ -0,0 +1,24 @@
+#ifndef SRC_USR_ARGP_JOOLD_TCPSOCKET_H_
+#define SRC_USR_ARGP_JOOLD_TCPSOCKET_H_
+
+/*
+ * The unicast TCP alternative to netsocket's multicast.
+ *
+ * Every batch of sessions the kernel module hands us is given a sequence
+ * number, and kept in a history ring until every peer acknowledges it (or the
+ * ring fills up). Each proxy connects to every one of its peers and streams
+ * them the batches, in order. When a connection is reestablished, the peer
+ * reports the last batch it got from us, and we resume from there; a full
+ * advertisement is only requested from the kernel module when the missing
+ * batches are no longer in the history.
+ */
+
+#include <stddef.h>
+
+#include "usr/argp/joold/netsocket.h"
+
+int tcpsocket_start(struct netsocket_cfg *cfg);
+void tcpsocket_send(void *nest, size_t nest_len);
+void tcpsocket_stop(void);
+
+#endif /* SRC_USR_ARGP_JOOLD_TCPSOCKET_H_ */
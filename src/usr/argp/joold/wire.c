@@ -0,0 +1,542 @@
+#include "usr/argp/joold/wire.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <syslog.h>
+#include <netlink/attr.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "common/config.h"
+#include "common/session.h"
+
+/*
+ * Compact format, version 1:
+ *
+ *	Header:
+ *		'J' 'S' <version> <flags>
+ *		<session count>			(varint)
+ *		[<uncompressed body length>]	(varint; only if WIRE_F_ZSTD)
+ *	Body: <session count> records, zstd-compressed if WIRE_F_ZSTD.
+ *
+ * Each record is the delta of a kernel session record against the previous
+ * one (the first one is compared against zeroes):
+ *
+ *	<control>	(1 byte. Bits 7-3: Length (in bytes) of the prefix the
+ *			src6 address shares with the previous one. Bits 2-0:
+ *			WR_* flags.)
+ *	<src6 suffix>	(16 - prefix length bytes)
+ *	[<src4 addr>]	(4 bytes; absent if WR_SRC4_SAME)
+ *	[<dst4 addr>]	(4 bytes; absent if WR_DST4_SAME)
+ *	[<meta>]	(1 byte; protocol, state and timer; absent if
+ *			WR_META_SAME)
+ *	<src6 port>, <src4 port>, <dst4 port>, <expiration>
+ *			(zigzag varints; differences against the previous
+ *			record)
+ *
+ * dst6 is never transmitted; the kernel module already infers it from pool6
+ * and dst4.
+ */
+
+#define WIRE_MAGIC0 'J'
+#define WIRE_MAGIC1 'S'
+#define WIRE_VERSION 1
+#define WIRE_HDR_LEN 4
+
+/* Header flags */
+#define WIRE_F_ZSTD (1 << 0)
+
+/* Record control flags */
+#define WR_SRC4_SAME (1 << 0)
+#define WR_DST4_SAME (1 << 1)
+#define WR_META_SAME (1 << 2)
+
+#define KR_ATTR_LEN (NLA_HDRLEN + JOOLD_SESSION_SIZE)
+
+#define ZSTD_LEVEL 3
+
+struct wire_buffer {
+	unsigned char *data;
+	size_t len;
+	size_t offset;
+};
+
+int wire_str2format(char const *str, enum wire_format *result)
+{
+	if (!str || strcasecmp(str, "compact") == 0) {
+		*result = WIRE_FORMAT_COMPACT;
+		return 0;
+	}
+	if (strcasecmp(str, "legacy") == 0) {
+		*result = WIRE_FORMAT_LEGACY;
+		return 0;
+	}
+
+	return EINVAL;
+}
+
+bool wire_compression_supported(void)
+{
+#ifdef HAVE_ZSTD
+	return true;
+#else
+	return false;
+#endif
+}
+
+static __u16 get16(unsigned char const *src)
+{
+	return (src[0] << 8) | src[1];
+}
+
+static void put16(unsigned char *dst, __u16 value)
+{
+	dst[0] = value >> 8;
+	dst[1] = value;
+}
+
+static __u32 get32(unsigned char const *src)
+{
+	return ((__u32)src[0] << 24) | (src[1] << 16) | (src[2] << 8) | src[3];
+}
+
+static void put32(unsigned char *dst, __u32 value)
+{
+	dst[0] = value >> 24;
+	dst[1] = value >> 16;
+	dst[2] = value >> 8;
+	dst[3] = value;
+}
+
+static __u64 zigzag(__s64 value)
+{
+	return ((__u64)value << 1) ^ (__u64)(value >> 63);
+}
+
+static __s64 unzigzag(__u64 value)
+{
+	return (__s64)(value >> 1) ^ -(__s64)(value & 1);
+}
+
+static int write_bytes(struct wire_buffer *buf, void const *src, size_t len)
+{
+	if (buf->offset + len > buf->len)
+		return -1;
+	memcpy(buf->data + buf->offset, src, len);
+	buf->offset += len;
+	return 0;
+}
+
+static int write_byte(struct wire_buffer *buf, unsigned char byte)
+{
+	return write_bytes(buf, &byte, 1);
+}
+
+static int write_varint(struct wire_buffer *buf, __u64 value)
+{
+	while (value >= 0x80) {
+		if (write_byte(buf, (value & 0x7F) | 0x80))
+			return -1;
+		value >>= 7;
+	}
+	return write_byte(buf, value);
+}
+
+static int read_bytes(struct wire_buffer *buf, void *dst, size_t len)
+{
+	if (buf->offset + len > buf->len)
+		return -1;
+	memcpy(dst, buf->data + buf->offset, len);
+	buf->offset += len;
+	return 0;
+}
+
+static int read_varint(struct wire_buffer *buf, __u64 *result)
+{
+	unsigned int shift;
+	unsigned char byte;
+
+	*result = 0;
+	for (shift = 0; shift < 64; shift += 7) {
+		if (read_bytes(buf, &byte, 1))
+			return -1;
+		*result |= (__u64)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return 0;
+	}
+
+	return -1; /* Too long */
+}
+
+/* Writes the difference between @rec's and @prev's 16-bit fields @offset. */
+static int write_delta16(struct wire_buffer *buf, unsigned char const *prev,
+		unsigned char const *rec, unsigned int offset)
+{
+	return write_varint(buf,
+			zigzag((__s64)get16(rec + offset) - get16(prev + offset)));
+}
+
+static int write_delta32(struct wire_buffer *buf, unsigned char const *prev,
+		unsigned char const *rec, unsigned int offset)
+{
+	return write_varint(buf,
+			zigzag((__s64)get32(rec + offset) - get32(prev + offset)));
+}
+
+/* Reverts write_delta16(). */
+static int read_delta16(struct wire_buffer *buf, unsigned char const *prev,
+		unsigned char *rec, unsigned int offset)
+{
+	__u64 delta;
+
+	if (read_varint(buf, &delta))
+		return -1;
+	put16(rec + offset, get16(prev + offset) + unzigzag(delta));
+	return 0;
+}
+
+static int read_delta32(struct wire_buffer *buf, unsigned char const *prev,
+		unsigned char *rec, unsigned int offset)
+{
+	__u64 delta;
+
+	if (read_varint(buf, &delta))
+		return -1;
+	put32(rec + offset, get32(prev + offset) + unzigzag(delta));
+	return 0;
+}
+
+static unsigned int shared_prefix(unsigned char const *a,
+		unsigned char const *b)
+{
+	unsigned int i;
+
+	for (i = 0; i < 16; i++)
+		if (a[i] != b[i])
+			break;
+	return i;
+}
+
+static int encode_record(struct wire_buffer *buf, unsigned char const *prev,
+		unsigned char const *rec)
+{
+	unsigned int shared;
+	unsigned char control;
+
+	shared = shared_prefix(prev + JOOLD_SESSION_SRC6,
+			rec + JOOLD_SESSION_SRC6);
+	control = shared << 3;
+	if (memcmp(prev + JOOLD_SESSION_SRC4, rec + JOOLD_SESSION_SRC4, 4) == 0)
+		control |= WR_SRC4_SAME;
+	if (memcmp(prev + JOOLD_SESSION_DST4, rec + JOOLD_SESSION_DST4, 4) == 0)
+		control |= WR_DST4_SAME;
+	if (prev[JOOLD_SESSION_META + 1] == rec[JOOLD_SESSION_META + 1])
+		control |= WR_META_SAME;
+
+	if (write_byte(buf, control))
+		return -1;
+	if (write_bytes(buf, rec + JOOLD_SESSION_SRC6 + shared, 16 - shared))
+		return -1;
+	if (!(control & WR_SRC4_SAME)
+			&& write_bytes(buf, rec + JOOLD_SESSION_SRC4, 4))
+		return -1;
+	if (!(control & WR_DST4_SAME)
+			&& write_bytes(buf, rec + JOOLD_SESSION_DST4, 4))
+		return -1;
+	if (!(control & WR_META_SAME)
+			&& write_byte(buf, rec[JOOLD_SESSION_META + 1]))
+		return -1;
+
+	if (write_delta16(buf, prev, rec, JOOLD_SESSION_SRC6_PORT))
+		return -1;
+	if (write_delta16(buf, prev, rec, JOOLD_SESSION_SRC4_PORT))
+		return -1;
+	if (write_delta16(buf, prev, rec, JOOLD_SESSION_DST4_PORT))
+		return -1;
+	return write_delta32(buf, prev, rec, JOOLD_SESSION_EXPIRATION);
+}
+
+static int decode_record(struct wire_buffer *buf, unsigned char const *prev,
+		unsigned char *rec)
+{
+	unsigned char control;
+	unsigned int shared;
+
+	if (read_bytes(buf, &control, 1))
+		return -1;
+	shared = control >> 3;
+	if (shared > 16)
+		return -1;
+
+	memset(rec, 0, JOOLD_SESSION_SIZE);
+	memcpy(rec + JOOLD_SESSION_SRC6, prev + JOOLD_SESSION_SRC6, shared);
+	if (read_bytes(buf, rec + JOOLD_SESSION_SRC6 + shared, 16 - shared))
+		return -1;
+
+	if (control & WR_SRC4_SAME)
+		memcpy(rec + JOOLD_SESSION_SRC4, prev + JOOLD_SESSION_SRC4, 4);
+	else if (read_bytes(buf, rec + JOOLD_SESSION_SRC4, 4))
+		return -1;
+
+	if (control & WR_DST4_SAME)
+		memcpy(rec + JOOLD_SESSION_DST4, prev + JOOLD_SESSION_DST4, 4);
+	else if (read_bytes(buf, rec + JOOLD_SESSION_DST4, 4))
+		return -1;
+
+	if (control & WR_META_SAME)
+		rec[JOOLD_SESSION_META + 1] = prev[JOOLD_SESSION_META + 1];
+	else if (read_bytes(buf, rec + JOOLD_SESSION_META + 1, 1))
+		return -1;
+
+	if (read_delta16(buf, prev, rec, JOOLD_SESSION_SRC6_PORT))
+		return -1;
+	if (read_delta16(buf, prev, rec, JOOLD_SESSION_SRC4_PORT))
+		return -1;
+	if (read_delta16(buf, prev, rec, JOOLD_SESSION_DST4_PORT))
+		return -1;
+	return read_delta32(buf, prev, rec, JOOLD_SESSION_EXPIRATION);
+}
+
+/* Returns the number of sessions in @nest, or -1 if it's not encodable. */
+static int count_records(void const *nest, size_t nest_len)
+{
+	struct nlattr *attr;
+	int rem;
+	int count;
+
+	count = 0;
+	nla_for_each_attr(attr, (struct nlattr *)nest, nest_len, rem) {
+		if (nla_len(attr) != JOOLD_SESSION_SIZE)
+			return -1;
+		/* Bits we don't know how to encode */
+		if (((unsigned char *)nla_data(attr))[JOOLD_SESSION_META] != 0)
+			return -1;
+		count++;
+	}
+
+	return count;
+}
+
+static int encode_legacy(void const *nest, size_t nest_len, unsigned char *out,
+		size_t out_len)
+{
+	if (nest_len > out_len) {
+		syslog(LOG_ERR, "Session batch is too big: %zu bytes", nest_len);
+		return -1;
+	}
+
+	memcpy(out, nest, nest_len);
+	return nest_len;
+}
+
+static int encode_body(void const *nest, size_t nest_len,
+		struct wire_buffer *buf)
+{
+	static const unsigned char zeroes[JOOLD_SESSION_SIZE];
+	unsigned char const *prev;
+	struct nlattr *attr;
+	int rem;
+
+	prev = zeroes;
+	nla_for_each_attr(attr, (struct nlattr *)nest, nest_len, rem) {
+		if (encode_record(buf, prev, nla_data(attr)))
+			return -1;
+		prev = nla_data(attr);
+	}
+
+	return 0;
+}
+
+#ifdef HAVE_ZSTD
+
+static int compress_body(struct wire_buffer *out, struct wire_buffer *body)
+{
+	unsigned char hdr[10];
+	struct wire_buffer lenbuf = { .data = hdr, .len = sizeof(hdr) };
+	size_t csize;
+
+	if (write_varint(&lenbuf, body->offset))
+		return -1;
+	if (out->offset + lenbuf.offset >= out->len)
+		return -1;
+
+	csize = ZSTD_compress(out->data + out->offset + lenbuf.offset,
+			out->len - out->offset - lenbuf.offset,
+			body->data, body->offset, ZSTD_LEVEL);
+	if (ZSTD_isError(csize)) {
+		syslog(LOG_DEBUG, "zstd compression failed: %s",
+				ZSTD_getErrorName(csize));
+		return -1;
+	}
+	if (lenbuf.offset + csize >= body->offset)
+		return -1; /* Not worth it */
+
+	memcpy(out->data + out->offset, hdr, lenbuf.offset);
+	out->offset += lenbuf.offset + csize;
+	return 0;
+}
+
+static int decompress_body(struct wire_buffer *in, struct wire_buffer *body)
+{
+	__u64 len;
+	size_t dsize;
+
+	if (read_varint(in, &len) || len > body->len)
+		return -1;
+
+	dsize = ZSTD_decompress(body->data, len, in->data + in->offset,
+			in->len - in->offset);
+	if (ZSTD_isError(dsize) || dsize != len) {
+		syslog(LOG_ERR, "Cannot decompress session batch: %s",
+				ZSTD_isError(dsize)
+						? ZSTD_getErrorName(dsize)
+						: "Length mismatch");
+		return -1;
+	}
+
+	body->len = dsize;
+	return 0;
+}
+
+#else
+
+static int compress_body(struct wire_buffer *out, struct wire_buffer *body)
+{
+	return -1;
+}
+
+static int decompress_body(struct wire_buffer *in, struct wire_buffer *body)
+{
+	syslog(LOG_ERR, "Received a compressed session batch, but I was compiled without zstd.");
+	return -1;
+}
+
+#endif
+
+int wire_encode(struct wire_cfg const *cfg, void const *nest, size_t nest_len,
+		unsigned char *out, size_t out_len, unsigned int *sessions)
+{
+	unsigned char body_data[WIRE_MAX_LEN];
+	struct wire_buffer result = { .data = out, .len = out_len };
+	struct wire_buffer body = { .data = body_data, .len = WIRE_MAX_LEN };
+	int count;
+
+	count = count_records(nest, nest_len);
+	if (count < 0) {
+		syslog(LOG_DEBUG, "Batch is not compact-encodable; falling back to legacy format.");
+		return encode_legacy(nest, nest_len, out, out_len);
+	}
+
+	*sessions = count;
+	if (cfg->format == WIRE_FORMAT_LEGACY)
+		return encode_legacy(nest, nest_len, out, out_len);
+
+	if (encode_body(nest, nest_len, &body)) {
+		syslog(LOG_ERR, "Session batch does not fit in a datagram.");
+		return -1;
+	}
+	if (out_len < WIRE_HDR_LEN)
+		return -1;
+
+	out[0] = WIRE_MAGIC0;
+	out[1] = WIRE_MAGIC1;
+	out[2] = WIRE_VERSION;
+	out[3] = 0;
+	result.offset = WIRE_HDR_LEN;
+	if (write_varint(&result, count))
+		return -1;
+
+	if (cfg->compress && count >= cfg->compress_threshold) {
+		if (compress_body(&result, &body) == 0) {
+			out[3] |= WIRE_F_ZSTD;
+			return result.offset;
+		}
+	}
+
+	if (write_bytes(&result, body.data, body.offset)) {
+		syslog(LOG_ERR, "Session batch does not fit in a datagram.");
+		return -1;
+	}
+
+	return result.offset;
+}
+
+static int decode_legacy(void const *in, size_t in_len, unsigned char *nest,
+		size_t nest_len, unsigned int *sessions)
+{
+	struct nlattr *attr;
+	int rem;
+
+	if (in_len > nest_len) {
+		syslog(LOG_ERR, "Session batch is too big: %zu bytes", in_len);
+		return -1;
+	}
+
+	*sessions = 0;
+	nla_for_each_attr(attr, (struct nlattr *)in, in_len, rem)
+		(*sessions)++;
+
+	memcpy(nest, in, in_len);
+	return in_len;
+}
+
+int wire_decode(void const *in, size_t in_len, unsigned char *nest,
+		size_t nest_len, unsigned int *sessions)
+{
+	static const unsigned char zeroes[JOOLD_SESSION_SIZE];
+	unsigned char body_data[WIRE_MAX_LEN];
+	unsigned char const *hdr = in;
+	struct wire_buffer src = { .data = (unsigned char *)in, .len = in_len };
+	struct wire_buffer body;
+	unsigned char const *prev;
+	struct nlattr *attr;
+	__u64 count, i;
+
+	if (in_len < WIRE_HDR_LEN || hdr[0] != WIRE_MAGIC0
+			|| hdr[1] != WIRE_MAGIC1)
+		return decode_legacy(in, in_len, nest, nest_len, sessions);
+
+	if (hdr[2] != WIRE_VERSION) {
+		syslog(LOG_ERR, "Unsupported session batch version: %u", hdr[2]);
+		return -1;
+	}
+
+	src.offset = WIRE_HDR_LEN;
+	if (read_varint(&src, &count))
+		goto truncated;
+	if (count > nest_len / KR_ATTR_LEN) {
+		syslog(LOG_ERR, "Session batch is too big: %llu sessions",
+				(unsigned long long)count);
+		return -1;
+	}
+
+	if (hdr[3] & WIRE_F_ZSTD) {
+		body.data = body_data;
+		body.len = sizeof(body_data);
+		body.offset = 0;
+		if (decompress_body(&src, &body))
+			return -1;
+	} else {
+		body = src;
+	}
+
+	prev = zeroes;
+	for (i = 0; i < count; i++) {
+		attr = (struct nlattr *)(nest + i * KR_ATTR_LEN);
+		attr->nla_len = KR_ATTR_LEN;
+		attr->nla_type = JNLAL_ENTRY;
+		if (decode_record(&body, prev, nla_data(attr)))
+			goto truncated;
+		prev = nla_data(attr);
+	}
+
+	*sessions = count;
+	return count * KR_ATTR_LEN;
+
+truncated:
+	syslog(LOG_ERR, "Session batch is truncated or corrupted.");
+	return -1;
+}
@@ -0,0 +1,55 @@
+#ifndef SRC_USR_ARGP_JOOLD_WIRE_H_
+#define SRC_USR_ARGP_JOOLD_WIRE_H_
+
+/*
+ * Encoding of the sessions joold exchanges over the network.
+ *
+ * The kernel module hands us a Netlink nest of fixed-size session records
+ * (see jnla_put_session_joold()). The "legacy" format forwards that nest
+ * verbatim. The "compact" format packs the same records into a versioned,
+ * delta-encoded representation, which is translated back into the nest on the
+ * receiving end. Neither the kernel module nor the remote instance need to
+ * know which one was used.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Large enough for any UDP datagram. */
+#define WIRE_MAX_LEN 65536
+/* Worst case size of the encoding of a @nest_len-sized nest. */
+#define WIRE_ENCODED_MAX(nest_len) ((nest_len) + 16)
+
+enum wire_format {
+	WIRE_FORMAT_COMPACT = 0,
+	WIRE_FORMAT_LEGACY,
+};
+
+struct wire_cfg {
+	enum wire_format format;
+	/** Compress compact batches? (Requires zstd.) */
+	bool compress;
+	/** Minimum number of sessions a batch needs to have to be compressed. */
+	unsigned int compress_threshold;
+};
+
+int wire_str2format(char const *str, enum wire_format *result);
+bool wire_compression_supported(void);
+
+/*
+ * Converts the kernel's @nest (@nest_len bytes) into @cfg's format.
+ * @out_len should be at least WIRE_ENCODED_MAX(@nest_len).
+ * Returns the number of bytes written to @out, or -1 on error.
+ */
+int wire_encode(struct wire_cfg const *cfg, void const *nest, size_t nest_len,
+		unsigned char *out, size_t out_len, unsigned int *sessions);
+/*
+ * Converts network datagram @in (@in_len bytes, in any format) into a nest the
+ * kernel module can read.
+ * Returns the number of bytes written to @nest (which has room for @nest_len
+ * bytes), or -1 on error.
+ */
+int wire_decode(void const *in, size_t in_len, unsigned char *nest,
+		size_t nest_len, unsigned int *sessions);
+
+#endif /* SRC_USR_ARGP_JOOLD_WIRE_H_ */
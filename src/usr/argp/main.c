@@ -27,6 +27,7 @@
 #include "usr/argp/wargp/pool4.h"
 #include "usr/argp/wargp/session.h"
 #include "usr/argp/wargp/stats.h"
+#include "usr/argp/wargp/xdp.h"
 
 #define DISPLAY "display"
 #define ADD "add"
@@ -72,6 +73,16 @@ static struct cmd_option stats_ops[] = {
 			.xt = XT_ANY,
 			.handler = handle_stats_display,
 			.handle_autocomplete = autocomplete_stats_display,
+		}, {
+			.label = "latency",
+			.xt = XT_ANY,
+			.handler = handle_stats_latency,
+			.handle_autocomplete = autocomplete_stats_latency,
+		}, {
+			.label = "locks",
+			.xt = XT_NAT64,
+			.handler = handle_stats_locks,
+			.handle_autocomplete = autocomplete_stats_locks,
 		},
 		{ 0 },
 };
@@ -216,6 +227,11 @@ static struct cmd_option bib_ops[] = {
 			.xt = XT_NAT64,
 			.handler = handle_bib_remove,
 			.handle_autocomplete = autocomplete_bib_remove,
+		}, {
+			.label = "lookup",
+			.xt = XT_NAT64,
+			.handler = handle_bib_lookup,
+			.handle_autocomplete = autocomplete_bib_lookup,
 		},
 		{ 0 },
 };
@@ -226,6 +242,11 @@ static struct cmd_option session_ops[] = {
 			.xt = XT_NAT64,
 			.handler = handle_session_display,
 			.handle_autocomplete = autocomplete_session_display,
+		}, {
+			.label = "top",
+			.xt = XT_NAT64,
+			.handler = handle_session_top,
+			.handle_autocomplete = autocomplete_session_top,
 		}, {
 			.label = "follow",
 			.xt = XT_NAT64,
@@ -236,7 +257,12 @@ static struct cmd_option session_ops[] = {
 			.xt = XT_NAT64,
 			.handler = handle_session_proxy,
 			.handle_autocomplete = autocomplete_session_proxy,
-		},{
+		}, {
+			.label = "log",
+			.xt = XT_NAT64,
+			.handler = handle_session_log,
+			.handle_autocomplete = autocomplete_session_log,
+		}, {
 			.label = "advertise",
 			.xt = XT_NAT64,
 			.handler = handle_session_advertise,
@@ -255,6 +281,31 @@ static struct cmd_option file_ops[] = {
 		{ 0 },
 };
 
+static struct cmd_option xdp_ops[] = {
+		{
+			.label = DISPLAY,
+			.xt = XT_SIIT,
+			.handler = handle_xdp_display,
+			.handle_autocomplete = autocomplete_xdp_display,
+		}, {
+			.label = "attach",
+			.xt = XT_SIIT,
+			.handler = handle_xdp_attach,
+			.handle_autocomplete = autocomplete_xdp_attach,
+		}, {
+			.label = "detach",
+			.xt = XT_SIIT,
+			.handler = handle_xdp_detach,
+			.handle_autocomplete = autocomplete_xdp_detach,
+		}, {
+			.label = "sync",
+			.xt = XT_SIIT,
+			.handler = handle_xdp_sync,
+			.handle_autocomplete = autocomplete_xdp_sync,
+		},
+		{ 0 },
+};
+
 static struct cmd_option joold_ops[] = {
 		{
 			.label = "advertise",
@@ -311,6 +362,10 @@ struct cmd_option tree[] = {
 			.label = "file",
 			.xt = XT_ANY,
 			.children = file_ops,
+		}, {
+			.label = "xdp",
+			.xt = XT_SIIT,
+			.children = xdp_ops,
 		}, {
 			.label = "joold",
 			.xt = XT_NAT64,
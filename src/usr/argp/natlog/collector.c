@@ -0,0 +1,326 @@
+#include "usr/argp/natlog/collector.h"
+
+#include <endian.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/genl/genl.h>
+
+#include "common/config.h"
+#include "usr/nl/core.h"
+#include "usr/argp/log.h"
+
+/* Requested size of the socket's kernel buffers. */
+#define NATLOG_SKBUF_SIZE (4 << 20)
+
+static char const *iname;
+static struct natlog_cfg *cfg;
+
+static FILE *out;
+static unsigned long out_size;
+
+static int open_file(void)
+{
+	if (!cfg->file) {
+		out = stdout;
+		return 0;
+	}
+
+	out = fopen(cfg->file, "a");
+	if (!out) {
+		pr_err("Cannot open %s: %s", cfg->file, strerror(errno));
+		return errno;
+	}
+
+	fseek(out, 0, SEEK_END);
+	out_size = ftell(out);
+	return 0;
+}
+
+/* file.N-1 -> file.N, ..., file -> file.1 */
+static int rotate_file(void)
+{
+	char *old_name;
+	char *new_name;
+	size_t len;
+	unsigned int i;
+	int error;
+
+	fclose(out);
+	out = NULL;
+
+	len = strlen(cfg->file) + 12;
+	old_name = malloc(len);
+	new_name = malloc(len);
+	if (!old_name || !new_name) {
+		error = ENOMEM;
+		goto end;
+	}
+
+	for (i = cfg->file_count; i > 0; i--) {
+		if (i > 1)
+			snprintf(old_name, len, "%s.%u", cfg->file, i - 1);
+		else
+			snprintf(old_name, len, "%s", cfg->file);
+		snprintf(new_name, len, "%s.%u", cfg->file, i);
+
+		if (rename(old_name, new_name) && errno != ENOENT)
+			pr_warn("Cannot rename %s: %s", old_name,
+					strerror(errno));
+	}
+
+	if (cfg->file_count == 0)
+		remove(cfg->file);
+
+	error = open_file();
+
+end:	free(old_name);
+	free(new_name);
+	return error;
+}
+
+static char const *event2str(__u8 event)
+{
+	switch (event) {
+	case NATLOG_BIB_ADD:
+		return "Mapped";
+	case NATLOG_BIB_RM:
+		return "Forgot";
+	case NATLOG_SESSION_ADD:
+		return "Added session";
+	case NATLOG_SESSION_RM:
+		return "Forgot session";
+	case NATLOG_BLOCK_ADD:
+		return "Allocated block";
+	case NATLOG_BLOCK_RM:
+		return "Released block";
+	}
+
+	return "Unknown";
+}
+
+static char const *proto2str(__u8 proto)
+{
+	switch (proto) {
+	case IPPROTO_TCP:
+		return "TCP";
+	case IPPROTO_UDP:
+		return "UDP";
+	case IPPROTO_ICMP:
+		return "ICMP";
+	}
+
+	return "Unknown";
+}
+
+/*
+ * <time>,<instance>,<event>,<protocol>,
+ * <IPv6 node>,<port>,<IPv6 representation of IPv4 node>,<port>,
+ * <IPv4 representation of IPv6 node>,<port>,<IPv4 node>,<port>
+ *
+ * (The remote node's columns are empty in BIB events. Port block events print
+ * the subscriber's prefix in the IPv6 node column, and the block's port range
+ * in the IPv4 representation's port column.)
+ */
+static void print_record(struct natlog_record const *record)
+{
+	__u64 ns;
+	time_t sec;
+	struct tm tm;
+	char date[32];
+	char src6[INET6_ADDRSTRLEN];
+	char dst6[INET6_ADDRSTRLEN];
+	char src4[INET_ADDRSTRLEN];
+	char dst4[INET_ADDRSTRLEN];
+	int written;
+
+	ns = be64toh(record->timestamp);
+	sec = ns / 1000000000;
+	gmtime_r(&sec, &tm);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+
+	inet_ntop(AF_INET6, &record->src6, src6, sizeof(src6));
+	inet_ntop(AF_INET, &record->src4, src4, sizeof(src4));
+	switch (record->event) {
+	case NATLOG_SESSION_ADD:
+	case NATLOG_SESSION_RM:
+		inet_ntop(AF_INET6, &record->dst6, dst6, sizeof(dst6));
+		inet_ntop(AF_INET, &record->dst4, dst4, sizeof(dst4));
+		written = fprintf(out, "%s.%09lluZ,%s,%s,%s,%s,%u,%s,%u,%s,%u,%s,%u\n",
+				date, (unsigned long long)(ns % 1000000000),
+				iname, event2str(record->event),
+				proto2str(record->proto),
+				src6, ntohs(record->src6_port),
+				dst6, ntohs(record->dst6_port),
+				src4, ntohs(record->src4_port),
+				dst4, ntohs(record->dst4_port));
+		break;
+	case NATLOG_BLOCK_ADD:
+	case NATLOG_BLOCK_RM:
+		written = fprintf(out, "%s.%09lluZ,%s,%s,%s,%s/%u,,,,%s,%u-%u,,\n",
+				date, (unsigned long long)(ns % 1000000000),
+				iname, event2str(record->event),
+				proto2str(record->proto),
+				src6, ntohs(record->src6_port),
+				src4, ntohs(record->src4_port),
+				ntohs(record->dst4_port));
+		break;
+	default:
+		written = fprintf(out, "%s.%09lluZ,%s,%s,%s,%s,%u,,,%s,%u,,\n",
+				date, (unsigned long long)(ns % 1000000000),
+				iname, event2str(record->event),
+				proto2str(record->proto),
+				src6, ntohs(record->src6_port),
+				src4, ntohs(record->src4_port));
+	}
+
+	if (written > 0)
+		out_size += written;
+}
+
+static void write_records(struct natlog_record const *records,
+		unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		print_record(&records[i]);
+	fflush(out);
+
+	if (cfg->file && out_size >= cfg->file_size)
+		rotate_file();
+}
+
+static int natlog_cb(struct nl_msg *msg, void *arg)
+{
+	struct nlmsghdr *nhdr;
+	struct genlmsghdr *ghdr;
+	struct joolnlhdr *jhdr;
+	struct nlattr *attr;
+	struct jool_result result;
+	unsigned int count;
+
+	nhdr = nlmsg_hdr(msg);
+	if (!genlmsg_valid_hdr(nhdr, sizeof(struct joolnlhdr))) {
+		pr_err("Kernel sent invalid data: Message too short to contain headers");
+		return NL_SKIP;
+	}
+
+	ghdr = genlmsg_hdr(nhdr);
+	jhdr = genlmsg_user_hdr(ghdr);
+	result = validate_joolnlhdr(jhdr, XT_NAT64);
+	if (result.error) {
+		pr_result(&result);
+		return NL_SKIP;
+	}
+	if (strcasecmp(jhdr->iname, iname) != 0)
+		return NL_SKIP; /* Another instance's records. */
+
+	attr = genlmsg_attrdata(ghdr, sizeof(struct joolnlhdr));
+	if (genlmsg_attrlen(ghdr, sizeof(struct joolnlhdr)) < NLA_HDRLEN
+			|| nla_type(attr) != JNLAR_NATLOG_RECORDS) {
+		pr_err("Kernel sent invalid data: Message lacks a record array");
+		return NL_SKIP;
+	}
+
+	count = nla_len(attr) / sizeof(struct natlog_record);
+
+	if (cfg->ipfix_enabled)
+		ipfix_export(nla_data(attr), count);
+	if (out)
+		write_records(nla_data(attr), count);
+
+	return NL_OK;
+}
+
+static int listen_kernel(void)
+{
+	struct joolnl_socket sk;
+	struct jool_result result;
+	int group;
+	int error;
+
+	result = joolnl_setup(&sk, XT_NAT64);
+	if (result.error)
+		return pr_result(&result);
+
+	/* Multicast messages don't follow our sequence. */
+	nl_socket_disable_seq_check(sk.sk);
+	error = nl_socket_modify_cb(sk.sk, NL_CB_VALID, NL_CB_CUSTOM,
+			natlog_cb, NULL);
+	if (error) {
+		pr_err("Couldn't modify the socket's callbacks.");
+		goto end;
+	}
+
+	group = genl_ctrl_resolve_grp(sk.sk, JOOLNL_FAMILY,
+			JOOLNL_NATLOG_GRP_NAME);
+	if (group < 0) {
+		pr_err("Unable to resolve the NAT log's multicast group. (Is the kernel module too old?)");
+		error = group;
+		goto end;
+	}
+
+	error = nl_socket_add_membership(sk.sk, group);
+	if (error) {
+		pr_err("Can't register to the NAT log's multicast group.");
+		goto end;
+	}
+
+	error = nl_socket_set_buffer_size(sk.sk, NATLOG_SKBUF_SIZE,
+			NATLOG_SKBUF_SIZE);
+	if (error) {
+		/* Not fatal; we'll just drop more under stress. */
+		pr_warn("Can't enlarge the kernel socket's buffers: %s",
+				nl_geterror(error));
+	}
+
+	do {
+		error = nl_recvmsgs_default(sk.sk);
+		if (error == -NLE_NOMEM) {
+			/* The kernel overran our buffer (ENOBUFS). */
+			pr_warn("The socket buffer overflowed; some records were lost.");
+		} else if (error < 0) {
+			pr_err("Error receiving packet from kernelspace: %s",
+					nl_geterror(error));
+		}
+	} while (true);
+
+end:
+	joolnl_teardown(&sk);
+	if (error < 0)
+		pr_err("Netlink error message: %s", nl_geterror(error));
+	return error;
+}
+
+int natlog_collect(char const *instance, struct natlog_cfg *config)
+{
+	int error;
+
+	iname = instance ? instance : INAME_DEFAULT;
+	cfg = config;
+	out = NULL;
+
+	if (cfg->file || !cfg->ipfix_enabled) {
+		error = open_file();
+		if (error)
+			return error;
+	}
+	if (cfg->ipfix_enabled) {
+		error = ipfix_setup(&cfg->ipfix);
+		if (error)
+			goto end;
+	}
+
+	error = listen_kernel();
+
+	ipfix_teardown();
+end:
+	if (out && out != stdout)
+		fclose(out);
+	return error;
+}
@@ -0,0 +1,27 @@
+#ifndef SRC_USR_ARGP_NATLOG_COLLECTOR_H_
+#define SRC_USR_ARGP_NATLOG_COLLECTOR_H_
+
+/*
+ * Userspace end of the NAT event log. Listens to the kernel module's natlog
+ * Netlink multicast group, and writes the instance's records to rotating CSV
+ * files, standard output or an IPFIX collector.
+ */
+
+#include <stdbool.h>
+#include "usr/argp/natlog/ipfix.h"
+
+struct natlog_cfg {
+	/* NULL means standard output. */
+	char const *file;
+	/* Rotate @file once it grows past this many bytes. */
+	unsigned long file_size;
+	/* Number of rotated files to keep (@file.1 through @file.N). */
+	unsigned int file_count;
+
+	bool ipfix_enabled;
+	struct ipfix_cfg ipfix;
+};
+
+int natlog_collect(char const *iname, struct natlog_cfg *cfg);
+
+#endif /* SRC_USR_ARGP_NATLOG_COLLECTOR_H_ */
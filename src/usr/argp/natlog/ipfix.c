@@ -0,0 +1,353 @@
+#include "usr/argp/natlog/ipfix.h"
+
+#include <endian.h>
+#include <errno.h>
+#include <netdb.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "usr/argp/log.h"
+
+#define IPFIX_VERSION 10
+#define IPFIX_HDR_LEN 16
+#define IPFIX_SET_HDR_LEN 4
+#define IPFIX_SET_TEMPLATE 2
+
+#define TEMPLATE_BIB 256
+#define TEMPLATE_SESSION 257
+#define TEMPLATE_BLOCK 258
+
+/* Keeps the datagrams below the usual Ethernet MTU. */
+#define IPFIX_MAX_MSG 1400
+/* RFC 7011 section 8.4: Templates need to be resent periodically over UDP. */
+#define TEMPLATE_REFRESH 60 /* Seconds */
+
+/* natEvent values; RFC 8158 section 4.1. */
+#define NAT_EVENT_NAT64_SESSION_CREATE 6
+#define NAT_EVENT_NAT64_SESSION_DELETE 7
+#define NAT_EVENT_NAT64_BIB_CREATE 10
+#define NAT_EVENT_NAT64_BIB_DELETE 11
+#define NAT_EVENT_PORT_BLOCK_ALLOC 16
+#define NAT_EVENT_PORT_BLOCK_DEALLOC 17
+
+struct field_spec {
+	__u16 id;
+	__u16 len;
+};
+
+static struct field_spec const session_fields[] = {
+	{ 323, 8 },	/* observationTimeMilliseconds */
+	{ 230, 1 },	/* natEvent */
+	{ 4, 1 },	/* protocolIdentifier */
+	{ 27, 16 },	/* sourceIPv6Address */
+	{ 7, 2 },	/* sourceTransportPort */
+	{ 225, 4 },	/* postNATSourceIPv4Address */
+	{ 227, 2 },	/* postNAPTSourceTransportPort */
+	/* BIB records end here. */
+	{ 28, 16 },	/* destinationIPv6Address */
+	{ 11, 2 },	/* destinationTransportPort */
+	{ 226, 4 },	/* postNATDestinationIPv4Address */
+	{ 228, 2 },	/* postNAPTDestinationTransportPort */
+};
+
+static struct field_spec const block_fields[] = {
+	{ 323, 8 },	/* observationTimeMilliseconds */
+	{ 230, 1 },	/* natEvent */
+	{ 4, 1 },	/* protocolIdentifier */
+	{ 27, 16 },	/* sourceIPv6Address */
+	{ 29, 1 },	/* sourceIPv6PrefixLength */
+	{ 225, 4 },	/* postNATSourceIPv4Address */
+	{ 361, 2 },	/* portRangeStart */
+	{ 362, 2 },	/* portRangeEnd */
+};
+
+#define SESSION_FIELD_COUNT 11
+#define BIB_FIELD_COUNT 7
+#define BLOCK_FIELD_COUNT 8
+#define BIB_RECORD_LEN 34
+#define SESSION_RECORD_LEN 58
+#define BLOCK_RECORD_LEN 35
+
+struct ipfix_msg {
+	__u8 buffer[IPFIX_MAX_MSG];
+	size_t len;
+	/* Offset of the current set's header; 0 if there's no open set. */
+	size_t set;
+	__u16 set_id;
+	unsigned int records;
+};
+
+static int sk = -1;
+static unsigned int domain;
+static __u32 sequence;
+static time_t last_template;
+
+static void put8(struct ipfix_msg *msg, __u8 value)
+{
+	msg->buffer[msg->len] = value;
+	msg->len += 1;
+}
+
+static void put16(struct ipfix_msg *msg, __u16 value)
+{
+	value = htons(value);
+	memcpy(msg->buffer + msg->len, &value, sizeof(value));
+	msg->len += sizeof(value);
+}
+
+static void put32(struct ipfix_msg *msg, __u32 value)
+{
+	value = htonl(value);
+	memcpy(msg->buffer + msg->len, &value, sizeof(value));
+	msg->len += sizeof(value);
+}
+
+/* For fields that are already in network byte order. */
+static void putraw(struct ipfix_msg *msg, void const *value, size_t len)
+{
+	memcpy(msg->buffer + msg->len, value, len);
+	msg->len += len;
+}
+
+static void close_set(struct ipfix_msg *msg)
+{
+	__u16 len;
+
+	if (!msg->set)
+		return;
+
+	len = htons(msg->len - msg->set);
+	memcpy(msg->buffer + msg->set + 2, &len, sizeof(len));
+	msg->set = 0;
+}
+
+static void open_set(struct ipfix_msg *msg, __u16 id)
+{
+	if (msg->set && msg->set_id == id)
+		return;
+
+	close_set(msg);
+	msg->set = msg->len;
+	msg->set_id = id;
+	put16(msg, id);
+	put16(msg, 0); /* Length; see close_set(). */
+}
+
+static void put_templates(struct ipfix_msg *msg)
+{
+	unsigned int i;
+
+	open_set(msg, IPFIX_SET_TEMPLATE);
+
+	put16(msg, TEMPLATE_BIB);
+	put16(msg, BIB_FIELD_COUNT);
+	for (i = 0; i < BIB_FIELD_COUNT; i++) {
+		put16(msg, session_fields[i].id);
+		put16(msg, session_fields[i].len);
+	}
+
+	put16(msg, TEMPLATE_SESSION);
+	put16(msg, SESSION_FIELD_COUNT);
+	for (i = 0; i < SESSION_FIELD_COUNT; i++) {
+		put16(msg, session_fields[i].id);
+		put16(msg, session_fields[i].len);
+	}
+
+	put16(msg, TEMPLATE_BLOCK);
+	put16(msg, BLOCK_FIELD_COUNT);
+	for (i = 0; i < BLOCK_FIELD_COUNT; i++) {
+		put16(msg, block_fields[i].id);
+		put16(msg, block_fields[i].len);
+	}
+
+	close_set(msg);
+}
+
+static void init_msg(struct ipfix_msg *msg)
+{
+	time_t now;
+
+	msg->len = IPFIX_HDR_LEN;
+	msg->set = 0;
+	msg->records = 0;
+
+	now = time(NULL);
+	if (now - last_template >= TEMPLATE_REFRESH) {
+		put_templates(msg);
+		last_template = now;
+	}
+}
+
+static void send_msg(struct ipfix_msg *msg)
+{
+	size_t data_len;
+
+	close_set(msg);
+	data_len = msg->len;
+
+	msg->len = 0;
+	put16(msg, IPFIX_VERSION);
+	put16(msg, data_len);
+	put32(msg, time(NULL));
+	put32(msg, sequence);
+	put32(msg, domain);
+
+	if (send(sk, msg->buffer, data_len, 0) < 0)
+		pr_err("IPFIX send() failed: %s", strerror(errno));
+	else
+		sequence += msg->records;
+}
+
+static __u16 record2template(struct natlog_record const *record)
+{
+	switch (record->event) {
+	case NATLOG_SESSION_ADD:
+	case NATLOG_SESSION_RM:
+		return TEMPLATE_SESSION;
+	case NATLOG_BLOCK_ADD:
+	case NATLOG_BLOCK_RM:
+		return TEMPLATE_BLOCK;
+	}
+
+	return TEMPLATE_BIB;
+}
+
+static size_t record2len(struct natlog_record const *record)
+{
+	switch (record2template(record)) {
+	case TEMPLATE_SESSION:
+		return SESSION_RECORD_LEN;
+	case TEMPLATE_BLOCK:
+		return BLOCK_RECORD_LEN;
+	}
+
+	return BIB_RECORD_LEN;
+}
+
+static __u8 record2natevent(struct natlog_record const *record)
+{
+	switch (record->event) {
+	case NATLOG_BIB_ADD:
+		return NAT_EVENT_NAT64_BIB_CREATE;
+	case NATLOG_BIB_RM:
+		return NAT_EVENT_NAT64_BIB_DELETE;
+	case NATLOG_SESSION_ADD:
+		return NAT_EVENT_NAT64_SESSION_CREATE;
+	case NATLOG_SESSION_RM:
+		return NAT_EVENT_NAT64_SESSION_DELETE;
+	case NATLOG_BLOCK_ADD:
+		return NAT_EVENT_PORT_BLOCK_ALLOC;
+	case NATLOG_BLOCK_RM:
+		return NAT_EVENT_PORT_BLOCK_DEALLOC;
+	}
+
+	return 0;
+}
+
+static void put_record(struct ipfix_msg *msg,
+		struct natlog_record const *record)
+{
+	__u64 millis;
+
+	millis = htobe64(be64toh(record->timestamp) / 1000000);
+
+	putraw(msg, &millis, sizeof(millis));
+	put8(msg, record2natevent(record));
+	put8(msg, record->proto);
+	putraw(msg, &record->src6, sizeof(record->src6));
+
+	if (record2template(record) == TEMPLATE_BLOCK) {
+		put8(msg, ntohs(record->src6_port)); /* Prefix length */
+		putraw(msg, &record->src4, sizeof(record->src4));
+		putraw(msg, &record->src4_port, sizeof(record->src4_port));
+		putraw(msg, &record->dst4_port, sizeof(record->dst4_port));
+		msg->records++;
+		return;
+	}
+
+	putraw(msg, &record->src6_port, sizeof(record->src6_port));
+	putraw(msg, &record->src4, sizeof(record->src4));
+	putraw(msg, &record->src4_port, sizeof(record->src4_port));
+	if (record2template(record) == TEMPLATE_SESSION) {
+		putraw(msg, &record->dst6, sizeof(record->dst6));
+		putraw(msg, &record->dst6_port, sizeof(record->dst6_port));
+		putraw(msg, &record->dst4, sizeof(record->dst4));
+		putraw(msg, &record->dst4_port, sizeof(record->dst4_port));
+	}
+
+	msg->records++;
+}
+
+int ipfix_setup(struct ipfix_cfg *cfg)
+{
+	struct addrinfo hints = { 0 };
+	struct addrinfo *addrs;
+	struct addrinfo *addr;
+	int error;
+
+	hints.ai_socktype = SOCK_DGRAM;
+	error = getaddrinfo(cfg->address, cfg->port, &hints, &addrs);
+	if (error) {
+		pr_err("getaddrinfo(%s, %s) failed: %s", cfg->address,
+				cfg->port, gai_strerror(error));
+		return error;
+	}
+
+	for (addr = addrs; addr != NULL; addr = addr->ai_next) {
+		sk = socket(addr->ai_family, addr->ai_socktype,
+				addr->ai_protocol);
+		if (sk < 0)
+			continue;
+		if (connect(sk, addr->ai_addr, addr->ai_addrlen) == 0)
+			break;
+		close(sk);
+		sk = -1;
+	}
+
+	freeaddrinfo(addrs);
+	if (sk < 0) {
+		pr_err("Cannot reach IPFIX collector %s#%s.", cfg->address,
+				cfg->port);
+		return -EINVAL;
+	}
+
+	domain = cfg->domain;
+	sequence = 0;
+	last_template = 0;
+	return 0;
+}
+
+void ipfix_export(struct natlog_record const *records, unsigned int count)
+{
+	struct ipfix_msg msg;
+	size_t needed;
+	unsigned int i;
+
+	init_msg(&msg);
+
+	for (i = 0; i < count; i++) {
+		needed = record2len(&records[i]) + IPFIX_SET_HDR_LEN;
+
+		if (msg.len + needed > IPFIX_MAX_MSG) {
+			send_msg(&msg);
+			init_msg(&msg);
+		}
+
+		open_set(&msg, record2template(&records[i]));
+		put_record(&msg, &records[i]);
+	}
+
+	if (msg.records)
+		send_msg(&msg);
+}
+
+void ipfix_teardown(void)
+{
+	if (sk >= 0) {
+		close(sk);
+		sk = -1;
+	}
+}
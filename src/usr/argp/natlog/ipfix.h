@@ -0,0 +1,25 @@
+#ifndef SRC_USR_ARGP_NATLOG_IPFIX_H_
+#define SRC_USR_ARGP_NATLOG_IPFIX_H_
+
+/*
+ * A minimal IPFIX (RFC 7011) exporter for the NAT event log.
+ *
+ * Exports over UDP, using the NAT logging Information Elements from RFC 8158.
+ * There are three templates: one for BIB events (mapping only), one for
+ * session events (mapping plus remote node) and one for port block events
+ * (subscriber prefix plus port range).
+ */
+
+#include "common/natlog.h"
+
+struct ipfix_cfg {
+	char const *address;
+	char const *port;
+	unsigned int domain;
+};
+
+int ipfix_setup(struct ipfix_cfg *cfg);
+void ipfix_export(struct natlog_record const *records, unsigned int count);
+void ipfix_teardown(void);
+
+#endif /* SRC_USR_ARGP_NATLOG_IPFIX_H_ */
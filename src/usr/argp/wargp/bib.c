@@ -1,5 +1,7 @@
 #include "usr/argp/wargp/bib.h"
 
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "usr/argp/dns.h"
@@ -8,8 +10,11 @@
 #include "usr/argp/userspace-types.h"
 #include "usr/argp/wargp.h"
 #include "usr/argp/xlator_type.h"
+#include "common/deterministic.h"
 #include "usr/nl/bib.h"
 #include "usr/nl/core.h"
+#include "usr/nl/global.h"
+#include "usr/nl/pool4.h"
 #include "usr/util/str_utils.h"
 
 struct display_args {
@@ -226,3 +231,223 @@ void autocomplete_bib_remove(void const *args)
 {
 	print_wargp_opts(remove_opts);
 }
+
+#define ARGP_MARK 3000
+
+struct lookup_addr {
+	bool addr6_set;
+	struct in6_addr addr6;
+	bool addr4_set;
+	struct ipv4_transport_addr addr4;
+};
+
+struct lookup_args {
+	struct wargp_l4proto proto;
+	__u32 mark;
+	struct lookup_addr addr;
+};
+
+static int parse_lookup_addr(void *void_field, int key, char *str)
+{
+	struct lookup_addr *field = void_field;
+	struct jool_result result;
+
+	if (field->addr6_set || field->addr4_set)
+		return ARGP_ERR_UNKNOWN;
+
+	if (strchr(str, ':')) {
+		field->addr6_set = true;
+		result = str_to_addr6(str, &field->addr6);
+		return pr_result(&result);
+	}
+	if (strchr(str, '.')) {
+		field->addr4_set = true;
+		result = str_to_addr4_port(str, &field->addr4);
+		return pr_result(&result);
+	}
+
+	return ARGP_ERR_UNKNOWN;
+}
+
+struct wargp_type wt_lookup_addr = {
+	.arg = "IP6ADDR|IP4ADDR#PORT",
+	.parse = parse_lookup_addr,
+};
+
+static struct wargp_option lookup_opts[] = {
+	WARGP_TCP(struct lookup_args, proto, "Query the TCP mapping (default)"),
+	WARGP_UDP(struct lookup_args, proto, "Query the UDP mapping"),
+	WARGP_ICMP(struct lookup_args, proto, "Query the ICMP mapping"),
+	{
+		.name = "mark",
+		.key = ARGP_MARK,
+		.doc = "Mark of the pool4 entries the subscriber is masked with",
+		.offset = offsetof(struct lookup_args, mark),
+		.type = &wt_u32,
+	}, {
+		.name = "Address",
+		.key = ARGP_KEY_ARG,
+		.doc = "Subscriber IPv6 address, or masked IPv4 transport address",
+		.offset = offsetof(struct lookup_args, addr),
+		.type = &wt_lookup_addr,
+	},
+	{ 0 },
+};
+
+/* The deterministic mapping's inputs, as currently configured. */
+struct det_config {
+	__u32 mark;
+	__u32 block_size;
+	__u8 prefix_len;
+	struct config_prefix6 prefix;
+
+	struct ipv4_range *ranges;
+	unsigned int count;
+};
+
+static struct jool_result collect_global(struct joolnl_global_meta const *meta,
+		void *value, void *args)
+{
+	struct det_config *cfg = args;
+
+	switch (joolnl_global_meta_id(meta)) {
+	case JNLAG_PBA_BLOCK_SIZE:
+		cfg->block_size = *(__u32 *)value;
+		break;
+	case JNLAG_PBA_PREFIX_LEN:
+		cfg->prefix_len = *(__u8 *)value;
+		break;
+	case JNLAG_PBA_DET_PREFIX:
+		cfg->prefix = *(struct config_prefix6 *)value;
+		break;
+	default:
+		break;
+	}
+
+	return result_success();
+}
+
+static struct jool_result collect_range(struct pool4_entry const *entry,
+		void *args)
+{
+	struct det_config *cfg = args;
+	struct ipv4_range *ranges;
+
+	if (entry->mark != cfg->mark)
+		return result_success();
+
+	ranges = realloc(cfg->ranges, (cfg->count + 1) * sizeof(*ranges));
+	if (!ranges)
+		return result_from_enomem();
+
+	ranges[cfg->count] = entry->range;
+	cfg->ranges = ranges;
+	cfg->count++;
+	return result_success();
+}
+
+static struct jool_result print_block(struct det_config *cfg,
+		struct lookup_addr *addr)
+{
+	struct ipv6_prefix subscriber;
+	struct ipv4_transport_addr first;
+	__u64 index;
+	char str6[INET6_ADDRSTRLEN];
+	char str4[INET_ADDRSTRLEN];
+	int error;
+
+	if (addr->addr6_set) {
+		error = det_subscriber_index(&cfg->prefix.prefix,
+				cfg->prefix_len, &addr->addr6, &index);
+		if (error)
+			return result_from_error(error,
+					"The address is not a deterministic subscriber.");
+		error = det_nth_block(cfg->ranges, cfg->count,
+				cfg->block_size, index, &first);
+		if (error)
+			return result_from_error(error,
+					"pool4 mark %u has no port block for the subscriber.",
+					cfg->mark);
+	} else {
+		error = det_block_index(cfg->ranges, cfg->count,
+				cfg->block_size, &addr->addr4, &index, &first);
+		if (error)
+			return result_from_error(error,
+					"The transport address does not belong to any port block.");
+		if (cfg->prefix_len - cfg->prefix.prefix.len < 64
+				&& index >> (cfg->prefix_len - cfg->prefix.prefix.len))
+			return result_from_error(-ESRCH,
+					"The port block is not assigned to any subscriber.");
+	}
+
+	det_subscriber_prefix(&cfg->prefix.prefix, cfg->prefix_len, index,
+			&subscriber);
+
+	inet_ntop(AF_INET6, &subscriber.addr, str6, sizeof(str6));
+	inet_ntop(AF_INET, &first.l3, str4, sizeof(str4));
+	printf("%s/%u - %s#%u-%u\n", str6, subscriber.len, str4, first.l4,
+			first.l4 + cfg->block_size - 1);
+	return result_success();
+}
+
+/*
+ * Computes the deterministic mapping (see common/deterministic.h) from the
+ * instance's current configuration. There are no logs to query; the answer
+ * holds for any point in time during which pool4 and the PBA globals were the
+ * same as they are now.
+ */
+int handle_bib_lookup(char *iname, int argc, char **argv, void const *arg)
+{
+	struct lookup_args largs = { 0 };
+	struct det_config cfg = { 0 };
+	struct joolnl_socket sk;
+	struct jool_result result;
+
+	result.error = wargp_parse(lookup_opts, argc, argv, &largs);
+	if (result.error)
+		return result.error;
+
+	if (!largs.addr.addr6_set && !largs.addr.addr4_set) {
+		struct requirement reqs[] = {
+			{ false, "an IPv6 address or an IPv4 transport address" },
+			{ 0 },
+		};
+		return requirement_print(reqs);
+	}
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error)
+		return pr_result(&result);
+
+	cfg.mark = largs.mark;
+	result = joolnl_global_foreach(&sk, iname, collect_global, &cfg);
+	if (result.error)
+		goto end;
+	if (!cfg.block_size || !cfg.prefix.set) {
+		result = result_from_error(-EINVAL,
+				"Deterministic PBA is disabled. (See pba-block-size and pba-deterministic-prefix.)");
+		goto end;
+	}
+	if (det_validate(&cfg.prefix.prefix, cfg.prefix_len)) {
+		result = result_from_error(-EINVAL,
+				"pba-prefix-length is incompatible with pba-deterministic-prefix.");
+		goto end;
+	}
+
+	result = joolnl_pool4_foreach(&sk, iname, largs.proto.proto,
+			collect_range, &cfg);
+	if (result.error)
+		goto end;
+
+	result = print_block(&cfg, &largs.addr);
+
+end:
+	free(cfg.ranges);
+	joolnl_teardown(&sk);
+	return pr_result(&result);
+}
+
+void autocomplete_bib_lookup(void const *args)
+{
+	print_wargp_opts(lookup_opts);
+}
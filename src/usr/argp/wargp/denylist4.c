@@ -4,6 +4,7 @@
 #include "usr/argp/requirements.h"
 #include "usr/argp/userspace-types.h"
 #include "usr/argp/wargp.h"
+#include "usr/argp/wargp/xdp.h"
 #include "usr/argp/xlator_type.h"
 #include "usr/nl/core.h"
 #include "usr/nl/denylist4.h"
@@ -126,6 +127,8 @@ int handle_denylist4_add(char *iname, int argc, char **argv, void const *arg)
 		return pr_result(&result);
 
 	result = joolnl_denylist4_add(&sk, iname, &aargs.prefix.prefix, aargs.force);
+	if (!result.error)
+		result = xdp_refresh(&sk, iname);
 
 	joolnl_teardown(&sk);
 	return pr_result(&result);
@@ -180,6 +183,8 @@ int handle_denylist4_remove(char *iname, int argc, char **argv, void const *arg)
 		return pr_result(&result);
 
 	result = joolnl_denylist4_rm(&sk, iname, &rargs.prefix.prefix);
+	if (!result.error)
+		result = xdp_refresh(&sk, iname);
 
 	joolnl_teardown(&sk);
 	return pr_result(&result);
@@ -210,6 +215,8 @@ int handle_denylist4_flush(char *iname, int argc, char **argv, void const *arg)
 		return pr_result(&result);
 
 	result = joolnl_denylist4_flush(&sk, iname);
+	if (!result.error)
+		result = xdp_refresh(&sk, iname);
 
 	joolnl_teardown(&sk);
 	return pr_result(&result);
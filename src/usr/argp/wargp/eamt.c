@@ -4,6 +4,7 @@
 #include "usr/argp/requirements.h"
 #include "usr/argp/userspace-types.h"
 #include "usr/argp/wargp.h"
+#include "usr/argp/wargp/xdp.h"
 #include "usr/argp/xlator_type.h"
 #include "usr/nl/core.h"
 #include "usr/nl/eamt.h"
@@ -164,6 +165,8 @@ int handle_eamt_add(char *iname, int argc, char **argv, void const *arg)
 			&aargs.entry.value.prefix6,
 			&aargs.entry.value.prefix4,
 			aargs.force);
+	if (!result.error)
+		result = xdp_refresh(&sk, iname);
 
 	joolnl_teardown(&sk);
 	return pr_result(&result);
@@ -214,6 +217,8 @@ int handle_eamt_remove(char *iname, int argc, char **argv, void const *arg)
 	result = joolnl_eamt_rm(&sk, iname,
 			rargs.entry.prefix6_set ? &rargs.entry.value.prefix6 : NULL,
 			rargs.entry.prefix4_set ? &rargs.entry.value.prefix4 : NULL);
+	if (!result.error)
+		result = xdp_refresh(&sk, iname);
 
 	joolnl_teardown(&sk);
 	return pr_result(&result);
@@ -242,6 +247,8 @@ int handle_eamt_flush(char *iname, int argc, char **argv, void const *arg)
 		return pr_result(&result);
 
 	result = joolnl_eamt_flush(&sk, iname);
+	if (!result.error)
+		result = xdp_refresh(&sk, iname);
 
 	joolnl_teardown(&sk);
 	return pr_result(&result);
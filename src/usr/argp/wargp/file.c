@@ -1,11 +1,13 @@
 #include "usr/argp/wargp/file.h"
 
 #include <errno.h>
+#include <stdlib.h>
 
 #include "usr/argp/log.h"
 #include "usr/argp/requirements.h"
 #include "usr/argp/wargp.h"
 #include "usr/argp/xlator_type.h"
+#include "usr/argp/wargp/xdp.h"
 #include "usr/nl/core.h"
 #include "usr/nl/file.h"
 
@@ -26,6 +28,31 @@ static struct wargp_option update_opts[] = {
 	{ 0 },
 };
 
+/*
+ * Atomic configuration can replace anything, so the XDP maps need a full
+ * refresh. The instance name might have come from the file.
+ */
+static struct jool_result refresh_xdp(struct joolnl_socket *sk,
+		char const *iname, char const *file_name)
+{
+	char *file_iname;
+	struct jool_result result;
+
+	if (iname)
+		return xdp_refresh(sk, iname);
+
+	result = joolnl_file_get_iname(file_name, &file_iname);
+	if (result.error) {
+		/* The file doesn't name it, so it's the default instance. */
+		result_cleanup(&result);
+		return xdp_refresh(sk, NULL);
+	}
+
+	result = xdp_refresh(sk, file_iname);
+	free(file_iname);
+	return result;
+}
+
 int handle_file_update(char *iname, int argc, char **argv, void const *arg)
 {
 	struct update_args uargs = { 0 };
@@ -50,6 +77,8 @@ int handle_file_update(char *iname, int argc, char **argv, void const *arg)
 
 	result = joolnl_file_parse(&sk, xt_get(), iname, uargs.file_name.value,
 			uargs.force.value);
+	if (!result.error)
+		result = refresh_xdp(&sk, iname, uargs.file_name.value);
 
 	joolnl_teardown(&sk);
 	return pr_result(&result);
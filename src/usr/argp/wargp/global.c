@@ -4,6 +4,7 @@
 #include "usr/argp/log.h"
 #include "usr/argp/userspace-types.h"
 #include "usr/argp/wargp.h"
+#include "usr/argp/wargp/xdp.h"
 #include "usr/argp/xlator_type.h"
 #include "usr/nl/core.h"
 #include "usr/nl/global.h"
@@ -101,6 +102,8 @@ static int handle_global_update(char *iname, int argc, char **argv, void const *
 	if (result.error)
 		return pr_result(&result);
 	result = joolnl_global_update(&sk, iname, field, uargs.global_str.value, uargs.force.value);
+	if (!result.error)
+		result = xdp_refresh(&sk, iname);
 	joolnl_teardown(&sk);
 
 	return pr_result(&result);
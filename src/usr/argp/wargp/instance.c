@@ -7,15 +7,18 @@
 #include "usr/argp/requirements.h"
 #include "usr/argp/wargp.h"
 #include "usr/argp/xlator_type.h"
+#include "usr/argp/wargp/xdp.h"
 #include "usr/util/str_utils.h"
 #include "usr/nl/core.h"
 #include "usr/nl/instance.h"
 
 #define OPTNAME_NETFILTER		"netfilter"
 #define OPTNAME_IPTABLES		"iptables"
+#define OPTNAME_INGRESS			"ingress"
 
 #define ARGP_IPTABLES 1000
 #define ARGP_NETFILTER 1001
+#define ARGP_INGRESS 1002
 #define ARGP_POOL6 '6'
 
 struct wargp_iname {
@@ -77,6 +80,8 @@ static void print_entry_csv(struct instance_entry_usr const *entry)
 		printf("netfilter");
 	else if (entry->xf & XF_IPTABLES)
 		printf("iptables");
+	else if (entry->xf & XF_INGRESS)
+		printf("ingress");
 	else
 		printf("unknown");
 	printf("\n");
@@ -95,6 +100,8 @@ static void print_entry_normal(struct instance_entry_usr const *entry)
 		printf("netfilter");
 	else if (entry->xf & XF_IPTABLES)
 		printf(" iptables");
+	else if (entry->xf & XF_INGRESS)
+		printf("  ingress");
 	else
 		printf("  unknown");
 	printf(" |\n");
@@ -162,6 +169,7 @@ struct add_args {
 	struct wargp_iname iname;
 	struct wargp_bool iptables;
 	struct wargp_bool netfilter;
+	struct wargp_string ingress;
 	struct wargp_prefix6 pool6;
 };
 
@@ -181,6 +189,12 @@ static struct wargp_option add_opts[] = {
 		.doc = "Sit the translator on top of Netfilter (default)",
 		.offset = offsetof(struct add_args, netfilter),
 		.type = &wt_bool,
+	}, {
+		.name = OPTNAME_INGRESS,
+		.key = ARGP_INGRESS,
+		.doc = "Sit the translator on the ingress of these (comma-separated) interfaces",
+		.offset = offsetof(struct add_args, ingress),
+		.type = &wt_string,
 	}, {
 		.name = "pool6",
 		.key = ARGP_POOL6,
@@ -211,9 +225,8 @@ int handle_instance_add(char *iname, int argc, char **argv, void const *arg)
 		iname = aargs.iname.value;
 
 	/* Validate framework */
-	if (!aargs.netfilter.value && !aargs.iptables.value)
-		aargs.netfilter.value = true;
-	if (aargs.netfilter.value && aargs.iptables.value) {
+	if (aargs.netfilter.value + aargs.iptables.value
+			+ (aargs.ingress.value != NULL) > 1) {
 		pr_err("The translator can only be hooked to one framework.");
 		return -EINVAL;
 	}
@@ -228,9 +241,15 @@ int handle_instance_add(char *iname, int argc, char **argv, void const *arg)
 	if (result.error)
 		return pr_result(&result);
 
-	xf = aargs.netfilter.value ? XF_NETFILTER : XF_IPTABLES;
+	if (aargs.iptables.value)
+		xf = XF_IPTABLES;
+	else if (aargs.ingress.value)
+		xf = XF_INGRESS;
+	else
+		xf = XF_NETFILTER;
 	result = joolnl_instance_add(&sk, xf, iname,
-			aargs.pool6.set ? &aargs.pool6.prefix : NULL);
+			aargs.pool6.set ? &aargs.pool6.prefix : NULL,
+			aargs.ingress.value);
 
 	joolnl_teardown(&sk);
 	return pr_result(&result);
@@ -272,6 +291,8 @@ int handle_instance_remove(char *iname, int argc, char **argv, void const *arg)
 		return pr_result(&result);
 
 	result = joolnl_instance_rm(&sk, iname);
+	if (!result.error)
+		result = xdp_forget(iname);
 
 	joolnl_teardown(&sk);
 	return pr_result(&result);
@@ -17,6 +17,7 @@ struct display_args {
 	struct wargp_l4proto proto;
 	struct wargp_bool no_headers;
 	struct wargp_bool csv;
+	struct wargp_bool usage;
 
 	struct {
 		bool initialized;
@@ -33,16 +34,32 @@ static struct wargp_option display_opts[] = {
 	WARGP_ICMP(struct display_args, proto, "Print the ICMP table"),
 	WARGP_NO_HEADERS(struct display_args, no_headers),
 	WARGP_CSV(struct display_args, csv),
+	{
+		.name = "usage",
+		.key = 'u',
+		.doc = "Also print how many ports are taken, and the allocation iteration counters",
+		.offset = offsetof(struct display_args, usage),
+		.type = &wt_bool,
+	},
 	{ 0 },
 };
 
-static void print_separator(void)
+static void print_separator(struct display_args *args)
+{
+	if (args->usage.value)
+		print_table_separator(0, 10, 5, 18, 15, 11, 24, 0);
+	else
+		print_table_separator(0, 10, 5, 18, 15, 11, 0);
+}
+
+static unsigned long long count_ports(struct pool4_entry const *entry)
 {
-	print_table_separator(0, 10, 5, 18, 15, 11, 0);
+	return (unsigned long long)port_range_count(&entry->range.ports)
+			<< (32 - entry->range.prefix.len);
 }
 
 static void display_entry_csv(struct pool4_entry const *entry,
-		struct display_args *args)
+		__u32 const *used, struct display_args *args)
 {
 	printf("%u,%s,%s", entry->mark, l4proto_to_string(entry->proto),
 			inet_ntoa(entry->range.prefix.addr));
@@ -55,7 +72,11 @@ static void display_entry_csv(struct pool4_entry const *entry,
 	else
 		printf("%u,", entry->iterations);
 
-	printf("%u\n", !(entry->flags & ITERATIONS_AUTO));
+	printf("%u", !(entry->flags & ITERATIONS_AUTO));
+
+	if (used)
+		printf(",%u,%llu", *used, count_ports(entry));
+	printf("\n");
 }
 
 static bool print_common_values(struct pool4_entry const *entry,
@@ -68,10 +89,12 @@ static bool print_common_values(struct pool4_entry const *entry,
 }
 
 static void display_entry_normal(struct pool4_entry const *entry,
-		struct display_args *args)
+		__u32 const *used, struct display_args *args)
 {
+	unsigned long long total;
+
 	if (print_common_values(entry, args)) {
-		print_separator();
+		print_separator(args);
 		printf("| %10u | %5s | ", entry->mark,
 				l4proto_to_string(entry->proto));
 		if (entry->flags & ITERATIONS_INFINITE)
@@ -87,9 +110,15 @@ static void display_entry_normal(struct pool4_entry const *entry,
 	printf(" | %15s", inet_ntoa(entry->range.prefix.addr));
 	if (entry->range.prefix.len != 32)
 		printf("/%u", entry->range.prefix.len);
-	printf(" | %5u-%5u |\n",
+	printf(" | %5u-%5u |",
 			entry->range.ports.min,
 			entry->range.ports.max);
+	if (used) {
+		total = count_ports(entry);
+		printf(" %7u/%7llu (%5.1f%%) |", *used, total,
+				total ? (100.0 * *used / total) : 0.0);
+	}
+	printf("\n");
 
 	args->last.initialized = true;
 	args->last.mark = entry->mark;
@@ -102,17 +131,81 @@ static struct jool_result handle_display_response(struct pool4_entry const *entr
 	struct display_args *dargs = args;
 
 	if (dargs->csv.value)
-		display_entry_csv(entry, args);
+		display_entry_csv(entry, NULL, args);
+	else
+		display_entry_normal(entry, NULL, args);
+
+	dargs->count++;
+	return result_success();
+}
+
+static struct jool_result handle_usage_response(
+		struct joolnl_pool4_usage const *usage, void *args)
+{
+	struct display_args *dargs = args;
+
+	if (dargs->csv.value)
+		display_entry_csv(&usage->entry, &usage->used, args);
 	else
-		display_entry_normal(entry, args);
+		display_entry_normal(&usage->entry, &usage->used, args);
 
 	dargs->count++;
 	return result_success();
 }
 
+static unsigned long long bucket_min(unsigned int bucket)
+{
+	return bucket ? (1ULL << bucket) : 0;
+}
+
+static void print_iterations(struct jool_mask_iterations const *iterations,
+		struct display_args *args)
+{
+	__u64 allocations;
+	unsigned int b;
+
+	allocations = iterations->successes + iterations->failures;
+
+	if (args->csv.value) {
+		printf("\n");
+		if (!args->no_headers.value)
+			printf("Min iterations,Max iterations,Allocations\n");
+	} else {
+		printf("\nAllocations: %llu (%llu failed)\n",
+				(unsigned long long)allocations,
+				(unsigned long long)iterations->failures);
+		if (!allocations)
+			return;
+		printf("Iterations per allocation: %.1f average, %llu max\n",
+				(double)iterations->total / allocations,
+				(unsigned long long)iterations->max);
+	}
+
+	for (b = 0; b < JITER_BUCKETS; b++) {
+		if (!iterations->buckets[b])
+			continue;
+
+		if (args->csv.value) {
+			printf("%llu,", bucket_min(b));
+			if (b != JITER_BUCKETS - 1)
+				printf("%llu", (1ULL << (b + 1)) - 1);
+			printf(",%llu\n",
+					(unsigned long long)iterations->buckets[b]);
+		} else if (b != JITER_BUCKETS - 1) {
+			printf("\t%8llu - %8llu: %llu\n", bucket_min(b),
+					(1ULL << (b + 1)) - 1,
+					(unsigned long long)iterations->buckets[b]);
+		} else {
+			printf("\t%8llu+          : %llu\n", bucket_min(b),
+					(unsigned long long)iterations->buckets[b]);
+		}
+	}
+}
+
 int handle_pool4_display(char *iname, int argc, char **argv, void const *arg)
 {
 	struct display_args dargs = { 0 };
+	struct jool_mask_iterations iterations[JITER_PROTO_COUNT];
 	struct joolnl_socket sk;
 	struct jool_result result;
 
@@ -125,19 +218,32 @@ int handle_pool4_display(char *iname, int argc, char **argv, void const *arg)
 		return pr_result(&result);
 
 	if (!dargs.no_headers.value) {
-		if (dargs.csv.value)
-			printf("Mark,Protocol,Address,Min port,Max port,Iterations,Iterations fixed\n");
-		else {
-			print_separator();
-			printf("| %10s | %5s | %18s | %15s | %11s |\n",
+		if (dargs.csv.value) {
+			printf("Mark,Protocol,Address,Min port,Max port,Iterations,Iterations fixed");
+			if (dargs.usage.value)
+				printf(",Used ports,Total ports");
+			printf("\n");
+		} else {
+			print_separator(&dargs);
+			printf("| %10s | %5s | %18s | %15s | %11s |",
 					"Mark", "Proto", "Max iterations",
 					"Address", "Ports");
+			if (dargs.usage.value)
+				printf(" %24s |", "Used");
+			printf("\n");
 		}
 	}
 
 	dargs.count = 0;
-	result = joolnl_pool4_foreach(&sk, iname, dargs.proto.proto,
-			handle_display_response, &dargs);
+	if (dargs.usage.value) {
+		result = joolnl_pool4_usage(&sk, iname, dargs.proto.proto,
+				handle_usage_response, &dargs);
+		if (!result.error)
+			result = joolnl_pool4_iterations(&sk, iname, iterations);
+	} else {
+		result = joolnl_pool4_foreach(&sk, iname, dargs.proto.proto,
+				handle_display_response, &dargs);
+	}
 
 	joolnl_teardown(&sk);
 
@@ -146,9 +252,11 @@ int handle_pool4_display(char *iname, int argc, char **argv, void const *arg)
 
 	if (!dargs.csv.value) {
 		if (dargs.count == 0)
-			print_separator(); /* Header border */
-		print_separator(); /* Table border */
+			print_separator(&dargs); /* Header border */
+		print_separator(&dargs); /* Table border */
 	}
+	if (dargs.usage.value)
+		print_iterations(&iterations[dargs.proto.proto], &dargs);
 	return 0;
 }
 
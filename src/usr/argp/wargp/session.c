@@ -1,8 +1,11 @@
 #include "usr/argp/wargp/session.h"
 
+#include <arpa/inet.h>
+#include <errno.h>
 #include <linux/types.h>
 #include <netlink/genl/ctrl.h>
 #include <netlink/genl/genl.h>
+#include <stdlib.h>
 #include <syslog.h>
 
 #include "common/config.h"
@@ -17,7 +20,9 @@
 #include "usr/argp/userspace-types.h"
 #include "usr/argp/wargp.h"
 #include "usr/argp/xlator_type.h"
+#include "usr/argp/joold/loop.h"
 #include "usr/argp/joold/modsocket.h"
+#include "usr/argp/natlog/collector.h"
 
 struct display_args {
 	struct wargp_bool no_headers;
@@ -138,6 +143,121 @@ int handle_session_display(char *iname, int argc, char **argv, void const *arg)
 	return pr_result(&result);
 }
 
+struct top_args {
+	struct wargp_bool no_headers;
+	struct wargp_bool csv;
+	struct wargp_l4proto proto;
+};
+
+static struct wargp_option top_opts[] = {
+	WARGP_TCP(struct top_args, proto, "Print the TCP top talkers (default)"),
+	WARGP_UDP(struct top_args, proto, "Print the UDP top talkers"),
+	WARGP_ICMP(struct top_args, proto, "Print the ICMP top talkers"),
+	WARGP_NO_HEADERS(struct top_args, no_headers),
+	WARGP_CSV(struct top_args, csv),
+	{ 0 },
+};
+
+struct talker_list {
+	struct joolnl_talker *talkers;
+	unsigned int count;
+};
+
+static struct jool_result collect_talker(struct joolnl_talker const *talker,
+		void *args)
+{
+	struct talker_list *list = args;
+	struct joolnl_talker *tmp;
+
+	tmp = realloc(list->talkers, (list->count + 1) * sizeof(*tmp));
+	if (!tmp)
+		return result_from_enomem();
+
+	tmp[list->count] = *talker;
+	list->talkers = tmp;
+	list->count++;
+	return result_success();
+}
+
+/* Sorts by requests, descending. */
+static int compare_talkers(void const *a, void const *b)
+{
+	__u32 requests1 = ((struct joolnl_talker const *)a)->requests;
+	__u32 requests2 = ((struct joolnl_talker const *)b)->requests;
+
+	if (requests1 != requests2)
+		return (requests1 < requests2) ? 1 : -1;
+	return 0;
+}
+
+static void print_top_separator(void)
+{
+	print_table_separator(0, 43, 10, 10, 0);
+}
+
+int handle_session_top(char *iname, int argc, char **argv, void const *arg)
+{
+	struct top_args targs = { 0 };
+	struct joolnl_socket sk;
+	struct talker_list list = { 0 };
+	struct joolnl_talker *talker;
+	char prefix_str[INET6_ADDRSTRLEN];
+	unsigned int i;
+	struct jool_result result;
+
+	result.error = wargp_parse(top_opts, argc, argv, &targs);
+	if (result.error)
+		return result.error;
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error)
+		return pr_result(&result);
+
+	result = joolnl_session_top(&sk, iname, targs.proto.proto,
+			collect_talker, &list);
+
+	joolnl_teardown(&sk);
+
+	if (result.error) {
+		free(list.talkers);
+		return pr_result(&result);
+	}
+
+	qsort(list.talkers, list.count, sizeof(*list.talkers),
+			compare_talkers);
+
+	if (!targs.no_headers.value) {
+		if (targs.csv.value) {
+			printf("Subscriber,Requests,Sessions\n");
+		} else {
+			print_top_separator();
+			printf("| %43s | %10s | %10s |\n",
+					"Subscriber", "Requests", "Sessions");
+			print_top_separator();
+		}
+	}
+
+	for (i = 0; i < list.count; i++) {
+		talker = &list.talkers[i];
+		inet_ntop(AF_INET6, &talker->prefix.addr, prefix_str,
+				sizeof(prefix_str));
+		if (targs.csv.value) {
+			printf("%s/%u,%u,%u\n", prefix_str, talker->prefix.len,
+					talker->requests, talker->sessions);
+		} else {
+			printf("| %39s/%-3u | %10u | %10u |\n", prefix_str,
+					talker->prefix.len, talker->requests,
+					talker->sessions);
+		}
+	}
+
+	if (!targs.csv.value)
+		print_top_separator();
+
+	free(list.talkers);
+	return 0;
+}
+
 int handle_session_follow(char *iname, int argc, char **argv, void const *arg)
 {
 	int error;
@@ -163,11 +283,18 @@ end:	closelog();
 struct proxy_args {
 	struct wargp_string net_mcast_addr;
 	struct wargp_string net_mcast_port;
+	struct wargp_string net_transport;
+	struct wargp_string net_peers;
 	struct wargp_string net_dev_in;
 	struct wargp_string net_dev_out;
 	__u32 net_ttl;
+	struct wargp_string net_format;
+	struct wargp_bool net_compress;
+	__u32 net_compress_threshold;
 	struct wargp_string stats_addr;
 	struct wargp_string stats_port;
+	struct wargp_string metrics_addr;
+	struct wargp_string metrics_port;
 };
 
 static struct wargp_option proxy_opts[] = {
@@ -184,6 +311,18 @@ static struct wargp_option proxy_opts[] = {
 		.doc = "UDP port where the sessions will be advertised",
 		.offset = offsetof(struct proxy_args, net_mcast_port),
 		.type = &wt_string,
+	}, {
+		.name = "net.transport",
+		.key = 3023,
+		.doc = "Session exchange transport (udp = multicast, tcp = unicast to --net.peers)",
+		.offset = offsetof(struct proxy_args, net_transport),
+		.type = &wt_string,
+	}, {
+		.name = "net.peers",
+		.key = 3024,
+		.doc = "TCP only: Comma-separated proxies to send our sessions to (<address>[#<port>])",
+		.offset = offsetof(struct proxy_args, net_peers),
+		.type = &wt_string,
 	}, {
 		.name = "net.dev.in",
 		.key = 'i',
@@ -202,6 +341,24 @@ static struct wargp_option proxy_opts[] = {
 		.doc = "Multicast datagram Time To Live",
 		.offset = offsetof(struct proxy_args, net_ttl),
 		.type = &wt_u32,
+	}, {
+		.name = "net.format",
+		.key = 3020,
+		.doc = "Session encoding on the network (compact, legacy)",
+		.offset = offsetof(struct proxy_args, net_format),
+		.type = &wt_string,
+	}, {
+		.name = "net.compress",
+		.key = 3021,
+		.doc = "Compress large compact batches (requires zstd)",
+		.offset = offsetof(struct proxy_args, net_compress),
+		.type = &wt_bool,
+	}, {
+		.name = "net.compress.threshold",
+		.key = 3022,
+		.doc = "Minimum number of sessions a batch needs to be compressed",
+		.offset = offsetof(struct proxy_args, net_compress_threshold),
+		.type = &wt_u32,
 	}, {
 		.name = "stats.address",
 		.key = 3010,
@@ -214,6 +371,18 @@ static struct wargp_option proxy_opts[] = {
 		.doc = "Port to bind the stats socket to",
 		.offset = offsetof(struct proxy_args, stats_port),
 		.type = &wt_string,
+	}, {
+		.name = "stats.metrics.address",
+		.key = 3012,
+		.doc = "Address to serve OpenMetrics (HTTP) from",
+		.offset = offsetof(struct proxy_args, metrics_addr),
+		.type = &wt_string,
+	}, {
+		.name = "stats.metrics.port",
+		.key = 3013,
+		.doc = "Port to serve OpenMetrics (HTTP) from",
+		.offset = offsetof(struct proxy_args, metrics_port),
+		.type = &wt_string,
 	},
 	{ 0 },
 };
@@ -226,6 +395,7 @@ int handle_session_proxy(char *iname, int argc, char **argv, void const *arg)
 	int error;
 
 	pargs.net_ttl = 1;
+	pargs.net_compress_threshold = 16;
 
 	error = wargp_parse(proxy_opts, argc, argv, &pargs);
 	if (error)
@@ -236,9 +406,26 @@ int handle_session_proxy(char *iname, int argc, char **argv, void const *arg)
 	netcfg.mcast_port = (pargs.net_mcast_port.value != NULL)
 			? pargs.net_mcast_port.value
 			: "6400";
+	error = net_str2transport(pargs.net_transport.value, &netcfg.transport);
+	if (error) {
+		pr_err("Unknown net.transport: '%s'", pargs.net_transport.value);
+		return error;
+	}
+	netcfg.peers = pargs.net_peers.value;
+	if (netcfg.transport != NET_TRANSPORT_TCP && netcfg.peers) {
+		pr_err("--net.peers requires --net.transport=tcp.");
+		return EINVAL;
+	}
 	netcfg.in_interface = pargs.net_dev_in.value;
 	netcfg.out_interface = pargs.net_dev_out.value;
 	netcfg.ttl = pargs.net_ttl;
+	error = wire_str2format(pargs.net_format.value, &netcfg.wire.format);
+	if (error) {
+		pr_err("Unknown net.format: '%s'", pargs.net_format.value);
+		return error;
+	}
+	netcfg.wire.compress = pargs.net_compress.value;
+	netcfg.wire.compress_threshold = pargs.net_compress_threshold;
 
 	statcfg.enabled = pargs.stats_addr.value || pargs.stats_port.value;
 	statcfg.address = (pargs.stats_addr.value != NULL)
@@ -247,10 +434,99 @@ int handle_session_proxy(char *iname, int argc, char **argv, void const *arg)
 	statcfg.port = (pargs.stats_port.value != NULL)
 			? pargs.stats_port.value
 			: "6401";
+	statcfg.metrics_enabled = pargs.metrics_addr.value
+			|| pargs.metrics_port.value;
+	statcfg.metrics_address = (pargs.metrics_addr.value != NULL)
+			? pargs.metrics_addr.value
+			: "::";
+	statcfg.metrics_port = (pargs.metrics_port.value != NULL)
+			? pargs.metrics_port.value
+			: "9641";
 
 	return joold_start(iname, &netcfg, &statcfg);
 }
 
+struct log_args {
+	struct wargp_string file;
+	__u32 file_size;
+	__u32 file_count;
+	struct wargp_string ipfix_addr;
+	struct wargp_string ipfix_port;
+	__u32 ipfix_domain;
+};
+
+static struct wargp_option log_opts[] = {
+	{
+		.name = "file",
+		.key = 'f',
+		.doc = "File the records will be appended to (Default: standard output)",
+		.offset = offsetof(struct log_args, file),
+		.type = &wt_string,
+	}, {
+		.name = "file.size",
+		.key = 3030,
+		.doc = "Rotate the file once it grows past this many MiB",
+		.offset = offsetof(struct log_args, file_size),
+		.type = &wt_u32,
+	}, {
+		.name = "file.count",
+		.key = 3031,
+		.doc = "Number of rotated files to keep",
+		.offset = offsetof(struct log_args, file_count),
+		.type = &wt_u32,
+	}, {
+		.name = "ipfix.address",
+		.key = 3032,
+		.doc = "Also export the records to this IPFIX collector (UDP)",
+		.offset = offsetof(struct log_args, ipfix_addr),
+		.type = &wt_string,
+	}, {
+		.name = "ipfix.port",
+		.key = 3033,
+		.doc = "IPFIX collector's port",
+		.offset = offsetof(struct log_args, ipfix_port),
+		.type = &wt_string,
+	}, {
+		.name = "ipfix.domain",
+		.key = 3034,
+		.doc = "IPFIX Observation Domain ID",
+		.offset = offsetof(struct log_args, ipfix_domain),
+		.type = &wt_u32,
+	},
+	{ 0 },
+};
+
+int handle_session_log(char *iname, int argc, char **argv, void const *arg)
+{
+	struct log_args largs = { 0 };
+	struct natlog_cfg cfg;
+	int error;
+
+	largs.file_size = 64;
+	largs.file_count = 8;
+
+	error = wargp_parse(log_opts, argc, argv, &largs);
+	if (error)
+		return error;
+
+	if (largs.file_size == 0) {
+		pr_err("--file.size cannot be zero.");
+		return EINVAL;
+	}
+
+	cfg.file = largs.file.value;
+	cfg.file_size = (unsigned long)largs.file_size << 20;
+	cfg.file_count = largs.file_count;
+	cfg.ipfix_enabled = largs.ipfix_addr.value != NULL;
+	cfg.ipfix.address = largs.ipfix_addr.value;
+	cfg.ipfix.port = (largs.ipfix_port.value != NULL)
+			? largs.ipfix_port.value
+			: "4739";
+	cfg.ipfix.domain = largs.ipfix_domain;
+
+	return natlog_collect(iname, &cfg);
+}
+
 int handle_session_advertise(char *iname, int argc, char **argv, void const *arg)
 {
 	struct joolnl_socket sk;
@@ -271,6 +547,11 @@ void autocomplete_session_display(void const *args)
 	print_wargp_opts(display_opts);
 }
 
+void autocomplete_session_top(void const *args)
+{
+	print_wargp_opts(top_opts);
+}
+
 void autocomplete_session_follow(void const *args)
 {
 	/* Nothing needed here. */
@@ -281,6 +562,11 @@ void autocomplete_session_proxy(void const *args)
 	print_wargp_opts(proxy_opts);
 }
 
+void autocomplete_session_log(void const *args)
+{
+	print_wargp_opts(log_opts);
+}
+
 void autocomplete_session_advertise(void const *args)
 {
 	/* Nothing needed here. */
@@ -298,14 +584,30 @@ int joold_start(char const *iname, struct netsocket_cfg *netcfg,
 	if (netcfg->enabled) {
 		printf("  net.mcast.addr: %s\n", netcfg->mcast_addr);
 		printf("  net.mcast.port: %s\n", netcfg->mcast_port);
+		printf("  net.transport: %s\n",
+				(netcfg->transport == NET_TRANSPORT_TCP)
+						? "tcp"
+						: "udp");
+		if (netcfg->transport == NET_TRANSPORT_TCP)
+			printf("  net.peers: %s\n", netcfg->peers);
 		printf("  net.dev.in: %s\n", netcfg->in_interface);
 		printf("  net.dev.out: %s\n", netcfg->out_interface);
 		printf("  net.ttl: %d\n", netcfg->ttl);
+		printf("  net.format: %s\n",
+				(netcfg->wire.format == WIRE_FORMAT_LEGACY)
+						? "legacy"
+						: "compact");
+		printf("  net.compress: %s\n",
+				netcfg->wire.compress ? "true" : "false");
 	}
 	if (statcfg->enabled) {
 		printf("  stats.addr: %s\n", statcfg->address);
 		printf("  stats.port: %s\n", statcfg->port);
 	}
+	if (statcfg->metrics_enabled) {
+		printf("  stats.metrics.addr: %s\n", statcfg->metrics_address);
+		printf("  stats.metrics.port: %s\n", statcfg->metrics_port);
+	}
 
 	printf("\n");
 	printf("joold is intended as a daemon, so it outputs straight to syslog.\n");
@@ -314,7 +616,13 @@ int joold_start(char const *iname, struct netsocket_cfg *netcfg,
 
 	openlog("joold", 0, LOG_DAEMON);
 
+	error = loop_setup();
+	if (error)
+		goto end;
 	error = modsocket_setup(iname);
+	if (error)
+		goto end;
+	error = modsocket_register();
 	if (error)
 		goto end;
 	error = netsocket_start(netcfg);
@@ -324,9 +632,10 @@ int joold_start(char const *iname, struct netsocket_cfg *netcfg,
 	if (error)
 		goto end;
 
-	modsocket_listen(NULL); /* Loops forever */
+	error = loop_run(); /* Loops forever */
 
-end:	closelog();
+end:	netsocket_stop();
+	closelog();
 	fprintf(stderr, "joold error: %d (See syslog)\n", error);
 	return error;
 }
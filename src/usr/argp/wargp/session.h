@@ -5,13 +5,17 @@
 #include "usr/argp/joold/statsocket.h"
 
 int handle_session_display(char *, int, char **, void const *);
+int handle_session_top(char *, int, char **, void const *);
 int handle_session_follow(char *, int, char **, void const *);
 int handle_session_proxy(char *, int, char **, void const *);
+int handle_session_log(char *, int, char **, void const *);
 int handle_session_advertise(char *, int, char **, void const *);
 
 void autocomplete_session_display(void const *);
+void autocomplete_session_top(void const *);
 void autocomplete_session_follow(void const *);
 void autocomplete_session_proxy(void const *);
+void autocomplete_session_log(void const *);
 void autocomplete_session_advertise(void const *);
 
 int joold_start(char const *iname, struct netsocket_cfg *netcfg,
@@ -85,3 +85,211 @@ void autocomplete_stats_display(void const *args)
 {
 	print_wargp_opts(display_opts);
 }
+
+struct latency_args {
+	struct wargp_bool no_headers;
+	struct wargp_bool csv;
+};
+
+static struct wargp_option latency_opts[] = {
+	WARGP_NO_HEADERS(struct latency_args, no_headers),
+	WARGP_CSV(struct latency_args, csv),
+	{ 0 },
+};
+
+static char const *const dir_names[] = {
+	[JLAT_6TO4] = "6to4",
+	[JLAT_4TO6] = "4to6",
+};
+
+static char const *const stage_names[] = {
+	[JLAT_IN_TUPLE] = "in-tuple",
+	[JLAT_FILTERING] = "filtering",
+	[JLAT_OUT_TUPLE] = "out-tuple",
+	[JLAT_TRANSLATE] = "translate",
+	[JLAT_SEND] = "send",
+};
+
+static unsigned long long bucket_min(unsigned int bucket)
+{
+	return bucket ? (1ULL << bucket) : 0;
+}
+
+/* Returns the upper bound of the bucket that contains the @percent% sample. */
+static unsigned long long percentile(__u64 const *buckets, __u64 total,
+		unsigned int percent)
+{
+	__u64 accumulated = 0;
+	unsigned int b;
+
+	for (b = 0; b < JLAT_BUCKETS; b++) {
+		accumulated += buckets[b];
+		if (100 * accumulated >= percent * total)
+			return 1ULL << (b + 1);
+	}
+
+	return 1ULL << JLAT_BUCKETS;
+}
+
+static void print_histogram(struct latency_args *largs, unsigned int d,
+		unsigned int s, __u64 const *buckets)
+{
+	__u64 total = 0;
+	unsigned int b;
+
+	for (b = 0; b < JLAT_BUCKETS; b++)
+		total += buckets[b];
+	if (total == 0)
+		return;
+
+	if (!largs->csv.value) {
+		printf("%s %s: %llu samples (p50 < %llu ns, p90 < %llu ns, p99 < %llu ns)\n",
+				dir_names[d], stage_names[s],
+				(unsigned long long)total,
+				percentile(buckets, total, 50),
+				percentile(buckets, total, 90),
+				percentile(buckets, total, 99));
+	}
+
+	for (b = 0; b < JLAT_BUCKETS; b++) {
+		if (!buckets[b])
+			continue;
+
+		if (largs->csv.value) {
+			printf("%s,%s,%llu,", dir_names[d], stage_names[s],
+					bucket_min(b));
+			if (b != JLAT_BUCKETS - 1)
+				printf("%llu", (1ULL << (b + 1)) - 1);
+			printf(",%llu\n", (unsigned long long)buckets[b]);
+		} else if (b != JLAT_BUCKETS - 1) {
+			printf("\t%10llu - %10llu ns: %llu\n", bucket_min(b),
+					(1ULL << (b + 1)) - 1,
+					(unsigned long long)buckets[b]);
+		} else {
+			printf("\t%10llu+             ns: %llu\n", bucket_min(b),
+					(unsigned long long)buckets[b]);
+		}
+	}
+}
+
+int handle_stats_latency(char *iname, int argc, char **argv, void const *arg)
+{
+	struct latency_args largs = { 0 };
+	struct jool_latency latency;
+	struct joolnl_socket sk;
+	struct jool_result result;
+	unsigned int d, s;
+
+	result.error = wargp_parse(latency_opts, argc, argv, &largs);
+	if (result.error)
+		return result.error;
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error)
+		return pr_result(&result);
+
+	result = joolnl_stats_latency(&sk, iname, &latency);
+	joolnl_teardown(&sk);
+	if (result.error)
+		return pr_result(&result);
+
+	if (show_csv_header(largs.no_headers.value, largs.csv.value))
+		printf("Direction,Stage,Min (ns),Max (ns),Count\n");
+
+	for (d = 0; d < JLAT_DIR_COUNT; d++)
+		for (s = 0; s < JLAT_STAGE_COUNT; s++)
+			print_histogram(&largs, d, s, latency.buckets[d][s]);
+
+	return 0;
+}
+
+void autocomplete_stats_latency(void const *args)
+{
+	print_wargp_opts(latency_opts);
+}
+
+struct locks_args {
+	struct wargp_bool no_headers;
+	struct wargp_bool csv;
+};
+
+static struct wargp_option locks_opts[] = {
+	WARGP_NO_HEADERS(struct locks_args, no_headers),
+	WARGP_CSV(struct locks_args, csv),
+	{ 0 },
+};
+
+static char const *const lock_names[] = {
+	[JLOCK_BIB_TCP] = "bib-tcp",
+	[JLOCK_BIB_UDP] = "bib-udp",
+	[JLOCK_BIB_ICMP] = "bib-icmp",
+	[JLOCK_POOL4] = "pool4",
+	[JLOCK_JOOLD] = "joold",
+};
+
+static void print_locks_separator(void)
+{
+	print_table_separator(0, 8, 14, 14, 14, 14, 0);
+}
+
+int handle_stats_locks(char *iname, int argc, char **argv, void const *arg)
+{
+	struct locks_args largs = { 0 };
+	struct jool_locks locks;
+	struct jool_lock_stats *lock;
+	struct joolnl_socket sk;
+	struct jool_result result;
+	unsigned long long mean;
+	unsigned int c;
+
+	result.error = wargp_parse(locks_opts, argc, argv, &largs);
+	if (result.error)
+		return result.error;
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error)
+		return pr_result(&result);
+
+	result = joolnl_stats_locks(&sk, iname, &locks);
+	joolnl_teardown(&sk);
+	if (result.error)
+		return pr_result(&result);
+
+	if (!largs.no_headers.value) {
+		if (largs.csv.value) {
+			printf("Lock,Acquisitions,Contended,Mean hold (ns),Max hold (ns)\n");
+		} else {
+			print_locks_separator();
+			printf("| %8s | %14s | %14s | %14s | %14s |\n", "Lock",
+					"Acquisitions", "Contended",
+					"Mean hold (ns)", "Max hold (ns)");
+			print_locks_separator();
+		}
+	}
+
+	for (c = 0; c < JLOCK_CLASS_COUNT; c++) {
+		lock = &locks.classes[c];
+		mean = lock->acquisitions
+				? (lock->hold_total / lock->acquisitions)
+				: 0;
+
+		printf(largs.csv.value
+				? "%s,%llu,%llu,%llu,%llu\n"
+				: "| %8s | %14llu | %14llu | %14llu | %14llu |\n",
+				lock_names[c],
+				(unsigned long long)lock->acquisitions,
+				(unsigned long long)lock->contended,
+				mean,
+				(unsigned long long)lock->hold_max);
+	}
+
+	if (!largs.csv.value)
+		print_locks_separator();
+
+	return 0;
+}
+
+void autocomplete_stats_locks(void const *args)
+{
+	print_wargp_opts(locks_opts);
+}
@@ -4,4 +4,10 @@
 int handle_stats_display(char *iname, int argc, char **argv, void const *arg);
 void autocomplete_stats_display(void const *args);
 
+int handle_stats_latency(char *iname, int argc, char **argv, void const *arg);
+void autocomplete_stats_latency(void const *args);
+
+int handle_stats_locks(char *iname, int argc, char **argv, void const *arg);
+void autocomplete_stats_locks(void const *args);
+
 #endif /* SRC_USR_ARGP_WARGP_STATS_H_ */
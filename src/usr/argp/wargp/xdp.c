@@ -0,0 +1,704 @@
+#include "usr/argp/wargp/xdp.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "usr/argp/log.h"
+#include "usr/argp/requirements.h"
+#include "usr/argp/wargp.h"
+#include "usr/argp/xlator_type.h"
+
+#ifdef HAVE_XDP
+
+#include <ifaddrs.h>
+#include <limits.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/stat.h>
+#include <linux/if_link.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "common/config.h"
+#include "common/xdp.h"
+#include "usr/nl/denylist4.h"
+#include "usr/nl/eamt.h"
+#include "usr/nl/global.h"
+#include "usr/nl/instance.h"
+
+#ifndef JOOL_XDP_OBJECT
+#define JOOL_XDP_OBJECT "/usr/local/lib/jool/jool_siit.bpf.o"
+#endif
+
+/* Must match the map names in src/usr/xdp/jool_siit.bpf.c. */
+enum xdp_map {
+	MAP_CONFIG,
+	MAP_EAMT6,
+	MAP_EAMT4,
+	MAP_DENYLIST4,
+	MAP_LOCAL4,
+	MAP_STATS,
+	MAP_COUNT,
+};
+
+static char const *const map_names[MAP_COUNT] = {
+	"config", "eamt6", "eamt4", "denylist4", "local4", "stats",
+};
+
+static void get_pin_dir(char const *iname, char *buffer, size_t size)
+{
+	snprintf(buffer, size, "%s/%s", JOOL_XDP_PIN_ROOT,
+			iname ? iname : INAME_DEFAULT);
+}
+
+static struct jool_result map_error(enum xdp_map map, char const *action,
+		int error)
+{
+	return result_from_error(error, "Cannot %s XDP map '%s': %s", action,
+			map_names[map], strerror(abs(error)));
+}
+
+static void maps_close(int *fds)
+{
+	unsigned int i;
+
+	for (i = 0; i < MAP_COUNT; i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+}
+
+/*
+ * Returns -ENOENT (and nothing else) if the fast path was never attached on
+ * behalf of @iname.
+ */
+static struct jool_result maps_open(char const *iname, int *fds)
+{
+	char path[PATH_MAX];
+	unsigned int i;
+
+	for (i = 0; i < MAP_COUNT; i++)
+		fds[i] = -1;
+
+	for (i = 0; i < MAP_COUNT; i++) {
+		get_pin_dir(iname, path, sizeof(path));
+		strcat(path, "/");
+		strcat(path, map_names[i]);
+
+		fds[i] = bpf_obj_get(path);
+		if (fds[i] < 0) {
+			int error = fds[i];
+			maps_close(fds);
+			return (error == -ENOENT)
+					? result_from_error(error, "The XDP fast path has not been attached on behalf of this instance.")
+					: map_error(i, "open", error);
+		}
+	}
+
+	return result_success();
+}
+
+static struct jool_result map_clear(int *fds, enum xdp_map map)
+{
+	/* Big enough for any of the keys. */
+	struct jool_xdp_key6 key;
+	int error;
+
+	while (bpf_map_get_next_key(fds[map], NULL, &key) == 0) {
+		error = bpf_map_delete_elem(fds[map], &key);
+		if (error)
+			return map_error(map, "flush", error);
+	}
+
+	return result_success();
+}
+
+static struct jool_result map_update(int *fds, enum xdp_map map,
+		void const *key, void const *value)
+{
+	int error;
+
+	error = bpf_map_update_elem(fds[map], key, value, BPF_ANY);
+	return error ? map_error(map, "update", error) : result_success();
+}
+
+/* The fast path assumes the prefixes' host bits are zero. */
+static void trim6(__be32 *dst, struct in6_addr const *src, unsigned int len)
+{
+	unsigned int i;
+
+	memcpy(dst, src, sizeof(*src));
+	for (i = 0; i < 4; i++) {
+		if (len >= 32) {
+			len -= 32;
+			continue;
+		}
+		dst[i] = len ? (dst[i] & htonl(~0u << (32 - len))) : 0;
+		len = 0;
+	}
+}
+
+static __be32 trim4(struct in_addr const *addr, unsigned int len)
+{
+	return len ? (addr->s_addr & htonl(~0u << (32 - len))) : 0;
+}
+
+static struct jool_result mirror_eam(struct eamt_entry const *entry,
+		void *args)
+{
+	int *fds = args;
+	struct jool_xdp_key6 key6;
+	struct jool_xdp_key4 key4;
+	struct jool_xdp_eam eam;
+	struct jool_result result;
+
+	memset(&eam, 0, sizeof(eam));
+	trim6(eam.prefix6, &entry->prefix6.addr, entry->prefix6.len);
+	eam.prefix6_len = entry->prefix6.len;
+	eam.prefix4 = trim4(&entry->prefix4.addr, entry->prefix4.len);
+	eam.prefix4_len = entry->prefix4.len;
+
+	key6.prefixlen = eam.prefix6_len;
+	memcpy(key6.addr, eam.prefix6, sizeof(key6.addr));
+	result = map_update(fds, MAP_EAMT6, &key6, &eam);
+	if (result.error)
+		return result;
+
+	key4.prefixlen = eam.prefix4_len;
+	key4.addr = eam.prefix4;
+	return map_update(fds, MAP_EAMT4, &key4, &eam);
+}
+
+static struct jool_result mirror_denylist4(struct ipv4_prefix const *prefix,
+		void *args)
+{
+	struct jool_xdp_key4 key;
+	__u8 value = 1;
+
+	key.prefixlen = prefix->len;
+	key.addr = trim4(&prefix->addr, prefix->len);
+	return map_update(args, MAP_DENYLIST4, &key, &value);
+}
+
+/*
+ * The kernel module refuses to translate its own namespace's addresses (see
+ * must_not_translate()), so the fast path needs to know them.
+ */
+static struct jool_result mirror_local4(int *fds)
+{
+	struct ifaddrs *ifaddrs, *ifa;
+	struct sockaddr_in *sin;
+	__u8 value = 1;
+	struct jool_result result;
+
+	if (getifaddrs(&ifaddrs))
+		return result_from_error(-errno,
+				"Cannot retrieve the interface addresses: %s",
+				strerror(errno));
+
+	result = result_success();
+	for (ifa = ifaddrs; ifa; ifa = ifa->ifa_next) {
+		if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET)
+			continue;
+		sin = (struct sockaddr_in *)ifa->ifa_addr;
+		result = map_update(fds, MAP_LOCAL4, &sin->sin_addr.s_addr,
+				&value);
+		if (result.error)
+			break;
+	}
+
+	freeifaddrs(ifaddrs);
+	return result;
+}
+
+static struct jool_result mirror_global(
+		struct joolnl_global_meta const *meta, void *value, void *args)
+{
+	struct jool_xdp_config *cfg = args;
+	struct config_prefix6 *pool6;
+
+	switch (joolnl_global_meta_id(meta)) {
+	case JNLAG_ENABLED:
+		cfg->enabled = *(bool *)value;
+		break;
+	case JNLAG_POOL6:
+		pool6 = value;
+		cfg->pool6_set = pool6->set;
+		if (pool6->set) {
+			cfg->pool6_len = pool6->prefix.len;
+			trim6(cfg->pool6, &pool6->prefix.addr,
+					pool6->prefix.len);
+		}
+		break;
+	case JNLAG_LOWEST_IPV6_MTU:
+		cfg->lowest_ipv6_mtu = *(__u32 *)value;
+		break;
+	case JNLAG_RESET_TC:
+		cfg->reset_traffic_class = *(bool *)value;
+		break;
+	case JNLAG_RESET_TOS:
+		cfg->reset_tos = *(bool *)value;
+		break;
+	case JNLAG_TOS:
+		cfg->new_tos = *(__u8 *)value;
+		break;
+	case JNLAG_HAIRPIN_MODE:
+		cfg->eam_hairpin_mode = *(__u8 *)value;
+		break;
+	default:
+		break;
+	}
+
+	return result_success();
+}
+
+/*
+ * Replaces the contents of the maps with @iname's current configuration.
+ *
+ * The fast path is disabled while this happens, which means the kernel module
+ * handles everything in the meantime. This is slower, but never wrong, so the
+ * maps don't need to be swapped atomically.
+ *
+ * The generation is queried before the configuration, so if somebody changes
+ * the instance while it's being mirrored, the fast path will see a mismatch
+ * and stay out of the way until the next refresh.
+ */
+static struct jool_result mirror(struct joolnl_socket *sk, char const *iname,
+		int *fds)
+{
+	struct jool_xdp_config cfg;
+	__u32 zero = 0;
+	enum xdp_map map;
+	struct jool_result result;
+
+	memset(&cfg, 0, sizeof(cfg));
+	result = map_update(fds, MAP_CONFIG, &zero, &cfg);
+	if (result.error)
+		return result;
+
+	for (map = MAP_EAMT6; map <= MAP_LOCAL4; map++) {
+		result = map_clear(fds, map);
+		if (result.error)
+			return result;
+	}
+
+	result = joolnl_instance_generation(sk, iname, &cfg.generation);
+	if (result.error)
+		return result;
+	strcpy(cfg.iname, iname ? iname : INAME_DEFAULT);
+
+	result = joolnl_eamt_foreach(sk, iname, mirror_eam, fds);
+	if (result.error)
+		return result;
+	result = joolnl_denylist4_foreach(sk, iname, mirror_denylist4, fds);
+	if (result.error)
+		return result;
+	result = mirror_local4(fds);
+	if (result.error)
+		return result;
+	result = joolnl_global_foreach(sk, iname, mirror_global, &cfg);
+	if (result.error)
+		return result;
+
+	return map_update(fds, MAP_CONFIG, &zero, &cfg);
+}
+
+static struct jool_result sync_maps(struct joolnl_socket *sk,
+		char const *iname)
+{
+	int fds[MAP_COUNT];
+	struct jool_result result;
+
+	result = maps_open(iname, fds);
+	if (result.error)
+		return result;
+
+	result = mirror(sk, iname, fds);
+
+	maps_close(fds);
+	return result;
+}
+
+struct jool_result xdp_refresh(struct joolnl_socket *sk, char const *iname)
+{
+	struct jool_result result;
+
+	if (xt_get() != XT_SIIT)
+		return result_success();
+
+	result = sync_maps(sk, iname);
+	if (result.error == -ENOENT) {
+		result_cleanup(&result);
+		return result_success();
+	}
+
+	return result;
+}
+
+struct jool_result xdp_forget(char const *iname)
+{
+	int fds[MAP_COUNT];
+	struct jool_xdp_config cfg;
+	__u32 zero = 0;
+	struct jool_result result;
+
+	if (xt_get() != XT_SIIT)
+		return result_success();
+
+	result = maps_open(iname, fds);
+	if (result.error == -ENOENT) {
+		result_cleanup(&result);
+		return result_success();
+	}
+	if (result.error)
+		return result;
+
+	memset(&cfg, 0, sizeof(cfg));
+	result = map_update(fds, MAP_CONFIG, &zero, &cfg);
+
+	maps_close(fds);
+	return result;
+}
+
+static struct jool_result get_ifindex(char const *name, int *ifindex)
+{
+	*ifindex = if_nametoindex(name);
+	if (*ifindex == 0)
+		return result_from_error(-errno, "Unknown interface '%s': %s",
+				name, strerror(errno));
+	return result_success();
+}
+
+static struct jool_result mkdir_pins(char const *iname, char *path,
+		size_t size)
+{
+	if (mkdir(JOOL_XDP_PIN_ROOT, 0700) && errno != EEXIST)
+		goto fail;
+	get_pin_dir(iname, path, size);
+	if (mkdir(path, 0700) && errno != EEXIST)
+		goto fail;
+	return result_success();
+
+fail:
+	return result_from_error(-errno,
+			"Cannot create directory under %s (is bpffs mounted?): %s",
+			JOOL_XDP_PIN_ROOT, strerror(errno));
+}
+
+static __u32 xdp_mode(bool generic)
+{
+	return generic ? XDP_FLAGS_SKB_MODE : XDP_FLAGS_DRV_MODE;
+}
+
+#else
+
+static int no_xdp(void)
+{
+	pr_err("This binary was compiled without XDP support.");
+	pr_err("(Reconfigure with --with-xdp; it requires libbpf and clang.)");
+	return -EOPNOTSUPP;
+}
+
+#endif /* HAVE_XDP */
+
+struct attach_args {
+	struct wargp_string dev;
+	struct wargp_bool generic;
+	struct wargp_string object;
+};
+
+static struct wargp_option attach_opts[] = {
+	{
+		.name = "Interface",
+		.key = ARGP_KEY_ARG,
+		.doc = "Interface whose incoming traffic will be translated by the fast path",
+		.offset = offsetof(struct attach_args, dev),
+		.type = &wt_string,
+		.arg = "<interface>",
+	}, {
+		.name = "generic",
+		.key = 'g',
+		.doc = "Attach in generic (SKB) mode, for drivers without native XDP",
+		.offset = offsetof(struct attach_args, generic),
+		.type = &wt_bool,
+	}, {
+		.name = "object",
+		.key = 'o',
+		.doc = "Path to the compiled fast path (jool_siit.bpf.o)",
+		.offset = offsetof(struct attach_args, object),
+		.type = &wt_string,
+	},
+	{ 0 },
+};
+
+int handle_xdp_attach(char *iname, int argc, char **argv, void const *arg)
+{
+	struct attach_args aargs = { 0 };
+	struct jool_result result;
+
+	result.error = wargp_parse(attach_opts, argc, argv, &aargs);
+	if (result.error)
+		return result.error;
+
+	if (!aargs.dev.value) {
+		struct requirement reqs[] = {
+				{ false, "an interface name" },
+				{ 0 },
+		};
+		return requirement_print(reqs);
+	}
+
+#ifdef HAVE_XDP
+	{
+		LIBBPF_OPTS(bpf_object_open_opts, opts);
+		struct joolnl_socket sk;
+		struct bpf_object *obj;
+		struct bpf_program *prog;
+		char pin_dir[PATH_MAX];
+		char const *path;
+		int ifindex;
+		int error;
+
+		result = get_ifindex(aargs.dev.value, &ifindex);
+		if (result.error)
+			return pr_result(&result);
+		result = mkdir_pins(iname, pin_dir, sizeof(pin_dir));
+		if (result.error)
+			return pr_result(&result);
+
+		/* Maps are pinned by name, so they're shared by all the interfaces. */
+		opts.pin_root_path = pin_dir;
+		path = aargs.object.value ? aargs.object.value : JOOL_XDP_OBJECT;
+		obj = bpf_object__open_file(path, &opts);
+		if (!obj) {
+			error = -errno;
+			pr_err("Cannot open %s: %s", path, strerror(-error));
+			return error;
+		}
+
+		error = bpf_object__load(obj);
+		if (error) {
+			pr_err("Cannot load %s: %s", path, strerror(-error));
+			pr_err("(The fast path needs the kernel module loaded, and Linux 6.9+ with CONFIG_DEBUG_INFO_BTF_MODULES.)");
+			goto end;
+		}
+		prog = bpf_object__find_program_by_name(obj, "jool_siit_xdp");
+		if (!prog) {
+			pr_err("%s does not contain the fast path.", path);
+			error = -ENOENT;
+			goto end;
+		}
+
+		/* Fill the maps before the program sees any traffic. */
+		result = joolnl_setup(&sk, xt_get());
+		if (result.error) {
+			error = pr_result(&result);
+			goto end;
+		}
+		result = sync_maps(&sk, iname);
+		joolnl_teardown(&sk);
+		if (result.error) {
+			error = pr_result(&result);
+			goto end;
+		}
+
+		error = bpf_xdp_attach(ifindex, bpf_program__fd(prog),
+				XDP_FLAGS_UPDATE_IF_NOEXIST
+				| xdp_mode(aargs.generic.value), NULL);
+		if (error)
+			pr_err("Cannot attach the fast path to %s: %s",
+					aargs.dev.value, strerror(-error));
+
+end:		/* The program and the maps outlive the object. */
+		bpf_object__close(obj);
+		return error;
+	}
+#else
+	return no_xdp();
+#endif
+}
+
+void autocomplete_xdp_attach(void const *args)
+{
+	print_wargp_opts(attach_opts);
+}
+
+struct detach_args {
+	struct wargp_string dev;
+	struct wargp_bool generic;
+};
+
+static struct wargp_option detach_opts[] = {
+	{
+		.name = "Interface",
+		.key = ARGP_KEY_ARG,
+		.doc = "Interface the fast path will be removed from",
+		.offset = offsetof(struct detach_args, dev),
+		.type = &wt_string,
+		.arg = "<interface>",
+	}, {
+		.name = "generic",
+		.key = 'g',
+		.doc = "The fast path was attached in generic (SKB) mode",
+		.offset = offsetof(struct detach_args, generic),
+		.type = &wt_bool,
+	},
+	{ 0 },
+};
+
+int handle_xdp_detach(char *iname, int argc, char **argv, void const *arg)
+{
+	struct detach_args dargs = { 0 };
+	struct jool_result result;
+
+	result.error = wargp_parse(detach_opts, argc, argv, &dargs);
+	if (result.error)
+		return result.error;
+
+	if (!dargs.dev.value) {
+		struct requirement reqs[] = {
+				{ false, "an interface name" },
+				{ 0 },
+		};
+		return requirement_print(reqs);
+	}
+
+#ifdef HAVE_XDP
+	{
+		int ifindex;
+		int error;
+
+		result = get_ifindex(dargs.dev.value, &ifindex);
+		if (result.error)
+			return pr_result(&result);
+
+		error = bpf_xdp_detach(ifindex, xdp_mode(dargs.generic.value),
+				NULL);
+		if (error)
+			pr_err("Cannot detach the fast path from %s: %s",
+					dargs.dev.value, strerror(-error));
+		return error;
+	}
+#else
+	return no_xdp();
+#endif
+}
+
+void autocomplete_xdp_detach(void const *args)
+{
+	print_wargp_opts(detach_opts);
+}
+
+int handle_xdp_sync(char *iname, int argc, char **argv, void const *arg)
+{
+	struct jool_result result;
+
+	result.error = wargp_parse(NULL, argc, argv, NULL);
+	if (result.error)
+		return result.error;
+
+#ifdef HAVE_XDP
+	{
+		struct joolnl_socket sk;
+
+		result = joolnl_setup(&sk, xt_get());
+		if (result.error)
+			return pr_result(&result);
+
+		result = sync_maps(&sk, iname);
+
+		joolnl_teardown(&sk);
+		return pr_result(&result);
+	}
+#else
+	return no_xdp();
+#endif
+}
+
+void autocomplete_xdp_sync(void const *args)
+{
+	/* Nothing needed here. */
+}
+
+int handle_xdp_display(char *iname, int argc, char **argv, void const *arg)
+{
+	struct jool_result result;
+
+	result.error = wargp_parse(NULL, argc, argv, NULL);
+	if (result.error)
+		return result.error;
+
+#ifdef HAVE_XDP
+	{
+		static char const *const labels[JOOL_XDP_STAT_COUNT] = {
+			"Translated IPv6 packets",
+			"Translated IPv4 packets",
+			"Packets left to the kernel module",
+		};
+		int fds[MAP_COUNT];
+		int cpus;
+		__u64 *values;
+		__u64 total;
+		__u32 key;
+		int i;
+		int error;
+
+		cpus = libbpf_num_possible_cpus();
+		if (cpus < 0) {
+			pr_err("Cannot count the CPUs: %s", strerror(-cpus));
+			return cpus;
+		}
+		values = calloc(cpus, sizeof(*values));
+		if (!values)
+			return -ENOMEM;
+
+		result = maps_open(iname, fds);
+		if (result.error) {
+			free(values);
+			return pr_result(&result);
+		}
+
+		for (key = 0; key < JOOL_XDP_STAT_COUNT; key++) {
+			error = bpf_map_lookup_elem(fds[MAP_STATS], &key,
+					values);
+			if (error) {
+				result = map_error(MAP_STATS, "read", error);
+				break;
+			}
+
+			total = 0;
+			for (i = 0; i < cpus; i++)
+				total += values[i];
+			printf("%s: %llu\n", labels[key],
+					(unsigned long long)total);
+		}
+
+		maps_close(fds);
+		free(values);
+		return pr_result(&result);
+	}
+#else
+	return no_xdp();
+#endif
+}
+
+void autocomplete_xdp_display(void const *args)
+{
+	/* Nothing needed here. */
+}
+
+#ifndef HAVE_XDP
+
+struct jool_result xdp_refresh(struct joolnl_socket *sk, char const *iname)
+{
+	return result_success();
+}
+
+struct jool_result xdp_forget(char const *iname)
+{
+	return result_success();
+}
+
+#endif
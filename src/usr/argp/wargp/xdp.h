@@ -0,0 +1,30 @@
+#ifndef SRC_USR_ARGP_WARGP_XDP_H_
+#define SRC_USR_ARGP_WARGP_XDP_H_
+
+#include "usr/nl/core.h"
+
+int handle_xdp_attach(char *iname, int argc, char **argv, void const *arg);
+void autocomplete_xdp_attach(void const *args);
+
+int handle_xdp_detach(char *iname, int argc, char **argv, void const *arg);
+void autocomplete_xdp_detach(void const *args);
+
+int handle_xdp_sync(char *iname, int argc, char **argv, void const *arg);
+void autocomplete_xdp_sync(void const *args);
+
+int handle_xdp_display(char *iname, int argc, char **argv, void const *arg);
+void autocomplete_xdp_display(void const *args);
+
+/*
+ * Re-mirrors @iname's configuration into its XDP maps, if the fast path has
+ * ever been attached on its behalf. Meant to be called after every successful
+ * configuration change.
+ */
+struct jool_result xdp_refresh(struct joolnl_socket *sk, char const *iname);
+/*
+ * Disables @iname's XDP maps, if the fast path has ever been attached on its
+ * behalf. Meant to be called after the instance is removed.
+ */
+struct jool_result xdp_forget(char const *iname);
+
+#endif /* SRC_USR_ARGP_WARGP_XDP_H_ */
@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "usr/joold/json.h"
 #include "usr/argp/wargp/session.h"
@@ -23,6 +24,8 @@ static int modsocket_config(char const *filename, char **iname)
 static int netsocket_config(char const *file, struct netsocket_cfg *cfg)
 {
 	cJSON *json;
+	char *format;
+	char *transport;
 	int error;
 
 	error = read_json(file, &json);
@@ -42,12 +45,38 @@ static int netsocket_config(char const *file, struct netsocket_cfg *cfg)
 	if (error)
 		goto end;
 	error = json2int(file, json, "ttl", &cfg->ttl);
+	if (error)
+		goto end;
 
 	if (cfg->ttl < 0 || 256 < cfg->ttl) {
 		fprintf(stderr, "%s: ttl out of range: %d\n", file, cfg->ttl);
 		return 1;
 	}
 
+	transport = NULL;
+	error = json2str(file, json, "transport", &transport);
+	if (error)
+		goto end;
+	error = net_str2transport(transport, &cfg->transport);
+	if (error) {
+		fprintf(stderr, "%s: Unknown transport: %s\n", file, transport);
+		free(transport);
+		goto end;
+	}
+	free(transport);
+	error = json2str(file, json, "peers", &cfg->peers);
+	if (error)
+		goto end;
+
+	format = NULL;
+	error = json2str(file, json, "format", &format);
+	if (error)
+		goto end;
+	error = wire_str2format(format, &cfg->wire.format);
+	if (error)
+		fprintf(stderr, "%s: Unknown format: %s\n", file, format);
+	free(format);
+
 end:	cJSON_Delete(json);
 	return error;
 }
@@ -65,6 +94,8 @@ int main(int argc, char **argv)
 		.mcast_port = "6400",
 		.enabled = true,
 		.ttl = 1,
+		.wire.format = WIRE_FORMAT_COMPACT,
+		.wire.compress_threshold = 16,
 	};
 	struct statsocket_cfg statcfg = {
 		.address = "::",
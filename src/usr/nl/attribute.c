@@ -321,6 +321,41 @@ struct jool_result nla_get_plateaus(struct nlattr *root,
 	return result_success();
 }
 
+struct jool_result nla_get_mark_ranges(struct nlattr *root,
+		struct mark_ranges *out)
+{
+	struct nlattr *attr;
+	struct nlattr *attrs[JNLAMR_COUNT];
+	int rem;
+	struct jool_result result;
+
+	result = jnla_validate_list(nla_data(root), nla_len(root),
+			"mark ranges", joolnl_struct_list_policy);
+	if (result.error)
+		return result;
+
+	out->count = 0;
+	nla_for_each_nested(attr, root, rem) {
+		if (out->count >= MARK_RANGES_MAX) {
+			return result_from_error(
+				-EINVAL,
+				"The kernel's response has too many mark ranges."
+			);
+		}
+
+		result = jnla_parse_nested(attrs, JNLAMR_MAX, attr,
+				joolnl_mark_range_policy);
+		if (result.error)
+			return result;
+
+		out->ranges[out->count].min = nla_get_u32(attrs[JNLAMR_LOW]);
+		out->ranges[out->count].max = nla_get_u32(attrs[JNLAMR_HIGH]);
+		out->count++;
+	}
+
+	return result_success();
+}
+
 static int nla_put_addr6(struct nl_msg *msg, int attrtype, struct in6_addr const *addr)
 {
 	return nla_put(msg, attrtype, sizeof(*addr), addr);
@@ -445,6 +480,36 @@ int nla_put_plateaus(struct nl_msg *msg, int attrtype, struct mtu_plateaus const
 	return 0;
 }
 
+int nla_put_mark_ranges(struct nl_msg *msg, int attrtype,
+		struct mark_ranges const *ranges)
+{
+	struct nlattr *root;
+	struct nlattr *entry;
+	unsigned int i;
+
+	root = jnla_nest_start(msg, attrtype);
+	if (!root)
+		return -NLE_NOMEM;
+
+	for (i = 0; i < ranges->count; i++) {
+		entry = jnla_nest_start(msg, JNLAL_ENTRY);
+		if (!entry)
+			goto cancel;
+		if (nla_put_u32(msg, JNLAMR_LOW, ranges->ranges[i].min) < 0)
+			goto cancel;
+		if (nla_put_u32(msg, JNLAMR_HIGH, ranges->ranges[i].max) < 0)
+			goto cancel;
+		nla_nest_end(msg, entry);
+	}
+
+	nla_nest_end(msg, root);
+	return 0;
+
+cancel:
+	nla_nest_cancel(msg, root);
+	return -NLE_NOMEM;
+}
+
 int nla_put_eam(struct nl_msg *msg, int attrtype, struct eamt_entry const *entry)
 {
 	struct nlattr *root;
@@ -35,6 +35,7 @@ struct jool_result nla_get_pool4(struct nlattr *attr, struct pool4_entry *out);
 struct jool_result nla_get_bib(struct nlattr *attr, struct bib_entry *out);
 struct jool_result nla_get_session(struct nlattr *attr, struct session_entry_usr *out);
 struct jool_result nla_get_plateaus(struct nlattr *attr, struct mtu_plateaus *out);
+struct jool_result nla_get_mark_ranges(struct nlattr *attr, struct mark_ranges *out);
 
 /*
  * Implementation notes:
@@ -63,6 +64,7 @@ struct jool_result nla_get_plateaus(struct nlattr *attr, struct mtu_plateaus *ou
 int nla_put_prefix6(struct nl_msg *msg, int attrtype, struct ipv6_prefix const *prefix);
 int nla_put_prefix4(struct nl_msg *msg, int attrtype, struct ipv4_prefix const *prefix);
 int nla_put_plateaus(struct nl_msg *msg, int attrtype, struct mtu_plateaus const *plateaus);
+int nla_put_mark_ranges(struct nl_msg *msg, int attrtype, struct mark_ranges const *ranges);
 int nla_put_eam(struct nl_msg *msg, int attrtype, struct eamt_entry const *entry);
 int nla_put_pool4(struct nl_msg *msg, int attrtype, struct pool4_entry const *entry);
 int nla_put_bib(struct nl_msg *msg, int attrtype, struct bib_entry const *entry);
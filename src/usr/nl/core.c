@@ -166,6 +166,23 @@ struct jool_result joolnl_msg2result(struct nl_msg *response)
 	);
 }
 
+static struct jool_result dump_done2result(struct nlmsghdr *nhdr)
+{
+	int error;
+
+	if (nlmsg_datalen(nhdr) < sizeof(error))
+		return result_success();
+
+	memcpy(&error, nlmsg_data(nhdr), sizeof(error));
+	if (error >= 0)
+		return result_success();
+
+	return result_from_error(
+		error,
+		"The kernel module's dump failed: %s", strerror(-error)
+	);
+}
+
 /*
  * Heads up:
  * Netlink wants this function to return either a negative error code or an enum
@@ -184,6 +201,11 @@ static int response_handler(struct nl_msg *response, void *_args)
 
 	args = _args;
 	nhdr = nlmsg_hdr(response);
+	if (nhdr->nlmsg_type == NLMSG_DONE) {
+		/* End of a dump. Let libnl handle it. */
+		args->result = dump_done2result(nhdr);
+		goto end;
+	}
 	if (!genlmsg_valid_hdr(nhdr, sizeof(struct joolnlhdr))) {
 		args->result = result_from_error(
 			-NLE_MSG_TOOSHORT,
@@ -273,6 +295,19 @@ struct jool_result joolnl_request(struct joolnl_socket *socket,
 	return result_success();
 }
 
+/**
+ * Same as joolnl_request(), except @msg is sent as a Netlink dump request.
+ * @cb will be called once for every message the kernel module streams back.
+ *
+ * Consumes @msg, even on error.
+ */
+struct jool_result joolnl_dump(struct joolnl_socket *socket,
+		struct nl_msg *msg, joolnl_response_cb cb, void *cb_arg)
+{
+	nlmsg_hdr(msg)->nlmsg_flags |= NLM_F_DUMP;
+	return joolnl_request(socket, msg, cb, cb_arg);
+}
+
 /**
  * Contract: The result will contain 0 on success, -ESRCH on module likely not
  * modprobed, else -EINVAL.
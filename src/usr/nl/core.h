@@ -21,6 +21,8 @@ struct jool_result joolnl_alloc_msg(struct joolnl_socket *socket,
 typedef struct jool_result (*joolnl_response_cb)(struct nl_msg *, void *);
 struct jool_result joolnl_request(struct joolnl_socket *sk, struct nl_msg *msg,
 		joolnl_response_cb cb, void *cb_arg);
+struct jool_result joolnl_dump(struct joolnl_socket *sk, struct nl_msg *msg,
+		joolnl_response_cb cb, void *cb_arg);
 
 struct jool_result validate_joolnlhdr(struct joolnlhdr *hdr, xlator_type xt);
 struct jool_result joolnl_msg2result(struct nl_msg *response);
@@ -575,6 +575,9 @@ static struct jool_result handle_framework_tag(cJSON *json,
 	} else if (STR_EQUAL(json->valuestring, "iptables")) {
 		flags |= XF_IPTABLES;
 		return result_success();
+	} else if (STR_EQUAL(json->valuestring, "ingress")) {
+		flags |= XF_INGRESS;
+		return result_success();
 	}
 
 	return result_from_error(
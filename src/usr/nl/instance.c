@@ -147,9 +147,53 @@ struct jool_result joolnl_instance_hello(struct joolnl_socket *sk,
 	return joolnl_request(sk, msg, jool_hello_cb, status);
 }
 
+static struct jool_result generation_cb(struct nl_msg *response,
+		void *generation)
+{
+	static struct nla_policy status_policy[JNLAIS_COUNT] = {
+		[JNLAIS_STATUS] = { .type = NLA_U8 },
+		[JNLAIS_GENERATION] = { .type = NLA_U64 },
+	};
+	struct nlattr *attrs[JNLAIS_COUNT];
+	struct jool_result result;
+
+	result = jnla_parse_msg(response, attrs, JNLAIS_MAX, status_policy,
+			false);
+	if (result.error)
+		return result;
+
+	if (!attrs[JNLAIS_STATUS]
+			|| nla_get_u8(attrs[JNLAIS_STATUS]) != IHS_ALIVE)
+		return result_from_error(-ESRCH, "The instance does not exist.");
+	if (!attrs[JNLAIS_GENERATION]) {
+		return result_from_error(-EINVAL,
+				"The kernel module did not report the instance's generation. (Is it older than the client?)");
+	}
+
+	*((__u64 *)generation) = nla_get_u64(attrs[JNLAIS_GENERATION]);
+	return result_success();
+}
+
+/**
+ * Retrieves the instance's generation; a number that changes whenever its
+ * translation rules do. (Used to tell whether the XDP maps are current.)
+ */
+struct jool_result joolnl_instance_generation(struct joolnl_socket *sk,
+		char const *iname, __u64 *generation)
+{
+	struct nl_msg *msg;
+	struct jool_result result;
+
+	result = joolnl_alloc_msg(sk, iname, JNLOP_INSTANCE_HELLO, 0, &msg);
+	if (result.error)
+		return result;
+
+	return joolnl_request(sk, msg, generation_cb, generation);
+}
+
 struct jool_result joolnl_instance_add(struct joolnl_socket *sk,
 		xlator_framework xf, char const *iname,
-		struct ipv6_prefix const *pool6)
+		struct ipv6_prefix const *pool6, char const *devices)
 {
 	struct nl_msg *msg;
 	struct nlattr *root;
@@ -158,6 +202,11 @@ struct jool_result joolnl_instance_add(struct joolnl_socket *sk,
 	result.error = xf_validate(xf);
 	if (result.error)
 		return result_from_error(result.error, XF_VALIDATE_ERRMSG);
+	if (devices && strlen(devices) >= INGRESS_DEVS_MAX_SIZE) {
+		return result_from_error(-EINVAL,
+				"The interface list is too long. (Max: %u characters)",
+				INGRESS_DEVS_MAX_SIZE - 1);
+	}
 
 	result = joolnl_alloc_msg(sk, iname, JNLOP_INSTANCE_ADD, 0, &msg);
 	if (result.error)
@@ -170,6 +219,8 @@ struct jool_result joolnl_instance_add(struct joolnl_socket *sk,
 	NLA_PUT_U8(msg, JNLAIA_XF, xf);
 	if (nla_put_prefix6(msg, JNLAIA_POOL6, pool6) < 0)
 		goto nla_put_failure;
+	if (devices)
+		NLA_PUT_STRING(msg, JNLAIA_DEVICES, devices);
 
 	nla_nest_end(msg, root);
 	return joolnl_request(sk, msg, NULL, NULL);
@@ -20,11 +20,18 @@ struct jool_result joolnl_instance_hello(
 	enum instance_hello_status *status
 );
 
+struct jool_result joolnl_instance_generation(
+	struct joolnl_socket *sk,
+	char const *iname,
+	__u64 *generation
+);
+
 struct jool_result joolnl_instance_add(
 	struct joolnl_socket *sk,
 	xlator_framework xf,
 	char const *iname,
-	struct ipv6_prefix const *pool6
+	struct ipv6_prefix const *pool6,
+	char const *devices
 );
 
 struct jool_result joolnl_instance_rm(
@@ -28,18 +28,26 @@ struct jool_result joolnl_joold_add(struct joolnl_socket *sk, char const *iname,
 	struct nl_msg *msg;
 	struct jool_result result;
 
+	size_t needed;
+
 	result = joolnl_alloc_msg(sk, iname, JNLOP_JOOLD_ADD, 0, &msg);
 	if (result.error)
 		return result;
 
+	/* joold merges several network datagrams into one request. */
+	needed = nlmsg_hdr(msg)->nlmsg_len + nla_total_size(data_len);
+	if (needed > nlmsg_get_max_size(msg)) {
+		result.error = nlmsg_expand(msg, needed);
+		if (result.error < 0) {
+			nlmsg_free(msg);
+			return result_from_enomem();
+		}
+	}
+
 	result.error = nla_put(msg, NLA_F_NESTED | JNLAR_SESSION_ENTRIES,
 			data_len, data);
 	if (result.error < 0) {
 		nlmsg_free(msg);
-		/*
-		 * This is fine as long as page size > 1500.
-		 * But admittedly, it's not the most elegant implementation.
-		 */
 		return result_from_error(
 			result.error,
 			"Can't send joold sessions to kernel: Packet too small."
@@ -1,12 +1,15 @@
 #include "usr/nl/pool4.h"
 
 #include <errno.h>
+#include <string.h>
 #include <netlink/genl/genl.h>
 #include "usr/nl/attribute.h"
 #include "usr/nl/common.h"
 
 struct foreach_args {
+	/* One of these is NULL. */
 	joolnl_pool4_foreach_cb cb;
+	joolnl_pool4_usage_cb usage_cb;
 	void *args;
 	bool done;
 	struct pool4_entry last;
@@ -18,7 +21,9 @@ static struct jool_result handle_foreach_response(struct nl_msg *response,
 	struct foreach_args *args = arg;
 	struct nlattr *attr;
 	int rem;
+	struct nlattr *used;
 	struct pool4_entry entry;
+	struct joolnl_pool4_usage usage;
 	struct jool_result result;
 
 	result = joolnl_init_foreach_list(response, "pool4", &args->done);
@@ -30,7 +35,20 @@ static struct jool_result handle_foreach_response(struct nl_msg *response,
 		if (result.error)
 			return result;
 
-		result = args->cb(&entry, args->args);
+		if (args->usage_cb) {
+			used = nla_find(nla_data(attr), nla_len(attr), JNLAP4_USED);
+			if (!used) {
+				return result_from_error(
+					-EINVAL,
+					"The kernel's pool4 usage entry lacks a port count."
+				);
+			}
+			usage.entry = entry;
+			usage.used = nla_get_u32(used);
+			result = args->usage_cb(&usage, args->args);
+		} else {
+			result = args->cb(&entry, args->args);
+		}
 		if (result.error)
 			return result;
 
@@ -40,23 +58,20 @@ static struct jool_result handle_foreach_response(struct nl_msg *response,
 	return result_success();
 }
 
-struct jool_result joolnl_pool4_foreach(struct joolnl_socket *sk,
-		char const *iname, l4_protocol proto,
-		joolnl_pool4_foreach_cb cb, void *_args)
+static struct jool_result __foreach(struct joolnl_socket *sk,
+		char const *iname, enum joolnl_operation operation,
+		l4_protocol proto, struct foreach_args *args)
 {
 	struct nl_msg *msg;
-	struct foreach_args args;
 	struct jool_result result;
 	bool first_request;
 
-	args.cb = cb;
-	args.args = _args;
-	args.done = true;
-	memset(&args.last, 0, sizeof(args.last));
+	args->done = true;
+	memset(&args->last, 0, sizeof(args->last));
 	first_request = true;
 
 	do {
-		result = joolnl_alloc_msg(sk, iname, JNLOP_POOL4_FOREACH, 0, &msg);
+		result = joolnl_alloc_msg(sk, iname, operation, 0, &msg);
 		if (result.error)
 			return result;
 
@@ -65,14 +80,14 @@ struct jool_result joolnl_pool4_foreach(struct joolnl_socket *sk,
 				goto cancel;
 			first_request = false;
 
-		} else if (nla_put_pool4(msg, JNLAR_OFFSET, &args.last) < 0) {
+		} else if (nla_put_pool4(msg, JNLAR_OFFSET, &args->last) < 0) {
 			goto cancel;
 		}
 
-		result = joolnl_request(sk, msg, handle_foreach_response, &args);
+		result = joolnl_request(sk, msg, handle_foreach_response, args);
 		if (result.error)
 			return result;
-	} while (!args.done);
+	} while (!args->done);
 
 	return result_success();
 
@@ -81,6 +96,70 @@ cancel:
 	return joolnl_err_msgsize();
 }
 
+struct jool_result joolnl_pool4_foreach(struct joolnl_socket *sk,
+		char const *iname, l4_protocol proto,
+		joolnl_pool4_foreach_cb cb, void *args)
+{
+	struct foreach_args fargs = { .cb = cb, .args = args };
+	return __foreach(sk, iname, JNLOP_POOL4_FOREACH, proto, &fargs);
+}
+
+/*
+ * Same as joolnl_pool4_foreach(), except each entry comes with the number of
+ * its ports that are currently taken by BIB entries.
+ */
+struct jool_result joolnl_pool4_usage(struct joolnl_socket *sk,
+		char const *iname, l4_protocol proto,
+		joolnl_pool4_usage_cb cb, void *args)
+{
+	struct foreach_args fargs = { .usage_cb = cb, .args = args };
+	return __foreach(sk, iname, JNLOP_POOL4_USAGE, proto, &fargs);
+}
+
+static struct jool_result iterations_response_cb(struct nl_msg *response,
+		void *args)
+{
+	static struct nla_policy iterations_policy[JNLAR_COUNT] = {
+		[JNLAR_POOL4_ITERATIONS] = {
+			.type = NLA_UNSPEC,
+			.minlen = JITER_PROTO_COUNT
+					* sizeof(struct jool_mask_iterations),
+		},
+	};
+	struct nlattr *attrs[JNLAR_COUNT];
+	struct jool_result result;
+
+	result = jnla_parse_msg(response, attrs, JNLAR_MAX, iterations_policy,
+			false);
+	if (result.error)
+		return result;
+
+	if (!attrs[JNLAR_POOL4_ITERATIONS]) {
+		return result_from_error(
+			-ESRCH,
+			"The kernel's response lacks the iteration counters."
+		);
+	}
+
+	memcpy(args, nla_data(attrs[JNLAR_POOL4_ITERATIONS]),
+			JITER_PROTO_COUNT * sizeof(struct jool_mask_iterations));
+	return result_success();
+}
+
+/* @out has to be a JITER_PROTO_COUNT-sized array. (Indexed by protocol.) */
+struct jool_result joolnl_pool4_iterations(struct joolnl_socket *sk,
+		char const *iname, struct jool_mask_iterations *out)
+{
+	struct nl_msg *msg;
+	struct jool_result result;
+
+	result = joolnl_alloc_msg(sk, iname, JNLOP_POOL4_ITERATIONS, 0, &msg);
+	if (result.error)
+		return result;
+
+	return joolnl_request(sk, msg, iterations_response_cb, out);
+}
+
 static struct jool_result __update(struct joolnl_socket *sk, char const *iname,
 		enum joolnl_operation operation, struct pool4_entry const *entry,
 		bool quick)
@@ -2,6 +2,7 @@
 #define SRC_USR_NL_POOL4_H_
 
 #include "common/config.h"
+#include "common/stats.h"
 #include "usr/nl/core.h"
 
 typedef struct jool_result (*joolnl_pool4_foreach_cb)(
@@ -16,6 +17,30 @@ struct jool_result joolnl_pool4_foreach(
 	void *args
 );
 
+struct joolnl_pool4_usage {
+	struct pool4_entry entry;
+	/* Number of @entry's ports that are currently taken. */
+	__u32 used;
+};
+
+typedef struct jool_result (*joolnl_pool4_usage_cb)(
+	struct joolnl_pool4_usage const *usage, void *args
+);
+
+struct jool_result joolnl_pool4_usage(
+	struct joolnl_socket *sk,
+	char const *iname,
+	l4_protocol proto,
+	joolnl_pool4_usage_cb cb,
+	void *args
+);
+
+struct jool_result joolnl_pool4_iterations(
+	struct joolnl_socket *sk,
+	char const *iname,
+	struct jool_mask_iterations *out
+);
+
 struct jool_result joolnl_pool4_add(
 	struct joolnl_socket *sk,
 	char const *iname,
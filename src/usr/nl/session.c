@@ -8,8 +8,6 @@
 struct foreach_args {
 	joolnl_session_foreach_cb cb;
 	void *args;
-	bool done;
-	struct session_entry_usr last;
 };
 
 static struct jool_result handle_foreach_response(struct nl_msg *response,
@@ -19,9 +17,10 @@ static struct jool_result handle_foreach_response(struct nl_msg *response,
 	struct nlattr *attr;
 	int rem;
 	struct session_entry_usr entry;
+	bool done; /* Unused; the dump ends with NLMSG_DONE instead. */
 	struct jool_result result;
 
-	result = joolnl_init_foreach_list(response, "session", &args->done);
+	result = joolnl_init_foreach_list(response, "session", &done);
 	if (result.error)
 		return result;
 
@@ -33,13 +32,16 @@ static struct jool_result handle_foreach_response(struct nl_msg *response,
 		result = args->cb(&entry, args->args);
 		if (result.error)
 			return result;
-
-		memcpy(&args->last, &entry, sizeof(entry));
 	}
 
 	return result_success();
 }
 
+/*
+ * The session table can be huge, so this uses a Netlink dump: the kernel
+ * module streams the pages back-to-back, and we don't need to request them one
+ * by one.
+ */
 struct jool_result joolnl_session_foreach(struct joolnl_socket *sk,
 		char const *iname, l4_protocol proto,
 		joolnl_session_foreach_cb cb, void *_args)
@@ -47,36 +49,100 @@ struct jool_result joolnl_session_foreach(struct joolnl_socket *sk,
 	struct nl_msg *msg;
 	struct foreach_args args;
 	struct jool_result result;
-	bool first_request;
 
 	args.cb = cb;
 	args.args = _args;
-	args.done = true;
-	memset(&args.last, 0, sizeof(args.last));
-	first_request = true;
 
-	do {
-		result = joolnl_alloc_msg(sk, iname, JNLOP_SESSION_FOREACH, 0, &msg);
-		if (result.error)
-			return result;
+	result = joolnl_alloc_msg(sk, iname, JNLOP_SESSION_FOREACH, 0, &msg);
+	if (result.error)
+		return result;
+
+	if (nla_put_u8(msg, JNLAR_PROTO, proto) < 0) {
+		nlmsg_free(msg);
+		return joolnl_err_msgsize();
+	}
+
+	return joolnl_dump(sk, msg, handle_foreach_response, &args);
+}
+
+struct top_args {
+	joolnl_session_top_cb cb;
+	void *args;
+};
+
+static struct jool_result attr2talker(struct nlattr *root,
+		struct joolnl_talker *talker)
+{
+	struct nlattr *attrs[JNLATK_COUNT];
+	struct jool_result result;
+
+	result = jnla_parse_nested(attrs, JNLATK_MAX, root,
+			joolnl_talker_policy);
+	if (result.error)
+		return result;
+
+	if (!attrs[JNLATK_PREFIX] || !attrs[JNLATK_REQUESTS]
+			|| !attrs[JNLATK_SESSIONS]) {
+		return result_from_error(
+			-EINVAL,
+			"Invalid kernel response: Top talker lacks fields."
+		);
+	}
+
+	result = nla_get_prefix6(attrs[JNLATK_PREFIX], &talker->prefix);
+	if (result.error)
+		return result;
+	talker->requests = nla_get_u32(attrs[JNLATK_REQUESTS]);
+	talker->sessions = nla_get_u32(attrs[JNLATK_SESSIONS]);
+	return result_success();
+}
+
+static struct jool_result handle_top_response(struct nl_msg *response,
+		void *arg)
+{
+	struct top_args *args = arg;
+	struct nlattr *attr;
+	int rem;
+	struct joolnl_talker talker;
+	bool done; /* Unused; the talkers always fit in one message. */
+	struct jool_result result;
 
-		if (nla_put_u8(msg, JNLAR_PROTO, proto) < 0)
-			goto cancel;
+	result = joolnl_init_foreach_list(response, "top talkers", &done);
+	if (result.error)
+		return result;
 
-		if (first_request)
-			first_request = false;
-		else if (nla_put_session(msg, JNLAR_OFFSET, &args.last) < 0)
-			goto cancel;
+	foreach_entry(attr, genlmsg_hdr(nlmsg_hdr(response)), rem) {
+		result = attr2talker(attr, &talker);
+		if (result.error)
+			return result;
 
-		result = joolnl_request(sk, msg, handle_foreach_response, &args);
+		result = args->cb(&talker, args->args);
 		if (result.error)
 			return result;
-	} while (!args.done);
+	}
 
 	return result_success();
-
-cancel:
-	nlmsg_free(msg);
-	return joolnl_err_msgsize();
 }
 
+struct jool_result joolnl_session_top(struct joolnl_socket *sk,
+		char const *iname, l4_protocol proto,
+		joolnl_session_top_cb cb, void *_args)
+{
+	struct nl_msg *msg;
+	struct top_args args;
+	struct jool_result result;
+
+	args.cb = cb;
+	args.args = _args;
+
+	result = joolnl_alloc_msg(sk, iname, JNLOP_SESSION_TOP, 0, &msg);
+	if (result.error)
+		return result;
+
+	if (nla_put_u8(msg, JNLAR_PROTO, proto) < 0) {
+		nlmsg_free(msg);
+		return joolnl_err_msgsize();
+	}
+
+	return joolnl_request(sk, msg, handle_top_response, &args);
+}
@@ -34,4 +34,28 @@ struct jool_result joolnl_session_foreach(
 	void *args
 );
 
+/**
+ * A subscriber that has requested many sessions lately.
+ * (See session-quota-prefix-length.)
+ */
+struct joolnl_talker {
+	struct ipv6_prefix prefix;
+	/** Estimated number of sessions requested lately. */
+	__u32 requests;
+	/** Sessions currently held. (Only tracked if session-quota is set.) */
+	__u32 sessions;
+};
+
+typedef struct jool_result (*joolnl_session_top_cb)(
+	struct joolnl_talker const *talker, void *args
+);
+
+struct jool_result joolnl_session_top(
+	struct joolnl_socket *sk,
+	char const *iname,
+	l4_protocol proto,
+	joolnl_session_top_cb cb,
+	void *args
+);
+
 #endif /* SRC_USR_NL_SESSION_H_ */
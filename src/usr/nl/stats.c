@@ -1,6 +1,7 @@
 #include "usr/nl/stats.h"
 
 #include <errno.h>
+#include <string.h>
 #include <netlink/genl/genl.h>
 #include "common/xlat.h"
 #include "usr/nl/attribute.h"
@@ -59,6 +60,7 @@ static struct joolnl_stat_metadata const jstat_metadatas[] = {
 	DEFINE_STAT(JSTAT_TYPE2PKT, "Total number of Type 2 packets stored. (See https://github.com/NICMx/Jool/blob/584a846d09e891a0cd6342426b7a25c6478c90d6/src/mod/nat64/bib/pkt_queue.h#L77) (This counter is not decremented when a packet leaves the queue.)"),
 	DEFINE_STAT(JSTAT_SO_EXISTS, TC "Packet was a Simultaneous Open retry. (Client was trying to punch a hole, and was being unnecessarily greedy.)"),
 	DEFINE_STAT(JSTAT_SO_FULL, TC "Packet queue was full, so the Simultaneous Open attempt was denied. (Too many clients were trying to punch holes.)"),
+	DEFINE_STAT(JSTAT_SESSION_QUOTA, TC "The source subscriber already had `session-quota` sessions."),
 	DEFINE_STAT(JSTAT64_SRC, TC "IPv6 packet's source address did not match pool6 nor any EAMT entries, or the resulting address was denylist4ed."),
 	DEFINE_STAT(JSTAT64_DST, TC "IPv6 packet's destination address did not match pool6 nor any EAMT entries, or the resulting address was denylist4ed."),
 	DEFINE_STAT(JSTAT64_PSKB_COPY, TC "It was not possible to allocate the IPv4 counterpart of the IPv6 packet. (The kernel's pskb_copy() function failed.)"),
@@ -85,10 +87,21 @@ static struct joolnl_stat_metadata const jstat_metadatas[] = {
 	DEFINE_STAT(JSTAT_FAILED_ROUTES, TC "The translated packet could not be routed; the kernel's routing function errored. Cause is unknown. (It usually happens because the packet's destination address could not be found in the routing table.)"),
 	DEFINE_STAT(JSTAT_PKT_TOO_BIG, TC "Translated IPv4 packet did not fit in the outgoing interface's MTU. A Packet Too Big or Fragmentation Needed ICMP error was returned to the client."),
 	DEFINE_STAT(JSTAT_DST_OUTPUT, TC "Translation was successful but the kernel's packet dispatch function (dst_output()) returned nonzero."),
+	DEFINE_STAT(JSTAT_XLAT_IN_PLACE, "Packets whose headers were rewritten in place; the incoming packet itself was forwarded."),
+	DEFINE_STAT(JSTAT_XLAT_COPY, "Packets that had to be copied (pskb_copy() or fragmentation) because they could not be rewritten in place."),
+	DEFINE_STAT(JSTAT_ROUTE_CACHE_HIT, "Packets routed through a still valid route cached for their flow. (No FIB lookup needed.)"),
+	DEFINE_STAT(JSTAT_ROUTE_CACHE_MISS, "Packets that needed a FIB lookup, because their flow's route was not cached, or the cached route had become stale."),
+	DEFINE_STAT(JSTAT_FRAG_QUEUED, "Fragments that arrived before their datagram's first fragment, and were therefore stored until it showed up. (virtual-reassembly only.)"),
+	DEFINE_STAT(JSTAT_FRAG_QUEUE_FULL, TC "Fragment arrived before its datagram's first fragment, but there was no room left to store it. (See maximum-stored-fragments.)"),
+	DEFINE_STAT(JSTAT_FRAG_EXPIRED, TC "Fragment's datagram could not be mapped, because its first fragment never arrived, or took too long to do so."),
+	DEFINE_STAT(JSTAT_FRAG_UNKNOWN, TC "Fragment's datagram is unknown, and the fragment could not be stored until its first fragment arrives. (Happens to hairpinned fragments, and to the ones whose datagram was discarded.)"),
+	DEFINE_STAT(JSTAT_FRAG_OVERLAP, TC "Fragment overlaps a previous fragment of the same datagram. If the datagram is IPv6, the rest of it is dropped as well. (RFC 5722)"),
 	DEFINE_STAT(JSTAT_ICMP6ERR_SUCCESS, "ICMPv6 errors (created by Jool, not translated) sent successfully."),
 	DEFINE_STAT(JSTAT_ICMP6ERR_FAILURE, "ICMPv6 errors (created by Jool, not translated) that could not be sent."),
 	DEFINE_STAT(JSTAT_ICMP4ERR_SUCCESS, "ICMPv4 errors (created by Jool, not translated) sent successfully."),
 	DEFINE_STAT(JSTAT_ICMP4ERR_FAILURE, "ICMPv4 errors (created by Jool, not translated) that could not be sent."),
+	DEFINE_STAT(JSTAT_ICMP6ERR_LIMITED, "ICMPv6 errors (created by Jool, not translated) that were not sent, because their destination had exceeded icmp-errors-rate."),
+	DEFINE_STAT(JSTAT_ICMP4ERR_LIMITED, "ICMPv4 errors (created by Jool, not translated) that were not sent, because their destination had exceeded icmp-errors-rate."),
 	DEFINE_STAT(JSTAT_ICMPEXT_BIG, "Illegal ICMP header length. (Exceeds available payload in packet.)"),
 
 	DEFINE_STAT(JSTAT_JOOLD_EMPTY, "Joold packet not sent; no sessions queued."),
@@ -102,11 +115,17 @@ static struct joolnl_stat_metadata const jstat_metadatas[] = {
 	DEFINE_STAT(JSTAT_JOOLD_SSS_SENT, "Joold: Total sessions successfully sent."),
 	DEFINE_STAT(JSTAT_JOOLD_SSS_RCVD, "Joold: Total sessions successfully received."),
 	DEFINE_STAT(JSTAT_JOOLD_SSS_ENOSPC, "Joold: Total sessions dropped because the queue was full."),
+	DEFINE_STAT(JSTAT_JOOLD_SSS_FILTERED, "Joold: Total sessions not queued because they did not pass the ss-* sync filters."),
 	DEFINE_STAT(JSTAT_JOOLD_PKT_SENT, "Joold: Total session packets successfully sent."),
 	DEFINE_STAT(JSTAT_JOOLD_PKT_RCVD, "Joold: Total session packets successfully received."),
 	DEFINE_STAT(JSTAT_JOOLD_ADS, "Joold: Total advertises queued."),
 	DEFINE_STAT(JSTAT_JOOLD_ACKS, "Joold: Total ACKs received from userspace."),
 
+	DEFINE_STAT(JSTAT_NATLOG_SENT, "NAT event log: Records sent to userspace."),
+	DEFINE_STAT(JSTAT_NATLOG_RING_FULL, "NAT event log: Records dropped because the CPU's ring was full. (Userspace is not draining it fast enough.)"),
+	DEFINE_STAT(JSTAT_NATLOG_ENOMEM, "NAT event log: Records dropped because a Netlink message could not be allocated."),
+	DEFINE_STAT(JSTAT_NATLOG_UNHEARD, "NAT event log: Messages nobody was listening to. (Is `jool session log` running?)"),
+
 	DEFINE_STAT(JSTAT_UNKNOWN, TC "Programming error found. The module recovered, but the packet was dropped."),
 	DEFINE_STAT(JSTAT_PADDING, "Dummy; ignore this one."),
 };
@@ -134,6 +153,12 @@ failure:
 	);
 }
 
+/* Returns NULL if @id is unknown. */
+struct joolnl_stat_metadata const *joolnl_stats_meta(enum jool_stat_id id)
+{
+	return (id < 1 || JSTAT_MAX <= id) ? NULL : &jstat_metadatas[id];
+}
+
 struct query_args {
 	joolnl_stats_foreach_cb cb;
 	void *args;
@@ -227,3 +252,114 @@ struct jool_result joolnl_stats_foreach(struct joolnl_socket *sk,
 
 	return result_success();
 }
+
+/* Does not validate the Jool header. */
+struct jool_result joolnl_stats_push_parse(struct nl_msg *msg,
+		struct joolnl_stats_push *out)
+{
+	static struct nla_policy push_policy[JNLAR_COUNT] = {
+		[JNLAR_STATS_SEQ] = { .type = NLA_U32 },
+		[JNLAR_STATS_KEYFRAME] = { .type = NLA_FLAG },
+		[JNLAR_STATS_DELTAS] = { .type = NLA_NESTED },
+	};
+	struct nlattr *attrs[JNLAR_COUNT];
+	struct jool_result result;
+
+	result = jnla_parse_msg(msg, attrs, JNLAR_MAX, push_policy, false);
+	if (result.error)
+		return result;
+
+	if (!attrs[JNLAR_STATS_SEQ] || !attrs[JNLAR_STATS_DELTAS]) {
+		return result_from_error(
+			-EINVAL,
+			"The kernel's stats push lacks a sequence number or counters."
+		);
+	}
+
+	out->seq = nla_get_u32(attrs[JNLAR_STATS_SEQ]);
+	out->keyframe = attrs[JNLAR_STATS_KEYFRAME] != NULL;
+	out->deltas = attrs[JNLAR_STATS_DELTAS];
+	return result_success();
+}
+
+static struct jool_result latency_response_cb(struct nl_msg *response,
+		void *args)
+{
+	static struct nla_policy latency_policy[JNLAR_COUNT] = {
+		[JNLAR_LATENCY] = {
+			.type = NLA_UNSPEC,
+			.minlen = sizeof(struct jool_latency),
+		},
+	};
+	struct nlattr *attrs[JNLAR_COUNT];
+	struct jool_result result;
+
+	result = jnla_parse_msg(response, attrs, JNLAR_MAX, latency_policy,
+			false);
+	if (result.error)
+		return result;
+
+	if (!attrs[JNLAR_LATENCY]) {
+		return result_from_error(
+			-ESRCH,
+			"The kernel's response lacks the histograms."
+		);
+	}
+
+	memcpy(args, nla_data(attrs[JNLAR_LATENCY]), sizeof(struct jool_latency));
+	return result_success();
+}
+
+struct jool_result joolnl_stats_latency(struct joolnl_socket *sk,
+		char const *iname, struct jool_latency *out)
+{
+	struct nl_msg *msg;
+	struct jool_result result;
+
+	result = joolnl_alloc_msg(sk, iname, JNLOP_STATS_LATENCY, 0, &msg);
+	if (result.error)
+		return result;
+
+	return joolnl_request(sk, msg, latency_response_cb, out);
+}
+
+static struct jool_result locks_response_cb(struct nl_msg *response,
+		void *args)
+{
+	static struct nla_policy locks_policy[JNLAR_COUNT] = {
+		[JNLAR_LOCKS] = {
+			.type = NLA_UNSPEC,
+			.minlen = sizeof(struct jool_locks),
+		},
+	};
+	struct nlattr *attrs[JNLAR_COUNT];
+	struct jool_result result;
+
+	result = jnla_parse_msg(response, attrs, JNLAR_MAX, locks_policy,
+			false);
+	if (result.error)
+		return result;
+
+	if (!attrs[JNLAR_LOCKS]) {
+		return result_from_error(
+			-ESRCH,
+			"The kernel's response lacks the lock statistics."
+		);
+	}
+
+	memcpy(args, nla_data(attrs[JNLAR_LOCKS]), sizeof(struct jool_locks));
+	return result_success();
+}
+
+struct jool_result joolnl_stats_locks(struct joolnl_socket *sk,
+		char const *iname, struct jool_locks *out)
+{
+	struct nl_msg *msg;
+	struct jool_result result;
+
+	result = joolnl_alloc_msg(sk, iname, JNLOP_STATS_LOCKS, 0, &msg);
+	if (result.error)
+		return result;
+
+	return joolnl_request(sk, msg, locks_response_cb, out);
+}
@@ -25,4 +25,32 @@ struct jool_result joolnl_stats_foreach(
 	void *args
 );
 
+struct joolnl_stat_metadata const *joolnl_stats_meta(enum jool_stat_id id);
+
+/* A message from the JOOLNL_STATS_GRP_NAME multicast group. */
+struct joolnl_stats_push {
+	__u32 seq;
+	/* true: @deltas are values. false: @deltas are deltas. */
+	bool keyframe;
+	/* Nested u64s; the attribute type is the jool_stat_id. */
+	struct nlattr *deltas;
+};
+
+struct jool_result joolnl_stats_push_parse(
+	struct nl_msg *msg,
+	struct joolnl_stats_push *out
+);
+
+struct jool_result joolnl_stats_latency(
+	struct joolnl_socket *sk,
+	char const *iname,
+	struct jool_latency *out
+);
+
+struct jool_result joolnl_stats_locks(
+	struct joolnl_socket *sk,
+	char const *iname,
+	struct jool_locks *out
+);
+
 #endif /* SRC_USR_NL_STATS_H_ */
@@ -480,6 +480,64 @@ struct jool_result str_to_plateaus_array(const char *str, struct mtu_plateaus *p
 	return result_success();
 }
 
+static struct jool_result str_to_mark_range(char *str, struct mark_range *range)
+{
+	unsigned long long int tmp;
+	char *endptr = NULL;
+	struct jool_result result;
+
+	result = str_to_ull(str, &endptr, 0, MAX_U32, &tmp);
+	if (result.error)
+		return result;
+	range->min = tmp;
+
+	if (*endptr != '-') {
+		range->max = range->min;
+		return result_success();
+	}
+
+	result = str_to_ull(endptr + 1, NULL, range->min, MAX_U32, &tmp);
+	if (result.error)
+		return result;
+
+	range->max = tmp;
+	return result;
+}
+
+struct jool_result str_to_mark_ranges(const char *str, struct mark_ranges *ranges)
+{
+	char *str_copy;
+	char *token;
+	struct jool_result result;
+
+	str_copy = strdup(str);
+	if (!str_copy)
+		return result_from_enomem();
+
+	ranges->count = 0;
+	for (token = strtok(str_copy, ","); token; token = strtok(NULL, ",")) {
+		if (ranges->count >= MARK_RANGES_MAX) {
+			free(str_copy);
+			return result_from_error(
+				-EINVAL,
+				"Too many mark ranges. The current max is %u.",
+				MARK_RANGES_MAX
+			);
+		}
+
+		result = str_to_mark_range(token, &ranges->ranges[ranges->count]);
+		if (result.error) {
+			free(str_copy);
+			return result;
+		}
+
+		ranges->count++;
+	}
+
+	free(str_copy);
+	return result_success();
+}
+
 void timeout2str(unsigned int millis, char *buffer)
 {
 	static const unsigned int MILLIS_PER_SECOND = 1000;
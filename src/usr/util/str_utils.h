@@ -64,6 +64,12 @@ struct jool_result str_to_prefix4(const char *str, struct ipv4_prefix *out);
  */
 struct jool_result str_to_plateaus_array(const char *str, struct mtu_plateaus *plateaus);
 
+/**
+ * Parses @str as a comma-separated list of marks and mark ranges ("min-max"),
+ * which it then copies to @ranges. An empty @str yields an empty list.
+ */
+struct jool_result str_to_mark_ranges(const char *str, struct mark_ranges *ranges);
+
 /**
  * Converts the @millis amount of milliseconds to a string.
  * The format is "HH:MM:SS.mmm".
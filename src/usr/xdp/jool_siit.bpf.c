@@ -0,0 +1,616 @@
+/*
+ * SIIT Jool's XDP fast path.
+ *
+ * Translates the boring majority of the traffic (unfragmented TCP and UDP
+ * without IPv4 options nor IPv6 extension headers) before the kernel even
+ * allocates a sk_buff for it, and redirects it straight to the output
+ * interface.
+ *
+ * Everything else (ICMP, fragments, packets that need an ICMP error, addresses
+ * the kernel module would treat specially, anything this program is unsure
+ * about) is returned untouched with XDP_PASS, so the kernel module's Netfilter
+ * hook can handle it the usual way. The fast path therefore never has to be
+ * complete; it only has to be right about the packets it does translate.
+ *
+ * The maps are mirrors of the instance's configuration; jool_siit keeps them in
+ * sync. (See src/usr/argp/wargp/xdp.c.) In case it doesn't, the kernel module
+ * has the final word: Its generation of the instance needs to match the one
+ * the maps were mirrored from, or nothing is translated here.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/in.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <bpf/bpf_endian.h>
+#include <bpf/bpf_helpers.h>
+
+#include "common/xdp.h"
+
+#define AF_INET 2
+#define AF_INET6 10
+
+#define IP_DF 0x4000
+#define IP_MF 0x2000
+#define IP_OFFSET 0x1FFF
+
+/* enum eam_hairpinning_mode (common/config.h isn't BPF-friendly) */
+#define EHM_SIMPLE 1
+
+/*
+ * Provided by the kernel module. (See src/mod/common/xlator.c.)
+ * Not weak; the program refuses to load if the module isn't there.
+ */
+extern __u64 bpf_jool_siit_generation(struct xdp_md *ctx, const char *iname,
+		__u32 iname__sz) __ksym;
+
+/* Size difference between the IPv6 and IPv4 headers. */
+#define HDRS_DELTA ((int)(sizeof(struct ipv6hdr) - sizeof(struct iphdr)))
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__type(key, __u32);
+	__type(value, struct jool_xdp_config);
+	__uint(max_entries, 1);
+	__uint(pinning, LIBBPF_PIN_BY_NAME);
+} config SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_LPM_TRIE);
+	__type(key, struct jool_xdp_key6);
+	__type(value, struct jool_xdp_eam);
+	__uint(max_entries, JOOL_XDP_EAMT_MAX);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+	__uint(pinning, LIBBPF_PIN_BY_NAME);
+} eamt6 SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_LPM_TRIE);
+	__type(key, struct jool_xdp_key4);
+	__type(value, struct jool_xdp_eam);
+	__uint(max_entries, JOOL_XDP_EAMT_MAX);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+	__uint(pinning, LIBBPF_PIN_BY_NAME);
+} eamt4 SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_LPM_TRIE);
+	__type(key, struct jool_xdp_key4);
+	__type(value, __u8);
+	__uint(max_entries, JOOL_XDP_DENYLIST4_MAX);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+	__uint(pinning, LIBBPF_PIN_BY_NAME);
+} denylist4 SEC(".maps");
+
+/* The namespace's own IPv4 addresses. (See must_not_translate().) */
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__type(key, __be32);
+	__type(value, __u8);
+	__uint(max_entries, JOOL_XDP_LOCAL4_MAX);
+	__uint(pinning, LIBBPF_PIN_BY_NAME);
+} local4 SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__type(key, __u32);
+	__type(value, __u64);
+	__uint(max_entries, JOOL_XDP_STAT_COUNT);
+	__uint(pinning, LIBBPF_PIN_BY_NAME);
+} stats SEC(".maps");
+
+static __always_inline void count(__u32 stat)
+{
+	__u64 *counter;
+
+	counter = bpf_map_lookup_elem(&stats, &stat);
+	if (counter)
+		(*counter)++;
+}
+
+static __always_inline int pass(void)
+{
+	count(JOOL_XDP_PASS);
+	return XDP_PASS;
+}
+
+static __always_inline __sum16 csum_fold(__s64 sum)
+{
+	__u32 csum = sum;
+
+	csum = (csum & 0xFFFF) + (csum >> 16);
+	csum = (csum & 0xFFFF) + (csum >> 16);
+	return (__sum16)~csum;
+}
+
+/*
+ * RFC 1624 update of a TCP/UDP checksum, after the pseudoheader's addresses
+ * changed from @old to @new.
+ * (The pseudoheader's length and protocol weigh the same in both families.)
+ */
+static __always_inline __sum16 csum_update(__sum16 csum, __be32 *old,
+		__u32 old_size, __be32 *new, __u32 new_size, bool udp)
+{
+	csum = csum_fold(bpf_csum_diff(old, old_size, new, new_size,
+			(__u16)~csum));
+	return (udp && !csum) ? 0xFFFF : csum;
+}
+
+/* Mirrors addr4_is_scope_subnet() and interface_contains(). */
+static __always_inline bool must_not_translate(__be32 addr)
+{
+	__u32 haddr = bpf_ntohl(addr);
+
+	if ((haddr & 0xFF000000) == 0x00000000 /* 0.0.0.0/8 */
+			|| (haddr & 0xFF000000) == 0x7F000000 /* 127/8 */
+			|| (haddr & 0xFFFF0000) == 0xA9FE0000 /* 169.254/16 */
+			|| (haddr & 0xF0000000) == 0xE0000000 /* 224/4 */
+			|| haddr == 0xFFFFFFFF)
+		return true;
+
+	return bpf_map_lookup_elem(&local4, &addr) != NULL;
+}
+
+static __always_inline void u128_load(__be32 const *addr, __u64 *hi, __u64 *lo)
+{
+	*hi = ((__u64)bpf_ntohl(addr[0]) << 32) | bpf_ntohl(addr[1]);
+	*lo = ((__u64)bpf_ntohl(addr[2]) << 32) | bpf_ntohl(addr[3]);
+}
+
+static __always_inline void u128_store(__u64 hi, __u64 lo, __be32 *addr)
+{
+	addr[0] = bpf_htonl(hi >> 32);
+	addr[1] = bpf_htonl(hi);
+	addr[2] = bpf_htonl(lo >> 32);
+	addr[3] = bpf_htonl(lo);
+}
+
+/* Mirrors eamt_xlat_6to4(). */
+static __always_inline int eam_6to4(struct jool_xdp_eam const *eam,
+		__be32 const *addr6, __be32 *addr4)
+{
+	__u32 suffix_len = 32 - eam->prefix4_len;
+	__u32 shift;
+	__u64 hi, lo, bits;
+
+	if (eam->prefix4_len > 32 || eam->prefix6_len + suffix_len > 128)
+		return -1;
+	if (suffix_len == 0) {
+		*addr4 = eam->prefix4;
+		return 0;
+	}
+
+	u128_load(addr6, &hi, &lo);
+	shift = 128 - eam->prefix6_len - suffix_len;
+	if (shift >= 64)
+		bits = hi >> (shift - 64);
+	else if (shift == 0)
+		bits = lo;
+	else
+		bits = (lo >> shift) | (hi << (64 - shift));
+	bits &= (1ULL << suffix_len) - 1;
+
+	*addr4 = bpf_htonl(bpf_ntohl(eam->prefix4) | (__u32)bits);
+	return 0;
+}
+
+/* Mirrors eamt_xlat_4to6(). */
+static __always_inline int eam_4to6(struct jool_xdp_eam const *eam,
+		__be32 addr4, __be32 *addr6)
+{
+	__u32 suffix_len = 32 - eam->prefix4_len;
+	__u32 shift;
+	__u64 hi, lo, bits;
+
+	if (eam->prefix4_len > 32 || eam->prefix6_len + suffix_len > 128)
+		return -1;
+
+	u128_load(eam->prefix6, &hi, &lo);
+	if (suffix_len != 0) {
+		bits = bpf_ntohl(addr4) & ((1ULL << suffix_len) - 1);
+		shift = 128 - eam->prefix6_len - suffix_len;
+		if (shift >= 64) {
+			hi |= bits << (shift - 64);
+		} else {
+			lo |= bits << shift;
+			if (shift != 0)
+				hi |= bits >> (64 - shift);
+		}
+	}
+
+	u128_store(hi, lo, addr6);
+	return 0;
+}
+
+/* Index of the @i'th IPv4 address byte in a RFC 6052 address. */
+static __always_inline __u32 rfc6052_index(__u32 prefix_len, __u32 i)
+{
+	__u32 index = prefix_len / 8 + i;
+	/* Bits 64-71 are the "u" octet. */
+	return (prefix_len < 96 && index >= 8) ? (index + 1) : index;
+}
+
+/* Mirrors __rfc6052_6to4(). */
+static __always_inline int rfc6052_6to4(struct jool_xdp_config const *cfg,
+		__be32 const *addr6, __be32 *addr4)
+{
+	__u8 const *src = (__u8 const *)addr6;
+	__u8 const *prefix = (__u8 const *)cfg->pool6;
+	__u8 *dst = (__u8 *)addr4;
+	__u32 len = cfg->pool6_len;
+	__u32 i;
+
+	if (len != 32 && len != 40 && len != 48 && len != 56 && len != 64
+			&& len != 96)
+		return -1;
+
+#pragma unroll
+	for (i = 0; i < 12; i++)
+		if (i < len / 8 && src[i] != prefix[i])
+			return -1;
+
+#pragma unroll
+	for (i = 0; i < 4; i++)
+		dst[i] = src[rfc6052_index(len, i) & 15];
+
+	return 0;
+}
+
+/* Mirrors __rfc6052_4to6(). */
+static __always_inline int rfc6052_4to6(struct jool_xdp_config const *cfg,
+		__be32 addr4, __be32 *addr6)
+{
+	__u8 const *src = (__u8 const *)&addr4;
+	__u8 *dst = (__u8 *)addr6;
+	__u32 len = cfg->pool6_len;
+	__u32 i;
+
+	if (len != 32 && len != 40 && len != 48 && len != 56 && len != 64
+			&& len != 96)
+		return -1;
+
+	/* Userspace zeroized the prefix's suffix. */
+	addr6[0] = cfg->pool6[0];
+	addr6[1] = cfg->pool6[1];
+	addr6[2] = cfg->pool6[2];
+	addr6[3] = cfg->pool6[3];
+#pragma unroll
+	for (i = 0; i < 4; i++)
+		dst[rfc6052_index(len, i) & 15] = src[i];
+
+	return 0;
+}
+
+/*
+ * Mirrors addrxlat_siit64(), except it punts (returns nonzero) on anything
+ * other than straightforward EAM or RFC 6052 translation.
+ * In particular, intrinsic hairpinning is left to the kernel module.
+ */
+static __always_inline int addrxlat64(struct jool_xdp_config const *cfg,
+		__be32 const *addr6, __be32 *addr4)
+{
+	struct jool_xdp_key6 key6;
+	struct jool_xdp_key4 key4;
+	struct jool_xdp_eam *eam;
+
+	key6.prefixlen = 128;
+	__builtin_memcpy(key6.addr, addr6, sizeof(key6.addr));
+	eam = bpf_map_lookup_elem(&eamt6, &key6);
+	if (eam) {
+		if (eam_6to4(eam, addr6, addr4))
+			return -1;
+	} else {
+		if (!cfg->pool6_set || rfc6052_6to4(cfg, addr6, addr4))
+			return -1;
+		key4.prefixlen = 32;
+		key4.addr = *addr4;
+		if (bpf_map_lookup_elem(&denylist4, &key4))
+			return -1;
+		if (bpf_map_lookup_elem(&eamt4, &key4))
+			return -1;
+	}
+
+	return must_not_translate(*addr4) ? -1 : 0;
+}
+
+/* Mirrors addrxlat_siit46(); punts like addrxlat64(). */
+static __always_inline int addrxlat46(struct jool_xdp_config const *cfg,
+		__be32 addr4, __be32 *addr6, bool enable_eam)
+{
+	struct jool_xdp_key4 key4;
+	struct jool_xdp_eam *eam;
+
+	if (must_not_translate(addr4))
+		return -1;
+
+	key4.prefixlen = 32;
+	key4.addr = addr4;
+	if (enable_eam) {
+		eam = bpf_map_lookup_elem(&eamt4, &key4);
+		if (eam)
+			return eam_4to6(eam, addr4, addr6);
+	}
+
+	if (bpf_map_lookup_elem(&denylist4, &key4))
+		return -1;
+	if (!cfg->pool6_set)
+		return -1;
+
+	return rfc6052_4to6(cfg, addr4, addr6);
+}
+
+static __always_inline int l4_hdr_len(__u8 proto)
+{
+	switch (proto) {
+	case IPPROTO_TCP:
+		return sizeof(struct tcphdr);
+	case IPPROTO_UDP:
+		return sizeof(struct udphdr);
+	}
+	return -1;
+}
+
+/*
+ * Returns the location of @l4_hdr's checksum, or NULL if the header is
+ * truncated. (Also proves the ports are in bounds to the verifier.)
+ */
+static __always_inline __sum16 *l4_csum(void *l4_hdr, void *data_end,
+		__u8 proto)
+{
+	struct tcphdr *tcp;
+	struct udphdr *udp;
+
+	if (proto == IPPROTO_TCP) {
+		tcp = l4_hdr;
+		return ((void *)(tcp + 1) > data_end) ? NULL : &tcp->check;
+	}
+
+	udp = l4_hdr;
+	return ((void *)(udp + 1) > data_end) ? NULL : &udp->check;
+}
+
+static int xlat64(struct xdp_md *ctx, struct jool_xdp_config const *cfg)
+{
+	void *data = (void *)(long)ctx->data;
+	void *data_end = (void *)(long)ctx->data_end;
+	__u32 pkt_len = ctx->data_end - ctx->data;
+	struct ipv6hdr *in6;
+	struct ipv6hdr hdr6;
+	struct iphdr hdr4 = { 0 };
+	struct ethhdr *eth;
+	struct bpf_fib_lookup fib = { 0 };
+	__be16 *ports;
+	__sum16 *check;
+	__sum16 csum;
+	__u32 payload_len;
+	int l4_len;
+
+	in6 = data + sizeof(struct ethhdr);
+	if ((void *)(in6 + 1) > data_end)
+		return pass();
+	hdr6 = *in6;
+
+	if (hdr6.version != 6 || hdr6.hop_limit <= 1)
+		return pass();
+	l4_len = l4_hdr_len(hdr6.nexthdr);
+	if (l4_len < 0)
+		return pass();
+	payload_len = bpf_ntohs(hdr6.payload_len);
+	if (payload_len < l4_len || payload_len
+			> pkt_len - sizeof(struct ethhdr) - sizeof(hdr6))
+		return pass();
+
+	ports = (void *)(in6 + 1);
+	check = l4_csum(ports, data_end, hdr6.nexthdr);
+	if (!check)
+		return pass();
+
+	/* Dst first, like translate_addrs64_siit(). */
+	if (addrxlat64(cfg, hdr6.daddr.in6_u.u6_addr32, &hdr4.daddr))
+		return pass();
+	if (addrxlat64(cfg, hdr6.saddr.in6_u.u6_addr32, &hdr4.saddr))
+		return pass();
+
+	hdr4.version = 4;
+	hdr4.ihl = 5;
+	hdr4.tos = cfg->reset_tos
+			? cfg->new_tos
+			: ((hdr6.priority << 4) | (hdr6.flow_lbl[0] >> 4));
+	hdr4.tot_len = bpf_htons(sizeof(hdr4) + payload_len);
+	hdr4.id = bpf_get_prandom_u32();
+	hdr4.frag_off = (sizeof(hdr4) + payload_len > 1260)
+			? bpf_htons(IP_DF)
+			: 0;
+	hdr4.ttl = hdr6.hop_limit - 1;
+	hdr4.protocol = hdr6.nexthdr;
+	hdr4.check = 0;
+	hdr4.check = csum_fold(bpf_csum_diff(NULL, 0, (__be32 *)&hdr4,
+			sizeof(hdr4), 0));
+
+	/*
+	 * Route before touching the packet, so it can still be handed to the
+	 * kernel module intact if this fails.
+	 * (This includes the MTU check; Fragmentation Neededs are its job.)
+	 */
+	fib.family = AF_INET;
+	fib.tos = hdr4.tos;
+	fib.l4_protocol = hdr4.protocol;
+	fib.sport = ports[0];
+	fib.dport = ports[1];
+	fib.tot_len = sizeof(hdr4) + payload_len;
+	fib.ipv4_src = hdr4.saddr;
+	fib.ipv4_dst = hdr4.daddr;
+	fib.ifindex = ctx->ingress_ifindex;
+	if (bpf_fib_lookup(ctx, &fib, sizeof(fib), 0) != BPF_FIB_LKUP_RET_SUCCESS)
+		return pass();
+
+	csum = csum_update(*check,
+			hdr6.saddr.in6_u.u6_addr32, 2 * sizeof(hdr6.saddr),
+			&hdr4.saddr, 2 * sizeof(hdr4.saddr),
+			hdr6.nexthdr == IPPROTO_UDP);
+
+	/* The layer 4 header stays where it is; the headers shrink into it. */
+	if (bpf_xdp_adjust_head(ctx, HDRS_DELTA))
+		return pass();
+
+	data = (void *)(long)ctx->data;
+	data_end = (void *)(long)ctx->data_end;
+	eth = data;
+	if ((void *)(eth + 1) + sizeof(hdr4) > data_end)
+		return XDP_DROP;
+	check = l4_csum((void *)(eth + 1) + sizeof(hdr4), data_end,
+			hdr4.protocol);
+	if (!check)
+		return XDP_DROP;
+
+	__builtin_memcpy(eth->h_dest, fib.dmac, ETH_ALEN);
+	__builtin_memcpy(eth->h_source, fib.smac, ETH_ALEN);
+	eth->h_proto = bpf_htons(ETH_P_IP);
+	__builtin_memcpy(eth + 1, &hdr4, sizeof(hdr4));
+	*check = csum;
+
+	count(JOOL_XDP_XLAT64);
+	return bpf_redirect(fib.ifindex, 0);
+}
+
+static int xlat46(struct xdp_md *ctx, struct jool_xdp_config const *cfg)
+{
+	void *data = (void *)(long)ctx->data;
+	void *data_end = (void *)(long)ctx->data_end;
+	__u32 pkt_len = ctx->data_end - ctx->data;
+	struct iphdr *in4;
+	struct iphdr hdr4;
+	struct ipv6hdr hdr6 = { 0 };
+	struct ethhdr *eth;
+	struct bpf_fib_lookup fib = { 0 };
+	__be16 *ports;
+	__sum16 *check;
+	__sum16 csum;
+	__u32 tot_len;
+	int l4_len;
+
+	in4 = data + sizeof(struct ethhdr);
+	if ((void *)(in4 + 1) > data_end)
+		return pass();
+	hdr4 = *in4;
+
+	if (hdr4.version != 4 || hdr4.ihl != 5 || hdr4.ttl <= 1)
+		return pass();
+	if (hdr4.frag_off & bpf_htons(IP_MF | IP_OFFSET))
+		return pass();
+	if (csum_fold(bpf_csum_diff(NULL, 0, (__be32 *)&hdr4, sizeof(hdr4), 0)))
+		return pass();
+	l4_len = l4_hdr_len(hdr4.protocol);
+	if (l4_len < 0)
+		return pass();
+	tot_len = bpf_ntohs(hdr4.tot_len);
+	if (tot_len < sizeof(hdr4) + l4_len
+			|| tot_len > pkt_len - sizeof(struct ethhdr))
+		return pass();
+	/* DF-less packets might need a fragment header; see lowest-ipv6-mtu. */
+	if (!(hdr4.frag_off & bpf_htons(IP_DF))
+			&& tot_len + HDRS_DELTA > cfg->lowest_ipv6_mtu)
+		return pass();
+
+	ports = (void *)(in4 + 1);
+	check = l4_csum(ports, data_end, hdr4.protocol);
+	if (!check)
+		return pass();
+	/* Zero UDP checksums need the full computation. */
+	if (hdr4.protocol == IPPROTO_UDP && !*check)
+		return pass();
+
+	if (addrxlat46(cfg, hdr4.daddr, hdr6.daddr.in6_u.u6_addr32, true))
+		return pass();
+	if (addrxlat46(cfg, hdr4.saddr, hdr6.saddr.in6_u.u6_addr32,
+			cfg->eam_hairpin_mode != EHM_SIMPLE))
+		return pass();
+
+	hdr6.version = 6;
+	if (!cfg->reset_traffic_class) {
+		hdr6.priority = hdr4.tos >> 4;
+		hdr6.flow_lbl[0] = hdr4.tos << 4;
+	}
+	hdr6.payload_len = bpf_htons(tot_len - sizeof(hdr4));
+	hdr6.nexthdr = hdr4.protocol;
+	hdr6.hop_limit = hdr4.ttl - 1;
+
+	fib.family = AF_INET6;
+	fib.flowinfo = *(__be32 *)&hdr6 & bpf_htonl(0x0FFFFFFF);
+	fib.l4_protocol = hdr6.nexthdr;
+	fib.sport = ports[0];
+	fib.dport = ports[1];
+	fib.tot_len = tot_len + HDRS_DELTA;
+	__builtin_memcpy(fib.ipv6_src, &hdr6.saddr, sizeof(hdr6.saddr));
+	__builtin_memcpy(fib.ipv6_dst, &hdr6.daddr, sizeof(hdr6.daddr));
+	fib.ifindex = ctx->ingress_ifindex;
+	if (bpf_fib_lookup(ctx, &fib, sizeof(fib), 0) != BPF_FIB_LKUP_RET_SUCCESS)
+		return pass();
+
+	csum = csum_update(*check,
+			&hdr4.saddr, 2 * sizeof(hdr4.saddr),
+			hdr6.saddr.in6_u.u6_addr32, 2 * sizeof(hdr6.saddr),
+			hdr4.protocol == IPPROTO_UDP);
+
+	/* The layer 4 header stays where it is; the headers grow backwards. */
+	if (bpf_xdp_adjust_head(ctx, -HDRS_DELTA))
+		return pass();
+
+	data = (void *)(long)ctx->data;
+	data_end = (void *)(long)ctx->data_end;
+	eth = data;
+	if ((void *)(eth + 1) + sizeof(hdr6) > data_end)
+		return XDP_DROP;
+	check = l4_csum((void *)(eth + 1) + sizeof(hdr6), data_end,
+			hdr6.nexthdr);
+	if (!check)
+		return XDP_DROP;
+
+	__builtin_memcpy(eth->h_dest, fib.dmac, ETH_ALEN);
+	__builtin_memcpy(eth->h_source, fib.smac, ETH_ALEN);
+	eth->h_proto = bpf_htons(ETH_P_IPV6);
+	__builtin_memcpy(eth + 1, &hdr6, sizeof(hdr6));
+	*check = csum;
+
+	count(JOOL_XDP_XLAT46);
+	return bpf_redirect(fib.ifindex, 0);
+}
+
+SEC("xdp")
+int jool_siit_xdp(struct xdp_md *ctx)
+{
+	void *data = (void *)(long)ctx->data;
+	void *data_end = (void *)(long)ctx->data_end;
+	struct ethhdr *eth = data;
+	struct jool_xdp_config *cfg;
+	__u32 zero = 0;
+
+	if ((void *)(eth + 1) > data_end)
+		return XDP_PASS;
+
+	switch (eth->h_proto) {
+	case bpf_htons(ETH_P_IPV6):
+	case bpf_htons(ETH_P_IP):
+		break;
+	default:
+		return XDP_PASS;
+	}
+
+	cfg = bpf_map_lookup_elem(&config, &zero);
+	if (!cfg || !cfg->enabled)
+		return pass();
+	if (bpf_jool_siit_generation(ctx, cfg->iname, sizeof(cfg->iname))
+			!= cfg->generation)
+		return pass();
+
+	return (eth->h_proto == bpf_htons(ETH_P_IPV6))
+			? xlat64(ctx, cfg)
+			: xlat46(ctx, cfg);
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,126 @@
+#!/bin/bash
+
+# GRO/GSO throughput test.
+#
+# Builds three network namespaces on this host:
+#
+#	jgclient4 --- jgsiit --- jgserver6
+#
+# jgsiit runs a SIIT instance, and GRO is enabled on all the veths. jgclient4
+# opens an iperf3 TCP stream towards jgserver6, first with DF enabled and then
+# with DF disabled (and lowest-ipv6-mtu below the IPv6 link's MTU, so Jool
+# needs to shrink the translated packets). Neither run should need Slow Path,
+# so the script fails if the XLAT_COPY counter grows more than a handful of
+# packets (which would mean the GRO super-packets were being fragmented by
+# Jool).
+#
+# Needs root, an installed Jool, iperf3 and ethtool. The veths need a kernel
+# with veth GRO support (5.13+).
+#
+# Arguments:
+#
+# $1: Seconds per run. (Default: 10)
+
+SECONDS_PER_RUN=${1:-10}
+
+CLIENT=jgclient4
+SIIT=jgsiit
+SERVER=jgserver6
+
+function setup() {
+	ip netns add $CLIENT
+	ip netns add $SIIT
+	ip netns add $SERVER
+
+	ip link add name to_siit4 type veth peer name to_client
+	ip link set dev to_siit4 netns $CLIENT
+	ip link set dev to_client netns $SIIT
+	ip link add name to_server type veth peer name to_siit6
+	ip link set dev to_server netns $SIIT
+	ip link set dev to_siit6 netns $SERVER
+
+	ip netns exec $CLIENT ip link set up dev lo
+	ip netns exec $CLIENT ip link set up dev to_siit4
+	ip netns exec $CLIENT ip addr add 192.0.2.2/24 dev to_siit4
+	ip netns exec $CLIENT ip route add 198.51.100.0/24 via 192.0.2.1
+
+	ip netns exec $SIIT ip link set up dev lo
+	ip netns exec $SIIT sysctl -qw net.ipv4.conf.all.forwarding=1
+	ip netns exec $SIIT sysctl -qw net.ipv6.conf.all.forwarding=1
+	ip netns exec $SIIT ip link set up dev to_client
+	ip netns exec $SIIT ip addr add 192.0.2.1/24 dev to_client
+	ip netns exec $SIIT ethtool -K to_client gro on > /dev/null
+	ip netns exec $SIIT ip link set up dev to_server
+	ip netns exec $SIIT ip addr add 2001:db8:2::1/64 dev to_server nodad
+
+	ip netns exec $SERVER ip link set up dev lo
+	ip netns exec $SERVER ip link set up dev to_siit6
+	ip netns exec $SERVER ip addr add 2001:db8:2::2/64 dev to_siit6 nodad
+	ip netns exec $SERVER ip route add 64:ff9b::/96 via 2001:db8:2::1
+	ip netns exec $SERVER ethtool -K to_siit6 gro on > /dev/null
+
+	modprobe jool_siit
+
+	ip netns exec $SIIT jool_siit instance add jgbench --netfilter \
+			--pool6 64:ff9b::/96
+	ip netns exec $SIIT jool_siit -i jgbench eamt add \
+			2001:db8:2::/120 198.51.100.0/24
+	ip netns exec $SIIT jool_siit -i jgbench global update \
+			lowest-ipv6-mtu 1400
+
+	ip netns exec $SERVER iperf3 --server --daemon --one-off=0 \
+			--pidfile /tmp/jgbench-iperf3.pid > /dev/null
+	sleep 1
+}
+
+function cleanup() {
+	[ -f /tmp/jgbench-iperf3.pid ] && kill $(cat /tmp/jgbench-iperf3.pid)
+	rm -f /tmp/jgbench-iperf3.pid
+	ip netns exec $SIIT jool_siit instance remove jgbench 2> /dev/null
+	ip netns del $CLIENT 2> /dev/null
+	ip netns del $SIIT 2> /dev/null
+	ip netns del $SERVER 2> /dev/null
+}
+
+function xlat_copies() {
+	ip netns exec $SIIT jool_siit -i jgbench stats display --all --csv \
+			| grep "^JSTAT_XLAT_COPY," | cut -d, -f2
+}
+
+# $1: label
+function run() {
+	BEFORE=$(xlat_copies)
+	RATE=$(ip netns exec $CLIENT iperf3 --client 198.51.100.2 \
+			--time $SECONDS_PER_RUN --format m \
+			| grep receiver | awk '{ print $7 }')
+	COPIES=$(( $(xlat_copies) - BEFORE ))
+
+	echo "$1:"
+	echo "	Throughput: $RATE Mbits/sec"
+	echo "	Packets that fell to Slow Path or were copied: $COPIES"
+
+	# (Handshakes and the odd retransmission may get copied.)
+	if [ $COPIES -gt 16 ]; then
+		echo "	Error: GRO packets are not staying on Fast Path."
+		FAILED=1
+	fi
+}
+
+
+if [ $(id -u) -ne 0 ]; then
+	echo "This test needs root."
+	exit 1
+fi
+
+cleanup
+setup
+trap cleanup EXIT
+FAILED=0
+
+ip netns exec $CLIENT sysctl -qw net.ipv4.ip_no_pmtu_disc=0
+run "DF enabled"
+
+ip netns exec $CLIENT sysctl -qw net.ipv4.ip_no_pmtu_disc=1
+run "DF disabled, lowest-ipv6-mtu 1400"
+
+exit $FAILED
@@ -0,0 +1,184 @@
+#!/bin/bash
+
+# Session synchronization loopback benchmark.
+#
+# Builds three network namespaces on this host:
+#
+#	jbclient6 --- jbnat64a ===(SS multicast)=== jbnat64b
+#
+# jbnat64a and jbnat64b each run a NAT64 instance and a `jool session proxy`.
+# jbclient6 opens $SESSIONS UDP sessions through jbnat64a, and the script
+# measures how long it takes for jbnat64b to learn all of them, how many bytes
+# the proxies needed per session, and how much CPU time the proxies burned.
+#
+# Needs root, an installed Jool (kernel modules and userspace clients) and
+# python3.
+#
+# Arguments:
+#
+# $1: Number of sessions to create. (Default: 20000)
+# $2: Wire formats to test, separated by commas. (Default: legacy,compact)
+#     Append "+zstd" to a format to also enable compression. Example:
+#     ./benchmark.sh 50000 legacy,compact,compact+zstd
+
+SESSIONS=${1:-20000}
+FORMATS=${2:-legacy,compact}
+TIMEOUT=120
+
+CLIENT=jbclient6
+NAT64A=jbnat64a
+NAT64B=jbnat64b
+MCAST=ff08::db8:64:64
+
+
+function setup() {
+	ip netns add $CLIENT
+	ip netns add $NAT64A
+	ip netns add $NAT64B
+
+	ip link add name to_nat64 type veth peer name to_client
+	ip link set dev to_nat64 netns $CLIENT
+	ip link set dev to_client netns $NAT64A
+	ip link add name to_b type veth peer name to_a
+	ip link set dev to_b netns $NAT64A
+	ip link set dev to_a netns $NAT64B
+
+	ip netns exec $CLIENT ip link set up dev lo
+	ip netns exec $CLIENT ip link set up dev to_nat64
+	ip netns exec $CLIENT ip addr add 2001:db8::2/64 dev to_nat64 nodad
+	ip netns exec $CLIENT ip route add 64:ff9b::/96 via 2001:db8::1
+
+	for NS in $NAT64A $NAT64B; do
+		ip netns exec $NS ip link set up dev lo
+		ip netns exec $NS sysctl -qw net.ipv4.conf.all.forwarding=1
+		ip netns exec $NS sysctl -qw net.ipv6.conf.all.forwarding=1
+		# Translated packets are routed here and discarded.
+		ip netns exec $NS ip link add dummy4 type dummy
+		ip netns exec $NS ip link set up dev dummy4
+		ip netns exec $NS ip addr add 198.51.100.1/24 dev dummy4
+	done
+
+	ip netns exec $NAT64A ip link set up dev to_client
+	ip netns exec $NAT64A ip addr add 2001:db8::1/64 dev to_client nodad
+	ip netns exec $NAT64A ip link set up dev to_b
+	ip netns exec $NAT64B ip link set up dev to_a
+	ip netns exec $NAT64A ip -6 route add ff08::/16 dev to_b
+	ip netns exec $NAT64B ip -6 route add ff08::/16 dev to_a
+
+	modprobe jool
+}
+
+function cleanup() {
+	pkill -f "jool -i jbench session proxy" 2> /dev/null
+	ip netns exec $NAT64A jool instance remove jbench 2> /dev/null
+	ip netns exec $NAT64B jool instance remove jbench 2> /dev/null
+	ip netns del $CLIENT 2> /dev/null
+	ip netns del $NAT64A 2> /dev/null
+	ip netns del $NAT64B 2> /dev/null
+}
+
+# $1: namespace, $2: device, $3: format, $4: compress flag
+function start_node() {
+	ip netns exec $1 jool instance add jbench --netfilter --pool6 64:ff9b::/96
+	ip netns exec $1 jool -i jbench pool4 add 198.51.100.1 1024-65535 --udp
+	ip netns exec $1 jool -i jbench global update ss-enabled true
+	ip netns exec $1 jool -i jbench session proxy $MCAST \
+			--net.dev.in=$2 --net.dev.out=$2 \
+			--net.format=$3 $4 \
+			--stats.address=::1 --stats.port=6401 \
+			> /dev/null 2>&1 &
+}
+
+function stop_nodes() {
+	pkill -f "jool -i jbench session proxy"
+	ip netns exec $NAT64A jool instance remove jbench
+	ip netns exec $NAT64B jool instance remove jbench
+	sleep 1
+}
+
+function session_count() {
+	ip netns exec $1 jool -i jbench session display --udp --csv \
+			--no-headers --numeric | wc -l
+}
+
+# Prints the CPU time (user + system, in seconds) consumed so far by process $1.
+function cpu_time() {
+	TICKS=$(cut -d' ' -f14,15 /proc/$1/stat | tr ' ' '+' | bc)
+	echo "scale=2; $TICKS / $(getconf CLK_TCK)" | bc
+}
+
+# $1: namespace, $2: stat name
+function proxy_stat() {
+	echo "" | ip netns exec $1 nc -u -w1 ::1 6401 | grep "^$2," | cut -d, -f2
+}
+
+function generate_sessions() {
+	ip netns exec $CLIENT python3 - $SESSIONS <<'PYTHON'
+import socket, sys
+count = int(sys.argv[1])
+sock = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+for i in range(count):
+	# One session per destination port; the source port stays the same.
+	sock.sendto(b"x", ("64:ff9b::198.51.100.100", 1024 + (i % 64000)))
+PYTHON
+}
+
+# $1: format
+function run() {
+	FORMAT=${1%+zstd}
+	COMPRESS=""
+	if [ "$FORMAT" != "$1" ]; then
+		COMPRESS="--net.compress"
+	fi
+
+	start_node $NAT64A to_b $FORMAT $COMPRESS
+	PID_A=$!
+	start_node $NAT64B to_a $FORMAT $COMPRESS
+	PID_B=$!
+	sleep 1
+
+	START=$(date +%s.%N)
+	generate_sessions
+	while [ $(session_count $NAT64B) -lt $SESSIONS ]; do
+		sleep 0.1
+		if (( $(echo "$(date +%s.%N) - $START > $TIMEOUT" | bc) )); then
+			echo "$1: Timed out; peer only has $(session_count $NAT64B) sessions."
+			break
+		fi
+	done
+	END=$(date +%s.%N)
+
+	BYTES=$(proxy_stat $NAT64A NET_SENT_BYTES)
+	PKTS=$(proxy_stat $NAT64A NET_SENT_PKTS)
+	SYNCED=$(proxy_stat $NAT64A NET_SENT_SESSIONS)
+	KERNEL_REQS=$(proxy_stat $NAT64B KERNEL_ADD_PKTS)
+	RCVD=$(session_count $NAT64B)
+	CPU_A=$(cpu_time $PID_A)
+	CPU_B=$(cpu_time $PID_B)
+
+	echo "$1:"
+	echo "	Sessions synced: $RCVD/$SESSIONS"
+	echo "	Sessions/second: $(echo "$RCVD / ($END - $START)" | bc)"
+	echo "	Datagrams: $PKTS"
+	echo "	Bytes/session: $(echo "scale=2; $BYTES / $SYNCED" | bc)"
+	echo "	Sessions/datagram: $(echo "scale=2; $SYNCED / $PKTS" | bc)"
+	echo "	Netlink requests on the receiver: $KERNEL_REQS"
+	echo "	CPU seconds (sender proxy): $CPU_A"
+	echo "	CPU seconds (receiver proxy): $CPU_B"
+
+	stop_nodes
+}
+
+
+if [ $(id -u) -ne 0 ]; then
+	echo "This benchmark needs root."
+	exit 1
+fi
+
+cleanup
+setup
+trap cleanup EXIT
+
+for FORMAT in ${FORMATS//,/ }; do
+	run $FORMAT
+done
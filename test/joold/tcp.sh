@@ -0,0 +1,156 @@
+#!/bin/bash
+
+# Session synchronization over TCP: reconnection test.
+#
+# Builds three network namespaces on this host:
+#
+#	jtclient6 --- jtnat64a ===(SS over TCP)=== jtnat64b
+#
+# jtnat64a's proxy streams its sessions to jtnat64b's. Halfway through, the
+# script kills their TCP connection (with `ss -K`) and keeps creating sessions.
+# jtnat64b must end up with every session, and the proxy must have recovered
+# through a delta resync rather than a full advertisement.
+#
+# Needs root, an installed Jool (kernel modules and userspace clients),
+# python3, and a kernel with CONFIG_INET_DIAG_DESTROY.
+#
+# Arguments:
+#
+# $1: Number of sessions to create in each half. (Default: 5000)
+
+SESSIONS=${1:-5000}
+TIMEOUT=60
+
+CLIENT=jtclient6
+NAT64A=jtnat64a
+NAT64B=jtnat64b
+
+
+function setup() {
+	ip netns add $CLIENT
+	ip netns add $NAT64A
+	ip netns add $NAT64B
+
+	ip link add name to_nat64 type veth peer name to_client
+	ip link set dev to_nat64 netns $CLIENT
+	ip link set dev to_client netns $NAT64A
+	ip link add name to_b type veth peer name to_a
+	ip link set dev to_b netns $NAT64A
+	ip link set dev to_a netns $NAT64B
+
+	ip netns exec $CLIENT ip link set up dev lo
+	ip netns exec $CLIENT ip link set up dev to_nat64
+	ip netns exec $CLIENT ip addr add 2001:db8::2/64 dev to_nat64 nodad
+	ip netns exec $CLIENT ip route add 64:ff9b::/96 via 2001:db8::1
+
+	for NS in $NAT64A $NAT64B; do
+		ip netns exec $NS ip link set up dev lo
+		ip netns exec $NS sysctl -qw net.ipv4.conf.all.forwarding=1
+		ip netns exec $NS sysctl -qw net.ipv6.conf.all.forwarding=1
+		ip netns exec $NS ip link add dummy4 type dummy
+		ip netns exec $NS ip link set up dev dummy4
+		ip netns exec $NS ip addr add 198.51.100.1/24 dev dummy4
+	done
+
+	ip netns exec $NAT64A ip link set up dev to_client
+	ip netns exec $NAT64A ip addr add 2001:db8::1/64 dev to_client nodad
+	ip netns exec $NAT64A ip link set up dev to_b
+	ip netns exec $NAT64A ip addr add 2001:db8:ab::a/64 dev to_b nodad
+	ip netns exec $NAT64B ip link set up dev to_a
+	ip netns exec $NAT64B ip addr add 2001:db8:ab::b/64 dev to_a nodad
+
+	modprobe jool
+}
+
+function cleanup() {
+	pkill -f "jool -i jtcp session proxy" 2> /dev/null
+	ip netns exec $NAT64A jool instance remove jtcp 2> /dev/null
+	ip netns exec $NAT64B jool instance remove jtcp 2> /dev/null
+	ip netns del $CLIENT 2> /dev/null
+	ip netns del $NAT64A 2> /dev/null
+	ip netns del $NAT64B 2> /dev/null
+}
+
+# $1: namespace, $2: local address, $3: peers
+function start_node() {
+	ip netns exec $1 jool instance add jtcp --netfilter --pool6 64:ff9b::/96
+	ip netns exec $1 jool -i jtcp pool4 add 198.51.100.1 1024-65535 --udp
+	ip netns exec $1 jool -i jtcp global update ss-enabled true
+	ip netns exec $1 jool -i jtcp session proxy $2 \
+			--net.transport=tcp $3 \
+			--stats.address=::1 --stats.port=6401 \
+			> /dev/null 2>&1 &
+}
+
+function session_count() {
+	ip netns exec $1 jool -i jtcp session display --udp --csv \
+			--no-headers --numeric | wc -l
+}
+
+# $1: namespace, $2: stat name
+function proxy_stat() {
+	echo "" | ip netns exec $1 nc -u -w1 ::1 6401 | grep "^$2," | cut -d, -f2
+}
+
+# $1: first destination port
+function generate_sessions() {
+	ip netns exec $CLIENT python3 - $SESSIONS $1 <<'PYTHON'
+import socket, sys
+count = int(sys.argv[1])
+first = int(sys.argv[2])
+sock = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+for i in range(count):
+	sock.sendto(b"x", ("64:ff9b::198.51.100.100", first + i))
+PYTHON
+}
+
+# $1: expected session count
+function wait_for_peer() {
+	START=$(date +%s)
+	while [ $(session_count $NAT64B) -lt $1 ]; do
+		sleep 0.2
+		if [ $(( $(date +%s) - START )) -gt $TIMEOUT ]; then
+			return 1
+		fi
+	done
+	return 0
+}
+
+
+if [ $(id -u) -ne 0 ]; then
+	echo "This test needs root."
+	exit 1
+fi
+
+cleanup
+setup
+trap cleanup EXIT
+
+start_node $NAT64B :: ""
+start_node $NAT64A :: --net.peers=2001:db8:ab::b
+sleep 2
+
+generate_sessions 2000
+if ! wait_for_peer $SESSIONS; then
+	echo "FAIL: The peer only learned $(session_count $NAT64B)/$SESSIONS sessions."
+	exit 1
+fi
+
+# Break the connection, and keep going while the proxy reconnects.
+ip netns exec $NAT64A ss -K dst 2001:db8:ab::b > /dev/null
+generate_sessions $(( 2000 + SESSIONS ))
+if ! wait_for_peer $(( 2 * SESSIONS )); then
+	echo "FAIL: The peer only learned $(session_count $NAT64B)/$(( 2 * SESSIONS )) sessions."
+	exit 1
+fi
+
+echo "Sessions synced: $(session_count $NAT64B)/$(( 2 * SESSIONS ))"
+echo "Batches resent: $(proxy_stat $NAT64A TCP_RESYNCS)"
+echo "Full advertisements: $(proxy_stat $NAT64A TCP_ADVERTISES)"
+echo "Gaps seen by the peer: $(proxy_stat $NAT64B TCP_GAPS)"
+
+if [ "$(proxy_stat $NAT64A TCP_ADVERTISES)" != "0" ]; then
+	echo "FAIL: The proxy needed a full advertisement."
+	exit 1
+fi
+echo "Success."
@@ -0,0 +1,871 @@
+#define pr_fmt(fmt) "benchmark: " fmt
+
+#include <linux/completion.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/sched/task.h>
+#include <net/ip.h>
+#include <net/ip6_checksum.h>
+
+#include "framework/skb_generator.h"
+#include "mod/common/address.h"
+#include "mod/common/core.h"
+#include "mod/common/xlator.h"
+#include "mod/common/db/bib/db.h"
+#include "mod/common/db/pool4/db.h"
+#include "mod/common/db/pool4/rfc6056.h"
+
+MODULE_LICENSE(JOOL_LICENSE);
+MODULE_AUTHOR("Alberto Leiva");
+MODULE_DESCRIPTION("Translation core benchmark");
+
+/*
+ * Drives generated packets through core_6to4() and core_4to6() in a tight
+ * loop, and prints the throughput in the kernel log. Nothing is sent or
+ * received; the packets die right after translation, so this measures Jool's
+ * per-packet cost in isolation (plus skb_copy(), which is measured separately).
+ */
+
+static unsigned int THREADS = 1;
+module_param(THREADS, uint, 0);
+MODULE_PARM_DESC(THREADS, "Number of translating kthreads. They are spread across the online CPUs. Min 1, max 64, default 1.");
+
+static unsigned int PACKETS = 1000000;
+module_param(PACKETS, uint, 0);
+MODULE_PARM_DESC(PACKETS, "Number of packets each thread translates, per traffic type. Default 1000000.");
+
+static unsigned int SESSIONS = 0;
+module_param(SESSIONS, uint, 0);
+MODULE_PARM_DESC(SESSIONS, "Number of unrelated sessions to add to each session table (TCP, UDP, ICMP) before measuring. Default 0.");
+
+static char *TRAFFIC = "udp6,udp4,tcp6,tcp4,icmp6,icmp4,frag4,icmperr6,icmperr4";
+module_param(TRAFFIC, charp, 0);
+MODULE_PARM_DESC(TRAFFIC, "Comma-separated list of traffic types to measure, in order. Default is all of them.");
+
+static unsigned int PAYLOAD = 64;
+module_param(PAYLOAD, uint, 0);
+MODULE_PARM_DESC(PAYLOAD, "Layer 4 payload length of the packets. Must be a multiple of 8. Max 1024, default 64.");
+
+static bool STAGES = false;
+module_param(STAGES, bool, 0);
+MODULE_PARM_DESC(STAGES, "Also print the per-stage breakdown? (Enables latency-histograms, which adds a few clock reads per packet.) Default false.");
+
+#define MAX_THREADS 64
+
+#define POOL4 "192.0.2.0"
+/* Every thread's static BIB entries are masked by this address. */
+#define STATIC4 "192.0.2.1"
+#define POOL6 "64:ff9b::"
+#define CLIENT6 "2001:db8::1"
+/* Port of the client's BIB entries. Thread N uses BASE_PORT + N. */
+#define BASE_PORT 5000
+#define REMOTE_PORT 80
+
+struct bench_counters {
+	__u64 stolen;
+	__u64 dropped;
+	__u64 other;
+};
+
+struct bench_thread {
+	/* The client's port (or ICMP identifier). */
+	__u16 port;
+	/*
+	 * Each thread speaks to a different IPv4 node, so their fragments
+	 * don't compete for the same fragment IDs.
+	 */
+	char remote4[INET_ADDRSTRLEN];
+	char remote6[INET6_ADDRSTRLEN];
+
+	struct bench_traffic const *traffic;
+	struct sk_buff *skbs[2];
+	struct completion *go;
+	struct completion done;
+
+	__u64 start;
+	__u64 end;
+	struct bench_counters counters;
+	int error;
+};
+
+struct bench_traffic {
+	char *name;
+	l3_protocol proto;
+	/* Number of packets created by @create. */
+	unsigned int skb_count;
+	/* Creates @thread's packet templates. */
+	int (*create)(struct bench_thread *thread, struct sk_buff **skbs);
+	/* Adjusts a copy of a template for iteration @i. Optional. */
+	void (*prepare)(struct sk_buff *skb, unsigned int i);
+};
+
+static struct xlator jool;
+static struct bench_thread *threads;
+
+static void defrag_dummy(struct net *ns)
+{
+	/* No code */
+}
+
+static void translate(struct sk_buff *skb, l3_protocol proto,
+		struct bench_counters *counters)
+{
+	struct xlation *state;
+	verdict result;
+
+	/* Jool normally runs in softirq context. */
+	local_bh_disable();
+
+	state = xlation_create(&jool);
+	if (!state) {
+		kfree_skb(skb);
+		counters->other++;
+		goto end;
+	}
+
+	result = (proto == L3PROTO_IPV6)
+			? core_6to4(skb, state)
+			: core_4to6(skb, state);
+	if (result != VERDICT_STOLEN)
+		kfree_skb(skb);
+	xlation_destroy(state);
+
+	switch (result) {
+	case VERDICT_STOLEN:
+		counters->stolen++;
+		break;
+	case VERDICT_DROP:
+		counters->dropped++;
+		break;
+	default:
+		counters->other++;
+	}
+
+end:
+	local_bh_enable();
+}
+
+static struct sk_buff *alloc_template(__be16 protocol, unsigned int hdr_len,
+		unsigned int len)
+{
+	struct sk_buff *skb;
+
+	skb = alloc_skb(LL_MAX_HEADER + len, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	skb->protocol = protocol;
+	skb_reserve(skb, LL_MAX_HEADER);
+	skb_put(skb, len);
+	skb_reset_mac_header(skb);
+	skb_reset_network_header(skb);
+	skb_set_transport_header(skb, hdr_len);
+
+	return skb;
+}
+
+static int create_udp6(struct bench_thread *thread, struct sk_buff **skbs)
+{
+	return create_skb6_udp(CLIENT6, thread->port,
+			thread->remote6, REMOTE_PORT, PAYLOAD, 64, &skbs[0]);
+}
+
+static int create_udp4(struct bench_thread *thread, struct sk_buff **skbs)
+{
+	return create_skb4_udp(thread->remote4, REMOTE_PORT,
+			STATIC4, thread->port, PAYLOAD, 64, &skbs[0]);
+}
+
+static int create_tcp6(struct bench_thread *thread, struct sk_buff **skbs)
+{
+	return create_skb6_tcp(CLIENT6, thread->port,
+			thread->remote6, REMOTE_PORT, PAYLOAD, 64, &skbs[0]);
+}
+
+static int create_tcp4(struct bench_thread *thread, struct sk_buff **skbs)
+{
+	return create_skb4_tcp(thread->remote4, REMOTE_PORT,
+			STATIC4, thread->port, PAYLOAD, 64, &skbs[0]);
+}
+
+static int create_icmp6(struct bench_thread *thread, struct sk_buff **skbs)
+{
+	return create_skb6_icmp_info(CLIENT6, thread->remote6, thread->port,
+			PAYLOAD, 64, &skbs[0]);
+}
+
+static int create_icmp4(struct bench_thread *thread, struct sk_buff **skbs)
+{
+	return create_skb4_icmp_info(thread->remote4, STATIC4, thread->port,
+			PAYLOAD, 64, &skbs[0]);
+}
+
+/* A UDP datagram, in two fragments of (sizeof(udphdr) + PAYLOAD) bytes. */
+static int create_frag4(struct bench_thread *thread, struct sk_buff **skbs)
+{
+	unsigned int frag_len = sizeof(struct udphdr) + PAYLOAD;
+	struct iphdr *hdr;
+	int error;
+
+	error = create_skb4_udp(thread->remote4, REMOTE_PORT,
+			STATIC4, thread->port, PAYLOAD, 64, &skbs[0]);
+	if (error)
+		return error;
+	hdr = ip_hdr(skbs[0]);
+	hdr->frag_off = build_ipv4_frag_off_field(false, true, 0);
+	ip_send_check(hdr);
+	udp_hdr(skbs[0])->len = cpu_to_be16(2 * frag_len);
+
+	/* (The second fragment's "UDP header" is just payload.) */
+	error = create_skb4_udp(thread->remote4, REMOTE_PORT,
+			STATIC4, thread->port, PAYLOAD, 64, &skbs[1]);
+	if (error) {
+		kfree_skb(skbs[0]);
+		return error;
+	}
+	hdr = ip_hdr(skbs[1]);
+	hdr->frag_off = build_ipv4_frag_off_field(false, false, frag_len);
+	ip_send_check(hdr);
+
+	return 0;
+}
+
+static void prepare_frag4(struct sk_buff *skb, unsigned int i)
+{
+	struct iphdr *hdr = ip_hdr(skb);
+
+	hdr->id = cpu_to_be16(i);
+	ip_send_check(hdr);
+}
+
+/* A Packet Too Big, about a packet that belongs to the thread's TCP session. */
+static int create_icmperr6(struct bench_thread *thread, struct sk_buff **skbs)
+{
+	unsigned int inner_len = sizeof(struct tcphdr) + PAYLOAD;
+	unsigned int outer_len = sizeof(struct icmp6hdr)
+			+ sizeof(struct ipv6hdr) + inner_len;
+	struct sk_buff *skb;
+	struct ipv6hdr *hdr;
+	int offset = 0;
+	int error;
+
+	skb = alloc_template(cpu_to_be16(ETH_P_IPV6), sizeof(struct ipv6hdr),
+			sizeof(struct ipv6hdr) + outer_len);
+	if (!skb)
+		return -ENOMEM;
+
+	error = init_ipv6_hdr(skb, &offset, CLIENT6, thread->remote6,
+			outer_len, NEXTHDR_ICMP, 64);
+	if (error)
+		goto fail;
+	error = init_icmp6_hdr_error(skb, &offset, 0, 0, 0);
+	if (error)
+		goto fail;
+	error = init_ipv6_hdr(skb, &offset, thread->remote6, CLIENT6,
+			inner_len, NEXTHDR_TCP, 64);
+	if (error)
+		goto fail;
+	error = init_tcp_hdr(skb, &offset, REMOTE_PORT, thread->port,
+			inner_len);
+	if (error)
+		goto fail;
+	error = init_payload_normal(skb, &offset);
+	if (error)
+		goto fail;
+
+	hdr = ipv6_hdr(skb);
+	icmp6_hdr(skb)->icmp6_cksum = csum_ipv6_magic(&hdr->saddr,
+			&hdr->daddr, outer_len, NEXTHDR_ICMP,
+			skb_checksum(skb, sizeof(*hdr), outer_len, 0));
+
+	skbs[0] = skb;
+	return 0;
+
+fail:
+	kfree_skb(skb);
+	return error;
+}
+
+/* A Fragmentation Needed, about the thread's TCP session. */
+static int create_icmperr4(struct bench_thread *thread, struct sk_buff **skbs)
+{
+	unsigned int inner_len = sizeof(struct tcphdr) + PAYLOAD;
+	unsigned int outer_len = sizeof(struct icmphdr)
+			+ sizeof(struct iphdr) + inner_len;
+	struct sk_buff *skb;
+	int offset = 0;
+	int error;
+
+	skb = alloc_template(cpu_to_be16(ETH_P_IP), sizeof(struct iphdr),
+			sizeof(struct iphdr) + outer_len);
+	if (!skb)
+		return -ENOMEM;
+
+	error = init_ipv4_hdr(skb, &offset, thread->remote4, STATIC4,
+			outer_len, IPPROTO_ICMP, 64);
+	if (error)
+		goto fail;
+	error = init_icmp4_hdr_error(skb, &offset, 0, 0, 0);
+	if (error)
+		goto fail;
+	error = init_ipv4_hdr(skb, &offset, STATIC4, thread->remote4,
+			inner_len, IPPROTO_TCP, 64);
+	if (error)
+		goto fail;
+	error = init_tcp_hdr(skb, &offset, thread->port, REMOTE_PORT,
+			inner_len);
+	if (error)
+		goto fail;
+	error = init_payload_normal(skb, &offset);
+	if (error)
+		goto fail;
+
+	icmp_hdr(skb)->checksum = csum_fold(skb_checksum(skb,
+			sizeof(struct iphdr), outer_len, 0));
+
+	skbs[0] = skb;
+	return 0;
+
+fail:
+	kfree_skb(skb);
+	return error;
+}
+
+static struct bench_traffic const traffics[] = {
+	{ "udp6", L3PROTO_IPV6, 1, create_udp6, NULL },
+	{ "udp4", L3PROTO_IPV4, 1, create_udp4, NULL },
+	{ "tcp6", L3PROTO_IPV6, 1, create_tcp6, NULL },
+	{ "tcp4", L3PROTO_IPV4, 1, create_tcp4, NULL },
+	{ "icmp6", L3PROTO_IPV6, 1, create_icmp6, NULL },
+	{ "icmp4", L3PROTO_IPV4, 1, create_icmp4, NULL },
+	{ "frag4", L3PROTO_IPV4, 2, create_frag4, prepare_frag4 },
+	{ "icmperr6", L3PROTO_IPV6, 1, create_icmperr6, NULL },
+	{ "icmperr4", L3PROTO_IPV4, 1, create_icmperr4, NULL },
+};
+
+static struct bench_traffic const *find_traffic(char const *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(traffics); i++)
+		if (strcmp(traffics[i].name, name) == 0)
+			return &traffics[i];
+
+	return NULL;
+}
+
+static void free_templates(struct bench_thread *thread)
+{
+	unsigned int s;
+
+	for (s = 0; s < ARRAY_SIZE(thread->skbs); s++) {
+		kfree_skb(thread->skbs[s]);
+		thread->skbs[s] = NULL;
+	}
+}
+
+/* Translates a copy of each of @thread's templates. */
+static int translate_templates(struct bench_thread *thread, unsigned int i)
+{
+	struct sk_buff *skb;
+	unsigned int s;
+
+	for (s = 0; s < thread->traffic->skb_count; s++) {
+		skb = skb_copy(thread->skbs[s], GFP_KERNEL);
+		if (!skb)
+			return -ENOMEM;
+		if (thread->traffic->prepare)
+			thread->traffic->prepare(skb, i);
+		translate(skb, thread->traffic->proto, &thread->counters);
+	}
+
+	return 0;
+}
+
+static int bench_thread_fn(void *arg)
+{
+	struct bench_thread *thread = arg;
+	unsigned int i;
+
+	wait_for_completion(thread->go);
+
+	thread->start = ktime_get_ns();
+	for (i = 0; i < PACKETS; i++) {
+		thread->error = translate_templates(thread, i);
+		if (thread->error)
+			break;
+		if ((i & 0xFF) == 0)
+			cond_resched();
+	}
+	thread->end = ktime_get_ns();
+
+	complete(&thread->done);
+	return 0;
+}
+
+static unsigned int nth_online_cpu(unsigned int n)
+{
+	unsigned int cpu;
+
+	n %= num_online_cpus();
+	for_each_online_cpu(cpu) {
+		if (n == 0)
+			return cpu;
+		n--;
+	}
+
+	return 0;
+}
+
+/* Returns the average nanoseconds skb_copy() and kfree_skb() take. */
+static __u64 measure_copy(struct sk_buff *template)
+{
+	struct sk_buff *skb;
+	unsigned int count;
+	unsigned int i;
+	__u64 start;
+
+	count = min(PACKETS, 100000u);
+	if (count == 0)
+		return 0;
+
+	start = ktime_get_ns();
+	for (i = 0; i < count; i++) {
+		skb = skb_copy(template, GFP_KERNEL);
+		if (!skb)
+			return 0;
+		kfree_skb(skb);
+	}
+
+	return div64_u64(ktime_get_ns() - start, count);
+}
+
+static char const *const stage_names[] = {
+	[JLAT_IN_TUPLE] = "in-tuple",
+	[JLAT_FILTERING] = "filtering",
+	[JLAT_OUT_TUPLE] = "out-tuple",
+	[JLAT_TRANSLATE] = "translate",
+	[JLAT_SEND] = "send",
+};
+
+/*
+ * Prints the average of each stage of the histograms' @dir direction, from the
+ * difference between @before and @after. The histograms are base 2, so the
+ * averages assume every sample sat in the middle of its bucket.
+ */
+static void print_stages(struct bench_traffic const *traffic,
+		struct jool_latency *before, struct jool_latency *after)
+{
+	enum jool_latency_dir dir;
+	unsigned int s, b;
+	__u64 samples, total, count;
+
+	dir = (traffic->proto == L3PROTO_IPV6) ? JLAT_6TO4 : JLAT_4TO6;
+
+	for (s = 0; s < JLAT_STAGE_COUNT; s++) {
+		samples = 0;
+		total = 0;
+		for (b = 0; b < JLAT_BUCKETS; b++) {
+			count = after->buckets[dir][s][b]
+					- before->buckets[dir][s][b];
+			samples += count;
+			total += count * (b ? (3ULL << (b - 1)) : 1);
+		}
+
+		if (samples)
+			pr_info("%s:   %-9s ~%llu ns\n", traffic->name,
+					stage_names[s],
+					div64_u64(total, samples));
+	}
+}
+
+static void print_results(struct bench_traffic const *traffic, __u64 copy_ns)
+{
+	struct bench_counters counters = { 0 };
+	struct bench_thread *thread;
+	__u64 start = U64_MAX;
+	__u64 end = 0;
+	__u64 busy = 0;
+	__u64 packets, wall, mpps, mpps_int;
+	unsigned int t;
+
+	for (t = 0; t < THREADS; t++) {
+		thread = &threads[t];
+		start = min(start, thread->start);
+		end = max(end, thread->end);
+		busy += thread->end - thread->start;
+		counters.stolen += thread->counters.stolen;
+		counters.dropped += thread->counters.dropped;
+		counters.other += thread->counters.other;
+	}
+
+	packets = counters.stolen + counters.dropped + counters.other;
+	wall = end - start;
+	if (!packets || !wall) {
+		pr_info("%s: Nothing was translated.\n", traffic->name);
+		return;
+	}
+
+	/* Packets per microsecond is Mpps; keep two decimals. */
+	mpps = div64_u64(packets * 100000, wall);
+	mpps_int = div64_u64(mpps, 100);
+	pr_info("%s: %u thread(s), %llu packets in %llu us: %llu.%02llu Mpps, %llu ns/packet (skb_copy(): %llu ns)\n",
+			traffic->name, THREADS, packets, div64_u64(wall, 1000),
+			mpps_int, mpps - 100 * mpps_int,
+			div64_u64(busy, packets), copy_ns);
+	pr_info("%s: verdicts: %llu stolen, %llu dropped, %llu other\n",
+			traffic->name, counters.stolen, counters.dropped,
+			counters.other);
+}
+
+static int run(struct bench_traffic const *traffic)
+{
+	struct completion go;
+	struct bench_thread *thread;
+	struct task_struct *task;
+	struct task_struct *tasks[MAX_THREADS];
+	struct jool_latency *before = NULL;
+	struct jool_latency *after;
+	unsigned int created = 0;
+	unsigned int t;
+	__u64 copy_ns;
+	int error;
+
+	for (t = 0; t < THREADS; t++) {
+		thread = &threads[t];
+		thread->traffic = traffic;
+		error = traffic->create(thread, thread->skbs);
+		if (error)
+			goto end;
+		/* Warm up; create the sessions, if they don't exist yet. */
+		error = translate_templates(thread, 0);
+		if (error)
+			goto end;
+		memset(&thread->counters, 0, sizeof(thread->counters));
+	}
+
+	copy_ns = measure_copy(threads[0].skbs[0]);
+
+	if (STAGES) {
+		before = jstat_latency_query(jool.stats);
+		if (!before) {
+			error = -ENOMEM;
+			goto end;
+		}
+	}
+
+	init_completion(&go);
+	for (t = 0; t < THREADS; t++) {
+		thread = &threads[t];
+		thread->go = &go;
+		thread->error = 0;
+		init_completion(&thread->done);
+
+		task = kthread_create(bench_thread_fn, thread, "jool_bench/%u",
+				t);
+		if (IS_ERR(task)) {
+			error = PTR_ERR(task);
+			break;
+		}
+		get_task_struct(task);
+		kthread_bind(task, nth_online_cpu(t));
+		wake_up_process(task);
+		tasks[created++] = task;
+	}
+
+	/* Start everyone at the same time. */
+	complete_all(&go);
+	for (t = 0; t < created; t++) {
+		wait_for_completion(&threads[t].done);
+		kthread_stop(tasks[t]);
+		put_task_struct(tasks[t]);
+		if (threads[t].error)
+			error = threads[t].error;
+	}
+	if (error)
+		goto end;
+
+	print_results(traffic, copy_ns);
+
+	if (STAGES) {
+		after = jstat_latency_query(jool.stats);
+		if (after) {
+			print_stages(traffic, before, after);
+			kfree(after);
+		}
+	}
+
+end:
+	if (error)
+		pr_err("%s: Benchmark failed. (errcode %d)\n", traffic->name,
+				error);
+	kfree(before);
+	for (t = 0; t < THREADS; t++)
+		free_templates(&threads[t]);
+	return error;
+}
+
+/*
+ * Fills the session tables with @SESSIONS sessions each, from clients that
+ * have nothing to do with the measured traffic.
+ */
+static int populate(void)
+{
+	struct bench_counters counters = { 0 };
+	struct sk_buff *skb;
+	char src6[INET6_ADDRSTRLEN];
+	char *dst6 = POOL6 "198.51.100.1";
+	unsigned int i;
+	int error;
+
+	for (i = 0; i < SESSIONS; i++) {
+		snprintf(src6, sizeof(src6), "2001:db8:1::%x:%x",
+				i >> 16, i & 0xFFFF);
+
+		error = create_skb6_udp(src6, 1024, dst6, REMOTE_PORT,
+				PAYLOAD, 64, &skb);
+		if (error)
+			return error;
+		translate(skb, L3PROTO_IPV6, &counters);
+
+		error = create_skb6_tcp(src6, 1024, dst6, REMOTE_PORT,
+				PAYLOAD, 64, &skb);
+		if (error)
+			return error;
+		translate(skb, L3PROTO_IPV6, &counters);
+
+		error = create_skb6_icmp_info(src6, dst6, 1024, PAYLOAD, 64,
+				&skb);
+		if (error)
+			return error;
+		translate(skb, L3PROTO_IPV6, &counters);
+
+		if ((i & 0xFF) == 0)
+			cond_resched();
+	}
+
+	if (counters.dropped || counters.other)
+		pr_warn("%llu of the %u background sessions could not be created.\n",
+				counters.dropped + counters.other, 3 * SESSIONS);
+	return 0;
+}
+
+static int add_static_bibs(struct bench_thread *thread)
+{
+	static const l4_protocol protos[] = {
+		L4PROTO_TCP, L4PROTO_UDP, L4PROTO_ICMP
+	};
+	struct bib_entry entry;
+	unsigned int p;
+	int error;
+
+	error = str_to_addr6(CLIENT6, &entry.addr6.l3);
+	if (error)
+		return error;
+	entry.addr6.l4 = thread->port;
+	error = str_to_addr4(STATIC4, &entry.addr4.l3);
+	if (error)
+		return error;
+	entry.addr4.l4 = thread->port;
+	entry.is_static = true;
+
+	for (p = 0; p < ARRAY_SIZE(protos); p++) {
+		entry.l4_proto = protos[p];
+		error = bib_add_static(&jool, &entry);
+		if (error)
+			return error;
+	}
+
+	return 0;
+}
+
+static int init_xlator(void)
+{
+	static const l4_protocol protos[] = {
+		L4PROTO_TCP, L4PROTO_UDP, L4PROTO_ICMP
+	};
+	struct ipv6_prefix pool6;
+	struct pool4_entry entry;
+	struct bench_thread *thread;
+	unsigned int i;
+	int error;
+
+	pool6.len = 96;
+	error = str_to_addr6(POOL6, &pool6.addr);
+	if (error)
+		return error;
+
+	error = xlator_add(XF_IPTABLES | XT_NAT64, INAME_DEFAULT, &pool6,
+			NULL, &jool);
+	if (error)
+		return error;
+
+	entry.mark = 0;
+	entry.iterations = 0;
+	entry.flags = ITERATIONS_SET | ITERATIONS_INFINITE;
+	error = str_to_addr4(POOL4, &entry.range.prefix.addr);
+	if (error)
+		goto fail;
+	entry.range.prefix.len = 24;
+	entry.range.ports.min = 1024;
+	entry.range.ports.max = 65535;
+	for (i = 0; i < ARRAY_SIZE(protos); i++) {
+		entry.proto = protos[i];
+		error = pool4db_add(jool.nat64.pool4, &entry);
+		if (error)
+			goto fail;
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		thread = &threads[i];
+		thread->port = BASE_PORT + i;
+		snprintf(thread->remote4, sizeof(thread->remote4),
+				"203.0.113.%u", i + 1);
+		snprintf(thread->remote6, sizeof(thread->remote6),
+				POOL6 "203.0.113.%u", i + 1);
+		error = add_static_bibs(thread);
+		if (error)
+			goto fail;
+	}
+
+	/*
+	 * These only affect this copy of the instance, which is the one the
+	 * packets see.
+	 */
+	jool.globals.nat64.virtual_reassembly = true;
+	jool.globals.latency_histograms = STAGES;
+	if (STAGES)
+		jstat_latency_enable();
+
+	return 0;
+
+fail:
+	xlator_put(&jool);
+	xlator_rm(XT_NAT64, INAME_DEFAULT);
+	return error;
+}
+
+static void clean_xlator(void)
+{
+	if (STAGES)
+		jstat_latency_disable();
+	xlator_put(&jool);
+	xlator_rm(XT_NAT64, INAME_DEFAULT);
+}
+
+static int setup(void)
+{
+	int error;
+
+	error = rfc6056_setup();
+	if (error)
+		goto rfc6056_fail;
+	error = xlation_setup();
+	if (error)
+		goto xlation_fail;
+	error = xlator_setup();
+	if (error)
+		goto xlator_fail;
+	xlator_set_defrag(defrag_dummy);
+
+	return 0;
+
+xlator_fail:
+	xlation_teardown();
+xlation_fail:
+	rfc6056_teardown();
+rfc6056_fail:
+	return error;
+}
+
+static void teardown(void)
+{
+	xlator_teardown();
+	xlation_teardown();
+	rfc6056_teardown();
+	bib_teardown();
+}
+
+static int validate_params(void)
+{
+	if (THREADS < 1 || MAX_THREADS < THREADS) {
+		pr_err("Error: THREADS is out of range (1-%u).\n", MAX_THREADS);
+		return -EINVAL;
+	}
+	if (PAYLOAD > 1024 || (PAYLOAD & 7) != 0) {
+		pr_err("Error: PAYLOAD must be a multiple of 8, 1024 max.\n");
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int run_all(void)
+{
+	struct bench_traffic const *traffic;
+	char *list, *cursor, *name;
+	int error = 0;
+
+	list = kstrdup(TRAFFIC, GFP_KERNEL);
+	if (!list)
+		return -ENOMEM;
+
+	cursor = list;
+	while ((name = strsep(&cursor, ",")) != NULL) {
+		if (!name[0])
+			continue;
+		traffic = find_traffic(name);
+		if (!traffic) {
+			pr_err("Error: Unknown traffic type: '%s'\n", name);
+			error = -EINVAL;
+			break;
+		}
+		error = run(traffic);
+		if (error)
+			break;
+	}
+
+	kfree(list);
+	return error;
+}
+
+static int benchmark_init(void)
+{
+	int error;
+
+	error = validate_params();
+	if (error)
+		return error;
+
+	threads = kcalloc(THREADS, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	error = setup();
+	if (error)
+		goto setup_fail;
+	error = init_xlator();
+	if (error)
+		goto xlator_fail;
+
+	pr_info("THREADS: %u, PACKETS: %u, SESSIONS: %u, PAYLOAD: %u\n",
+			THREADS, PACKETS, SESSIONS, PAYLOAD);
+	error = populate();
+	if (!error)
+		error = run_all();
+
+	clean_xlator();
+xlator_fail:
+	teardown();
+setup_fail:
+	kfree(threads);
+	return error;
+}
+
+static void benchmark_exit(void)
+{
+	/* No code. */
+}
+
+module_init(benchmark_init);
+module_exit(benchmark_exit);
@@ -0,0 +1,120 @@
+#include "mod/common/dev.h"
+#include "mod/common/icmp_ratelimit.h"
+#include "mod/common/icmp_wrapper.h"
+#include "mod/common/joold.h"
+#include "mod/common/natlog.h"
+#include "mod/common/steps/send_packet.h"
+
+/**
+ * @file
+ * The parts of Jool that touch the outside world, neutered.
+ *
+ * Unlike the unit tests' impersonators, these are called from several threads
+ * at once, so they must not keep state.
+ */
+
+static struct fake {
+	int junk;
+} dummy;
+
+verdict sendpkt_send(struct xlation *state)
+{
+	/* Pretend the packet reached the wire. */
+	kfree_skb(state->out.skb);
+	return VERDICT_CONTINUE;
+}
+
+struct icmp_ratelimit *icmprl_alloc(void)
+{
+	return (struct icmp_ratelimit *)&dummy;
+}
+
+void icmprl_get(struct icmp_ratelimit *rl)
+{
+	/* No code. */
+}
+
+void icmprl_put(struct icmp_ratelimit *rl)
+{
+	/* No code. */
+}
+
+bool icmp64_send6(struct xlator *jool, struct sk_buff *skb,
+		icmp_error_code error, __u32 info)
+{
+	return true;
+}
+
+bool icmp64_send4(struct xlator *jool, struct sk_buff *skb,
+		icmp_error_code error, __u32 info)
+{
+	return true;
+}
+
+bool icmp64_send(struct xlator *jool, struct sk_buff *skb,
+		icmp_error_code error, __u32 info)
+{
+	return true;
+}
+
+void joold_add(struct xlator *jool, struct session_entry *entry)
+{
+	/* No code. */
+}
+
+struct joold_queue *joold_alloc(void)
+{
+	return (struct joold_queue *)&dummy;
+}
+
+void joold_get(struct joold_queue *queue)
+{
+	/* No code. */
+}
+
+void joold_put(struct joold_queue *queue)
+{
+	/* No code. */
+}
+
+void joold_lockstat_enable(struct joold_queue *queue, bool enable)
+{
+	/* No code. */
+}
+
+struct natlog *natlog_alloc(void)
+{
+	return (struct natlog *)&dummy;
+}
+
+void natlog_get(struct natlog *log)
+{
+	/* No code. */
+}
+
+void natlog_put(struct natlog *log)
+{
+	/* No code. */
+}
+
+void natlog_add(struct xlator *jool, enum natlog_event event,
+		l4_protocol proto,
+		struct ipv6_transport_addr const *src6,
+		struct ipv6_transport_addr const *dst6,
+		struct ipv4_transport_addr const *src4,
+		struct ipv4_transport_addr const *dst4)
+{
+	/* No code. */
+}
+
+void natlog_flush(struct xlator *jool)
+{
+	/* No code. */
+}
+
+int foreach_ifa(struct net *ns, int (*cb)(struct in_ifaddr *, void const *),
+		void const *args)
+{
+	/* pool4 is never empty here. */
+	return 0;
+}
@@ -212,6 +212,41 @@ static bool test_flow(void)
 	return success;
 }
 
+static bool test_count(__u32 addr, __u8 len, __u16 min, __u16 max,
+		__u32 expected)
+{
+	struct ipv4_range range;
+	__u32 used;
+
+	range.prefix.addr.s_addr = cpu_to_be32(addr);
+	range.prefix.len = len;
+	range.ports.min = min;
+	range.ports.max = max;
+
+	return ASSERT_INT(0, bib_count_range(jool.nat64.bib, PROTO, &range,
+			&used), "result")
+		&& ASSERT_UINT(expected, used, "count");
+}
+
+static bool test_count_range(void)
+{
+	bool success = true;
+
+	if (!insert_test_bibs())
+		return false;
+
+	success &= test_count(0xc0000200, 32, 0, 65535, 2);
+	success &= test_count(0xc0000202, 31, 11, 20, 2);
+	success &= test_count(0xc0000201, 32, 12, 20, 0);
+	success &= test_count(0x00000000, 0, 0, 65535, 8);
+	/* Every address has ports on both sides of the range. */
+	success &= test_count(0xc0000200, 30, 11, 20, 4);
+
+	bib_flush(&jool);
+	drop_test_bibs();
+	return success;
+}
+
 enum session_fate tcp_est_expire_cb(struct session_entry *session, void *arg)
 {
 	return FATE_RM;
@@ -241,6 +276,7 @@ static int bibdb_test_init(void)
 		return -EINVAL;
 
 	test_group_test(&test, test_flow, "Flow");
+	test_group_test(&test, test_count_range, "Count range");
 
 	return test_group_end(&test);
 }
@@ -524,6 +524,177 @@ static bool test_tcp(void)
 	return success;
 }
 
+static bool translate_udp6(char *src6, u16 src6_port, verdict expected,
+		__u16 *src4_port)
+{
+	struct xlation state;
+	struct sk_buff *skb;
+	struct ipv6_transport_addr addr6;
+	struct bib_entry bib;
+	bool success = true;
+
+	xlation_init(&state, &jool);
+	if (create_skb6_udp(src6, src6_port, "3::4", 3434, 16, 32, &skb))
+		return false;
+	if (pkt_init_ipv6(&state, skb))
+		goto fail;
+	if (determine_in_tuple(&state) != VERDICT_CONTINUE)
+		goto fail;
+
+	success &= ASSERT_INT(expected, ipv6_simple(&state), "verdict");
+	kfree_skb(skb);
+
+	if (!src4_port)
+		return success;
+
+	if (str_to_addr6(src6, &addr6.l3))
+		return false;
+	addr6.l4 = src6_port;
+	success &= ASSERT_INT(0, bib_find6(jool.nat64.bib, L4PROTO_UDP, &addr6, &bib), "BIB exists");
+	success &= ASSERT_ADDR4("192.0.2.129", &bib.addr4.l3, "IPv4 address");
+	*src4_port = bib.addr4.l4;
+	return success;
+
+fail:
+	kfree_skb(skb);
+	return false;
+}
+
+static bool test_pba(void)
+{
+	struct pool4_entry entry;
+	__u16 port1, port2, port3;
+	bool success = true;
+
+	/* 192.0.2.128#1024 can't hold a block, so this is the only option. */
+	entry.mark = 0;
+	entry.iterations = 0;
+	entry.flags = ITERATIONS_SET | ITERATIONS_INFINITE;
+	entry.proto = L4PROTO_UDP;
+	if (str_to_addr4("192.0.2.129", &entry.range.prefix.addr))
+		return false;
+	entry.range.prefix.len = 32;
+	entry.range.ports.min = 2000;
+	entry.range.ports.max = 2007;
+	if (pool4db_add(jool.nat64.pool4, &entry))
+		return false;
+
+	jool.globals.nat64.bib.pba_block_size = 4;
+	jool.globals.nat64.bib.pba_prefix_len = 64;
+
+	/* Same subscriber, so same block. */
+	success &= translate_udp6("1::5", 1000, VERDICT_CONTINUE, &port1);
+	success &= translate_udp6("1::6", 1000, VERDICT_CONTINUE, &port2);
+	success &= ASSERT_UINT((port1 - 2000) / 4, (port2 - 2000) / 4, "block");
+	success &= ASSERT_BOOL(true, port1 != port2, "different ports");
+
+	/* Different subscriber, so the other block. */
+	success &= translate_udp6("2::5", 1000, VERDICT_CONTINUE, &port3);
+	success &= ASSERT_BOOL(true, (port1 - 2000) / 4 != (port3 - 2000) / 4, "new block");
+
+	/* No blocks left. */
+	success &= translate_udp6("4::5", 1000, VERDICT_DROP, NULL);
+	success &= assert_bib_count(3, L4PROTO_UDP);
+
+	jool.globals.nat64.bib.pba_block_size = 0;
+	return success;
+}
+
+static bool test_pba_deterministic(void)
+{
+	struct pool4_entry entry;
+	struct config_prefix6 *det;
+	__u16 port1, port2, port3;
+	bool success = true;
+
+	entry.mark = 0;
+	entry.iterations = 0;
+	entry.flags = ITERATIONS_SET | ITERATIONS_INFINITE;
+	entry.proto = L4PROTO_UDP;
+	if (str_to_addr4("192.0.2.129", &entry.range.prefix.addr))
+		return false;
+	entry.range.prefix.len = 32;
+	entry.range.ports.min = 2000;
+	entry.range.ports.max = 2007;
+	if (pool4db_add(jool.nat64.pool4, &entry))
+		return false;
+
+	jool.globals.nat64.bib.pba_block_size = 4;
+	jool.globals.nat64.bib.pba_prefix_len = 64;
+	det = &jool.globals.nat64.bib.pba_det_prefix;
+	det->set = true;
+	det->prefix.len = 62;
+	if (str_to_addr6("1::", &det->prefix.addr))
+		return false;
+
+	/* Subscriber 0 gets the first block, subscriber 1 the second one. */
+	success &= translate_udp6("1:0:0:1::5", 1000, VERDICT_CONTINUE, &port2);
+	success &= translate_udp6("1::5", 1000, VERDICT_CONTINUE, &port1);
+	success &= translate_udp6("1::6", 1000, VERDICT_CONTINUE, &port3);
+	success &= ASSERT_UINT(0, (port1 - 2000) / 4, "subscriber 0");
+	success &= ASSERT_UINT(0, (port3 - 2000) / 4, "subscriber 0 again");
+	success &= ASSERT_UINT(1, (port2 - 2000) / 4, "subscriber 1");
+
+	/* Subscriber 2 has no block; 2::5 is not a subscriber. */
+	success &= translate_udp6("1:0:0:2::5", 1000, VERDICT_DROP, NULL);
+	success &= translate_udp6("2::5", 1000, VERDICT_DROP, NULL);
+	success &= assert_bib_count(3, L4PROTO_UDP);
+
+	return success;
+}
+
+static bool test_session_quota(void)
+{
+	struct pool4_entry entry;
+	struct top_talker talkers[TOP_TALKERS];
+	bool success = true;
+
+	entry.mark = 0;
+	entry.iterations = 0;
+	entry.flags = ITERATIONS_SET | ITERATIONS_INFINITE;
+	entry.proto = L4PROTO_UDP;
+	if (str_to_addr4("192.0.2.129", &entry.range.prefix.addr))
+		return false;
+	entry.range.prefix.len = 32;
+	entry.range.ports.min = 2000;
+	entry.range.ports.max = 2007;
+	if (pool4db_add(jool.nat64.pool4, &entry))
+		return false;
+
+	jool.globals.nat64.bib.session_quota = 2;
+	jool.globals.nat64.bib.session_quota_prefix_len = 64;
+
+	/* Same subscriber; the third session exceeds the quota. */
+	success &= translate_udp6("1::5", 1000, VERDICT_CONTINUE, NULL);
+	success &= translate_udp6("1::6", 1001, VERDICT_CONTINUE, NULL);
+	success &= translate_udp6("1::7", 1002, VERDICT_DROP, NULL);
+	/* Existing sessions are not affected. */
+	success &= translate_udp6("1::5", 1000, VERDICT_CONTINUE, NULL);
+	/* Different subscriber. */
+	success &= translate_udp6("2::5", 1000, VERDICT_CONTINUE, NULL);
+	success &= assert_bib_count(3, L4PROTO_UDP);
+	success &= assert_session_count(3, L4PROTO_UDP);
+
+	/* The rejected request still counts as talking. */
+	success &= ASSERT_INT(2, bib_top_talkers(jool.nat64.bib, L4PROTO_UDP,
+			talkers), "talker count");
+	success &= ASSERT_ADDR6("1::", &talkers[0].prefix.addr, "talker 1");
+	success &= ASSERT_UINT(64, talkers[0].prefix.len, "length 1");
+	success &= ASSERT_UINT(3, talkers[0].requests, "requests 1");
+	success &= ASSERT_UINT(2, talkers[0].sessions, "sessions 1");
+	success &= ASSERT_ADDR6("2::", &talkers[1].prefix.addr, "talker 2");
+	success &= ASSERT_UINT(64, talkers[1].prefix.len, "length 2");
+	success &= ASSERT_UINT(1, talkers[1].requests, "requests 2");
+	success &= ASSERT_UINT(1, talkers[1].sessions, "sessions 2");
+
+	/* Once a session dies, the subscriber can open another one. */
+	bib_flush(&jool);
+	success &= translate_udp6("1::7", 1002, VERDICT_CONTINUE, NULL);
+
+	jool.globals.nat64.bib.session_quota = 0;
+	return success;
+}
+
 static void defrag_dummy(struct net *ns)
 {
 	/* No code */
@@ -568,7 +739,7 @@ static int init(void)
 		return error;
 
 	error = xlator_add(XF_NETFILTER | XT_NAT64, INAME_DEFAULT, &pool6,
-			&jool);
+			NULL, &jool);
 	if (error)
 		return error;
 
@@ -627,6 +798,9 @@ static int filtering_test_init(void)
 	test_group_test(&test, test_udp, "UDP");
 	test_group_test(&test, test_icmp, "ICMP");
 	test_group_test(&test, test_tcp, "test_tcp");
+	test_group_test(&test, test_pba, "Port Block Allocation");
+	test_group_test(&test, test_pba_deterministic, "Deterministic PBA");
+	test_group_test(&test, test_session_quota, "Session quota");
 
 	return test_group_end(&test);
 }
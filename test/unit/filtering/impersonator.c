@@ -1,5 +1,6 @@
 #include "mod/common/dev.h"
 #include "mod/common/joold.h"
+#include "mod/common/natlog.h"
 #include "framework/unit_test.h"
 
 static struct fake {
@@ -26,6 +27,41 @@ void joold_put(struct joold_queue *queue)
 	/* No code. */
 }
 
+void joold_lockstat_enable(struct joold_queue *queue, bool enable)
+{
+	/* No code. */
+}
+
+struct natlog *natlog_alloc(void)
+{
+	return (struct natlog *)&dummy;
+}
+
+void natlog_get(struct natlog *log)
+{
+	/* No code. */
+}
+
+void natlog_put(struct natlog *log)
+{
+	/* No code. */
+}
+
+void natlog_add(struct xlator *jool, enum natlog_event event,
+		l4_protocol proto,
+		struct ipv6_transport_addr const *src6,
+		struct ipv6_transport_addr const *dst6,
+		struct ipv4_transport_addr const *src4,
+		struct ipv4_transport_addr const *dst4)
+{
+	/* No code. */
+}
+
+void natlog_flush(struct xlator *jool)
+{
+	/* No code. */
+}
+
 int foreach_ifa(struct net *ns, int (*cb)(struct in_ifaddr *, void const *),
 		void const *args)
 {
@@ -0,0 +1,249 @@
+#include <linux/module.h>
+
+#include "framework/unit_test.h"
+#include "framework/types.h"
+#include "framework/skb_generator.h"
+#include "mod/common/db/fragdb.c"
+
+MODULE_LICENSE(JOOL_LICENSE);
+MODULE_AUTHOR("Alberto Leiva");
+MODULE_DESCRIPTION("Virtual reassembly database test.");
+
+static struct xlator jool;
+static struct xlation state;
+static struct tuple tuple4;
+static struct tuple tuple6;
+
+/**
+ * Prepares @state so it looks like it's translating the UDP fragment described
+ * by the arguments. @len is the length of the fragment's layer 3 payload.
+ */
+static int init_fragment(__u16 id, __u16 offset, bool mf, u16 len)
+{
+	struct sk_buff *skb;
+	struct iphdr *hdr;
+	int error;
+
+	error = create_skb4_udp("192.0.2.1", 1000, "192.0.2.2", 2000,
+			len - sizeof(struct udphdr), 32, &skb);
+	if (error)
+		return error;
+
+	hdr = ip_hdr(skb);
+	hdr->id = cpu_to_be16(id);
+	hdr->frag_off = build_ipv4_frag_off_field(false, mf, offset);
+
+	xlation_init(&state, &jool);
+	pkt_fill(&state.in, skb, L3PROTO_IPV4, L4PROTO_UDP, NULL,
+			skb_transport_header(skb) + sizeof(struct udphdr),
+			&state.in);
+	return 0;
+}
+
+static bool test_is_fragment(void)
+{
+	bool first;
+	bool success = true;
+
+	if (init_fragment(1, 0, true, 16))
+		return false;
+	success &= ASSERT_BOOL(true, fragdb_is_fragment(&state, &first), "first is frag");
+	success &= ASSERT_BOOL(true, first, "first is first");
+	kfree_skb(state.in.skb);
+
+	if (init_fragment(1, 16, false, 16))
+		return false;
+	success &= ASSERT_BOOL(true, fragdb_is_fragment(&state, &first), "last is frag");
+	success &= ASSERT_BOOL(false, first, "last is not first");
+	kfree_skb(state.in.skb);
+
+	if (init_fragment(1, 0, false, 16))
+		return false;
+	success &= ASSERT_BOOL(false, fragdb_is_fragment(&state, &first), "whole");
+	kfree_skb(state.in.skb);
+
+	jool.globals.nat64.virtual_reassembly = false;
+	if (init_fragment(1, 0, true, 16))
+		return false;
+	success &= ASSERT_BOOL(false, fragdb_is_fragment(&state, &first), "disabled");
+	kfree_skb(state.in.skb);
+	jool.globals.nat64.virtual_reassembly = true;
+
+	return success;
+}
+
+static bool add_first(__u16 id, u16 len, struct sk_buff_head *early)
+{
+	if (init_fragment(id, 0, true, len))
+		return false;
+	state.in.tuple = tuple4;
+	state.out.tuple = tuple6;
+	fragdb_add(&state, early);
+	kfree_skb(state.in.skb);
+	return true;
+}
+
+static bool test_in_order(void)
+{
+	struct fragdb *db = jool.nat64.fragdb;
+	struct sk_buff_head early;
+	bool success = true;
+
+	__skb_queue_head_init(&early);
+	if (!add_first(10, 32, &early))
+		return false;
+	success &= ASSERT_UINT(0, skb_queue_len(&early), "nothing early");
+	success &= ASSERT_UINT(1, db->entry_count, "entry created");
+
+	if (init_fragment(10, 32, true, 32))
+		return false;
+	success &= ASSERT_VERDICT(CONTINUE, fragdb_find(&state, true), "middle");
+	success &= ASSERT_TUPLE(&tuple4, &state.in.tuple, "middle in");
+	success &= ASSERT_TUPLE(&tuple6, &state.out.tuple, "middle out");
+	success &= ASSERT_UINT(1, db->entry_count, "middle keeps entry");
+	kfree_skb(state.in.skb);
+
+	if (init_fragment(10, 64, false, 8))
+		return false;
+	success &= ASSERT_VERDICT(CONTINUE, fragdb_find(&state, true), "last");
+	success &= ASSERT_TUPLE(&tuple6, &state.out.tuple, "last out");
+	success &= ASSERT_UINT(0, db->entry_count, "complete datagram forgotten");
+	kfree_skb(state.in.skb);
+
+	return success;
+}
+
+static bool test_out_of_order(void)
+{
+	struct fragdb *db = jool.nat64.fragdb;
+	struct fragdb_entry *entry;
+	struct sk_buff_head early;
+	bool success = true;
+
+	/* max_stored_frags is 2. */
+	if (init_fragment(20, 32, false, 8))
+		return false;
+	success &= ASSERT_VERDICT(STOLEN, fragdb_find(&state, true), "early 1");
+	if (init_fragment(21, 32, false, 8))
+		return false;
+	success &= ASSERT_VERDICT(STOLEN, fragdb_find(&state, true), "early 2");
+	if (init_fragment(22, 32, false, 8))
+		return false;
+	success &= ASSERT_VERDICT(DROP, fragdb_find(&state, true), "full");
+	kfree_skb(state.in.skb);
+	success &= ASSERT_UINT(2, db->early_count, "early count");
+
+	/* Unknown datagrams are only stored if the caller allows it. */
+	if (init_fragment(23, 32, false, 8))
+		return false;
+	success &= ASSERT_VERDICT(DROP, fragdb_find(&state, false), "no queue");
+	kfree_skb(state.in.skb);
+
+	__skb_queue_head_init(&early);
+	if (!add_first(20, 32, &early))
+		return false;
+	success &= ASSERT_UINT(1, skb_queue_len(&early), "early released");
+	success &= ASSERT_UINT(1, db->early_count, "early count after first");
+	success &= ASSERT_UINT(2, db->entry_count, "entries");
+	__skb_queue_purge(&early);
+
+	/* Datagram 21's first fragment never arrives. */
+	list_for_each_entry(entry, &db->list, list_hook)
+		entry->expires = jiffies - 1;
+	fragdb_clean(&jool);
+	success &= ASSERT_UINT(0, db->entry_count, "entries after clean");
+	success &= ASSERT_UINT(0, db->early_count, "early after clean");
+
+	return success;
+}
+
+static bool test_overlap(void)
+{
+	struct fragdb *db = jool.nat64.fragdb;
+	bool success = true;
+
+	if (!add_first(30, 32, NULL))
+		return false;
+
+	if (init_fragment(30, 32, true, 32))
+		return false;
+	success &= ASSERT_VERDICT(CONTINUE, fragdb_find(&state, true), "middle");
+	kfree_skb(state.in.skb);
+
+	/* The duplicate would otherwise make up for the missing bytes. */
+	if (init_fragment(30, 32, true, 32))
+		return false;
+	success &= ASSERT_VERDICT(DROP, fragdb_find(&state, true), "duplicate");
+	kfree_skb(state.in.skb);
+
+	if (init_fragment(30, 96, false, 8))
+		return false;
+	success &= ASSERT_VERDICT(CONTINUE, fragdb_find(&state, true), "last");
+	success &= ASSERT_UINT(1, db->entry_count, "hole keeps entry");
+	kfree_skb(state.in.skb);
+
+	if (init_fragment(30, 64, true, 32))
+		return false;
+	success &= ASSERT_VERDICT(CONTINUE, fragdb_find(&state, true), "hole");
+	success &= ASSERT_UINT(0, db->entry_count, "complete datagram forgotten");
+	kfree_skb(state.in.skb);
+
+	return success;
+}
+
+static int init(void)
+{
+	memset(&jool, 0, sizeof(jool));
+	jool.flags = XT_NAT64 | XF_NETFILTER;
+	jool.stats = jstat_alloc();
+	jool.globals.nat64.virtual_reassembly = true;
+	jool.globals.nat64.max_stored_frags = 2;
+	jool.nat64.fragdb = fragdb_alloc();
+	if (!jool.nat64.fragdb)
+		return -ENOMEM;
+
+	if (init_tuple4(&tuple4, "192.0.2.1", 1000, "192.0.2.2", 2000,
+			L4PROTO_UDP))
+		goto fail;
+	if (init_tuple6(&tuple6, "64:ff9b::192.0.2.2", 2000, "2001:db8::1",
+			1000, L4PROTO_UDP))
+		goto fail;
+
+	return 0;
+
+fail:
+	fragdb_put(jool.nat64.fragdb);
+	return -EINVAL;
+}
+
+static void clean(void)
+{
+	fragdb_put(jool.nat64.fragdb);
+}
+
+static int fragdb_test_init(void)
+{
+	struct test_group test = {
+		.name = "Virtual reassembly",
+		.init_fn = init,
+		.clean_fn = clean,
+	};
+
+	if (test_group_begin(&test))
+		return -EINVAL;
+
+	test_group_test(&test, test_is_fragment, "fragment detection");
+	test_group_test(&test, test_in_order, "in order");
+	test_group_test(&test, test_out_of_order, "out of order");
+	test_group_test(&test, test_overlap, "overlap");
+
+	return test_group_end(&test);
+}
+
+static void fragdb_test_exit(void)
+{
+	/* No code. */
+}
+
+module_init(fragdb_test_init);
+module_exit(fragdb_test_exit);
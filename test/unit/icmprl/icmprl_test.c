@@ -0,0 +1,202 @@
+#include <linux/module.h>
+
+#include "framework/unit_test.h"
+#include "mod/common/address.h"
+#include "mod/common/icmp_ratelimit.c"
+
+MODULE_LICENSE(JOOL_LICENSE);
+MODULE_AUTHOR("Alberto Leiva");
+MODULE_DESCRIPTION("ICMP error rate limiter test.");
+
+static struct xlator jool;
+
+#define ADDR4(a, b, c, d) cpu_to_be32(((a) << 24) | ((b) << 16) | ((c) << 8) | (d))
+
+/* Returns the number of errors that were allowed out of @attempts. */
+static unsigned int try4(__be32 dst, icmp_error_code error,
+		unsigned int attempts)
+{
+	unsigned int allowed = 0;
+
+	for (; attempts > 0; attempts--)
+		if (icmprl_allow4(&jool, dst, error))
+			allowed++;
+
+	return allowed;
+}
+
+static unsigned int try6(struct in6_addr *dst, icmp_error_code error,
+		unsigned int attempts)
+{
+	unsigned int allowed = 0;
+
+	for (; attempts > 0; attempts--)
+		if (icmprl_allow6(&jool, dst, error))
+			allowed++;
+
+	return allowed;
+}
+
+/* Pretends @seconds have elapsed since the last error charged to @dst. */
+static void age4(__be32 dst, icmp_error_code error, unsigned int seconds)
+{
+	struct icmprl_key key;
+	struct icmprl_bucket *bucket;
+
+	memset(&key, 0, sizeof(key));
+	key.prefix[0] = dst & cpu_to_be32(0xFFFFFF00u);
+	key.l3proto = L3PROTO_IPV4;
+	key.error = error;
+
+	bucket = &jool.icmprl->buckets[jhash(&key, sizeof(key),
+			jool.icmprl->seed) & (ICMPRL_SLOTS - 1)];
+	bucket->last -= seconds * HZ;
+}
+
+static bool test_burst(void)
+{
+	bool success = true;
+
+	success &= ASSERT_UINT(4, try4(ADDR4(192, 0, 2, 1), ICMPERR_TTL, 10),
+			"burst");
+	success &= ASSERT_UINT(0, try4(ADDR4(192, 0, 2, 1), ICMPERR_TTL, 1),
+			"empty bucket");
+	success &= ASSERT_UINT(0, try4(ADDR4(192, 0, 2, 200), ICMPERR_TTL, 1),
+			"same /24");
+	success &= ASSERT_UINT(4, try4(ADDR4(192, 0, 3, 1), ICMPERR_TTL, 10),
+			"different /24");
+	success &= ASSERT_UINT(4, try4(ADDR4(192, 0, 2, 1),
+			ICMPERR_ADDR_UNREACHABLE, 10), "different type");
+
+	return success;
+}
+
+static bool test_refill(void)
+{
+	__be32 dst = ADDR4(203, 0, 113, 1);
+	bool success = true;
+
+	success &= ASSERT_UINT(4, try4(dst, ICMPERR_FILTER, 10), "burst");
+
+	/* rate is 2, so one second should buy two errors. */
+	age4(dst, ICMPERR_FILTER, 1);
+	success &= ASSERT_UINT(2, try4(dst, ICMPERR_FILTER, 10), "1 second");
+
+	/* The bucket should not overflow past burst, no matter how long. */
+	age4(dst, ICMPERR_FILTER, 3600);
+	success &= ASSERT_UINT(4, try4(dst, ICMPERR_FILTER, 10), "1 hour");
+
+	return success;
+}
+
+static bool test_ipv6(void)
+{
+	struct in6_addr dst1, dst2;
+	bool success = true;
+
+	success &= ASSERT_INT(0, str_to_addr6("2001:db8:1::1", &dst1), "a1");
+	success &= ASSERT_INT(0, str_to_addr6("2001:db8:1::ffff", &dst2), "a2");
+
+	success &= ASSERT_UINT(4, try6(&dst1, ICMPERR_TTL, 10), "burst");
+	success &= ASSERT_UINT(0, try6(&dst2, ICMPERR_TTL, 1), "same /64");
+
+	success &= ASSERT_INT(0, str_to_addr6("2001:db8:2::1", &dst2), "a3");
+	success &= ASSERT_UINT(4, try6(&dst2, ICMPERR_TTL, 10), "other /64");
+
+	return success;
+}
+
+static unsigned int slot4(__be32 dst, icmp_error_code error)
+{
+	struct icmprl_key key;
+
+	memset(&key, 0, sizeof(key));
+	key.prefix[0] = dst & cpu_to_be32(0xFFFFFF00u);
+	key.l3proto = L3PROTO_IPV4;
+	key.error = error;
+
+	return jhash(&key, sizeof(key), jool.icmprl->seed) & (ICMPRL_SLOTS - 1);
+}
+
+static bool test_collision(void)
+{
+	__be32 dst1 = ADDR4(203, 0, 113, 1);
+	__be32 dst2 = 0;
+	unsigned int i;
+	bool success = true;
+
+	/* Find another /24 that lands in the same slot. */
+	for (i = 1; i < 0x10000; i++) {
+		dst2 = ADDR4(10, i >> 8, i & 0xFF, 1);
+		if (slot4(dst2, ICMPERR_TTL) == slot4(dst1, ICMPERR_TTL))
+			break;
+	}
+	if (!ASSERT_BOOL(true, i < 0x10000, "collision found"))
+		return false;
+
+	success &= ASSERT_UINT(4, try4(dst1, ICMPERR_TTL, 10), "first key");
+	/* The takeover must not refill the bucket. */
+	success &= ASSERT_UINT(0, try4(dst2, ICMPERR_TTL, 10), "second key");
+	success &= ASSERT_UINT(0, try4(dst1, ICMPERR_TTL, 10), "first again");
+
+	return success;
+}
+
+static bool test_disabled(void)
+{
+	bool success = true;
+
+	jool.globals.icmp_errors_rate = 0;
+	success &= ASSERT_UINT(100, try4(ADDR4(198, 51, 100, 1), ICMPERR_TTL,
+			100), "rate 0");
+	jool.globals.icmp_errors_rate = 2;
+
+	jool.globals.icmp_errors_burst = 0;
+	success &= ASSERT_UINT(0, try4(ADDR4(198, 51, 100, 1), ICMPERR_TTL,
+			100), "burst 0");
+	jool.globals.icmp_errors_burst = 4;
+
+	return success;
+}
+
+static int init(void)
+{
+	memset(&jool, 0, sizeof(jool));
+	jool.globals.icmp_errors_rate = 2;
+	jool.globals.icmp_errors_burst = 4;
+	jool.icmprl = icmprl_alloc();
+	return jool.icmprl ? 0 : -ENOMEM;
+}
+
+static void clean(void)
+{
+	icmprl_put(jool.icmprl);
+}
+
+static int icmprl_test_init(void)
+{
+	struct test_group test = {
+		.name = "ICMP error rate limiter",
+		.init_fn = init,
+		.clean_fn = clean,
+	};
+
+	if (test_group_begin(&test))
+		return -EINVAL;
+
+	test_group_test(&test, test_burst, "burst");
+	test_group_test(&test, test_refill, "refill");
+	test_group_test(&test, test_ipv6, "IPv6");
+	test_group_test(&test, test_collision, "collision");
+	test_group_test(&test, test_disabled, "disabled");
+
+	return test_group_end(&test);
+}
+
+static void icmprl_test_exit(void)
+{
+	/* No code. */
+}
+
+module_init(icmprl_test_init);
+module_exit(icmprl_test_exit);
@@ -1,4 +1,6 @@
+#include "mod/common/natlog.h"
 #include "mod/common/db/pool4/db.h"
+#include "mod/common/db/bib/pba.h"
 #include "mod/common/db/bib/pkt_queue.h"
 #include "framework/unit_test.h"
 
@@ -75,7 +77,76 @@ unsigned int pktqueue_prepare_clean(struct pktqueue *queue,
 	return broken_unit_call(__func__);
 }
 
-void pktqueue_clean(struct list_head *probes)
+void pktqueue_clean(struct xlator *jool, struct list_head *probes)
 {
 	broken_unit_call(__func__);
 }
+
+void pba_init(struct pba_table *table)
+{
+	/* No code. */
+}
+
+void pba_flush(struct pba_table *table)
+{
+	/* No code. */
+}
+
+struct pba_block *pba_first(struct pba_table *table,
+		struct ipv6_prefix const *subscriber)
+{
+	broken_unit_call(__func__);
+	return NULL;
+}
+
+struct pba_block *pba_next(struct pba_block *block)
+{
+	broken_unit_call(__func__);
+	return NULL;
+}
+
+bool pba_matches(struct pba_block *block, struct mask_domain *masks)
+{
+	broken_unit_call(__func__);
+	return false;
+}
+
+int pba_add(struct pba_table *table, struct mask_domain *masks,
+		struct ipv6_prefix const *subscriber, l4_protocol proto,
+		unsigned int size, struct pba_block **result)
+{
+	return broken_unit_call(__func__);
+}
+
+int pba_add_det(struct xlator *jool, struct pba_table *table,
+		struct mask_domain *masks, struct in6_addr const *src6,
+		l4_protocol proto, struct pba_block **result)
+{
+	return broken_unit_call(__func__);
+}
+
+void pba_commit(struct xlator *jool, struct pba_block *block)
+{
+	broken_unit_call(__func__);
+}
+
+void pba_cancel(struct pba_table *table, struct pba_block *block)
+{
+	broken_unit_call(__func__);
+}
+
+void pba_put(struct xlator *jool, struct pba_table *table,
+		struct pba_block *block)
+{
+	broken_unit_call(__func__);
+}
+
+void natlog_add(struct xlator *jool, enum natlog_event event,
+		l4_protocol proto,
+		struct ipv6_transport_addr const *src6,
+		struct ipv6_transport_addr const *dst6,
+		struct ipv4_transport_addr const *src4,
+		struct ipv4_transport_addr const *dst4)
+{
+	/* No code. */
+}
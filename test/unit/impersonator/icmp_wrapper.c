@@ -1,10 +1,30 @@
 #include "mod/common/icmp_wrapper.h"
 
+#include "mod/common/icmp_ratelimit.h"
 #include "mod/common/log.h"
 
 /* The unit tests never spawn threads, so this does not need protection. */
 static int sent = 0;
 
+static struct icmp_ratelimit {
+	int junk;
+} phony;
+
+struct icmp_ratelimit *icmprl_alloc(void)
+{
+	return &phony;
+}
+
+void icmprl_get(struct icmp_ratelimit *rl)
+{
+	/* No code. */
+}
+
+void icmprl_put(struct icmp_ratelimit *rl)
+{
+	/* No code. */
+}
+
 bool icmp64_send6(struct xlator *jool, struct sk_buff *skb,
 		icmp_error_code error, __u32 info)
 {
@@ -1,4 +1,6 @@
 #include "mod/common/joold.h"
+#include "mod/common/natlog.h"
+#include "mod/common/db/fragdb.h"
 #include "mod/common/db/pool4/db.h"
 #include "mod/common/db/bib/db.h"
 #include "mod/common/steps/compute_outgoing_tuple.h"
@@ -54,6 +56,27 @@ void joold_put(struct joold_queue *queue)
 	fail(__func__);
 }
 
+void joold_lockstat_enable(struct joold_queue *queue, bool enable)
+{
+	fail(__func__);
+}
+
+struct natlog *natlog_alloc(void)
+{
+	fail(__func__);
+	return NULL;
+}
+
+void natlog_get(struct natlog *log)
+{
+	fail(__func__);
+}
+
+void natlog_put(struct natlog *log)
+{
+	fail(__func__);
+}
+
 struct pool4 *pool4db_alloc(void)
 {
 	fail(__func__);
@@ -70,6 +93,11 @@ void pool4db_put(struct pool4 *pool)
 	fail(__func__);
 }
 
+void pool4db_lockstat_enable(struct pool4 *pool, bool enable)
+{
+	fail(__func__);
+}
+
 struct bib *bib_alloc(void)
 {
 	fail(__func__);
@@ -86,6 +114,44 @@ void bib_put(struct bib *db)
 	fail(__func__);
 }
 
+void bib_lockstat_enable(struct bib *db, bool enable)
+{
+	fail(__func__);
+}
+
+struct fragdb *fragdb_alloc(void)
+{
+	fail(__func__);
+	return NULL;
+}
+
+void fragdb_get(struct fragdb *db)
+{
+	fail(__func__);
+}
+
+void fragdb_put(struct fragdb *db)
+{
+	fail(__func__);
+}
+
+bool fragdb_is_fragment(struct xlation *state, bool *first)
+{
+	fail(__func__);
+	return false;
+}
+
+verdict fragdb_find(struct xlation *state, bool queue)
+{
+	fail(__func__);
+	return VERDICT_DROP;
+}
+
+void fragdb_add(struct xlation *state, struct sk_buff_head *early)
+{
+	fail(__func__);
+}
+
 bool is_hairpin_nat64(struct xlation *state)
 {
 	fail(__func__);
@@ -12,3 +12,11 @@ unsigned int hook_ipv4(void *priv, struct sk_buff *skb,
 {
 	return NF_ACCEPT;
 }
+
+#ifdef CONFIG_NETFILTER_INGRESS
+unsigned int hook_ingress(void *priv, struct sk_buff *skb,
+		const struct nf_hook_state *nhs)
+{
+	return NF_ACCEPT;
+}
+#endif
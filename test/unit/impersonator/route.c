@@ -4,6 +4,25 @@
 #include "mod/common/log.h"
 #include "framework/unit_test.h"
 
+static struct route_cache {
+	int junk;
+} phony;
+
+struct route_cache *rtcache_alloc(void)
+{
+	return &phony;
+}
+
+void rtcache_get(struct route_cache *cache)
+{
+	/* No code. */
+}
+
+void rtcache_put(struct route_cache *cache)
+{
+	/* No code. */
+}
+
 struct dst_entry *route4(struct xlator *jool, struct flowi4 *flow)
 {
 	log_debug(jool, "Pretending I'm routing an IPv4 packet.");
@@ -33,3 +33,21 @@ void jstat_add(struct jool_stats *stats, enum jool_stat_id stat, int addend)
 {
 	/* No code. */
 }
+
+DEFINE_STATIC_KEY_FALSE(jstat_latency_key);
+
+void jstat_latency_enable(void)
+{
+	/* No code. */
+}
+
+void jstat_latency_disable(void)
+{
+	/* No code. */
+}
+
+void jstat_iterations_add(struct jool_stats *stats, l4_protocol proto,
+		unsigned int iterations, bool success)
+{
+	/* No code. */
+}
@@ -100,6 +100,9 @@ static void init_session(unsigned int index, struct session_entry *result)
 	result->update_time = jiffies;
 	result->timeout = 5000;
 	result->has_stored = false;
+	result->creation_time = jiffies;
+	result->pkts = 1;
+	result->mark = 0;
 }
 
 static int init_sessions(void)
@@ -117,6 +120,10 @@ static struct joold_queue *init_xlator(struct xlator *jool)
 	jool->globals.nat64.joold.flush_deadline = 2000;
 	jool->globals.nat64.joold.capacity = 4;
 	jool->globals.nat64.joold.max_sessions_per_pkt = 3;
+	memset(&jool->globals.nat64.joold.filter, 0,
+			sizeof(jool->globals.nat64.joold.filter));
+	jool->globals.nat64.joold.tcp_states = DEFAULT_JOOLD_TCP_STATES;
+	jool->globals.nat64.joold.marks.count = 0;
 	jool->nat64.joold = joold_alloc();
 	return jool->nat64.joold;
 }
@@ -565,6 +572,76 @@ end:	joold_put(joold);
 	return success;
 }
 
+static bool test_filters(void)
+{
+	struct xlator jool;
+	struct joold_queue *joold;
+	struct joold_config *cfg;
+	struct session_entry session;
+	bool success = true;
+
+	joold = init_xlator(&jool);
+	if (!joold)
+		return false;
+	cfg = &jool.globals.nat64.joold;
+	session = ss[0];
+
+	/* TCP states */
+	cfg->tcp_states = 1 << ESTABLISHED;
+	session.state = V6_INIT;
+	success &= ASSERT_BOOL(false, should_sync(cfg, &session), "V6_INIT");
+	session.state = ESTABLISHED;
+	success &= ASSERT_BOOL(true, should_sync(cfg, &session), "ESTABLISHED");
+	session.proto = L4PROTO_UDP;
+	session.state = V6_INIT; /* Irrelevant */
+	success &= ASSERT_BOOL(true, should_sync(cfg, &session), "UDP state");
+	cfg->tcp_states = DEFAULT_JOOLD_TCP_STATES;
+
+	/* Packet count */
+	cfg->filter.udp.min_pkts = 3;
+	session.pkts = 2;
+	success &= ASSERT_BOOL(false, should_sync(cfg, &session), "2 pkts");
+	session.pkts = 3;
+	success &= ASSERT_BOOL(true, should_sync(cfg, &session), "3 pkts");
+	session.proto = L4PROTO_ICMP;
+	session.pkts = 1;
+	success &= ASSERT_BOOL(true, should_sync(cfg, &session), "ICMP pkts");
+	cfg->filter.udp.min_pkts = 0;
+
+	/* Age */
+	cfg->filter.icmp.min_age = 10000;
+	session.creation_time = jiffies;
+	success &= ASSERT_BOOL(false, should_sync(cfg, &session), "young");
+	session.creation_time = jiffies - msecs_to_jiffies(10000);
+	success &= ASSERT_BOOL(true, should_sync(cfg, &session), "old");
+	cfg->filter.icmp.min_age = 0;
+
+	/* Marks */
+	cfg->marks.ranges[0].min = 10;
+	cfg->marks.ranges[0].max = 20;
+	cfg->marks.ranges[1].min = 30;
+	cfg->marks.ranges[1].max = 30;
+	cfg->marks.count = 2;
+	session.mark = 9;
+	success &= ASSERT_BOOL(false, should_sync(cfg, &session), "mark 9");
+	session.mark = 10;
+	success &= ASSERT_BOOL(true, should_sync(cfg, &session), "mark 10");
+	session.mark = 20;
+	success &= ASSERT_BOOL(true, should_sync(cfg, &session), "mark 20");
+	session.mark = 25;
+	success &= ASSERT_BOOL(false, should_sync(cfg, &session), "mark 25");
+	session.mark = 30;
+	success &= ASSERT_BOOL(true, should_sync(cfg, &session), "mark 30");
+
+	/* Filtered sessions must not reach the queue. */
+	session.mark = 0;
+	joold_add(&jool, &session);
+	success &= assert_deferred(joold, NULL);
+
+	joold_put(joold);
+	return success;
+}
+
 /********************** Hooks **********************/
 
 static int joold_test_init(void)
@@ -579,6 +656,7 @@ static int joold_test_init(void)
 	test_group_test(&test, print_sizes, "print sizes");
 	test_group_test(&test, test_no_flush_asap, "ss-flush-asap disabled");
 	test_group_test(&test, test_advertise, "advertise");
+	test_group_test(&test, test_filters, "sync filters");
 	return test_group_end(&test);
 }
 
@@ -217,7 +217,7 @@ static int init(void)
 		log_info("xlator_setup() threw %d", error);
 		return error;
 	}
-	error = xlator_add(XF_NETFILTER | XT_SIIT, INAME_DEFAULT, NULL, &jool);
+	error = xlator_add(XF_NETFILTER | XT_SIIT, INAME_DEFAULT, NULL, NULL, &jool);
 	if (error) {
 		log_info("xlator_add() threw %d", error);
 		goto fail1;
@@ -24,7 +24,7 @@ static int init(void)
 	if (error)
 		return error;
 
-	return xlator_add(XF_NETFILTER | XT_SIIT, INAME_DEFAULT, &pool6, &jool);
+	return xlator_add(XF_NETFILTER | XT_SIIT, INAME_DEFAULT, &pool6, NULL, &jool);
 }
 
 static void clean(void)
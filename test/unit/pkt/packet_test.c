@@ -119,6 +119,36 @@ static bool test_inner_validation6(void)
 	return result;
 }
 
+static bool test_hdrs6_summary(void)
+{
+	static struct xlation state; /* Too large for the stack. */
+	static struct xlator jool; /* Too large for the stack. */
+	struct sk_buff *skb;
+	bool result = true;
+
+	memset(&jool, 0, sizeof(jool));
+	xlation_init(&state, &jool);
+
+	if (create_skb6_tcp("1::1", 1000, "2::2", 2000, 100, 32, &skb))
+		return false;
+	result &= ASSERT_VERDICT(CONTINUE, pkt_init_ipv6(&state, skb), "tcp init");
+	result &= ASSERT_UINT(NEXTHDR_TCP, state.in.hdrs6.nexthdr, "tcp nexthdr");
+	result &= ASSERT_UINT(0, state.in.hdrs6.rt_offset, "tcp rt offset");
+	result &= ASSERT_UINT(0, state.in.hdrs6.inner_l3hdr_len, "tcp inner len");
+	kfree_skb(skb);
+
+	if (create_skb6_icmp_error("1::1", "2::2", 100, 32, &skb))
+		return false;
+	result &= ASSERT_VERDICT(CONTINUE, pkt_init_ipv6(&state, skb), "error init");
+	result &= ASSERT_UINT(NEXTHDR_ICMP, state.in.hdrs6.nexthdr, "error nexthdr");
+	result &= ASSERT_UINT(NEXTHDR_TCP, state.in.hdrs6.inner_nexthdr, "inner nexthdr");
+	result &= ASSERT_UINT(sizeof(struct ipv6hdr),
+			state.in.hdrs6.inner_l3hdr_len, "inner len");
+	kfree_skb(skb);
+
+	return result;
+}
+
 static int packet_test_init(void)
 {
 	struct test_group test = {
@@ -134,6 +164,7 @@ static int packet_test_init(void)
 
 	test_group_test(&test, test_inner_validation4, "Inner IPv4 pkt validation");
 	test_group_test(&test, test_inner_validation6, "Inner IPv6 pkt validation");
+	test_group_test(&test, test_hdrs6_summary, "IPv6 header chain summary");
 
 	return test_group_end(&test);
 }
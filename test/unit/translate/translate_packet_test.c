@@ -1,5 +1,6 @@
 #include <linux/module.h>
 #include <linux/printk.h>
+#include <linux/random.h>
 
 #include "framework/unit_test.h"
 #include "framework/skb_generator.h"
@@ -225,29 +226,67 @@ static bool test_function_icmp4_to_icmp6_param_prob(void)
  * But that'd be testing the header iterator, not the build_protocol_field() function.
  * Please look elsewhere for that.
  */
+/*
+ * Wraps @hdr6 (the first @len bytes of an IPv6 packet) into an skb, and
+ * initializes @state->in with it.
+ */
+static bool init_pkt6(struct xlation *state, struct xlator *jool,
+		struct ipv6hdr *hdr6, unsigned int len)
+{
+	struct sk_buff *skb;
+
+	hdr6->version = 6;
+	hdr6->payload_len = cpu_to_be16(len - sizeof(*hdr6));
+
+	skb = alloc_skb(len, GFP_ATOMIC);
+	if (!skb) {
+		log_err("Could not allocate a test packet.");
+		return false;
+	}
+	skb_put_data(skb, hdr6, len);
+	skb_reset_network_header(skb);
+	skb->protocol = htons(ETH_P_IPV6);
+
+	memset(jool, 0, sizeof(*jool));
+	xlation_init(state, jool);
+	if (pkt_init_ipv6(state, skb) != VERDICT_CONTINUE) {
+		log_err("pkt_init_ipv6() rejected the test packet.");
+		kfree_skb(skb);
+		return false;
+	}
+
+	return true;
+}
+
 static bool test_function_build_protocol_field(void)
 {
+	static struct xlator jool; /* Too large for the stack */
+	static struct xlation state; /* Ditto */
 	struct ipv6hdr *ip6_hdr;
 	struct ipv6_opt_hdr *hop_by_hop_hdr;
 	struct ipv6_opt_hdr *routing_hdr;
 	struct ipv6_opt_hdr *dest_options_hdr;
 	struct icmp6hdr *icmp6_hdr;
+	struct tcphdr *tcp_hdr;
+	bool success = true;
 
-	ip6_hdr = kmalloc(sizeof(*ip6_hdr) + 8 + 16 + 24 + sizeof(struct tcphdr), GFP_ATOMIC);
+	ip6_hdr = kzalloc(sizeof(*ip6_hdr) + 8 + 16 + 24 + sizeof(struct tcphdr), GFP_ATOMIC);
 	if (!ip6_hdr) {
 		log_err("Could not allocate a test packet.");
-		goto failure;
+		return false;
 	}
 
 	/* Just ICMP. */
 	ip6_hdr->nexthdr = NEXTHDR_ICMP;
-	ip6_hdr->payload_len = cpu_to_be16(sizeof(*icmp6_hdr));
-	if (!ASSERT_UINT(IPPROTO_ICMP, xlat_proto(ip6_hdr), "Just ICMP"))
+	icmp6_hdr = (struct icmp6hdr *)(ip6_hdr + 1);
+	icmp6_hdr->icmp6_type = ICMPV6_ECHO_REQUEST;
+	if (!init_pkt6(&state, &jool, ip6_hdr, sizeof(*ip6_hdr) + sizeof(*icmp6_hdr)))
 		goto failure;
+	success &= ASSERT_UINT(IPPROTO_ICMP, xlat_proto(&state.in), "Just ICMP");
+	kfree_skb(state.in.skb);
 
 	/* Skippable headers then ICMP. */
 	ip6_hdr->nexthdr = NEXTHDR_HOP;
-	ip6_hdr->payload_len = cpu_to_be16(8 + 16 + 24 + sizeof(*icmp6_hdr));
 
 	hop_by_hop_hdr = (struct ipv6_opt_hdr *) (ip6_hdr + 1);
 	hop_by_hop_hdr->nexthdr = NEXTHDR_ROUTING;
@@ -261,17 +300,26 @@ static bool test_function_build_protocol_field(void)
 	dest_options_hdr->nexthdr = NEXTHDR_ICMP;
 	dest_options_hdr->hdrlen = 2;
 
-	if (!ASSERT_UINT(IPPROTO_ICMP, xlat_proto(ip6_hdr), "Skippable then ICMP"))
+	icmp6_hdr = (struct icmp6hdr *) (((unsigned char *) dest_options_hdr) + 24);
+	icmp6_hdr->icmp6_type = ICMPV6_ECHO_REQUEST;
+
+	if (!init_pkt6(&state, &jool, ip6_hdr, sizeof(*ip6_hdr) + 8 + 16 + 24 + sizeof(*icmp6_hdr)))
 		goto failure;
+	success &= ASSERT_UINT(IPPROTO_ICMP, xlat_proto(&state.in), "Skippable then ICMP");
+	kfree_skb(state.in.skb);
 
 	/* Skippable headers then something else */
 	dest_options_hdr->nexthdr = NEXTHDR_TCP;
-	ip6_hdr->payload_len = cpu_to_be16(8 + 16 + 24 + sizeof(struct tcphdr));
-	if (!ASSERT_UINT(IPPROTO_TCP, xlat_proto(ip6_hdr), "Skippable then TCP"))
+	tcp_hdr = (struct tcphdr *) icmp6_hdr;
+	memset(tcp_hdr, 0, sizeof(*tcp_hdr));
+	tcp_hdr->doff = sizeof(*tcp_hdr) / 4;
+	if (!init_pkt6(&state, &jool, ip6_hdr, sizeof(*ip6_hdr) + 8 + 16 + 24 + sizeof(*tcp_hdr)))
 		goto failure;
+	success &= ASSERT_UINT(IPPROTO_TCP, xlat_proto(&state.in), "Skippable then TCP");
+	kfree_skb(state.in.skb);
 
 	kfree(ip6_hdr);
-	return true;
+	return success;
 
 failure:
 	kfree(ip6_hdr);
@@ -280,60 +328,74 @@ failure:
 
 static bool test_function_has_nonzero_segments_left(void)
 {
+	static struct xlator jool; /* Too large for the stack */
+	static struct xlation state; /* Ditto */
 	struct ipv6hdr *ip6_hdr;
+	struct ipv6_opt_hdr *hop_by_hop_hdr;
 	struct ipv6_rt_hdr *routing_hdr;
-	struct frag_hdr *fragment_hdr;
+	struct udphdr *udp_hdr;
+	unsigned int len;
 	__u32 offset;
 
 	bool success = true;
 
-	ip6_hdr = kmalloc(sizeof(*ip6_hdr) + sizeof(*fragment_hdr) + sizeof(*routing_hdr), GFP_ATOMIC);
+	len = sizeof(*ip6_hdr) + 8 + sizeof(*routing_hdr) + 4 + sizeof(*udp_hdr);
+	ip6_hdr = kzalloc(len, GFP_ATOMIC);
 	if (!ip6_hdr) {
 		log_err("Could not allocate a test packet.");
 		return false;
 	}
-	ip6_hdr->payload_len = cpu_to_be16(sizeof(*fragment_hdr) + sizeof(*routing_hdr));
 
 	/* No extension headers. */
-	ip6_hdr->nexthdr = NEXTHDR_TCP;
-	success &= ASSERT_BOOL(false, has_nonzero_segments_left(ip6_hdr, &offset), "No extension headers");
-
-	if (!success)
-		goto end;
+	ip6_hdr->nexthdr = NEXTHDR_UDP;
+	if (!init_pkt6(&state, &jool, ip6_hdr, sizeof(*ip6_hdr) + sizeof(*udp_hdr)))
+		goto failure;
+	success &= ASSERT_BOOL(false, has_nonzero_segments_left(&state.in, &offset), "No extension headers");
+	kfree_skb(state.in.skb);
 
 	/* Routing header with nonzero segments left. */
 	ip6_hdr->nexthdr = NEXTHDR_ROUTING;
 	routing_hdr = (struct ipv6_rt_hdr *) (ip6_hdr + 1);
+	routing_hdr->nexthdr = NEXTHDR_UDP;
+	routing_hdr->hdrlen = 0;
 	routing_hdr->segments_left = 12;
-	success &= ASSERT_BOOL(true, has_nonzero_segments_left(ip6_hdr, &offset), "Nonzero left - result");
+	if (!init_pkt6(&state, &jool, ip6_hdr, sizeof(*ip6_hdr) + 8 + sizeof(*udp_hdr)))
+		goto failure;
+	success &= ASSERT_BOOL(true, has_nonzero_segments_left(&state.in, &offset), "Nonzero left - result");
 	success &= ASSERT_UINT(40 + 3, offset, "Nonzero left - offset");
-
-	if (!success)
-		goto end;
+	kfree_skb(state.in.skb);
 
 	/* Routing header with zero segments left. */
 	routing_hdr->segments_left = 0;
-	success &= ASSERT_BOOL(false, has_nonzero_segments_left(ip6_hdr, &offset), "Zero left");
-
-	if (!success)
-		goto end;
+	if (!init_pkt6(&state, &jool, ip6_hdr, sizeof(*ip6_hdr) + 8 + sizeof(*udp_hdr)))
+		goto failure;
+	success &= ASSERT_BOOL(false, has_nonzero_segments_left(&state.in, &offset), "Zero left");
+	kfree_skb(state.in.skb);
 
 	/*
-	 * Fragment header, then routing header with nonzero segments left
+	 * Hop-by-hop header, then routing header with nonzero segments left
 	 * (further test the out parameter).
 	 */
-	ip6_hdr->nexthdr = NEXTHDR_FRAGMENT;
-	fragment_hdr = (struct frag_hdr *) (ip6_hdr + 1);
-	fragment_hdr->nexthdr = NEXTHDR_ROUTING;
-	routing_hdr = (struct ipv6_rt_hdr *) (fragment_hdr + 1);
+	ip6_hdr->nexthdr = NEXTHDR_HOP;
+	hop_by_hop_hdr = (struct ipv6_opt_hdr *) (ip6_hdr + 1);
+	hop_by_hop_hdr->nexthdr = NEXTHDR_ROUTING;
+	hop_by_hop_hdr->hdrlen = 0;
+	routing_hdr = (struct ipv6_rt_hdr *) (((unsigned char *) hop_by_hop_hdr) + 8);
+	routing_hdr->nexthdr = NEXTHDR_UDP;
+	routing_hdr->hdrlen = 0;
 	routing_hdr->segments_left = 24;
-	success &= ASSERT_BOOL(true, has_nonzero_segments_left(ip6_hdr, &offset), "Two headers - result");
+	if (!init_pkt6(&state, &jool, ip6_hdr, len))
+		goto failure;
+	success &= ASSERT_BOOL(true, has_nonzero_segments_left(&state.in, &offset), "Two headers - result");
 	success &= ASSERT_UINT(40 + 8 + 3, offset, "Two headers - offset");
+	kfree_skb(state.in.skb);
 
-	/* Fall through. */
-end:
 	kfree(ip6_hdr);
 	return success;
+
+failure:
+	kfree(ip6_hdr);
+	return false;
 }
 
 static bool test_function_icmp4_minimum_mtu(void)
@@ -347,6 +409,311 @@ static bool test_function_icmp4_minimum_mtu(void)
 	return success;
 }
 
+/*
+ * Checksum property tests: The incremental updates must agree with a full
+ * recomputation, for random headers and payloads.
+ */
+
+#define CSUM_ITERATIONS 1024
+/* L4 header + payload. Larger than a single fragment's worth of L4 header. */
+#define CSUM_MAX_LEN 128
+
+static unsigned int random_datagram(unsigned char *datagram,
+		unsigned int min_len)
+{
+	unsigned int len;
+
+	get_random_bytes(&len, sizeof(len));
+	len = min_len + (len % (CSUM_MAX_LEN - min_len + 1));
+	get_random_bytes(datagram, len);
+	return len;
+}
+
+/* One's complement has two zeroes, and either one is a valid checksum. */
+static bool assert_csum(__sum16 expected, __sum16 actual, char const *name)
+{
+	if (expected == CSUM_MANGLED_0)
+		expected = 0;
+	if (actual == CSUM_MANGLED_0)
+		actual = 0;
+	return ASSERT_UINT((__force unsigned int)expected,
+			(__force unsigned int)actual, "%s checksum", name);
+}
+
+static __sum16 full_csum4(struct iphdr *hdr4, void *l4, unsigned int len,
+		__u8 proto, __sum16 *check)
+{
+	*check = 0;
+	return csum_tcpudp_magic(hdr4->saddr, hdr4->daddr, len, proto,
+			csum_partial(l4, len, 0));
+}
+
+static __sum16 full_csum6(struct ipv6hdr *hdr6, void *l4, unsigned int len,
+		__u8 proto, __sum16 *check)
+{
+	*check = 0;
+	return csum_ipv6_magic(&hdr6->saddr, &hdr6->daddr, len, proto,
+			csum_partial(l4, len, 0));
+}
+
+static bool test_csum_l4(__u8 proto, unsigned int hdr_len,
+		unsigned int check_offset)
+{
+	unsigned char in[CSUM_MAX_LEN];
+	unsigned char out[CSUM_MAX_LEN];
+	__sum16 *in_check = (__sum16 *)(in + check_offset);
+	__sum16 *out_check = (__sum16 *)(out + check_offset);
+	struct iphdr hdr4;
+	struct ipv6hdr hdr6;
+	__sum16 expected;
+	__sum16 csum;
+	unsigned int len;
+	unsigned int i;
+	bool success = true;
+
+	for (i = 0; i < CSUM_ITERATIONS && success; i++) {
+		get_random_bytes(&hdr4, sizeof(hdr4));
+		get_random_bytes(&hdr6, sizeof(hdr6));
+
+		/* 4 -> 6 */
+		len = random_datagram(in, hdr_len);
+		*in_check = full_csum4(&hdr4, in, len, proto, in_check);
+		memcpy(out, in, len);
+		/* New ports (NAT64). SIIT is the special case. */
+		if (i & 1)
+			get_random_bytes(out, 4);
+
+		csum = update_csum_4to6(*in_check, &hdr4, in, &hdr6, out);
+		expected = full_csum6(&hdr6, out, len, proto, out_check);
+		success &= assert_csum(expected, csum, "4to6");
+
+		/* 6 -> 4 */
+		*in_check = full_csum6(&hdr6, in, len, proto, in_check);
+		memcpy(out, in, len);
+		if (i & 1)
+			get_random_bytes(out, 4);
+
+		csum = update_csum_6to4(*in_check, &hdr6, in, &hdr4, out);
+		expected = full_csum4(&hdr4, out, len, proto, out_check);
+		success &= assert_csum(expected, csum, "6to4");
+
+		/*
+		 * CHECKSUM_PARTIAL: Only the pseudoheader is stored; the NIC
+		 * adds the rest.
+		 */
+		*out_check = ~csum_ipv6_magic(&hdr6.saddr, &hdr6.daddr, len,
+				proto, 0);
+		csum = csum_fold(csum_partial(out, len, 0));
+		expected = full_csum6(&hdr6, out, len, proto, out_check);
+		success &= assert_csum(expected, csum, "partial");
+	}
+
+	return success;
+}
+
+static bool test_csum_tcp(void)
+{
+	return test_csum_l4(IPPROTO_TCP, sizeof(struct tcphdr),
+			offsetof(struct tcphdr, check));
+}
+
+static bool test_csum_udp(void)
+{
+	return test_csum_l4(IPPROTO_UDP, sizeof(struct udphdr),
+			offsetof(struct udphdr, check));
+}
+
+static bool test_csum_icmp(void)
+{
+	unsigned char in[CSUM_MAX_LEN];
+	unsigned char out[CSUM_MAX_LEN];
+	struct icmphdr *icmp4;
+	struct icmp6hdr *icmp6;
+	struct ipv6hdr hdr6;
+	__sum16 expected;
+	__sum16 csum;
+	unsigned int len;
+	unsigned int i;
+	bool success = true;
+
+	for (i = 0; i < CSUM_ITERATIONS && success; i++) {
+		get_random_bytes(&hdr6, sizeof(hdr6));
+
+		/* 4 -> 6 */
+		len = random_datagram(in, sizeof(struct icmphdr));
+		icmp4 = (struct icmphdr *)in;
+		icmp4->type = ICMP_ECHO;
+		icmp4->code = 0;
+		icmp4->checksum = 0;
+		icmp4->checksum = csum_fold(csum_partial(in, len, 0));
+
+		memcpy(out, in, len);
+		icmp6 = (struct icmp6hdr *)out;
+		icmp6->icmp6_type = ICMPV6_ECHO_REQUEST;
+		if (i & 1)
+			get_random_bytes(&icmp6->icmp6_identifier, 2);
+
+		csum = update_icmp6_csum(icmp4, &hdr6, icmp6, len);
+		expected = full_csum6(&hdr6, out, len, NEXTHDR_ICMP,
+				&icmp6->icmp6_cksum);
+		success &= assert_csum(expected, csum, "4to6");
+
+		/* 6 -> 4 */
+		icmp6 = (struct icmp6hdr *)in;
+		icmp6->icmp6_type = ICMPV6_ECHO_REPLY;
+		icmp6->icmp6_code = 0;
+		icmp6->icmp6_cksum = full_csum6(&hdr6, in, len, NEXTHDR_ICMP,
+				&icmp6->icmp6_cksum);
+
+		memcpy(out, in, len);
+		icmp4 = (struct icmphdr *)out;
+		icmp4->type = ICMP_ECHOREPLY;
+		if (i & 1)
+			get_random_bytes(&icmp4->un.echo.id, 2);
+
+		csum = update_icmp4_csum(&hdr6, icmp6, icmp4, len);
+		icmp4->checksum = 0;
+		expected = csum_fold(csum_partial(out, len, 0));
+		success &= assert_csum(expected, csum, "6to4");
+	}
+
+	return success;
+}
+
+#define SHARE_HEAD_LEN 100
+#define SHARE_FRAG_LEN 1000
+#define SHARE_LIST_LEN 500
+#define SHARE_TOTAL_LEN (SHARE_HEAD_LEN + 2 * SHARE_FRAG_LEN + SHARE_LIST_LEN)
+
+/*
+ * Builds a packet with random data in its head, two frags and a frag_list
+ * member. (In that order.)
+ */
+static struct sk_buff *create_scattered_skb(void)
+{
+	struct sk_buff *skb;
+	struct sk_buff *member;
+	struct page *page;
+	int i;
+
+	skb = alloc_skb(SHARE_HEAD_LEN, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+	get_random_bytes(skb_put(skb, SHARE_HEAD_LEN), SHARE_HEAD_LEN);
+
+	for (i = 0; i < 2; i++) {
+		page = alloc_page(GFP_KERNEL);
+		if (!page)
+			goto fail;
+		get_random_bytes(page_address(page), PAGE_SIZE);
+		skb_add_rx_frag(skb, i, page, 16, SHARE_FRAG_LEN, PAGE_SIZE);
+	}
+
+	member = alloc_skb(SHARE_LIST_LEN, GFP_KERNEL);
+	if (!member)
+		goto fail;
+	get_random_bytes(skb_put(member, SHARE_LIST_LEN), SHARE_LIST_LEN);
+	skb_shinfo(skb)->frag_list = member;
+	skb->len += SHARE_LIST_LEN;
+	skb->data_len += SHARE_LIST_LEN;
+	skb->truesize += member->truesize;
+
+	return skb;
+
+fail:
+	kfree_skb(skb);
+	return NULL;
+}
+
+static bool test_share_range_single(struct sk_buff *from,
+		unsigned int offset, unsigned int len)
+{
+	static unsigned char expected[SHARE_TOTAL_LEN];
+	static unsigned char actual[SHARE_TOTAL_LEN];
+	struct sk_buff *to;
+	bool success = true;
+
+	to = alloc_skb(HDRS_LEN, GFP_KERNEL);
+	if (!to)
+		return false;
+	skb_put(to, HDRS_LEN);
+
+	success &= ASSERT_INT(0, share_range(to, from, offset, len),
+			"share_range(%u, %u) result", offset, len);
+	if (!success)
+		goto end;
+
+	success &= ASSERT_UINT(HDRS_LEN, skb_headlen(to), "head length");
+	success &= ASSERT_UINT(HDRS_LEN + len, to->len, "length");
+	success &= ASSERT_INT(0, skb_copy_bits(from, offset, expected, len),
+			"expected copy");
+	success &= ASSERT_INT(0, skb_copy_bits(to, HDRS_LEN, actual, len),
+			"actual copy");
+	success &= ASSERT_INT(0, memcmp(expected, actual, len),
+			"share_range(%u, %u) content", offset, len);
+
+end:
+	kfree_skb(to);
+	return success;
+}
+
+static bool test_share_range(void)
+{
+	unsigned int boundaries[] = {
+		0,
+		SHARE_HEAD_LEN,
+		SHARE_HEAD_LEN + SHARE_FRAG_LEN,
+		SHARE_HEAD_LEN + 2 * SHARE_FRAG_LEN,
+		SHARE_TOTAL_LEN,
+	};
+	struct sk_buff *from;
+	struct sk_buff *to;
+	unsigned int b1, b2;
+	bool success = true;
+
+	from = create_scattered_skb();
+	if (!from)
+		return false;
+
+	/* Ranges that begin and end at, or right next to, every boundary */
+	for (b1 = 0; b1 < ARRAY_SIZE(boundaries); b1++) {
+		for (b2 = b1 + 1; b2 < ARRAY_SIZE(boundaries); b2++) {
+			success &= test_share_range_single(from,
+					boundaries[b1], boundaries[b2]
+							- boundaries[b1]);
+			success &= test_share_range_single(from,
+					boundaries[b1] + 1, boundaries[b2]
+							- boundaries[b1] - 2);
+		}
+	}
+
+	/* Frag pages must be referenced, not copied. */
+	to = alloc_skb(0, GFP_KERNEL);
+	if (!to)
+		goto end;
+	success &= ASSERT_INT(0, share_range(to, from, SHARE_HEAD_LEN + 8, 8),
+			"frag share result");
+	success &= ASSERT_PTR(skb_frag_page(&skb_shinfo(from)->frags[0]),
+			skb_frag_page(&skb_shinfo(to)->frags[0]),
+			"frag page");
+	success &= ASSERT_UINT(16 + 8, skb_frag_off(&skb_shinfo(to)->frags[0]),
+			"frag offset");
+	kfree_skb(to);
+
+	/* Out of bounds */
+	to = alloc_skb(0, GFP_KERNEL);
+	if (!to)
+		goto end;
+	success &= ASSERT_INT(-EFAULT,
+			share_range(to, from, SHARE_TOTAL_LEN - 4, 8),
+			"out of bounds");
+	kfree_skb(to);
+
+end:
+	kfree_skb(from);
+	return success;
+}
+
 static int translate_packet_test_init(void)
 {
 	struct test_group test = {
@@ -366,6 +733,12 @@ static int translate_packet_test_init(void)
 	test_group_test(&test, test_function_has_nonzero_segments_left, "Segments left indicator function");
 	test_group_test(&test, test_function_icmp4_minimum_mtu, "ICMP4 Minimum MTU function");
 
+	test_group_test(&test, test_csum_tcp, "TCP checksum update");
+	test_group_test(&test, test_csum_udp, "UDP checksum update");
+	test_group_test(&test, test_csum_icmp, "ICMP checksum update");
+
+	test_group_test(&test, test_share_range, "Slow Path page sharing");
+
 	return test_group_end(&test);
 }
 
@@ -0,0 +1,151 @@
+#!/bin/bash
+
+# XDP fast path loopback benchmark.
+#
+# Builds three network namespaces on this host:
+#
+#	jxclient6 --- jxsiit --- jxserver4
+#
+# jxsiit runs a SIIT instance. jxclient6 floods jxserver4 with IPv6 UDP packets
+# (using pktgen), once with the kernel module alone and once with the XDP fast
+# path attached, and the script prints the rate at which the translated
+# packets reached jxserver4 in each case.
+#
+# Needs root, an installed Jool (kernel module and a jool_siit configured with
+# --with-xdp), nsenter, ethtool and bc. The veths need a kernel with veth XDP
+# and GRO NAPI support (5.13+).
+#
+# Arguments:
+#
+# $1: Number of packets to send per run. (Default: 2000000)
+# $2: UDP payload size. (Default: 18, ie. the smallest Ethernet frame)
+
+PACKETS=${1:-2000000}
+PAYLOAD=${2:-18}
+
+CLIENT=jxclient6
+SIIT=jxsiit
+SERVER=jxserver4
+
+
+# Like `ip netns exec $SIIT`, except it does not mount a private bpffs, which
+# would hide the fast path's pinned maps from the next command.
+function siit() {
+	nsenter --net=/run/netns/$SIIT "$@"
+}
+
+function setup() {
+	ip netns add $CLIENT
+	ip netns add $SIIT
+	ip netns add $SERVER
+
+	ip link add name to_siit6 type veth peer name to_client
+	ip link set dev to_siit6 netns $CLIENT
+	ip link set dev to_client netns $SIIT
+	ip link add name to_server type veth peer name to_siit4
+	ip link set dev to_server netns $SIIT
+	ip link set dev to_siit4 netns $SERVER
+
+	ip netns exec $CLIENT ip link set up dev lo
+	ip netns exec $CLIENT ip link set up dev to_siit6
+	ip netns exec $CLIENT ip addr add 2001:db8:1::2/64 dev to_siit6 nodad
+	ip netns exec $CLIENT ip route add 64:ff9b::/96 via 2001:db8:1::1
+	# pktgen needs to compute the UDP checksum itself.
+	ip netns exec $CLIENT ethtool -K to_siit6 tx off > /dev/null
+
+	ip netns exec $SIIT ip link set up dev lo
+	ip netns exec $SIIT sysctl -qw net.ipv4.conf.all.forwarding=1
+	ip netns exec $SIIT sysctl -qw net.ipv6.conf.all.forwarding=1
+	ip netns exec $SIIT ip link set up dev to_client
+	ip netns exec $SIIT ip addr add 2001:db8:1::1/64 dev to_client nodad
+	ip netns exec $SIIT ip link set up dev to_server
+	ip netns exec $SIIT ip addr add 198.51.100.1/24 dev to_server
+
+	ip netns exec $SERVER ip link set up dev lo
+	ip netns exec $SERVER ip link set up dev to_siit4
+	ip netns exec $SERVER ip addr add 198.51.100.2/24 dev to_siit4
+	ip netns exec $SERVER ip route add 192.0.2.0/24 via 198.51.100.1
+	# Lets the veth accept redirected XDP frames.
+	ip netns exec $SERVER ethtool -K to_siit4 gro on > /dev/null
+
+	modprobe jool_siit
+	modprobe pktgen
+
+	siit jool_siit instance add jxbench --netfilter \
+			--pool6 64:ff9b::/96
+	siit jool_siit -i jxbench eamt add \
+			2001:db8:1::/120 192.0.2.0/24
+
+	# Populate the neighbor tables. (The fast path punts on missing ones.)
+	ip netns exec $CLIENT ping -c 1 -W 1 64:ff9b::198.51.100.2 > /dev/null
+}
+
+function cleanup() {
+	siit jool_siit -i jxbench xdp detach to_client 2> /dev/null
+	siit jool_siit instance remove jxbench 2> /dev/null
+	rm -rf /sys/fs/bpf/jool/jxbench
+	ip netns del $CLIENT 2> /dev/null
+	ip netns del $SIIT 2> /dev/null
+	ip netns del $SERVER 2> /dev/null
+}
+
+# $1: namespace, $2: file, $3: command
+function pgset() {
+	ip netns exec $1 sh -c "echo '$3' > /proc/net/pktgen/$2"
+}
+
+function configure_pktgen() {
+	MAC=$(ip netns exec $SIIT cat /sys/class/net/to_client/address)
+
+	pgset $CLIENT kpktgend_0 "rem_device_all"
+	pgset $CLIENT kpktgend_0 "add_device to_siit6"
+	pgset $CLIENT to_siit6 "count $PACKETS"
+	pgset $CLIENT to_siit6 "clone_skb 0"
+	pgset $CLIENT to_siit6 "pkt_size $((14 + 40 + 8 + PAYLOAD))"
+	pgset $CLIENT to_siit6 "delay 0"
+	pgset $CLIENT to_siit6 "dst_mac $MAC"
+	pgset $CLIENT to_siit6 "src6 2001:db8:1::2"
+	pgset $CLIENT to_siit6 "dst6 64:ff9b::c633:6402"
+	pgset $CLIENT to_siit6 "udp_src_min 1024"
+	pgset $CLIENT to_siit6 "udp_src_max 1087"
+	pgset $CLIENT to_siit6 "udp_dst_min 5000"
+	pgset $CLIENT to_siit6 "udp_dst_max 5000"
+	pgset $CLIENT to_siit6 "flag UDPSRC_RND"
+	pgset $CLIENT to_siit6 "flag UDPCSUM"
+}
+
+function rx_packets() {
+	ip netns exec $SERVER cat /sys/class/net/to_siit4/statistics/rx_packets
+}
+
+# $1: label
+function run() {
+	BEFORE=$(rx_packets)
+	START=$(date +%s.%N)
+	pgset $CLIENT pgctrl "start"
+	END=$(date +%s.%N)
+	# Let the translator drain its queues.
+	sleep 1
+	RCVD=$(( $(rx_packets) - BEFORE ))
+
+	echo "$1:"
+	echo "	Packets translated: $RCVD/$PACKETS"
+	echo "	Packets/second: $(echo "$RCVD / ($END - $START)" | bc)"
+}
+
+
+if [ $(id -u) -ne 0 ]; then
+	echo "This benchmark needs root."
+	exit 1
+fi
+
+cleanup
+setup
+trap cleanup EXIT
+configure_pktgen
+
+run "Netfilter"
+
+siit jool_siit -i jxbench xdp attach to_client || exit 1
+run "XDP"
+siit jool_siit -i jxbench xdp display